@@ -27,6 +27,8 @@
 #include <QColorDialog>
 #include <QtConcurrent/QtConcurrent>
 
+#include <numeric>
+
 namespace pdfplugin
 {
 
@@ -39,7 +41,8 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     m_widget(widget),
     m_needUpdateImage(false),
     m_outputPreviewWidget(new OutputPreviewWidget(this)),
-    m_futureWatcher(nullptr)
+    m_futureWatcher(nullptr),
+    m_spotColorsFutureWatcher(nullptr)
 {
     ui->setupUi(this);
 
@@ -60,7 +63,32 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     m_outputPreviewWidget->setInkMapper(&m_inkMapper);
     ui->inksTreeWidget->setMinimumHeight(pdf::PDFWidgetUtils::scaleDPI_y(ui->inksTreeWidget, 150));
 
-    m_inkMapper.createSpotColors(ui->simulateSeparationsCheckBox->isChecked());
+    // Spot colors of the current page are found immediately, so preview
+    // can be displayed, the rest of the document is scanned in the background.
+    const size_t pageCount = document->getCatalog()->getPageCount();
+    const pdf::PDFInteger currentPageIndex = ui->pageIndexScrollBar->value() - 1;
+    if (currentPageIndex >= 0 && size_t(currentPageIndex) < pageCount)
+    {
+        m_inkMapper.addSpotColors({ currentPageIndex }, ui->simulateSeparationsCheckBox->isChecked());
+    }
+
+    std::vector<pdf::PDFInteger> pageIndices(pageCount, 0);
+    std::iota(pageIndices.begin(), pageIndices.end(), 0);
+    pageIndices.erase(std::remove(pageIndices.begin(), pageIndices.end(), currentPageIndex), pageIndices.end());
+
+    if (!pageIndices.empty())
+    {
+        // Pages are scanned sequentially in the background thread, so the scan
+        // doesn't delay rendering of the preview in the page thread pool.
+        const pdf::PDFInkMapper* inkMapper = &m_inkMapper;
+        auto findSpotColors = [inkMapper, pageIndices = qMove(pageIndices)]() { return inkMapper->findSpotColors(pageIndices, false); };
+
+        m_spotColorsFuture = QtConcurrent::run(findSpotColors);
+        m_spotColorsFutureWatcher = new QFutureWatcher<std::vector<pdf::PDFInkMapper::ColorInfo>>();
+        connect(m_spotColorsFutureWatcher, &QFutureWatcher<std::vector<pdf::PDFInkMapper::ColorInfo>>::finished, this, &OutputPreviewDialog::onSpotColorsFound);
+        m_spotColorsFutureWatcher->setFuture(m_spotColorsFuture);
+    }
+
     connect(ui->simulateSeparationsCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::onSimulateSeparationsChecked);
     connect(ui->simulatePaperColorCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::onSimulatePaperColorChecked);
     connect(ui->redPaperColorEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &OutputPreviewDialog::onPaperColorChanged);
@@ -72,6 +100,7 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     connect(ui->displayTextCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::updatePageImage);
     connect(ui->displayTilingPatternsCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::updatePageImage);
     connect(ui->displayVectorGraphicsCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::updatePageImage);
+    connect(ui->reducedPrecisionCheckBox, &QCheckBox::clicked, this, &OutputPreviewDialog::updatePageImage);
     connect(ui->inksTreeWidget->model(), &QAbstractItemModel::dataChanged, this, &OutputPreviewDialog::onInksChanged);
     connect(ui->alarmColorButton, &QPushButton::clicked, this, &OutputPreviewDialog::onAlarmColorButtonClicked);
     connect(ui->displayModeComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &OutputPreviewDialog::onDisplayModeChanged);
@@ -90,6 +119,13 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
 
 OutputPreviewDialog::~OutputPreviewDialog()
 {
+    if (m_spotColorsFutureWatcher)
+    {
+        m_spotColorsFuture.waitForFinished();
+        delete m_spotColorsFutureWatcher;
+        m_spotColorsFutureWatcher = nullptr;
+    }
+
     delete ui;
 }
 
@@ -116,6 +152,22 @@ void OutputPreviewDialog::showEvent(QShowEvent* event)
 
 void OutputPreviewDialog::updateInks()
 {
+    // Inks can be updated, when new spot colors are found,
+    // so we must keep inks, which were turned off by the user.
+    QSet<QString> uncheckedInks;
+    for (int i = 0; i < ui->inksTreeWidget->topLevelItemCount(); ++i)
+    {
+        QTreeWidgetItem* rootItem = ui->inksTreeWidget->topLevelItem(i);
+        for (int j = 0; j < rootItem->childCount(); ++j)
+        {
+            QTreeWidgetItem* childItem = rootItem->child(j);
+            if (childItem->checkState(0) != Qt::Checked)
+            {
+                uncheckedInks.insert(childItem->text(0));
+            }
+        }
+    }
+
     ui->inksTreeWidget->setUpdatesEnabled(false);
     ui->inksTreeWidget->clear();
 
@@ -156,7 +208,7 @@ void OutputPreviewDialog::updateInks()
         }
 
         item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-        item->setCheckState(0, Qt::Checked);
+        item->setCheckState(0, uncheckedInks.contains(colorInfo.textName) ? Qt::Unchecked : Qt::Checked);
         item->setData(0, Qt::UserRole, colorIndex++);
     }
 
@@ -268,7 +320,9 @@ void OutputPreviewDialog::updatePageImage()
 
     m_needUpdateImage = false;
 
-    const pdf::PDFPage* page = m_document->getCatalog()->getPage(ui->pageIndexScrollBar->value() - 1);
+    const pdf::PDFCatalog* catalog = m_document->getCatalog();
+    const pdf::PDFInteger pageIndex = ui->pageIndexScrollBar->value() - 1;
+    const pdf::PDFPage* page = (pageIndex >= 0 && size_t(pageIndex) < catalog->getPageCount()) ? catalog->getPage(pageIndex) : nullptr;
     if (!page)
     {
         m_outputPreviewWidget->clear();
@@ -319,6 +373,7 @@ void OutputPreviewDialog::updatePageImage()
     flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayShadings, ui->displayShadingCheckBox->isChecked());
     flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayTilingPatterns, ui->displayTilingPatternsCheckBox->isChecked());
     flags.setFlag(pdf::PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::ReducedPrecisionStorage, ui->reducedPrecisionCheckBox->isChecked());
 
     m_inkMapperForRendering = m_inkMapper;
     QSize renderSize = m_outputPreviewWidget->getPageImageSizeHint();
@@ -366,12 +421,10 @@ OutputPreviewDialog::RenderedImage OutputPreviewDialog::renderPage(const pdf::PD
     QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
     pdf::PDFDrawWidgetProxy* proxy = m_widget->getDrawWidgetProxy();
     pdf::PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
-    pdf::PDFTransparencyRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
-                                          &m_inkMapperForRendering, settings, pagePointToDevicePoint);
+    pdf::PDFTiledTransparencyRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
+                                               &m_inkMapperForRendering, settings, pagePointToDevicePoint);
 
-    renderer.beginPaint(imageSize);
-    result.errors = renderer.processContents();
-    renderer.endPaint();
+    result.errors = renderer.render(imageSize);
 
     QImage image = renderer.toImage(false, true, paperColor);
 
@@ -406,6 +459,26 @@ bool OutputPreviewDialog::isRenderingDone() const
     return !(m_futureWatcher && m_futureWatcher->isRunning());
 }
 
+void OutputPreviewDialog::onSpotColorsFound()
+{
+    if (m_spotColorsFuture.isFinished())
+    {
+        std::vector<pdf::PDFInkMapper::ColorInfo> spotColors = m_spotColorsFuture.result();
+        m_spotColorsFuture = QFuture<std::vector<pdf::PDFInkMapper::ColorInfo>>();
+        m_spotColorsFutureWatcher->deleteLater();
+        m_spotColorsFutureWatcher = nullptr;
+
+        const size_t separationCount = m_inkMapper.getSeparations(4).size();
+        m_inkMapper.mergeSpotColors(spotColors, ui->simulateSeparationsCheckBox->isChecked());
+
+        if (m_inkMapper.getSeparations(4).size() != separationCount)
+        {
+            updateInks();
+            updatePageImage();
+        }
+    }
+}
+
 void OutputPreviewDialog::accept()
 {
     if (!isRenderingDone())
@@ -63,6 +63,7 @@ private:
     void onInksChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
     void onInkCoverageLimitChanged(double value);
     void onRichBlackLimtiChanged(double value);
+    void onSpotColorsFound();
 
     struct RenderedImage
     {
@@ -91,6 +92,9 @@ private:
 
     QFuture<RenderedImage> m_future;
     QFutureWatcher<RenderedImage>* m_futureWatcher;
+
+    QFuture<std::vector<pdf::PDFInkMapper::ColorInfo>> m_spotColorsFuture;
+    QFutureWatcher<std::vector<pdf::PDFInkMapper::ColorInfo>>* m_spotColorsFutureWatcher;
 };
 
 }   // namespace pdf
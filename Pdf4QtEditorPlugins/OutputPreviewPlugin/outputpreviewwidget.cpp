@@ -446,7 +446,9 @@ void OutputPreviewWidget::buildInfoBoxItems()
                     Q_ASSERT(point.y() >= 0);
                     Q_ASSERT(point.y() < m_originalProcessBitmap.getHeight());
 
-                    pdf::PDFColorBuffer buffer = m_originalProcessBitmap.getPixel(point.x(), point.y());
+                    std::vector<pdf::PDFColorComponent> pixel(m_originalProcessBitmap.getPixelSize(), 0.0f);
+                    pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
+                    m_originalProcessBitmap.readPixel(point.x(), point.y(), buffer);
                     for (int i = 0; i < pixelFormat.getColorChannelCount(); ++i)
                     {
                         const pdf::PDFColorComponent color = buffer[i] * 100.0f;
@@ -667,11 +669,14 @@ std::vector<pdf::PDFColorComponent> OutputPreviewWidget::getInkCoverageImpl() co
         const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
         result.resize(colorChannelCount, 0.0f);
 
+        std::vector<pdf::PDFColorComponent> pixel(m_originalProcessBitmap.getPixelSize(), 0.0f);
+        pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
+
         for (size_t y = 0; y < m_originalProcessBitmap.getHeight(); ++y)
         {
             for (size_t x = 0; x < m_originalProcessBitmap.getWidth(); ++x)
             {
-                const pdf::PDFConstColorBuffer buffer = m_originalProcessBitmap.getPixel(x, y);
+                m_originalProcessBitmap.readPixel(x, y, buffer);
                 const pdf::PDFColorComponent alpha = pixelFormat.hasOpacityChannel() ? buffer[pixelFormat.getOpacityChannelIndex()] : 1.0f;
 
                 for (uint8_t i = 0; i < colorChannelCount; ++i)
@@ -743,11 +748,14 @@ OutputPreviewWidget::AlarmImageInfo OutputPreviewWidget::getAlarmRichBlackImageI
 
         const uint8_t blackChannelIndex = pixelFormat.getProcessColorChannelIndexStart() + 3;
 
+        std::vector<pdf::PDFColorComponent> pixel(m_originalProcessBitmap.getPixelSize(), 0.0f);
+        pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
+
         for (int y = 0; y < height; ++y)
         {
             for (int x = 0; x < width; ++x)
             {
-                pdf::PDFConstColorBuffer buffer = m_originalProcessBitmap.getPixel(x, y);
+                m_originalProcessBitmap.readPixel(x, y, buffer);
                 pdf::PDFColorComponent blackInk = buffer[blackChannelIndex];
                 pdf::PDFColorComponent inkCoverage = m_originalProcessBitmap.getPixelInkCoverage(x, y);
                 pdf::PDFColorComponent inkCoverageWithoutBlack = inkCoverage - blackInk;
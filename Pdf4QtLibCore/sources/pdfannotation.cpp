@@ -1297,7 +1297,12 @@ PDFAnnotationManager::PDFAnnotationManager(PDFFontCache* fontCache,
     m_features(features),
     m_target(target)
 {
+    m_appearanceCache.setMaxCost(APPEARANCE_CACHE_LIMIT);
 
+    if (m_optionalActivity)
+    {
+        connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearAppearanceCache);
+    }
 }
 
 PDFAnnotationManager::~PDFAnnotationManager()
@@ -1611,10 +1616,6 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     QRectF annotationRectangle = annotation.annotation->getRectangle();
     QRectF formBoundingBox = loader.readRectangle(formDictionary->get("BBox"), QRectF());
     QTransform formMatrix = loader.readMatrixFromDictionary(formDictionary, "Matrix", QTransform());
-    QByteArray content = m_document->getDecodedStream(formStream);
-    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
-    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
-    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
 
     if (formBoundingBox.isEmpty() || annotationRectangle.isEmpty())
     {
@@ -1648,22 +1649,23 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     // Step 3) - compute final matrix AA
     QTransform AA = formMatrix * A;
 
-    bool isContentVisible = false;
+    AppearanceCacheKey key;
+    key.annotation = annotation.annotation->getSelfReference();
+    key.appearance = annotation.appearance;
+    key.appearanceState = annotation.annotation->getAppearanceState();
+    key.features = features;
+    key.cmsId = cms->getId();
+    key.matrix = { AA.m11(), AA.m12(), AA.m21(), AA.m22(), AA.dx(), AA.dy() };
+
+    AppearanceCacheEntry entry = getCompiledAppearance(key, annotation, formStream, AA, features, page, cms);
+    const bool isContentVisible = entry.isContentVisible;
 
     // Draw annotation
+    if (isContentVisible && entry.compiledAppearance->isValid())
     {
+        // Annotations are not clipped to the crop box, so crop box is empty
         PDFPainterStateGuard guard(painter);
-        PDFPainter pdfPainter(painter, features, userSpaceToDeviceSpace, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
-        pdfPainter.initializeProcessor();
-
-        // Jakub Melka: we must check, that we do not display annotation disabled by optional content
-        PDFObjectReference oc = annotation.annotation->getOptionalContent();
-        isContentVisible = !oc.isValid() || !pdfPainter.isContentSuppressedByOC(oc);
-
-        if (isContentVisible)
-        {
-            pdfPainter.processForm(AA, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
-        }
+        entry.compiledAppearance->draw(painter, QRectF(), userSpaceToDeviceSpace, features, painter->opacity());
     }
 
     // Draw highlighting of fields, but only, if target is View,
@@ -1677,17 +1679,90 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     }
 }
 
+PDFAnnotationManager::AppearanceCacheEntry PDFAnnotationManager::getCompiledAppearance(const AppearanceCacheKey& key,
+                                                                                       const PageAnnotation& annotation,
+                                                                                       const PDFStream* formStream,
+                                                                                       const QTransform& formMatrix,
+                                                                                       PDFRenderer::Features features,
+                                                                                       const PDFPage* page,
+                                                                                       const PDFCMS* cms) const
+{
+    const bool isCacheable = key.annotation.isValid();
+
+    if (isCacheable)
+    {
+        QMutexLocker lock(&m_appearanceCacheMutex);
+        if (const AppearanceCacheEntry* entry = m_appearanceCache.object(key))
+        {
+            return *entry;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* formDictionary = formStream->getDictionary();
+    QRectF formBoundingBox = loader.readRectangle(formDictionary->get("BBox"), QRectF());
+    QByteArray content = m_document->getDecodedStream(formStream);
+    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
+    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
+    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
+
+    AppearanceCacheEntry entry;
+    entry.compiledAppearance = std::make_shared<PDFPrecompiledPage>();
+
+    QList<PDFRenderError> errors;
+    {
+        PDFPrecompiledPageGenerator generator(entry.compiledAppearance.get(), features, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
+        generator.initializeProcessor();
+
+        // Jakub Melka: we must check, that we do not display annotation disabled by optional content
+        PDFObjectReference oc = annotation.annotation->getOptionalContent();
+        entry.isContentVisible = !oc.isValid() || !generator.isContentSuppressedByOC(oc);
+
+        if (entry.isContentVisible)
+        {
+            generator.processForm(formMatrix, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+        }
+    }
+
+    entry.compiledAppearance->optimize();
+    entry.compiledAppearance->finalize(timer.nsecsElapsed(), qMove(errors));
+
+    if (isCacheable)
+    {
+        const qsizetype cost = qMax<qsizetype>(entry.compiledAppearance->getMemoryConsumptionEstimate(), 1);
+
+        QMutexLocker lock(&m_appearanceCacheMutex);
+        m_appearanceCache.insert(key, new AppearanceCacheEntry(entry), cost);
+    }
+
+    return entry;
+}
+
+void PDFAnnotationManager::clearAppearanceCache()
+{
+    QMutexLocker lock(&m_appearanceCacheMutex);
+    m_appearanceCache.clear();
+}
+
 void PDFAnnotationManager::setDocument(const PDFModifiedDocument& document)
 {
     if (m_document != document)
     {
         m_document = document;
-        m_optionalActivity = document.getOptionalContentActivity();
+        setOptionalActivity(document.getOptionalContentActivity());
 
         if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation))
         {
             m_pageAnnotations.clear();
         }
+
+        if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation) || document.hasFlag(PDFModifiedDocument::FormField) || document.hasFlag(PDFModifiedDocument::PageContents))
+        {
+            clearAppearanceCache();
+        }
     }
 }
 
@@ -1797,6 +1872,7 @@ PDFMeshQualitySettings PDFAnnotationManager::getMeshQualitySettings() const
 void PDFAnnotationManager::setMeshQualitySettings(const PDFMeshQualitySettings& meshQualitySettings)
 {
     m_meshQualitySettings = meshQualitySettings;
+    clearAppearanceCache();
 }
 
 PDFFontCache* PDFAnnotationManager::getFontCache() const
@@ -1806,7 +1882,11 @@ PDFFontCache* PDFAnnotationManager::getFontCache() const
 
 void PDFAnnotationManager::setFontCache(PDFFontCache* fontCache)
 {
-    m_fontCache = fontCache;
+    if (m_fontCache != fontCache)
+    {
+        m_fontCache = fontCache;
+        clearAppearanceCache();
+    }
 }
 
 const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() const
@@ -1816,7 +1896,23 @@ const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() co
 
 void PDFAnnotationManager::setOptionalActivity(const PDFOptionalContentActivity* optionalActivity)
 {
-    m_optionalActivity = optionalActivity;
+    if (m_optionalActivity != optionalActivity)
+    {
+        // Precompiled appearance streams depend on the state of optional content
+        if (m_optionalActivity)
+        {
+            disconnect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearAppearanceCache);
+        }
+
+        m_optionalActivity = optionalActivity;
+
+        if (m_optionalActivity)
+        {
+            connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearAppearanceCache);
+        }
+
+        clearAppearanceCache();
+    }
 }
 
 PDFAnnotationManager::Target PDFAnnotationManager::getTarget() const
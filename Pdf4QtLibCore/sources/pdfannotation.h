@@ -32,6 +32,7 @@
 #include "pdftextlayout.h"
 
 #include <QCursor>
+#include <QCache>
 #include <QPainterPath>
 
 #include <array>
@@ -1499,6 +1500,11 @@ public:
     PDFFormManager* getFormManager() const;
     void setFormManager(PDFFormManager* formManager);
 
+    /// Clears cache of precompiled appearance streams. Cache is cleared automatically,
+    /// when annotations or form fields are modified, or when state of optional
+    /// content is changed.
+    void clearAppearanceCache();
+
     struct PageAnnotation
     {
         PDFAppeareanceStreams::Appearance appearance = PDFAppeareanceStreams::Appearance::Normal;
@@ -1623,6 +1629,50 @@ protected:
                                              const PDFCMS* cms,
                                              QPainter* painter) const;
 
+    /// Key of the precompiled appearance stream. Matrix maps form
+    /// space to the annotation's user space (it depends on annotation
+    /// rectangle and for annotations with NoZoom flag, on the device).
+    struct AppearanceCacheKey
+    {
+        PDFObjectReference annotation;
+        PDFAppeareanceStreams::Appearance appearance = PDFAppeareanceStreams::Appearance::Normal;
+        QByteArray appearanceState;
+        PDFRenderer::Features::Int features = 0;
+        quint64 cmsId = 0;
+        std::array<PDFReal, 6> matrix = { };
+
+        bool operator==(const AppearanceCacheKey& other) const
+        {
+            return std::tie(annotation, appearance, appearanceState, features, cmsId, matrix) ==
+                   std::tie(other.annotation, other.appearance, other.appearanceState, other.features, other.cmsId, other.matrix);
+        }
+
+        friend inline size_t qHash(const AppearanceCacheKey& key, size_t seed = 0)
+        {
+            seed = qHashMulti(seed, key.annotation.objectNumber, key.annotation.generation, int(key.appearance), key.appearanceState, key.features, key.cmsId);
+            return qHashRange(key.matrix.cbegin(), key.matrix.cend(), seed);
+        }
+    };
+
+    struct AppearanceCacheEntry
+    {
+        std::shared_ptr<PDFPrecompiledPage> compiledAppearance;
+        bool isContentVisible = false;
+    };
+
+    /// Returns precompiled appearance stream. If it is not in the cache, then
+    /// appearance stream is compiled and inserted into the cache. Annotations
+    /// without reference are not cached.
+    AppearanceCacheEntry getCompiledAppearance(const AppearanceCacheKey& key,
+                                               const PageAnnotation& annotation,
+                                               const PDFStream* formStream,
+                                               const QTransform& formMatrix,
+                                               PDFRenderer::Features features,
+                                               const PDFPage* page,
+                                               const PDFCMS* cms) const;
+
+    static constexpr qsizetype APPEARANCE_CACHE_LIMIT = 32 * 1024 * 1024;
+
     const PDFDocument* m_document;
 
     PDFFontCache* m_fontCache;
@@ -1634,6 +1684,9 @@ protected:
 
     mutable QMutex m_mutex;
     mutable std::map<PDFInteger, PageAnnotations> m_pageAnnotations;
+
+    mutable QMutex m_appearanceCacheMutex;
+    mutable QCache<AppearanceCacheKey, AppearanceCacheEntry> m_appearanceCache;
     Target m_target = Target::View;
 };
 
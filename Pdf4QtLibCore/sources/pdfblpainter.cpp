@@ -19,6 +19,7 @@
 #include "pdffont.h"
 
 #include <QThread>
+#include <QPainter>
 #include <QRawFont>
 #include <QPainterPath>
 #include <QPaintEngine>
@@ -33,6 +34,36 @@
 namespace pdf
 {
 
+struct PDFBLDisplayListImpl
+{
+    struct PathData
+    {
+        BLPath path;
+        BLFillRule fillRule = BL_FILL_RULE_NON_ZERO;
+        QRectF boundingRect;
+        bool isStroke = false;
+        bool isFill = false;
+        bool isFillGradient = false;
+        bool isFillTexture = false;
+        double strokeAlpha = 1.0;
+        BLStrokeOptions strokeOptions;
+        BLRgba32 strokeColor;
+        BLRgba32 fillColor;
+        BLGradient fillGradient;
+        QBrush fillTexture; ///< Texture brush, converted in the same way as in live painting
+    };
+
+    struct ImageData
+    {
+        QImage image;
+        BLImage blImage;
+    };
+
+    std::vector<PathData> paths;
+    std::vector<ImageData> images;
+    qint64 convertedImagesSize = 0; ///< Size of images converted to the Blend2D pixel format
+};
+
 class PDFBLPaintEngine : public QPaintEngine
 {
 public:
@@ -60,7 +91,29 @@ public:
 
     static PaintEngineFeatures getStaticFeatures();
 
+    /// Draws path using cached Blend2D objects and current painter state.
+    /// Returns false, if path can't be drawn this way (clipping must be resolved).
+    bool drawCachedPath(const PDFBLDisplayListImpl::PathData& data);
+
+    /// Draws image using cached Blend2D objects and current painter state.
+    /// Returns false, if image can't be drawn this way (clipping must be resolved).
+    bool drawCachedImage(const PDFBLDisplayListImpl::ImageData& data);
+
+    /// Get BL path from path
+    static BLPath getBLPath(const QPainterPath& path);
+
+    /// Get BL stroke options from the pen
+    static BLStrokeOptions getBLStrokeOptions(const QPen& pen);
+
+    /// Get BL gradient from the brush, if brush is a gradient brush
+    static std::optional<BLGradient> getBLGradient(const QBrush& brush);
+
+    /// Returns BL fill rule
+    static BLFillRule getBLFillRule(Qt::FillRule fillRule);
+
 private:
+    /// Transfers current painter state into the Blend2D context
+    void syncPainterState();
 
     /// Get BL matrix from transformation
     static BLMatrix2D getBLMatrix(QTransform transform);
@@ -74,9 +127,6 @@ private:
     /// Get BL rect from regular rect
     static BLRect getBLRect(QRectF rect);
 
-    /// Get BL path from path
-    static BLPath getBLPath(const QPainterPath& path);
-
     /// Set pen to the context
     static void setBLPen(BLContext& context, const QPen& pen);
 
@@ -788,8 +838,8 @@ QPaintEngine::Type PDFBLPaintEngine::type() const
 
 QPaintEngine::PaintEngineFeatures PDFBLPaintEngine::getStaticFeatures()
 {
-    return PrimitiveTransform | PixmapTransform | LinearGradientFill |
-           RadialGradientFill | ConicalGradientFill | AlphaBlend |
+    return PrimitiveTransform | PatternTransform | PixmapTransform | PatternBrush |
+           LinearGradientFill | RadialGradientFill | ConicalGradientFill | AlphaBlend |
            PorterDuff | PainterPaths | Antialiasing | ConstantOpacity |
            BlendModes | PaintOutsidePaintEvent;
 }
@@ -860,63 +910,68 @@ BLPath PDFBLPaintEngine::getBLPath(const QPainterPath& path)
 }
 
 void PDFBLPaintEngine::setBLPen(BLContext& context, const QPen& pen)
+{
+    const QColor color = pen.color();
+
+    context.setStrokeAlpha(color.alphaF());
+    context.setStrokeOptions(getBLStrokeOptions(pen));
+    context.setStrokeStyle(BLRgba32(color.rgba()));
+}
+
+BLStrokeOptions PDFBLPaintEngine::getBLStrokeOptions(const QPen& pen)
 {
     const Qt::PenCapStyle capStyle = pen.capStyle();
     const Qt::PenJoinStyle joinStyle = pen.joinStyle();
-    const QColor color = pen.color();
     const qreal width = pen.widthF();
     const qreal miterLimit = pen.miterLimit();
     const qreal dashOffset = pen.dashOffset();
     const QList<qreal> customDashPattern = pen.dashPattern();
     const Qt::PenStyle penStyle = pen.style();
 
-    context.setStrokeAlpha(pen.color().alphaF());
-    context.setStrokeWidth(width);
-    context.setStrokeMiterLimit(miterLimit);
+    BLStrokeOptions strokeOptions;
+    strokeOptions.width = width;
+    strokeOptions.miterLimit = miterLimit;
 
     switch (capStyle)
     {
     case Qt::FlatCap:
-        context.setStrokeCaps(BL_STROKE_CAP_BUTT);
+        strokeOptions.setCaps(BL_STROKE_CAP_BUTT);
         break;
     case Qt::SquareCap:
-        context.setStrokeCaps(BL_STROKE_CAP_SQUARE);
+        strokeOptions.setCaps(BL_STROKE_CAP_SQUARE);
         break;
     case Qt::RoundCap:
-        context.setStrokeCaps(BL_STROKE_CAP_ROUND);
+        strokeOptions.setCaps(BL_STROKE_CAP_ROUND);
+        break;
+    default:
         break;
     }
 
-    BLArray<double> dashArray;
-
     for (double value : customDashPattern)
     {
-        dashArray.append(value);
+        strokeOptions.dashArray.append(value);
     }
 
-    context.setStrokeDashOffset(dashOffset);
-    context.setStrokeDashArray(dashArray);
+    strokeOptions.dashOffset = dashOffset;
 
     switch (joinStyle)
     {
     case Qt::MiterJoin:
-        context.setStrokeJoin(BL_STROKE_JOIN_MITER_CLIP);
+        strokeOptions.join = BL_STROKE_JOIN_MITER_CLIP;
         break;
     case Qt::BevelJoin:
-        context.setStrokeJoin(BL_STROKE_JOIN_BEVEL);
+        strokeOptions.join = BL_STROKE_JOIN_BEVEL;
         break;
     case Qt::RoundJoin:
-        context.setStrokeJoin(BL_STROKE_JOIN_ROUND);
+        strokeOptions.join = BL_STROKE_JOIN_ROUND;
         break;
     case Qt::SvgMiterJoin:
-        context.setStrokeJoin(BL_STROKE_JOIN_MITER_CLIP);
+        strokeOptions.join = BL_STROKE_JOIN_MITER_CLIP;
+        break;
+    default:
         break;
     }
 
-    context.setStrokeStyle(BLRgba32(color.rgba()));
-
-    BLStrokeOptions strokeOptions = context.strokeOptions();
-
     switch (penStyle)
     {
     case Qt::SolidLine:
@@ -964,10 +1019,67 @@ void PDFBLPaintEngine::setBLPen(BLContext& context, const QPen& pen)
         break;
     }
 
-    context.setStrokeOptions(strokeOptions);
+    return strokeOptions;
 }
 
 void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
+{
+    switch (brush.style())
+    {
+        default:
+        case Qt::SolidPattern:
+        {
+            QColor color = brush.color();
+            BLRgba32 blColor = BLRgba32(color.red(), color.green(), color.blue(), color.alpha());
+            context.setFillStyle(blColor);
+            break;
+        }
+        case Qt::LinearGradientPattern:
+        case Qt::RadialGradientPattern:
+        {
+            std::optional<BLGradient> blGradient = getBLGradient(brush);
+            if (blGradient.has_value())
+            {
+                context.setFillStyle(blGradient.value());
+            }
+            break;
+        }
+        case Qt::TexturePattern:
+        {
+            QImage image = brush.textureImage();
+
+            if (image.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                image.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+
+            // Pattern keeps the image, so pixel data are kept alive by the
+            // (shallow) image copy until Blend2D releases the image.
+            QImage* pixelOwner = new QImage(std::move(image));
+            auto destroyPixelOwner = [](void*, void*, void* userData) noexcept { delete static_cast<QImage*>(userData); };
+
+            BLImage blPatternImage;
+            if (blPatternImage.createFromData(pixelOwner->width(),
+                                              pixelOwner->height(),
+                                              BL_FORMAT_PRGB32,
+                                              const_cast<uchar*>(pixelOwner->constBits()),
+                                              pixelOwner->bytesPerLine(),
+                                              BL_DATA_ACCESS_READ,
+                                              destroyPixelOwner,
+                                              pixelOwner) != BL_SUCCESS)
+            {
+                delete pixelOwner;
+                break;
+            }
+
+            BLPattern blPattern(blPatternImage, BL_EXTEND_MODE_REPEAT, getBLMatrix(brush.transform()));
+            context.setFillStyle(blPattern);
+            break;
+        }
+    }
+}
+
+std::optional<BLGradient> PDFBLPaintEngine::getBLGradient(const QBrush& brush)
 {
     auto setGradientStops = [](BLGradient& blGradient, const auto& qGradient)
     {
@@ -981,14 +1093,6 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
 
     switch (brush.style())
     {
-        default:
-        case Qt::SolidPattern:
-        {
-            QColor color = brush.color();
-            BLRgba32 blColor = BLRgba32(color.red(), color.green(), color.blue(), color.alpha());
-            context.setFillStyle(blColor);
-            break;
-        }
         case Qt::LinearGradientPattern:
         {
             const QGradient* gradient = brush.gradient();
@@ -1002,7 +1106,7 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
                 blLinearGradient.y1 = linearGradient->finalStop().y();
                 BLGradient blGradient(blLinearGradient);
                 setGradientStops(blGradient, *gradient);
-                context.setFillStyle(blGradient);
+                return blGradient;
             }
             break;
         }
@@ -1020,11 +1124,15 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
                 blRadialGradientValues.r0 = radialGradient->radius();
                 BLGradient blGradient(blRadialGradientValues);
                 setGradientStops(blGradient, *gradient);
-                context.setFillStyle(blGradient);
+                return blGradient;
             }
             break;
         }
+        default:
+            break;
     }
+
+    return std::nullopt;
 }
 
 bool PDFBLPaintEngine::loadBLFont(BLFont& font, QString fontName, PDFReal fontSize)
@@ -1290,24 +1398,252 @@ PDFBLPaintEngine::ClipMode PDFBLPaintEngine::resolveClipping(const QPainterPath&
 
 void PDFBLPaintEngine::setFillRule(Qt::FillRule fillRule)
 {
-    BLFillRule blFillRule{};
+    m_blContext->setFillRule(getBLFillRule(fillRule));
+}
 
+BLFillRule PDFBLPaintEngine::getBLFillRule(Qt::FillRule fillRule)
+{
     switch (fillRule)
     {
     case Qt::OddEvenFill:
-        blFillRule = BL_FILL_RULE_EVEN_ODD;
-        break;
+        return BL_FILL_RULE_EVEN_ODD;
 
     case Qt::WindingFill:
-        blFillRule = BL_FILL_RULE_NON_ZERO;
-        break;
+        return BL_FILL_RULE_NON_ZERO;
 
     default:
         Q_ASSERT(false);
         break;
     }
 
-    m_blContext->setFillRule(blFillRule);
+    return BL_FILL_RULE_NON_ZERO;
+}
+
+void PDFBLPaintEngine::syncPainterState()
+{
+    // We are drawing directly onto the Blend2D context, bypassing
+    // the painter, so we must transfer dirty painter state into the context.
+    if (state)
+    {
+        syncState();
+        clearDirty(AllDirty);
+    }
+}
+
+bool PDFBLPaintEngine::drawCachedPath(const PDFBLDisplayListImpl::PathData& data)
+{
+    if (!isActive())
+    {
+        return false;
+    }
+
+    syncPainterState();
+
+    ClipMode clipMode = resolveClipping(m_currentTransform.mapRect(data.boundingRect));
+    switch (clipMode)
+    {
+        case ClipMode::NoClip:
+            break;
+
+        case ClipMode::NotVisible:
+            return true;
+
+        case ClipMode::NeedsResolve:
+            return false;
+    }
+
+    m_blContext->save();
+
+    if (data.isFill)
+    {
+        m_blContext->setFillRule(data.fillRule);
+
+        if (data.isFillGradient)
+        {
+            m_blContext->setFillStyle(data.fillGradient);
+        }
+        else if (data.isFillTexture)
+        {
+            setBLBrush(m_blContext.value(), data.fillTexture);
+        }
+        else
+        {
+            m_blContext->setFillStyle(data.fillColor);
+        }
+
+        m_blContext->fillPath(data.path);
+    }
+
+    if (data.isStroke)
+    {
+        m_blContext->setStrokeAlpha(data.strokeAlpha);
+        m_blContext->setStrokeOptions(data.strokeOptions);
+        m_blContext->setStrokeStyle(data.strokeColor);
+        m_blContext->strokePath(data.path);
+    }
+
+    m_blContext->restore();
+    return true;
+}
+
+bool PDFBLPaintEngine::drawCachedImage(const PDFBLDisplayListImpl::ImageData& data)
+{
+    if (!isActive())
+    {
+        return false;
+    }
+
+    syncPainterState();
+
+    const int width = data.image.width();
+    const int height = data.image.height();
+
+    ClipMode clipMode = resolveClipping(m_currentTransform.mapRect(QRectF(0, 0, width, height)));
+    switch (clipMode)
+    {
+        case ClipMode::NoClip:
+            break;
+
+        case ClipMode::NotVisible:
+            return true;
+
+        case ClipMode::NeedsResolve:
+            return false;
+    }
+
+    m_blContext->blitImage(BLRect(0, 0, width, height), data.blImage, BLRectI(0, 0, width, height));
+    return true;
+}
+
+PDFBLDisplayList::PDFBLDisplayList() :
+    m_impl(std::make_unique<PDFBLDisplayListImpl>())
+{
+
+}
+
+PDFBLDisplayList::~PDFBLDisplayList()
+{
+
+}
+
+bool PDFBLDisplayList::isBlend2DPainter(QPainter* painter)
+{
+    return painter && dynamic_cast<PDFBLPaintEngine*>(painter->paintEngine()) != nullptr;
+}
+
+size_t PDFBLDisplayList::addPath(const QPen& pen, const QBrush& brush, const QPainterPath& path)
+{
+    PDFBLDisplayListImpl::PathData data;
+    data.path = PDFBLPaintEngine::getBLPath(path);
+    data.fillRule = PDFBLPaintEngine::getBLFillRule(path.fillRule());
+    data.boundingRect = path.controlPointRect();
+    data.isStroke = pen.style() != Qt::NoPen;
+    data.isFill = brush.style() != Qt::NoBrush;
+
+    if (data.isStroke)
+    {
+        const QColor color = pen.color();
+        data.strokeAlpha = color.alphaF();
+        data.strokeOptions = PDFBLPaintEngine::getBLStrokeOptions(pen);
+        data.strokeColor = BLRgba32(color.rgba());
+    }
+
+    if (data.isFill)
+    {
+        std::optional<BLGradient> gradient = PDFBLPaintEngine::getBLGradient(brush);
+        if (gradient.has_value())
+        {
+            data.isFillGradient = true;
+            data.fillGradient = std::move(gradient.value());
+        }
+        else if (brush.style() == Qt::TexturePattern)
+        {
+            data.isFillTexture = true;
+            data.fillTexture = brush;
+        }
+        else
+        {
+            QColor color = brush.color();
+            data.fillColor = BLRgba32(color.red(), color.green(), color.blue(), color.alpha());
+        }
+    }
+
+    m_impl->paths.emplace_back(std::move(data));
+    return m_impl->paths.size() - 1;
+}
+
+size_t PDFBLDisplayList::addImage(const QImage& image)
+{
+    PDFBLDisplayListImpl::ImageData data;
+    data.image = image;
+
+    if (data.image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        data.image.convertTo(QImage::Format_ARGB32_Premultiplied);
+        m_impl->convertedImagesSize += data.image.sizeInBytes();
+    }
+
+    // Blend2D context can render asynchronously, so pixel data are
+    // kept alive by the image copy until Blend2D releases the image.
+    QImage* pixelOwner = new QImage(data.image);
+    auto destroyPixelOwner = [](void*, void*, void* userData) noexcept { delete static_cast<QImage*>(userData); };
+
+    if (data.blImage.createFromData(pixelOwner->width(),
+                                    pixelOwner->height(),
+                                    BL_FORMAT_PRGB32,
+                                    const_cast<uchar*>(pixelOwner->constBits()),
+                                    pixelOwner->bytesPerLine(),
+                                    BL_DATA_ACCESS_READ,
+                                    destroyPixelOwner,
+                                    pixelOwner) != BL_SUCCESS)
+    {
+        delete pixelOwner;
+        data.blImage.reset();
+    }
+
+    m_impl->images.emplace_back(std::move(data));
+    return m_impl->images.size() - 1;
+}
+
+bool PDFBLDisplayList::drawPath(QPainter* painter, size_t index) const
+{
+    PDFBLPaintEngine* engine = dynamic_cast<PDFBLPaintEngine*>(painter->paintEngine());
+
+    if (!engine || index >= m_impl->paths.size())
+    {
+        return false;
+    }
+
+    return engine->drawCachedPath(m_impl->paths[index]);
+}
+
+bool PDFBLDisplayList::drawImage(QPainter* painter, size_t index) const
+{
+    PDFBLPaintEngine* engine = dynamic_cast<PDFBLPaintEngine*>(painter->paintEngine());
+
+    if (!engine || index >= m_impl->images.size() || m_impl->images[index].blImage.empty())
+    {
+        return false;
+    }
+
+    return engine->drawCachedImage(m_impl->images[index]);
+}
+
+qint64 PDFBLDisplayList::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this) + sizeof(PDFBLDisplayListImpl);
+    memoryConsumption += sizeof(PDFBLDisplayListImpl::PathData) * m_impl->paths.capacity();
+    memoryConsumption += sizeof(PDFBLDisplayListImpl::ImageData) * m_impl->images.capacity();
+
+    for (const PDFBLDisplayListImpl::PathData& data : m_impl->paths)
+    {
+        memoryConsumption += data.path.capacity() * (sizeof(BLPoint) + sizeof(uint8_t));
+    }
+
+    // Images in the Blend2D pixel format share the data with the page images
+    memoryConsumption += m_impl->convertedImagesSize;
+
+    return memoryConsumption;
 }
 
 }   // namespace pdf
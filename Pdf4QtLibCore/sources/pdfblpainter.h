@@ -20,12 +20,20 @@
 
 #include "pdfglobal.h"
 
+#include <QPen>
+#include <QBrush>
 #include <QImage>
 #include <QPaintDevice>
+#include <QPainterPath>
+
+#include <memory>
+
+class QPainter;
 
 namespace pdf
 {
 class PDFBLPaintEngine;
+struct PDFBLDisplayListImpl;
 
 class PDF4QTLIBCORESHARED_EXPORT PDFBLPaintDevice : public QPaintDevice
 {
@@ -46,6 +54,56 @@ private:
     PDFBLPaintEngine* m_paintEngine;
 };
 
+/// Display list of native Blend2D objects. Paths, pens, brushes and images
+/// are converted to Blend2D objects only once, and then they are replayed
+/// directly onto the Blend2D context each time the display list is drawn,
+/// so no conversion is performed when page is drawn repeatedly. Images
+/// share pixel data with the source images, they are not copied.
+class PDF4QTLIBCORESHARED_EXPORT PDFBLDisplayList
+{
+public:
+    explicit PDFBLDisplayList();
+    ~PDFBLDisplayList();
+
+    PDFBLDisplayList(const PDFBLDisplayList&) = delete;
+    PDFBLDisplayList& operator=(const PDFBLDisplayList&) = delete;
+
+    /// Returns true, if painter paints using the Blend2D paint engine
+    /// \param painter Painter
+    static bool isBlend2DPainter(QPainter* painter);
+
+    /// Adds path into the display list, returns index of the path
+    /// \param pen Pen
+    /// \param brush Brush
+    /// \param path Path
+    size_t addPath(const QPen& pen, const QBrush& brush, const QPainterPath& path);
+
+    /// Adds image into the display list, returns index of the image
+    /// \param image Image
+    size_t addImage(const QImage& image);
+
+    /// Draws path with given index using current state of the painter
+    /// (transformation, composition mode, opacity). If path can't be drawn
+    /// natively (for example, complex clipping is active), false is returned
+    /// and caller must draw the path using the painter.
+    /// \param painter Painter using Blend2D paint engine
+    /// \param index Index of the path
+    bool drawPath(QPainter* painter, size_t index) const;
+
+    /// Draws image with given index into rectangle (0, 0, width, height)
+    /// using current state of the painter. If image can't be drawn natively,
+    /// false is returned and caller must draw the image using the painter.
+    /// \param painter Painter using Blend2D paint engine
+    /// \param index Index of the image
+    bool drawImage(QPainter* painter, size_t index) const;
+
+    /// Returns memory consumption estimate
+    qint64 getMemoryConsumptionEstimate() const;
+
+private:
+    std::unique_ptr<PDFBLDisplayListImpl> m_impl;
+};
+
 }   // namespace pdf
 
 #endif // PDFBLPAINTER_H
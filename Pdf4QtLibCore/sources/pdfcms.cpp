@@ -61,6 +61,8 @@
 #endif
 
 #include <unordered_map>
+#include <atomic>
+#include <cstring>
 
 namespace pdf
 {
@@ -83,6 +85,9 @@ public:
     virtual bool fillRGBBufferFromDeviceGray(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromDeviceRGB(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceGray8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceRGB8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceCMYK8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const override;
     virtual bool transformColorSpace(const ColorSpaceTransformParams& params) const override;
@@ -126,7 +131,8 @@ private:
     /// \param profile Color profile
     /// \param intent Rendering intent
     /// \param isRGB888Buffer If true, 8-bit RGB output buffer is used, otherwise FLOAT RGB output buffer is used
-    cmsHTRANSFORM getTransform(Profile profile, RenderingIntent intent, bool isRGB888Buffer) const;
+    /// \param is8BitInput If true, packed 8-bit input buffer is used, otherwise FLOAT input buffer is used
+    cmsHTRANSFORM getTransform(Profile profile, RenderingIntent intent, bool isRGB888Buffer, bool is8BitInput = false) const;
 
     /// Gets transform for ICC profile from cache. If transform doesn't exist, then it is created.
     /// \param iccData Data of icc profile
@@ -146,7 +152,8 @@ private:
     /// \param profile Color profile
     /// \param intent Rendering intent
     /// \param isRGB888Buffer If true, 8-bit RGB output buffer is used, otherwise FLOAT RGB output buffer is used
-    static constexpr int getCacheKey(Profile profile, RenderingIntent intent, bool isRGB888Buffer) { return ((int(intent) * ProfileCount + profile) << 1) + (isRGB888Buffer ? 1 : 0); }
+    /// \param is8BitInput If true, packed 8-bit input buffer is used, otherwise FLOAT input buffer is used
+    static constexpr int getCacheKey(Profile profile, RenderingIntent intent, bool isRGB888Buffer, bool is8BitInput) { return ((int(intent) * ProfileCount + profile) << 2) + (isRGB888Buffer ? 1 : 0) + (is8BitInput ? 2 : 0); }
 
     /// Returns little CMS rendering intent
     /// \param intent Rendering intent
@@ -154,7 +161,16 @@ private:
 
     /// Returns little CMS data format for profile
     /// \param profile Color profile handle
-    static cmsUInt32Number getProfileDataFormat(cmsHPROFILE profile);
+    /// \param is8BitInput If true, packed 8-bit format is returned (only for gray, RGB and CMYK profiles)
+    static cmsUInt32Number getProfileDataFormat(cmsHPROFILE profile, bool is8BitInput = false);
+
+    /// Fills packed 8-bit colors to the RGB buffer using 8-bit transform
+    /// \param profile Color profile of input colors
+    /// \param colors Packed 8-bit input colors
+    /// \param pixelCount Number of pixels
+    /// \param intent Rendering intent
+    /// \param outputBuffer Output buffer in format RGB_888 (8-bit RGB values)
+    bool fillRGBBuffer8(Profile profile, const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer) const;
 
     /// Returns color from output color. Clamps invalid rgb output values to range [0.0, 1.0].
     /// \param color01 Rgb color (range 0-1 is assumed).
@@ -263,6 +279,60 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors,
     return false;
 }
 
+bool PDFLittleCMS::fillRGBBufferFromDeviceGray8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(reporter);
+    return fillRGBBuffer8(Gray, colors, pixelCount, intent, outputBuffer);
+}
+
+bool PDFLittleCMS::fillRGBBufferFromDeviceRGB8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(reporter);
+    return fillRGBBuffer8(RGB, colors, pixelCount, intent, outputBuffer);
+}
+
+bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(reporter);
+    return fillRGBBuffer8(CMYK, colors, pixelCount, intent, outputBuffer);
+}
+
+bool PDFLittleCMS::fillRGBBuffer8(Profile profile, const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer) const
+{
+    cmsHTRANSFORM transform = getTransform(profile, getEffectiveRenderingIntent(intent), true, true);
+
+    cmsUInt32Number expectedInputFormat = 0;
+    switch (profile)
+    {
+        case Gray:
+            expectedInputFormat = TYPE_GRAY_8;
+            break;
+
+        case RGB:
+            expectedInputFormat = TYPE_RGB_8;
+            break;
+
+        case CMYK:
+            expectedInputFormat = TYPE_CMYK_8;
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    // If we can't create 8-bit transform, then caller will use float transform,
+    // which also reports the error.
+    if (!transform || cmsGetTransformInputFormat(transform) != expectedInputFormat)
+    {
+        return false;
+    }
+
+    Q_ASSERT(cmsGetTransformOutputFormat(transform) == TYPE_RGB_8);
+    cmsDoTransform(transform, colors, outputBuffer, static_cast<cmsUInt32Number>(pixelCount));
+    return true;
+}
+
 bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
     cmsHTRANSFORM transform = getTransform(XYZ, getEffectiveRenderingIntent(intent), true);
@@ -951,9 +1021,9 @@ cmsHPROFILE PDFLittleCMS::createProfile(const QString& id, const PDFColorProfile
     return cmsHPROFILE();
 }
 
-cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent, bool isRGB888Buffer) const
+cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent, bool isRGB888Buffer, bool is8BitInput) const
 {
-    const int key = getCacheKey(profile, intent, isRGB888Buffer);
+    const int key = getCacheKey(profile, intent, isRGB888Buffer, is8BitInput);
 
     QReadLocker lock(&m_transformationCacheLock);
     auto it = m_transformationCache.find(key);
@@ -982,12 +1052,12 @@ cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent
                         proofingIntent = intent;
                     }
 
-                    transform = cmsCreateProofingTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
+                    transform = cmsCreateProofingTransform(input, getProfileDataFormat(input, is8BitInput), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
                                                            getLittleCMSRenderingIntent(intent), getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
                 }
                 else
                 {
-                    transform = cmsCreateTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, getLittleCMSRenderingIntent(intent), getTransformationFlags());
+                    transform = cmsCreateTransform(input, getProfileDataFormat(input, is8BitInput), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, getLittleCMSRenderingIntent(intent), getTransformationFlags());
                 }
             }
 
@@ -1078,22 +1148,22 @@ cmsUInt32Number PDFLittleCMS::getLittleCMSRenderingIntent(RenderingIntent intent
     return INTENT_PERCEPTUAL;
 }
 
-cmsUInt32Number PDFLittleCMS::getProfileDataFormat(cmsHPROFILE profile)
+cmsUInt32Number PDFLittleCMS::getProfileDataFormat(cmsHPROFILE profile, bool is8BitInput)
 {
     cmsColorSpaceSignature signature = cmsGetColorSpace(profile);
     switch (signature)
     {
         case cmsSigGrayData:
-            return TYPE_GRAY_FLT;
+            return is8BitInput ? TYPE_GRAY_8 : TYPE_GRAY_FLT;
 
         case cmsSigRgbData:
-            return TYPE_RGB_FLT;
+            return is8BitInput ? TYPE_RGB_8 : TYPE_RGB_FLT;
 
         case cmsSigCmykData:
-            return TYPE_CMYK_FLT;
+            return is8BitInput ? TYPE_CMYK_8 : TYPE_CMYK_FLT;
 
         case cmsSigXYZData:
-            return TYPE_XYZ_FLT;
+            return is8BitInput ? 0 : TYPE_XYZ_FLT;
 
         default:
             break;
@@ -1269,6 +1339,11 @@ QString getInfoFromProfile(cmsHPROFILE profile, cmsInfoType infoType)
     return QString();
 }
 
+PDFCMSGeneric::PDFCMSGeneric()
+{
+
+}
+
 PDFCMSGeneric::PDFCMSGeneric(const PDFColorConvertor& colorConvertor) :
     m_colorConvertor(colorConvertor)
 {
@@ -1359,6 +1434,49 @@ bool PDFCMSGeneric::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors
     return false;
 }
 
+bool PDFCMSGeneric::fillRGBBufferFromDeviceGray8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(intent);
+    Q_UNUSED(reporter);
+
+    // Simple loop without dependencies, it is vectorized by the compiler
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        const unsigned char gray = colors[i];
+        outputBuffer[3 * i + 0] = gray;
+        outputBuffer[3 * i + 1] = gray;
+        outputBuffer[3 * i + 2] = gray;
+    }
+
+    return true;
+}
+
+bool PDFCMSGeneric::fillRGBBufferFromDeviceRGB8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(intent);
+    Q_UNUSED(reporter);
+
+    std::memcpy(outputBuffer, colors, pixelCount * 3);
+    return true;
+}
+
+bool PDFCMSGeneric::fillRGBBufferFromDeviceCMYK8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(intent);
+    Q_UNUSED(reporter);
+
+    // Same formula as in QColor, i.e. R = (1 - C) * (1 - K) etc.
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        const unsigned int white = 255 - colors[4 * i + 3];
+        outputBuffer[3 * i + 0] = static_cast<unsigned char>(((255 - colors[4 * i + 0]) * white + 127) / 255);
+        outputBuffer[3 * i + 1] = static_cast<unsigned char>(((255 - colors[4 * i + 1]) * white + 127) / 255);
+        outputBuffer[3 * i + 2] = static_cast<unsigned char>(((255 - colors[4 * i + 2]) * white + 127) / 255);
+    }
+
+    return true;
+}
+
 bool PDFCMSGeneric::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
     Q_UNUSED(whitePoint);
@@ -1865,6 +1983,42 @@ PDFColorProfileIdentifier PDFColorProfileIdentifier::createOutputIntent(PDFColor
     return result;
 }
 
+PDFCMS::PDFCMS()
+{
+    static std::atomic<quint64> lastId = 0;
+    m_id = ++lastId;
+}
+
+bool PDFCMS::fillRGBBufferFromDeviceGray8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(colors);
+    Q_UNUSED(pixelCount);
+    Q_UNUSED(intent);
+    Q_UNUSED(outputBuffer);
+    Q_UNUSED(reporter);
+    return false;
+}
+
+bool PDFCMS::fillRGBBufferFromDeviceRGB8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(colors);
+    Q_UNUSED(pixelCount);
+    Q_UNUSED(intent);
+    Q_UNUSED(outputBuffer);
+    Q_UNUSED(reporter);
+    return false;
+}
+
+bool PDFCMS::fillRGBBufferFromDeviceCMYK8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(colors);
+    Q_UNUSED(pixelCount);
+    Q_UNUSED(intent);
+    Q_UNUSED(outputBuffer);
+    Q_UNUSED(reporter);
+    return false;
+}
+
 PDFColor3 PDFCMS::getDefaultXYZWhitepoint()
 {
     const cmsCIEXYZ* whitePoint = cmsD50_XYZ();
@@ -98,9 +98,14 @@ struct PDFCMSSettings
 class PDFCMS
 {
 public:
-    explicit inline PDFCMS() = default;
+    explicit PDFCMS();
     virtual ~PDFCMS() = default;
 
+    /// Returns unique identifier of this color management system instance. Each
+    /// instance has different identifier, so it can be used as a key in caches
+    /// of color converted data (instance is recreated, when settings change).
+    quint64 getId() const { return m_id; }
+
     /// This function should decide, if color management system is compatible with these
     /// settings (so, it transforms colors according to this setting). If this
     /// function returns false, then this color management system should be replaced
@@ -194,6 +199,48 @@ public:
                                              unsigned char* outputBuffer,
                                              PDFRenderErrorReporter* reporter) const = 0;
 
+    /// Fills packed 8-bit colors in Device Gray color space to the RGB buffer. If color management
+    /// system can't transform 8-bit colors directly, false is returned, and caller should use
+    /// function with float colors instead.
+    /// \param colors Packed 8-bit gray values
+    /// \param pixelCount Number of pixels
+    /// \param intent Rendering intent
+    /// \param outputBuffer Output buffer in format RGB_888 (8-bit RGB values)
+    /// \param reporter Render error reporter (used, when color transform fails)
+    virtual bool fillRGBBufferFromDeviceGray8(const unsigned char* colors,
+                                              size_t pixelCount,
+                                              RenderingIntent intent,
+                                              unsigned char* outputBuffer,
+                                              PDFRenderErrorReporter* reporter) const;
+
+    /// Fills packed 8-bit colors in Device RGB color space to the RGB buffer. If color management
+    /// system can't transform 8-bit colors directly, false is returned, and caller should use
+    /// function with float colors instead.
+    /// \param colors Packed 8-bit colors, tuple(R, G, B) for each pixel
+    /// \param pixelCount Number of pixels
+    /// \param intent Rendering intent
+    /// \param outputBuffer Output buffer in format RGB_888 (8-bit RGB values)
+    /// \param reporter Render error reporter (used, when color transform fails)
+    virtual bool fillRGBBufferFromDeviceRGB8(const unsigned char* colors,
+                                             size_t pixelCount,
+                                             RenderingIntent intent,
+                                             unsigned char* outputBuffer,
+                                             PDFRenderErrorReporter* reporter) const;
+
+    /// Fills packed 8-bit colors in Device CMYK color space to the RGB buffer. If color management
+    /// system can't transform 8-bit colors directly, false is returned, and caller should use
+    /// function with float colors instead.
+    /// \param colors Packed 8-bit colors, tuple(C, M, Y, K) for each pixel
+    /// \param pixelCount Number of pixels
+    /// \param intent Rendering intent
+    /// \param outputBuffer Output buffer in format RGB_888 (8-bit RGB values)
+    /// \param reporter Render error reporter (used, when color transform fails)
+    virtual bool fillRGBBufferFromDeviceCMYK8(const unsigned char* colors,
+                                              size_t pixelCount,
+                                              RenderingIntent intent,
+                                              unsigned char* outputBuffer,
+                                              PDFRenderErrorReporter* reporter) const;
+
     /// Fills colors in XYZ color space to the RGB buffer. If error occurs, then false is returned.
     /// Caller then should handle this - try to convert color as accurate as possible.
     /// \param whitePoint White point of source XYZ color space
@@ -260,6 +307,9 @@ public:
 
     /// Get D50 white point for XYZ color space
     static PDFColor3 getDefaultXYZWhitepoint();
+
+private:
+    quint64 m_id;
 };
 
 using PDFCMSPointer = QSharedPointer<PDFCMS>;
@@ -267,7 +317,7 @@ using PDFCMSPointer = QSharedPointer<PDFCMS>;
 class PDF4QTLIBCORESHARED_EXPORT PDFCMSGeneric : public PDFCMS
 {
 public:
-    explicit inline PDFCMSGeneric() = default;
+    explicit PDFCMSGeneric();
     explicit inline PDFCMSGeneric(const PDFColorConvertor& colorConvertor);
 
     virtual bool isCompatible(const PDFCMSSettings& settings) const override;
@@ -280,6 +330,9 @@ public:
     virtual bool fillRGBBufferFromDeviceGray(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromDeviceRGB(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceGray8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceRGB8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBufferFromDeviceCMYK8(const unsigned char* colors, size_t pixelCount, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const override;
     virtual bool fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const override;
     virtual bool transformColorSpace(const ColorSpaceTransformParams& params) const override;
@@ -23,6 +23,7 @@
 #include "pdfpattern.h"
 #include "pdfcms.h"
 #include "pdfexecutionpolicy.h"
+#include "pdfvisitor.h"
 
 #include <QCryptographicHash>
 
@@ -94,6 +95,11 @@ void PDFDeviceGrayColorSpace::fillRGBBuffer(const std::vector<float>& colors, un
     }
 }
 
+bool PDFDeviceGrayColorSpace::fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    return cms->fillRGBBufferFromDeviceGray8(colors, pixelCount, intent, outputBuffer, reporter);
+}
+
 PDFColor PDFDeviceRGBColorSpace::getDefaultColorOriginal() const
 {
     return PDFColor(0.0f, 0.0f, 0.0f);
@@ -133,6 +139,11 @@ void PDFDeviceRGBColorSpace::fillRGBBuffer(const std::vector<float>& colors, uns
     }
 }
 
+bool PDFDeviceRGBColorSpace::fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    return cms->fillRGBBufferFromDeviceRGB8(colors, pixelCount, intent, outputBuffer, reporter);
+}
+
 PDFColor PDFDeviceCMYKColorSpace::getDefaultColorOriginal() const
 {
     return PDFColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -173,6 +184,11 @@ void PDFDeviceCMYKColorSpace::fillRGBBuffer(const std::vector<float>& colors, un
     }
 }
 
+bool PDFDeviceCMYKColorSpace::fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    return cms->fillRGBBufferFromDeviceCMYK8(colors, pixelCount, intent, outputBuffer, reporter);
+}
+
 bool PDFAbstractColorSpace::equals(const PDFAbstractColorSpace* other) const
 {
     return getColorSpace() == other->getColorSpace();
@@ -231,6 +247,13 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                 const unsigned int imageWidth = imageData.getWidth();
                 const unsigned int imageHeight = imageData.getHeight();
 
+                // Packed 8-bit data without decode array can be converted
+                // directly to the image scanlines, without conversion to floats.
+                const bool is8BitData = imageData.getBitsPerComponent() == 8 &&
+                                        decode.empty() &&
+                                        imageData.getStride() >= imageWidth * componentCount &&
+                                        imageData.getData().size() >= qsizetype(imageData.getStride()) * qsizetype(imageHeight);
+
                 QMutex exceptionMutex;
                 std::optional<PDFException> exception;
 
@@ -244,6 +267,15 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
 
                     try
                     {
+                        if (is8BitData)
+                        {
+                            const unsigned char* inputLine = reinterpret_cast<const unsigned char*>(imageData.getData().constData()) + size_t(i) * imageData.getStride();
+                            if (fillRGBBuffer8(inputLine, imageWidth, image.scanLine(i), intent, cms, reporter))
+                            {
+                                return;
+                            }
+                        }
+
                         PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
                         reader.seek(i * imageData.getStride());
 
@@ -524,6 +556,24 @@ void PDFAbstractColorSpace::fillRGBBuffer(const std::vector<float>& colors,
     }
 }
 
+bool PDFAbstractColorSpace::fillRGBBuffer8(const unsigned char* colors,
+                                           size_t pixelCount,
+                                           unsigned char* outputBuffer,
+                                           RenderingIntent intent,
+                                           const PDFCMS* cms,
+                                           PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(colors);
+    Q_UNUSED(pixelCount);
+    Q_UNUSED(outputBuffer);
+    Q_UNUSED(intent);
+    Q_UNUSED(cms);
+    Q_UNUSED(reporter);
+
+    // Generic color space doesn't support 8-bit data
+    return false;
+}
+
 QColor PDFAbstractColorSpace::getCheckedColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
     if (getColorComponentCount() != color.size())
@@ -601,8 +651,18 @@ PDFColorSpacePointer PDFAbstractColorSpace::createColorSpace(const PDFDictionary
                                                              const PDFDocument* document,
                                                              const PDFObject& colorSpace)
 {
+    PDFColorSpaceCache* cache = PDFColorSpaceCache::getInstance();
+    PDFColorSpaceCache::Key key = PDFColorSpaceCache::createKey(colorSpaceDictionary, document, colorSpace);
+
+    if (PDFColorSpacePointer cachedColorSpace = cache->getColorSpace(key))
+    {
+        return cachedColorSpace;
+    }
+
     std::set<QByteArray> usedNames;
-    return createColorSpaceImpl(colorSpaceDictionary, document, colorSpace, COLOR_SPACE_MAX_LEVEL_OF_RECURSION, usedNames);
+    PDFColorSpacePointer result = createColorSpaceImpl(colorSpaceDictionary, document, colorSpace, COLOR_SPACE_MAX_LEVEL_OF_RECURSION, usedNames);
+    cache->setColorSpace(key, result);
+    return result;
 }
 
 PDFColorSpacePointer PDFAbstractColorSpace::createDeviceColorSpaceByName(const PDFDictionary* colorSpaceDictionary,
@@ -2329,7 +2389,7 @@ PDFColorSpacePointer PDFSeparationColorSpace::createSeparationColorSpace(const P
         throw PDFException(PDFTranslationContext::tr("Can't determine alternate color space for separation color space."));
     }
 
-    PDFFunctionPtr tintTransform = PDFFunction::createFunction(document, array->getItem(3));
+    PDFFunctionPtr tintTransform = PDFFunction::createOptimizedFunction(PDFFunction::createFunction(document, array->getItem(3)));
     if (!tintTransform)
     {
         throw PDFException(PDFTranslationContext::tr("Can't determine tint transform for separation color space."));
@@ -2565,7 +2625,7 @@ PDFColorSpacePointer PDFDeviceNColorSpace::createDeviceNColorSpace(const PDFDict
         throw PDFException(PDFTranslationContext::tr("Can't determine alternate color space for DeviceN color space."));
     }
 
-    PDFFunctionPtr tintTransform = PDFFunction::createFunction(document, array->getItem(3));
+    PDFFunctionPtr tintTransform = PDFFunction::createOptimizedFunction(PDFFunction::createFunction(document, array->getItem(3)));
     if (!tintTransform)
     {
         throw PDFException(PDFTranslationContext::tr("Can't determine tint transform for DeviceN color space."));
@@ -2658,4 +2718,237 @@ PDFColorSpacePointer PDFDeviceNColorSpace::createDeviceNColorSpace(const PDFDict
     return PDFColorSpacePointer(new PDFDeviceNColorSpace(type, qMove(colorants), qMove(alternateColorSpace), qMove(processColorSpace), qMove(tintTransform), qMove(colorantsPrintingOrder), qMove(processColorSpaceComponents)));
 }
 
+/// Computes hash of the color space object, which is used as a key in the
+/// color space cache. Indirect objects are hashed by their reference only, but
+/// they are also traversed to find out, if color space depends on names
+/// defined in the color space dictionary.
+class PDFColorSpaceKeyVisitor : public PDFAbstractVisitor
+{
+public:
+    explicit PDFColorSpaceKeyVisitor(const PDFDictionary* colorSpaceDictionary, const PDFDocument* document) :
+        m_colorSpaceDictionary(colorSpaceDictionary),
+        m_document(document),
+        m_hasher(QCryptographicHash::Md5)
+    {
+
+    }
+
+    virtual void visitNull() override;
+    virtual void visitBool(bool value) override;
+    virtual void visitInt(PDFInteger value) override;
+    virtual void visitReal(PDFReal value) override;
+    virtual void visitString(PDFStringRef string) override;
+    virtual void visitName(PDFStringRef name) override;
+    virtual void visitArray(const PDFArray* array) override;
+    virtual void visitDictionary(const PDFDictionary* dictionary) override;
+    virtual void visitStream(const PDFStream* stream) override;
+    virtual void visitReference(const PDFObjectReference reference) override;
+
+    QByteArray getHash() const { return m_hasher.result(); }
+    bool isDictionaryDependent() const { return m_isDictionaryDependent; }
+
+private:
+    template<typename T>
+    void addValue(char type, T value)
+    {
+        if (m_hashingDisabled == 0)
+        {
+            m_hasher.addData(QByteArrayView(&type, 1));
+            m_hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(T)));
+        }
+    }
+
+    void addData(char type, const QByteArray& data)
+    {
+        if (m_hashingDisabled == 0)
+        {
+            addValue(type, data.size());
+            m_hasher.addData(data);
+        }
+    }
+
+    const PDFDictionary* m_colorSpaceDictionary;
+    const PDFDocument* m_document;
+    QCryptographicHash m_hasher;
+    std::set<PDFObjectReference> m_visitedReferences;
+    int m_hashingDisabled = 0;
+    bool m_isDictionaryDependent = false;
+};
+
+void PDFColorSpaceKeyVisitor::visitNull()
+{
+    addValue('n', 0);
+}
+
+void PDFColorSpaceKeyVisitor::visitBool(bool value)
+{
+    addValue('b', value);
+}
+
+void PDFColorSpaceKeyVisitor::visitInt(PDFInteger value)
+{
+    addValue('i', value);
+}
+
+void PDFColorSpaceKeyVisitor::visitReal(PDFReal value)
+{
+    addValue('r', value);
+}
+
+void PDFColorSpaceKeyVisitor::visitString(PDFStringRef string)
+{
+    addData('s', string.getString());
+}
+
+void PDFColorSpaceKeyVisitor::visitName(PDFStringRef name)
+{
+    QByteArray nameString = name.getString();
+
+    if (m_colorSpaceDictionary && m_colorSpaceDictionary->hasKey(nameString))
+    {
+        m_isDictionaryDependent = true;
+    }
+
+    addData('/', nameString);
+}
+
+void PDFColorSpaceKeyVisitor::visitArray(const PDFArray* array)
+{
+    addValue('[', array->getCount());
+    acceptArray(array);
+}
+
+void PDFColorSpaceKeyVisitor::visitDictionary(const PDFDictionary* dictionary)
+{
+    addValue('<', dictionary->getCount());
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        addData('k', dictionary->getKey(i).getString());
+        dictionary->getValue(i).accept(this);
+    }
+}
+
+void PDFColorSpaceKeyVisitor::visitStream(const PDFStream* stream)
+{
+    // Direct streams can't occur in color space, we hash just the dictionary
+    visitDictionary(stream->getDictionary());
+}
+
+void PDFColorSpaceKeyVisitor::visitReference(const PDFObjectReference reference)
+{
+    addValue('R', reference.objectNumber);
+    addValue('G', reference.generation);
+
+    if (!m_document || m_visitedReferences.count(reference))
+    {
+        return;
+    }
+
+    // Content of the indirect object is identified by the reference,
+    // so it is traversed only to detect dependency on the dictionary.
+    m_visitedReferences.insert(reference);
+    ++m_hashingDisabled;
+    m_document->getObjectByReference(reference).accept(this);
+    --m_hashingDisabled;
+}
+
+/// Returns true, if name is a device color space name, which is resolved
+/// without the color space dictionary (unless default color spaces are defined).
+static bool isDeviceColorSpaceName(const QByteArray& name)
+{
+    return name == COLOR_SPACE_NAME_DEVICE_GRAY || name == COLOR_SPACE_NAME_ABBREVIATION_DEVICE_GRAY ||
+           name == COLOR_SPACE_NAME_DEVICE_RGB || name == COLOR_SPACE_NAME_ABBREVIATION_DEVICE_RGB ||
+           name == COLOR_SPACE_NAME_DEVICE_CMYK || name == COLOR_SPACE_NAME_ABBREVIATION_DEVICE_CMYK ||
+           name == COLOR_SPACE_NAME_ABBREVIATION_CAL_CMYK || name == COLOR_SPACE_NAME_PATTERN;
+}
+
+inline size_t qHash(const PDFColorSpaceCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.document, key.colorSpaceDictionary, key.hash);
+}
+
+PDFColorSpaceCache::PDFColorSpaceCache() :
+    m_colorSpaces(DEFAULT_CACHE_LIMIT)
+{
+
+}
+
+PDFColorSpaceCache* PDFColorSpaceCache::getInstance()
+{
+    static PDFColorSpaceCache instance;
+    return &instance;
+}
+
+PDFColorSpaceCache::Key PDFColorSpaceCache::createKey(const PDFDictionary* colorSpaceDictionary,
+                                                      const PDFDocument* document,
+                                                      const PDFObject& colorSpace)
+{
+    Key key;
+    key.document = document;
+
+    PDFObject colorSpaceObject = colorSpace;
+
+    // Named color spaces are resolved here, so same color space
+    // referenced from different pages (possibly under different names) is
+    // shared, if it is an indirect object.
+    if (colorSpaceDictionary && colorSpace.isName())
+    {
+        QByteArray name = colorSpace.getString();
+        if (!isDeviceColorSpaceName(name) && colorSpaceDictionary->hasKey(name))
+        {
+            colorSpaceObject = colorSpaceDictionary->get(name);
+        }
+    }
+
+    PDFColorSpaceKeyVisitor visitor(colorSpaceDictionary, document);
+    colorSpaceObject.accept(&visitor);
+    key.hash = visitor.getHash();
+
+    const bool hasDefaultColorSpaces = colorSpaceDictionary && (colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_GRAY) ||
+                                                                colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_RGB) ||
+                                                                colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_CMYK));
+    if (hasDefaultColorSpaces || visitor.isDictionaryDependent())
+    {
+        key.colorSpaceDictionary = colorSpaceDictionary;
+    }
+
+    return key;
+}
+
+PDFColorSpacePointer PDFColorSpaceCache::getColorSpace(const Key& key) const
+{
+    QMutexLocker lock(&m_mutex);
+    if (const PDFColorSpacePointer* colorSpace = m_colorSpaces.object(key))
+    {
+        return *colorSpace;
+    }
+
+    return PDFColorSpacePointer();
+}
+
+void PDFColorSpaceCache::setColorSpace(const Key& key, PDFColorSpacePointer colorSpace)
+{
+    QMutexLocker lock(&m_mutex);
+    m_colorSpaces.insert(key, new PDFColorSpacePointer(qMove(colorSpace)));
+}
+
+void PDFColorSpaceCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_colorSpaces.keys())
+    {
+        if (key.document == document)
+        {
+            m_colorSpaces.remove(key);
+        }
+    }
+}
+
+void PDFColorSpaceCache::setCacheLimit(qsizetype cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_colorSpaces.setMaxCost(cacheLimit);
+}
+
 }   // namespace pdf
@@ -25,6 +25,8 @@
 
 #include <QColor>
 #include <QImage>
+#include <QMutex>
+#include <QCache>
 #include <QSharedPointer>
 
 #include <set>
@@ -388,6 +390,23 @@ public:
                                const PDFCMS* cms,
                                PDFRenderErrorReporter* reporter) const;
 
+    /// Fills RGB buffer using packed 8-bit colors from \p colors (value 255 corresponds
+    /// to color component value 1.0). If conversion of 8-bit colors is not supported
+    /// by this color space (or color management system), false is returned and caller
+    /// must use fillRGBBuffer instead.
+    /// \param colors Packed 8-bit input colors
+    /// \param pixelCount Number of pixels
+    /// \param outputBuffer 8-bit RGB output buffer
+    /// \param intent Rendering intent
+    /// \param cms Color management system
+    /// \param reporter Render error reporter
+    virtual bool fillRGBBuffer8(const unsigned char* colors,
+                                size_t pixelCount,
+                                unsigned char* outputBuffer,
+                                RenderingIntent intent,
+                                const PDFCMS* cms,
+                                PDFRenderErrorReporter* reporter) const;
+
     /// If this class is pattern space, returns this, otherwise returns nullptr.
     virtual const PDFPatternColorSpace* asPatternColorSpace() const { return nullptr; }
 
@@ -568,6 +587,7 @@ public:
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
     virtual void fillRGBBuffer(const std::vector<float>& colors,unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
 };
 
 class PDFDeviceRGBColorSpace : public PDFAbstractColorSpace
@@ -581,6 +601,7 @@ public:
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
     virtual void fillRGBBuffer(const std::vector<float>& colors,unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
 };
 
 class PDFDeviceCMYKColorSpace : public PDFAbstractColorSpace
@@ -594,6 +615,7 @@ public:
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
     virtual void fillRGBBuffer(const std::vector<float>& colors,unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBBuffer8(const unsigned char* colors, size_t pixelCount, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
 };
 
 class PDFXYZColorSpace : public PDFAbstractColorSpace
@@ -932,6 +954,69 @@ private:
      PDFColor m_uncoloredPatternColor;
 };
 
+/// Cache of parsed color spaces. Color spaces are immutable, once they are created,
+/// so they can be shared between page compilations (even concurrently running). Color
+/// space is identified by its object reference, inline color spaces are identified
+/// by hash of their content. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFColorSpaceCache
+{
+public:
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+
+        /// Color space dictionary is part of the key only, if color space
+        /// depends on the resources (default color spaces, or color space
+        /// names referring to the dictionary), otherwise it is nullptr.
+        const PDFDictionary* colorSpaceDictionary = nullptr;
+
+        /// Hash of the color space object (indirect objects are hashed
+        /// by their reference, direct objects by their content)
+        QByteArray hash;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, colorSpaceDictionary, hash) == std::tie(other.document, other.colorSpaceDictionary, other.hash);
+        }
+    };
+
+    static PDFColorSpaceCache* getInstance();
+
+    /// Creates key for the color space
+    /// \param colorSpaceDictionary Dictionary containing color spaces of the page
+    /// \param document Document (for loading objects)
+    /// \param colorSpace Identification of color space (either name or array)
+    static Key createKey(const PDFDictionary* colorSpaceDictionary,
+                         const PDFDocument* document,
+                         const PDFObject& colorSpace);
+
+    /// Returns color space from the cache. If color space is not found,
+    /// then null pointer is returned.
+    /// \param key Key
+    PDFColorSpacePointer getColorSpace(const Key& key) const;
+
+    /// Inserts color space into the cache
+    /// \param key Key
+    /// \param colorSpace Color space
+    void setColorSpace(const Key& key, PDFColorSpacePointer colorSpace);
+
+    /// Removes all color spaces of the document from the cache
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+    /// Sets cache limit (maximal number of color spaces)
+    /// \param cacheLimit Cache limit
+    void setCacheLimit(qsizetype cacheLimit);
+
+private:
+    explicit PDFColorSpaceCache();
+
+    static constexpr qsizetype DEFAULT_CACHE_LIMIT = 4096;
+
+    mutable QMutex m_mutex;
+    QCache<Key, PDFColorSpacePointer> m_colorSpaces;
+};
+
 }   // namespace pdf
 
 #endif // PDFCOLORSPACES_H
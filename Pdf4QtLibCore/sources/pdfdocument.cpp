@@ -21,6 +21,11 @@
 #include "pdfexception.h"
 #include "pdfstreamfilters.h"
 #include "pdfconstants.h"
+#include "pdfimage.h"
+#include "pdfcolorspaces.h"
+#include "pdfpattern.h"
+#include "pdftransparencyrenderer.h"
+#include "pdfpainter.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -35,7 +40,14 @@ QByteArray PDFObjectStorage::getDecodedStream(const PDFStream* stream) const
 
 PDFDocument::~PDFDocument()
 {
-
+    // Images, color spaces, shading meshes, spot colors, forms and Type 3 glyphs are cached using
+    // document pointer as a key, so we must remove them, before the address can be reused.
+    PDFImageCache::getInstance()->clear(this);
+    PDFColorSpaceCache::getInstance()->clear(this);
+    PDFShadingMeshCache::getInstance()->clear(this);
+    PDFSpotColorCache::getInstance()->clear(this);
+    PDFFormInstanceCache::getInstance()->clear(this);
+    PDFType3GlyphInstanceCache::getInstance()->clear(this);
 }
 
 bool PDFDocument::operator==(const PDFDocument& other) const
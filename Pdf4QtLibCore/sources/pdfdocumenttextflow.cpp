@@ -398,7 +398,7 @@ void PDFStructureTreeTextContentProcessor::performOutputCharacter(const PDFTextC
         {
             m_currentText.push_back(info.character);
 
-            QPainterPath worldPath = info.matrix.map(info.outline);
+            QPainterPath worldPath = info.outlineMatrix.map(info.outline);
             if (!worldPath.isEmpty())
             {
                 QRectF boundingRect = worldPath.controlPointRect();
@@ -31,9 +31,13 @@
 
 #include <QFile>
 #include <QMutex>
-#include <QReadWriteLock>
 #include <QPainterPath>
 #include <QDataStream>
+#include <QCryptographicHash>
+
+#include <array>
+#include <atomic>
+#include <map>
 
 #include "pdfdbgheap.h"
 
@@ -595,6 +599,95 @@ public:
 
     /// Returns character info
     virtual CharacterInfos getCharacterInfos() const = 0;
+
+    /// Returns scale of glyph outlines (outlines are shared for all sizes of the font)
+    virtual PDFReal getGlyphScale() const { return 1.0; }
+};
+
+/// FreeType face of the font program, shared by realized fonts of all sizes.
+/// Glyph outlines are unhinted, so they differ only by scale for different font
+/// sizes. For this reason, face keeps single outline for each glyph (for font size 1.0)
+/// and realized fonts scale them by their size. FreeType face functions must be
+/// called with the face mutex locked.
+class PDFFontFace
+{
+public:
+    /// Creates face from the font program data. If face can't
+    /// be created, then exception is thrown.
+    /// \param fontData Font program data
+    /// \param cacheKey Key of the face in the font face cache
+    explicit PDFFontFace(QByteArray fontData, QByteArray cacheKey);
+    ~PDFFontFace();
+
+    struct Glyph
+    {
+        QPainterPath glyph; ///< Glyph outline for font size 1.0
+        PDFReal horizontalAdvance = 0.0; ///< Advance for font size 1.0
+        PDFReal verticalAdvance = 0.0; ///< Advance for font size 1.0
+    };
+
+    FT_Face getFace() const { return m_face; }
+    QMutex* getMutex() const { return &m_mutex; }
+    const QByteArray& getFontData() const { return m_fontData; }
+    const QByteArray& getCacheKey() const { return m_cacheKey; }
+
+    /// Returns glyph for given glyph index. Glyphs are loaded on demand and they are
+    /// never removed, so returned reference is valid for the lifetime of the face.
+    /// If glyph can't be loaded, then exception is thrown.
+    /// \param glyphIndex Glyph index
+    const Glyph& getGlyph(GID glyphIndex);
+
+    /// Returns estimated memory occupied by the face (in bytes), including
+    /// outlines of already loaded glyphs.
+    qsizetype getEstimatedMemoryConsumption() const { return m_fontData.size() + FACE_MEMORY_OVERHEAD + m_glyphMemoryConsumption.load(std::memory_order_relaxed); }
+
+private:
+    /// Estimate of memory allocated by FreeType for the face structures
+    static constexpr qsizetype FACE_MEMORY_OVERHEAD = 64 * 1024;
+
+    /// Cost of the face in the font face cache is updated, when memory
+    /// of loaded glyphs grows by this amount since the last update.
+    static constexpr qsizetype GLYPH_MEMORY_UPDATE_THRESHOLD = 64 * 1024;
+
+    /// Glyphs are loaded in this pixel size and then scaled to the size 1.0,
+    /// so the font matrix of the font program is applied by FreeType.
+    static constexpr FT_UInt REFERENCE_PIXEL_SIZE = 4096;
+    static constexpr PDFReal FORMAT_26_6_MULTIPLIER = 1 / 64.0;
+    static constexpr PDFReal GLYPH_MULTIPLIER = FORMAT_26_6_MULTIPLIER / REFERENCE_PIXEL_SIZE;
+
+    static int outlineMoveTo(const FT_Vector* to, void* user);
+    static int outlineLineTo(const FT_Vector* to, void* user);
+    static int outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user);
+    static int outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user);
+
+    /// Number of glyphs in one page of the glyph table
+    static constexpr size_t GLYPH_PAGE_SIZE = 256;
+
+    struct GlyphPage
+    {
+        std::array<std::atomic<const Glyph*>, GLYPH_PAGE_SIZE> glyphs{ };
+    };
+
+    mutable QMutex m_mutex;
+
+    /// Glyph table indexed by glyph index. Pages and glyphs are created under
+    /// the mutex and published atomically. They are never removed before the face
+    /// is destroyed, so already loaded glyphs can be read without any lock.
+    std::vector<std::atomic<GlyphPage*>> m_glyphPages;
+
+    /// Glyphs, which are out of the glyph table (guarded by the mutex)
+    std::map<GID, Glyph> m_overflowGlyphs;
+
+    /// Memory occupied by loaded glyphs and glyph pages (in bytes)
+    std::atomic<qsizetype> m_glyphMemoryConsumption = 0;
+
+    /// Glyph memory, which was reported to the font face cache (guarded by the mutex)
+    qsizetype m_reportedGlyphMemoryConsumption = 0;
+
+    QByteArray m_fontData;
+    QByteArray m_cacheKey;
+    FT_Library m_library = nullptr;
+    FT_Face m_face = nullptr;
 };
 
 /// Implementation of the PDFRealizedFont class using PIMPL pattern for Type 3 fonts
@@ -630,49 +723,24 @@ public:
     virtual void dumpFontToTreeItem(ITreeFactory* treeFactory) const override;
     virtual QString getPostScriptName() const override { return m_postScriptName; }
     virtual CharacterInfos getCharacterInfos() const override;
-
-    static constexpr const PDFReal PIXEL_SIZE_MULTIPLIER = 100.0;
+    virtual PDFReal getGlyphScale() const override { return m_pixelSize; }
 
 private:
     friend class PDFRealizedFont;
+    friend class PDFFontFace;
 
     static constexpr const PDFReal FONT_WIDTH_MULTIPLIER = 1.0 / 1000.0;
-    static constexpr const PDFReal FORMAT_26_6_MULTIPLIER = 1 / 64.0;
-    static constexpr const PDFReal FONT_MULTIPLIER = FORMAT_26_6_MULTIPLIER / PIXEL_SIZE_MULTIPLIER;
-
-    struct Glyph
-    {
-        QPainterPath glyph;
-        PDFReal advance = 0.0;
-    };
-
-    static int outlineMoveTo(const FT_Vector* to, void* user);
-    static int outlineLineTo(const FT_Vector* to, void* user);
-    static int outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user);
-    static int outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user);
 
-    /// Get glyph for glyph index
-    const Glyph& getGlyph(unsigned int glyphIndex);
+    /// Returns advance of the glyph scaled to the size of this font
+    PDFReal getGlyphAdvance(const PDFFontFace::Glyph& glyph) const { return (m_isVertical ? glyph.verticalAdvance : glyph.horizontalAdvance) * m_pixelSize; }
 
     /// Function checks, if error occured, and if yes, then exception is thrown
     static void checkFreeTypeError(FT_Error error);
 
-    /// Read/write lock for accessing the glyph data
-    QReadWriteLock m_readWriteLock;
+    /// Shared face of the font program
+    PDFFontFacePointer m_fontFace;
 
-    /// Glyph cache, must be protected by the mutex above
-    std::unordered_map<unsigned int, Glyph> m_glyphCache;
-
-    /// For embedded fonts, this byte array contains embedded font data
-    QByteArray m_embeddedFontData;
-
-    /// For system fonts, this byte array contains system font data
-    QByteArray m_systemFontData;
-
-    /// Instance of FreeType library assigned to this font
-    FT_Library m_library;
-
-    /// Face of the font
+    /// Face of the font (owned by m_fontFace)
     FT_Face m_face;
 
     /// Pixel size of the font
@@ -692,7 +760,6 @@ private:
 };
 
 PDFRealizedFontImpl::PDFRealizedFontImpl() :
-    m_library(nullptr),
     m_face(nullptr),
     m_pixelSize(0.0),
     m_parentFont(nullptr),
@@ -704,17 +771,7 @@ PDFRealizedFontImpl::PDFRealizedFontImpl() :
 
 PDFRealizedFontImpl::~PDFRealizedFontImpl()
 {
-    if (m_face)
-    {
-        FT_Done_Face(m_face);
-        m_face = nullptr;
-    }
 
-    if (m_library)
-    {
-        FT_Done_FreeType(m_library);
-        m_library = nullptr;
-    }
 }
 
 void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter)
@@ -741,6 +798,7 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                     // Try to obtain glyph index from unicode
                     if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
                     {
+                        QMutexLocker faceLock(m_fontFace->getMutex());
                         glyphIndex = FT_Get_Char_Index(m_face, (*encoding)[static_cast<uint8_t>(byteArray[i])].unicode());
                     }
                 }
@@ -749,8 +807,8 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
 
                 if (glyphIndex)
                 {
-                    const Glyph& glyph = getGlyph(glyphIndex);
-                    textSequence.items.emplace_back(&glyph.glyph, (*encoding)[static_cast<uint8_t>(byteArray[i])], glyph.advance, static_cast<CID>(byteArray[i]));
+                    const PDFFontFace::Glyph& glyph = m_fontFace->getGlyph(glyphIndex);
+                    textSequence.items.emplace_back(&glyph.glyph, (*encoding)[static_cast<uint8_t>(byteArray[i])], getGlyphAdvance(glyph), static_cast<CID>(byteArray[i]));
                 }
                 else
                 {
@@ -784,8 +842,8 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                 if (glyphIndex)
                 {
                     QChar character = toUnicode->getToUnicode(cid);
-                    const Glyph& glyph = getGlyph(glyphIndex);
-                    textSequence.items.emplace_back(&glyph.glyph, character, glyph.advance, cid);
+                    const PDFFontFace::Glyph& glyph = m_fontFace->getGlyph(glyphIndex);
+                    textSequence.items.emplace_back(&glyph.glyph, character, getGlyphAdvance(glyph), cid);
                 }
                 else
                 {
@@ -843,6 +901,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                     // Try to obtain glyph index from unicode
                     if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
                     {
+                        QMutexLocker faceLock(m_fontFace->getMutex());
                         glyphIndex = FT_Get_Char_Index(m_face, character.unicode());
                     }
                 }
@@ -867,23 +926,29 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
             const PDFFontCMap* toUnicode = font->getToUnicode();
             const PDFCIDtoGIDMapper* CIDtoGIDmapper = font->getCIDtoGIDMapper();
 
-            FT_UInt index = 0;
-            FT_ULong character = FT_Get_First_Char(m_face, &index);
-            while (index != 0)
             {
-                const GID gid = index;
-                const CID cid = CIDtoGIDmapper->unmap(gid);
+                QMutexLocker faceLock(m_fontFace->getMutex());
+
+                FT_UInt index = 0;
+                FT_ULong character = FT_Get_First_Char(m_face, &index);
+                while (index != 0)
+                {
+                    const GID gid = index;
+                    const CID cid = CIDtoGIDmapper->unmap(gid);
 
-                CharacterInfo info;
-                info.gid = gid;
-                info.character = toUnicode->getToUnicode(cid);
-                result.emplace_back(qMove(info));
+                    CharacterInfo info;
+                    info.gid = gid;
+                    info.character = toUnicode->getToUnicode(cid);
+                    result.emplace_back(qMove(info));
 
-                character = FT_Get_Next_Char(m_face, character, &index);
+                    character = FT_Get_Next_Char(m_face, character, &index);
+                }
             }
 
             if (result.empty())
             {
+                QMutexLocker faceLock(m_fontFace->getMutex());
+
                 // We will try all reasonable high CIDs
                 for (CID cid = 0; cid < QChar::LastValidCodePoint; ++cid)
                 {
@@ -1022,72 +1087,125 @@ void PDFRealizedFontImpl::dumpFontToTreeItem(ITreeFactory* treeFactory) const
     treeFactory->popItem();
 }
 
-int PDFRealizedFontImpl::outlineMoveTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineMoveTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
-    glyph->glyph.moveTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
+    glyph->glyph.moveTo(to->x * GLYPH_MULTIPLIER, to->y * GLYPH_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineLineTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineLineTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
-    glyph->glyph.lineTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
+    glyph->glyph.lineTo(to->x * GLYPH_MULTIPLIER, to->y * GLYPH_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+int PDFFontFace::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
-    glyph->glyph.quadTo(control->x * FONT_MULTIPLIER, control->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
+    glyph->glyph.quadTo(control->x * GLYPH_MULTIPLIER, control->y * GLYPH_MULTIPLIER, to->x * GLYPH_MULTIPLIER, to->y * GLYPH_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+int PDFFontFace::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
-    glyph->glyph.cubicTo(control1->x * FONT_MULTIPLIER, control1->y * FONT_MULTIPLIER, control2->x * FONT_MULTIPLIER, control2->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
+    glyph->glyph.cubicTo(control1->x * GLYPH_MULTIPLIER, control1->y * GLYPH_MULTIPLIER, control2->x * GLYPH_MULTIPLIER, control2->y * GLYPH_MULTIPLIER, to->x * GLYPH_MULTIPLIER, to->y * GLYPH_MULTIPLIER);
     return 0;
 }
 
-const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int glyphIndex)
+const PDFFontFace::Glyph& PDFFontFace::getGlyph(GID glyphIndex)
 {
     if (glyphIndex)
     {
+        const size_t pageIndex = glyphIndex / GLYPH_PAGE_SIZE;
+        const size_t indexInPage = glyphIndex % GLYPH_PAGE_SIZE;
+
+        // First look into the glyph table, this doesn't need any lock
+        if (pageIndex < m_glyphPages.size())
         {
-            QReadLocker readLock(&m_readWriteLock);
+            if (const GlyphPage* page = m_glyphPages[pageIndex].load(std::memory_order_acquire))
+            {
+                if (const Glyph* glyph = page->glyphs[indexInPage].load(std::memory_order_acquire))
+                {
+                    return *glyph;
+                }
+            }
+        }
+
+        QMutexLocker faceLock(&m_mutex);
+
+        const bool isInGlyphTable = pageIndex < m_glyphPages.size();
+        GlyphPage* page = isInGlyphTable ? m_glyphPages[pageIndex].load(std::memory_order_relaxed) : nullptr;
+        if (page)
+        {
+            if (const Glyph* glyph = page->glyphs[indexInPage].load(std::memory_order_relaxed))
+            {
+                // Other thread was faster
+                return *glyph;
+            }
+        }
 
-            // First look into cache
-            auto it = m_glyphCache.find(glyphIndex);
-            if (it != m_glyphCache.cend())
+        if (!isInGlyphTable)
+        {
+            auto it = m_overflowGlyphs.find(glyphIndex);
+            if (it != m_overflowGlyphs.cend())
             {
                 return it->second;
             }
         }
 
-        QWriteLocker writeLock(&m_readWriteLock);
         Glyph glyph;
 
         FT_Outline_Funcs glyphOutlineInterface;
         glyphOutlineInterface.delta = 0;
         glyphOutlineInterface.shift = 0;
-        glyphOutlineInterface.move_to = PDFRealizedFontImpl::outlineMoveTo;
-        glyphOutlineInterface.line_to = PDFRealizedFontImpl::outlineLineTo;
-        glyphOutlineInterface.conic_to = PDFRealizedFontImpl::outlineConicTo;
-        glyphOutlineInterface.cubic_to = PDFRealizedFontImpl::outlineCubicTo;
+        glyphOutlineInterface.move_to = PDFFontFace::outlineMoveTo;
+        glyphOutlineInterface.line_to = PDFFontFace::outlineLineTo;
+        glyphOutlineInterface.conic_to = PDFFontFace::outlineConicTo;
+        glyphOutlineInterface.cubic_to = PDFFontFace::outlineCubicTo;
 
-        checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
-        checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
+        PDFRealizedFontImpl::checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
+        PDFRealizedFontImpl::checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
         glyph.glyph.closeSubpath();
-        glyph.advance = !m_isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
-        glyph.advance *= FONT_MULTIPLIER;
+        glyph.horizontalAdvance = m_face->glyph->advance.x * GLYPH_MULTIPLIER;
+        glyph.verticalAdvance = m_face->glyph->advance.y * GLYPH_MULTIPLIER;
+
+        qsizetype glyphMemoryConsumption = sizeof(Glyph) + glyph.glyph.capacity() * sizeof(QPainterPath::Element);
+
+        const Glyph* cachedGlyph = nullptr;
+        if (isInGlyphTable)
+        {
+            if (!page)
+            {
+                page = new GlyphPage();
+                m_glyphPages[pageIndex].store(page, std::memory_order_release);
+                glyphMemoryConsumption += sizeof(GlyphPage);
+            }
 
-        auto it = m_glyphCache.find(glyphIndex);
-        if (it == m_glyphCache.cend())
+            cachedGlyph = new Glyph(qMove(glyph));
+            page->glyphs[indexInPage].store(cachedGlyph, std::memory_order_release);
+        }
+        else
         {
-            it = m_glyphCache.insert(std::make_pair(glyphIndex, qMove(glyph))).first;
+            // Glyph count of the face can be inaccurate and glyph outside of the glyph
+            // table can be loaded. Such glyph is not cached in the glyph table, but it
+            // is kept aside, because returned reference must stay valid.
+            cachedGlyph = &m_overflowGlyphs.emplace(glyphIndex, qMove(glyph)).first->second;
         }
-        return it->second;
+
+        // Cost of the face in the cache is updated in larger steps, because
+        // the update locks the cache, which is shared by all threads.
+        const qsizetype totalGlyphMemoryConsumption = m_glyphMemoryConsumption.fetch_add(glyphMemoryConsumption, std::memory_order_relaxed) + glyphMemoryConsumption;
+        if (totalGlyphMemoryConsumption - m_reportedGlyphMemoryConsumption >= GLYPH_MEMORY_UPDATE_THRESHOLD)
+        {
+            m_reportedGlyphMemoryConsumption = totalGlyphMemoryConsumption;
+            faceLock.unlock();
+            PDFFontFaceCache::getInstance()->updateFontFaceCost(this);
+        }
+
+        return *cachedGlyph;
     }
 
     static Glyph dummy;
@@ -1138,6 +1256,11 @@ CharacterInfos PDFRealizedFont::getCharacterInfos() const
     return m_impl->getCharacterInfos();
 }
 
+PDFReal PDFRealizedFont::getGlyphScale() const
+{
+    return m_impl->getGlyphScale();
+}
+
 PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter)
 {
     PDFRealizedFontPointer result;
@@ -1163,20 +1286,14 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
         const FontDescriptor* descriptor = font->getFontDescriptor();
         if (descriptor->isEmbedded())
         {
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
             const QByteArray* embeddedFontData = descriptor->getEmbeddedFontData();
             Q_ASSERT(embeddedFontData);
-            impl->m_embeddedFontData = *embeddedFontData;
 
             // At this time, embedded font data should not be empty!
-            Q_ASSERT(!impl->m_embeddedFontData.isEmpty());
+            Q_ASSERT(!embeddedFontData->isEmpty());
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_embeddedFontData.constData()), impl->m_embeddedFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
-            impl->m_isVertical = cmap ? cmap->isVertical() : false;
+            impl->m_fontFace = PDFFontFaceCache::getInstance()->getFontFace(*embeddedFontData);
             impl->m_isEmbedded = true;
-            result.reset(new PDFRealizedFont(implPtr.release()));
         }
         else
         {
@@ -1189,25 +1306,30 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
             }
 
             const PDFSystemFontInfoStorage* fontStorage = PDFSystemFontInfoStorage::getInstance();
-            impl->m_systemFontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
+            QByteArray systemFontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
 
-            if (impl->m_systemFontData.isEmpty())
+            if (systemFontData.isEmpty())
             {
                 throw PDFException(PDFTranslationContext::tr("Can't load system font '%1'.").arg(QString::fromLatin1(descriptor->fontName)));
             }
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_systemFontData.constData()), impl->m_systemFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
-            impl->m_isVertical = cmap ? cmap->isVertical() : false;
+            impl->m_fontFace = PDFFontFaceCache::getInstance()->getFontFace(systemFontData);
             impl->m_isEmbedded = false;
+        }
+
+        impl->m_face = impl->m_fontFace->getFace();
+        impl->m_isVertical = cmap ? cmap->isVertical() : false;
+
+        if (!impl->m_isEmbedded)
+        {
+            QMutexLocker lock(impl->m_fontFace->getMutex());
             if (const char* postScriptName = FT_Get_Postscript_Name(impl->m_face))
             {
                 impl->m_postScriptName = QString::fromLatin1(postScriptName);
             }
-            result.reset(new PDFRealizedFont(implPtr.release()));
         }
+
+        result.reset(new PDFRealizedFont(implPtr.release()));
     }
 
     return result;
@@ -2161,25 +2283,30 @@ PDFFontPointer PDFFontCache::getFont(const PDFObject& fontObject, const QByteArr
     if (fontObject.isReference())
     {
         // Font is object reference. Look in the cache, if we have it, then return it.
-
-        QMutexLocker lock(&m_mutex);
         PDFObjectReference reference = fontObject.getReference();
+        if (PDFFontPointer font = m_fontCache.find(reference))
+        {
+            return font;
+        }
 
-        auto it = m_fontCache.find(reference);
-        if (it == m_fontCache.cend())
+        QMutexLocker lock(&m_mutex);
+        if (PDFFontPointer font = m_fontCache.find(reference))
         {
-            // We must create the font
-            PDFFontPointer font = PDFFont::createFont(fontObject, fontId, m_document);
+            // Other thread was faster
+            return font;
+        }
 
-            if (m_fontCacheShrinkDisabledObjects.empty() && m_fontCache.size() >= m_fontCacheLimit)
-            {
-                // We have exceeded the cache limit. Clear the cache.
-                m_fontCache.clear();
-            }
+        // We must create the font
+        PDFFontPointer font = PDFFont::createFont(fontObject, fontId, m_document);
 
-            it = m_fontCache.insert(std::make_pair(reference, qMove(font))).first;
+        if (m_fontCacheShrinkDisabledObjects.empty() && m_fontCache.size() >= m_fontCacheLimit)
+        {
+            // We have exceeded the cache limit. Clear the cache.
+            m_fontCache.clear();
         }
-        return it->second;
+
+        m_fontCache.insert(reference, font);
+        return font;
     }
     else
     {
@@ -2192,22 +2319,29 @@ PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font,
 {
     Q_ASSERT(font);
 
+    const std::pair<PDFFontPointer, PDFReal> key(font, size);
+    if (PDFRealizedFontPointer realizedFont = m_realizedFontCache.find(key))
+    {
+        return realizedFont;
+    }
+
     QMutexLocker lock(&m_mutex);
-    auto it = m_realizedFontCache.find(std::make_pair(font, size));
-    if (it == m_realizedFontCache.cend())
+    if (PDFRealizedFontPointer realizedFont = m_realizedFontCache.find(key))
     {
-        // We must create the realized font
-        PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
+        // Other thread was faster
+        return realizedFont;
+    }
 
-        if (m_fontCacheShrinkDisabledObjects.empty() && m_realizedFontCache.size() >= m_realizedFontCacheLimit)
-        {
-            m_realizedFontCache.clear();
-        }
+    // We must create the realized font
+    PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
 
-        it = m_realizedFontCache.insert(std::make_pair(std::make_pair(font, size), qMove(realizedFont))).first;
+    if (m_fontCacheShrinkDisabledObjects.empty() && m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+    {
+        m_realizedFontCache.clear();
     }
 
-    return it->second;
+    m_realizedFontCache.insert(key, realizedFont);
+    return realizedFont;
 }
 
 void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
@@ -2251,6 +2385,153 @@ void PDFFontCache::shrink()
     }
 }
 
+PDFFontFace::PDFFontFace(QByteArray fontData, QByteArray cacheKey) :
+    m_fontData(qMove(fontData)),
+    m_cacheKey(qMove(cacheKey))
+{
+    PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&m_library));
+
+    if (FT_Error error = FT_New_Memory_Face(m_library, reinterpret_cast<const FT_Byte*>(m_fontData.constData()), m_fontData.size(), 0, &m_face))
+    {
+        // Destructor is not called, if exception is thrown from the constructor
+        FT_Done_FreeType(m_library);
+        m_library = nullptr;
+        PDFRealizedFontImpl::checkFreeTypeError(error);
+    }
+
+    FT_Select_Charmap(m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
+
+    if (FT_Error error = FT_Set_Pixel_Sizes(m_face, 0, REFERENCE_PIXEL_SIZE))
+    {
+        FT_Done_Face(m_face);
+        FT_Done_FreeType(m_library);
+        m_face = nullptr;
+        m_library = nullptr;
+        PDFRealizedFontImpl::checkFreeTypeError(error);
+    }
+
+    const size_t glyphCount = static_cast<size_t>(qMax<FT_Long>(m_face->num_glyphs, 0));
+    m_glyphPages = std::vector<std::atomic<GlyphPage*>>((glyphCount + GLYPH_PAGE_SIZE - 1) / GLYPH_PAGE_SIZE);
+}
+
+PDFFontFace::~PDFFontFace()
+{
+    for (std::atomic<GlyphPage*>& pageItem : m_glyphPages)
+    {
+        if (GlyphPage* page = pageItem.load())
+        {
+            for (std::atomic<const Glyph*>& glyph : page->glyphs)
+            {
+                delete glyph.load();
+            }
+            delete page;
+        }
+    }
+
+    if (m_face)
+    {
+        FT_Done_Face(m_face);
+        m_face = nullptr;
+    }
+
+    if (m_library)
+    {
+        FT_Done_FreeType(m_library);
+        m_library = nullptr;
+    }
+}
+
+PDFFontFaceCache::PDFFontFaceCache() :
+    m_fontFaces(DEFAULT_CACHE_LIMIT)
+{
+
+}
+
+PDFFontFaceCache* PDFFontFaceCache::getInstance()
+{
+    static PDFFontFaceCache instance;
+    return &instance;
+}
+
+PDFFontFacePointer PDFFontFaceCache::getFontFace(const QByteArray& fontData)
+{
+    QByteArray key = QCryptographicHash::hash(fontData, QCryptographicHash::Md5);
+
+    // Hash collision is very improbable, but font program from
+    // one document must never be used in another one, so we compare the data.
+    auto findFontFace = [this, &key, &fontData]() -> PDFFontFacePointer
+    {
+        if (const PDFFontFacePointer* fontFace = m_fontFaces.object(key))
+        {
+            if ((*fontFace)->getFontData() == fontData)
+            {
+                return *fontFace;
+            }
+        }
+
+        return PDFFontFacePointer();
+    };
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (PDFFontFacePointer fontFace = findFontFace())
+        {
+            return fontFace;
+        }
+    }
+
+    // Face is created without the lock, other threads can use the cache meanwhile
+    PDFFontFacePointer fontFace(new PDFFontFace(fontData, key));
+
+    QMutexLocker lock(&m_mutex);
+    if (PDFFontFacePointer cachedFontFace = findFontFace())
+    {
+        // Other thread was faster
+        return cachedFontFace;
+    }
+
+    if (!m_fontFaces.contains(key))
+    {
+        m_fontFaces.insert(key, new PDFFontFacePointer(fontFace), fontFace->getEstimatedMemoryConsumption());
+    }
+
+    return fontFace;
+}
+
+void PDFFontFaceCache::updateFontFaceCost(const PDFFontFace* fontFace)
+{
+    QMutexLocker lock(&m_mutex);
+
+    // Face may be already evicted from the cache (and used only by realized fonts)
+    const QByteArray& key = fontFace->getCacheKey();
+    const PDFFontFacePointer* cachedFontFace = m_fontFaces.object(key);
+    if (!cachedFontFace || cachedFontFace->data() != fontFace)
+    {
+        return;
+    }
+
+    // QCache can't change cost of the object, so we must insert it again
+    m_fontFaces.insert(key, new PDFFontFacePointer(*cachedFontFace), fontFace->getEstimatedMemoryConsumption());
+}
+
+void PDFFontFaceCache::setCacheLimit(qsizetype cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_fontFaces.setMaxCost(cacheLimit);
+}
+
+qsizetype PDFFontFaceCache::getCacheSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_fontFaces.totalCost();
+}
+
+void PDFFontFaceCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_fontFaces.clear();
+}
+
 const QByteArray* FontDescriptor::getEmbeddedFontData() const
 {
     if (!fontFile.isEmpty())
@@ -2269,8 +2550,80 @@ const QByteArray* FontDescriptor::getEmbeddedFontData() const
     return nullptr;
 }
 
+struct PDFFontCMap::CodeLookupTable
+{
+    /// Value in the code tables for codes without mapping. Other
+    /// values are CIDs incremented by one.
+    static constexpr CID NO_MAPPING = 0;
+
+    /// One byte codes to CIDs
+    std::array<CID, 256> oneByteCodes = { };
+
+    /// Two byte codes to CIDs, table is indexed by the first byte of the code
+    /// and then by the second byte. Table is empty, if no code starting with
+    /// the first byte is mapped.
+    std::array<std::vector<CID>, 256> twoByteCodes;
+
+    /// Maximal number of table writes when compiling the table. Overlapping
+    /// ranges can make compilation much more expensive than the table size,
+    /// entries are searched instead, if this limit is exceeded.
+    static constexpr size_t MAX_FILL_WORK = 1 << 20;
+
+    /// True, if codes longer than two bytes are present (they are found in the entries)
+    bool hasLongCodes = false;
+
+    /// True, if one and two byte codes are in the tables, otherwise
+    /// all codes are found in the entries
+    bool isValid = false;
+};
+
+struct PDFFontCMap::UnicodeLookupTable
+{
+    /// Maximal size of the dense table mapping CIDs to unicode characters
+    static constexpr CID MAX_UNICODE_TABLE_SIZE = 0x10000;
+
+    /// CIDs to unicode characters (zero means no mapping), valid only,
+    /// if \p isValid is true
+    std::vector<char16_t> unicode;
+
+    /// Maximal number of table writes when compiling the table, see
+    /// CodeLookupTable::MAX_FILL_WORK
+    static constexpr size_t MAX_FILL_WORK = CodeLookupTable::MAX_FILL_WORK;
+
+    /// True, if unicode table covers all entries
+    bool isValid = false;
+};
+
+struct PDFFontCMap::LookupTables
+{
+    ~LookupTables()
+    {
+        delete codeTable.load(std::memory_order_relaxed);
+        delete unicodeTable.load(std::memory_order_relaxed);
+    }
+
+    QMutex mutex;
+    std::atomic<const CodeLookupTable*> codeTable = nullptr;
+    std::atomic<const UnicodeLookupTable*> unicodeTable = nullptr;
+};
+
 PDFFontCMap PDFFontCMap::createFromName(const QByteArray& name)
 {
+    // Predefined CMaps (for example, CMaps of Adobe-Japan1 collection)
+    // are large and they are used by many fonts in many documents, so we parse
+    // each of them only once. Lookup tables are shared by all copies.
+    static QMutex mutex;
+    static std::map<QByteArray, PDFFontCMap> predefinedCMaps;
+
+    {
+        QMutexLocker lock(&mutex);
+        auto it = predefinedCMaps.find(name);
+        if (it != predefinedCMaps.cend())
+        {
+            return it->second;
+        }
+    }
+
     QFile file(QString(":/cmaps/%1").arg(QString::fromLatin1(name)));
     if (file.exists())
     {
@@ -2281,7 +2634,11 @@ PDFFontCMap PDFFontCMap::createFromName(const QByteArray& name)
             file.close();
         }
 
-        return createFromData(data);
+        // CMap is parsed without the lock, because it can use other predefined CMaps
+        PDFFontCMap cmap = createFromData(data);
+
+        QMutexLocker lock(&mutex);
+        return predefinedCMaps.emplace(name, qMove(cmap)).first->second;
     }
 
     throw PDFException(PDFTranslationContext::tr("Can't load CID font mapping named '%1'.").arg(QString::fromLatin1(name)));
@@ -2537,13 +2894,21 @@ PDFFontCMap PDFFontCMap::deserialize(const QByteArray& byteArray)
         result.m_entries.push_back(entry);
     }
 
+    result.m_lookupTables = std::make_shared<LookupTables>();
     return result;
 }
 
 std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
 {
     std::vector<CID> result;
+
+    if (!isValid())
+    {
+        return result;
+    }
+
     result.reserve(byteArray.size() / m_maxKeyLength);
+    const CodeLookupTable* codeTable = getCodeLookupTable();
 
     unsigned int value = 0;
     unsigned int scannedBytes = 0;
@@ -2554,12 +2919,32 @@ std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
         ++scannedBytes;
 
         // Find suitable mapping
-        auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [value, scannedBytes](const Entry& entry) { return entry.from <= value && entry.to >= value && entry.byteCount == scannedBytes; });
-        if (it != m_entries.cend())
+        CID mappedCID = CodeLookupTable::NO_MAPPING;
+        const bool useTable = codeTable->isValid && scannedBytes <= 2;
+        if (useTable && scannedBytes == 1)
         {
-            const Entry& entry = *it;
-            const CID cid = value - entry.from + entry.cid;
-            result.push_back(cid);
+            mappedCID = codeTable->oneByteCodes[value];
+        }
+        else if (useTable)
+        {
+            const std::vector<CID>& codes = codeTable->twoByteCodes[value >> 8];
+            if (!codes.empty())
+            {
+                mappedCID = codes[value & 0xFF];
+            }
+        }
+        else if (!codeTable->isValid || codeTable->hasLongCodes)
+        {
+            auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [value, scannedBytes](const Entry& entry) { return entry.from <= value && entry.to >= value && entry.byteCount == scannedBytes; });
+            if (it != m_entries.cend())
+            {
+                mappedCID = value - it->from + it->cid + 1;
+            }
+        }
+
+        if (mappedCID != CodeLookupTable::NO_MAPPING)
+        {
+            result.push_back(mappedCID - 1);
 
             value = 0;
             scannedBytes = 0;
@@ -2609,6 +2994,12 @@ QChar PDFFontCMap::getToUnicode(CID cid) const
 {
     if (isValid())
     {
+        const UnicodeLookupTable* unicodeTable = getUnicodeLookupTable();
+        if (unicodeTable->isValid)
+        {
+            return cid < unicodeTable->unicode.size() ? QChar(unicodeTable->unicode[cid]) : QChar();
+        }
+
         auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [cid](const Entry& entry) { return entry.from <= cid && entry.to >= cid; });
         if (it != m_entries.cend())
         {
@@ -2650,6 +3041,151 @@ PDFFontCMap::PDFFontCMap(Entries&& entries, bool vertical) :
     m_vertical(vertical)
 {
     m_maxKeyLength = std::accumulate(m_entries.cbegin(), m_entries.cend(), 0, [](unsigned int a, const Entry& b) { return qMax(a, b.byteCount); });
+    m_lookupTables = std::make_shared<LookupTables>();
+}
+
+const PDFFontCMap::CodeLookupTable* PDFFontCMap::getCodeLookupTable() const
+{
+    const CodeLookupTable* table = m_lookupTables->codeTable.load(std::memory_order_acquire);
+    if (!table)
+    {
+        QMutexLocker lock(&m_lookupTables->mutex);
+        table = m_lookupTables->codeTable.load(std::memory_order_relaxed);
+        if (!table)
+        {
+            table = createCodeLookupTable(m_entries).release();
+            m_lookupTables->codeTable.store(table, std::memory_order_release);
+        }
+    }
+
+    return table;
+}
+
+const PDFFontCMap::UnicodeLookupTable* PDFFontCMap::getUnicodeLookupTable() const
+{
+    const UnicodeLookupTable* table = m_lookupTables->unicodeTable.load(std::memory_order_acquire);
+    if (!table)
+    {
+        QMutexLocker lock(&m_lookupTables->mutex);
+        table = m_lookupTables->unicodeTable.load(std::memory_order_relaxed);
+        if (!table)
+        {
+            table = createUnicodeLookupTable(m_entries).release();
+            m_lookupTables->unicodeTable.store(table, std::memory_order_release);
+        }
+    }
+
+    return table;
+}
+
+std::unique_ptr<const PDFFontCMap::CodeLookupTable> PDFFontCMap::createCodeLookupTable(const Entries& entries)
+{
+    std::unique_ptr<CodeLookupTable> table = std::make_unique<CodeLookupTable>();
+
+    size_t fillWork = 0;
+    for (const Entry& entry : entries)
+    {
+        if (entry.from <= entry.to && (entry.byteCount == 1 || entry.byteCount == 2))
+        {
+            const unsigned int maxCode = entry.byteCount == 1 ? 0xFFu : 0xFFFFu;
+            fillWork += entry.from <= maxCode ? qMin(entry.to, maxCode) - entry.from + 1 : 0;
+        }
+    }
+
+    if (fillWork > CodeLookupTable::MAX_FILL_WORK)
+    {
+        // Heavily overlapping ranges, entries are searched
+        return table;
+    }
+
+    // Entries can overlap, the first suitable entry is used. So we fill
+    // the table in reverse order, earlier entries overwrite later ones.
+    for (auto it = entries.crbegin(); it != entries.crend(); ++it)
+    {
+        const Entry& entry = *it;
+
+        if (entry.from > entry.to)
+        {
+            continue;
+        }
+
+        switch (entry.byteCount)
+        {
+            case 1:
+            {
+                for (unsigned int code = entry.from; code <= qMin(entry.to, 0xFFu); ++code)
+                {
+                    table->oneByteCodes[code] = code - entry.from + entry.cid + 1;
+                }
+                break;
+            }
+
+            case 2:
+            {
+                for (unsigned int code = entry.from; code <= qMin(entry.to, 0xFFFFu); ++code)
+                {
+                    std::vector<CID>& codes = table->twoByteCodes[code >> 8];
+                    if (codes.empty())
+                    {
+                        codes.resize(256, CodeLookupTable::NO_MAPPING);
+                    }
+                    codes[code & 0xFF] = code - entry.from + entry.cid + 1;
+                }
+                break;
+            }
+
+            default:
+                table->hasLongCodes = true;
+                break;
+        }
+    }
+
+    table->isValid = true;
+    return table;
+}
+
+std::unique_ptr<const PDFFontCMap::UnicodeLookupTable> PDFFontCMap::createUnicodeLookupTable(const Entries& entries)
+{
+    std::unique_ptr<UnicodeLookupTable> table = std::make_unique<UnicodeLookupTable>();
+
+    CID unicodeTableSize = 0;
+    size_t fillWork = 0;
+    for (const Entry& entry : entries)
+    {
+        if (entry.from > entry.to)
+        {
+            continue;
+        }
+
+        if (entry.to >= UnicodeLookupTable::MAX_UNICODE_TABLE_SIZE)
+        {
+            // Sparse map, entries are searched
+            return table;
+        }
+
+        unicodeTableSize = qMax(unicodeTableSize, entry.to + 1);
+        fillWork += entry.to - entry.from + 1;
+    }
+
+    if (fillWork > UnicodeLookupTable::MAX_FILL_WORK)
+    {
+        // Heavily overlapping ranges, entries are searched
+        return table;
+    }
+
+    // Same as in the code table, the first suitable entry is used
+    table->unicode.resize(unicodeTableSize, 0);
+    for (auto it = entries.crbegin(); it != entries.crend(); ++it)
+    {
+        const Entry& entry = *it;
+        for (CID cid = entry.from; cid <= entry.to; ++cid)
+        {
+            table->unicode[cid] = char16_t(cid - entry.from + entry.cid);
+        }
+    }
+
+    table->isValid = true;
+    return table;
 }
 
 PDFFontCMap::Entries PDFFontCMap::optimize(const PDFFontCMap::Entries& entries)
@@ -24,10 +24,14 @@
 
 #include <QFont>
 #include <QMutex>
+#include <QCache>
 #include <QTransform>
 #include <QSharedPointer>
 
 #include <set>
+#include <array>
+#include <algorithm>
+#include <atomic>
 #include <unordered_map>
 
 class QPainterPath;
@@ -38,6 +42,7 @@ class PDFDocument;
 class PDFModifiedDocument;
 class PDFRenderErrorReporter;
 class PDFFontCMap;
+class PDFFontFace;
 
 using CID = unsigned int;
 using GID = unsigned int;
@@ -79,7 +84,7 @@ struct TextSequenceItem
     inline bool isAdvance() const { return advance != 0.0; }
     inline bool isNull() const { return !isCharacter() && !isAdvance(); }
 
-    const QPainterPath* glyph = nullptr;
+    const QPainterPath* glyph = nullptr; ///< Glyph outline, it must be scaled by glyph scale of the realized font
     const QByteArray* characterContentStream = nullptr;
     QChar character;
     PDFReal advance = 0;
@@ -280,6 +285,10 @@ public:
     /// Returns character info
     CharacterInfos getCharacterInfos() const;
 
+    /// Returns scale of the glyph outlines in text sequences. Glyph outlines
+    /// are shared by all sizes of the font, so they must be scaled by this value.
+    PDFReal getGlyphScale() const;
+
     /// Creates new realized font from the standard font. If font can't be created,
     /// then exception is thrown.
     static PDFRealizedFontPointer createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter);
@@ -432,8 +441,135 @@ public:
     virtual FontType getFontType() const override;
 };
 
+/// Map with lookup without locks. Map is never modified in place, modification
+/// creates a modified copy of the map, which replaces the current one (read-copy-update).
+/// Replaced copies are deleted using epochs. Each lookup registers itself in the
+/// reader counter of the current epoch parity. Writer advances the epoch, when
+/// readers of the previous epoch are finished, and copies replaced two or more
+/// epochs ago can't be used by any lookup, so they are deleted. Lookups are short,
+/// so replaced copies are deleted even if lookups run all the time. Modifications
+/// must be serialized by the caller (for example, by mutex), lookups can be
+/// performed from any thread at any time.
+template<typename Key, typename Value>
+class PDFReadCopyUpdateMap
+{
+public:
+    using Map = std::map<Key, Value>;
+
+    inline explicit PDFReadCopyUpdateMap() :
+        m_map(new Map()),
+        m_epoch(0),
+        m_readers{ 0, 0 }
+    {
+
+    }
+
+    inline ~PDFReadCopyUpdateMap()
+    {
+        delete m_map.load();
+
+        for (const RetiredMap& retiredMap : m_retiredMaps)
+        {
+            delete retiredMap.map;
+        }
+    }
+
+    PDFReadCopyUpdateMap(const PDFReadCopyUpdateMap&) = delete;
+    PDFReadCopyUpdateMap& operator=(const PDFReadCopyUpdateMap&) = delete;
+
+    /// Finds value for the given key. Returns default constructed
+    /// value, if key is not found. No lock is taken.
+    /// \param key Key
+    Value find(const Key& key) const
+    {
+        // Reader must be registered in the epoch before the map is loaded.
+        // If epoch has changed meanwhile, writer may have already checked the readers
+        // of the epoch, so we must register again in the new epoch.
+        quint64 epoch = m_epoch.load();
+        for (;;)
+        {
+            ++m_readers[epoch & 1];
+
+            const quint64 currentEpoch = m_epoch.load();
+            if (currentEpoch == epoch)
+            {
+                break;
+            }
+
+            --m_readers[epoch & 1];
+            epoch = currentEpoch;
+        }
+
+        Value result = Value();
+        const Map* map = m_map.load();
+        auto it = map->find(key);
+        if (it != map->cend())
+        {
+            result = it->second;
+        }
+
+        --m_readers[epoch & 1];
+        return result;
+    }
+
+    /// Returns count of items in the map (must be called by writer)
+    std::size_t size() const { return m_map.load()->size(); }
+
+    /// Inserts value into the map (must be called by writer)
+    /// \param key Key
+    /// \param value Value
+    void insert(const Key& key, Value value)
+    {
+        Map* map = new Map(*m_map.load());
+        (*map)[key] = qMove(value);
+        publish(map);
+    }
+
+    /// Removes all items from the map (must be called by writer)
+    void clear()
+    {
+        publish(new Map());
+    }
+
+private:
+    struct RetiredMap
+    {
+        Map* map = nullptr;
+        quint64 epoch = 0; ///< Epoch, in which map was replaced
+    };
+
+    void publish(Map* map)
+    {
+        const quint64 epoch = m_epoch.load();
+        m_retiredMaps.push_back(RetiredMap{ m_map.exchange(map), epoch });
+
+        // Readers registered in the previous epoch are finished. Readers of older
+        // epochs were finished before the epoch was advanced to the current one,
+        // so only readers of the current epoch can use the replaced maps.
+        if (m_readers[(epoch - 1) & 1].load() == 0)
+        {
+            ++m_epoch;
+        }
+
+        // Maps replaced two epochs ago can't be used by any reader
+        const quint64 currentEpoch = m_epoch.load();
+        auto it = std::find_if(m_retiredMaps.begin(), m_retiredMaps.end(), [currentEpoch](const RetiredMap& retiredMap) { return retiredMap.epoch + 2 > currentEpoch; });
+        for (auto itDelete = m_retiredMaps.begin(); itDelete != it; ++itDelete)
+        {
+            delete itDelete->map;
+        }
+        m_retiredMaps.erase(m_retiredMaps.begin(), it);
+    }
+
+    std::atomic<Map*> m_map;
+    std::atomic<quint64> m_epoch;
+    mutable std::array<std::atomic<int>, 2> m_readers;
+    std::vector<RetiredMap> m_retiredMaps;
+};
+
 /// Font cache which caches both fonts, and realized fonts. Cache has individual limit
-/// for fonts, and realized fonts.
+/// for fonts, and realized fonts. Already cached fonts and realized fonts are retrieved
+/// without locking, so the cache can be used by many page compilers in parallel.
 class PDF4QTLIBCORESHARED_EXPORT PDFFontCache
 {
 public:
@@ -483,11 +619,55 @@ private:
     size_t m_realizedFontCacheLimit;
     mutable QMutex m_mutex;
     const PDFDocument* m_document;
-    mutable std::map<PDFObjectReference, PDFFontPointer> m_fontCache;
-    mutable std::map<std::pair<PDFFontPointer, PDFReal>, PDFRealizedFontPointer> m_realizedFontCache;
+    mutable PDFReadCopyUpdateMap<PDFObjectReference, PDFFontPointer> m_fontCache;
+    mutable PDFReadCopyUpdateMap<std::pair<PDFFontPointer, PDFReal>, PDFRealizedFontPointer> m_realizedFontCache;
     mutable std::set<const void*> m_fontCacheShrinkDisabledObjects;
 };
 
+using PDFFontFacePointer = QSharedPointer<PDFFontFace>;
+
+/// Process-wide cache of loaded font programs (FreeType faces). Faces are identified
+/// by hash of the font program data, so identical fonts are loaded only once, even if
+/// they are used in different documents (or in different font caches of the same
+/// document). Realized fonts of all sizes share the face of the font program. Faces
+/// are evicted in least recently used order, when estimated memory of the cached faces
+/// exceeds the cache limit. Evicted faces are destroyed, when last realized font using
+/// them is destroyed. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFFontFaceCache
+{
+public:
+    static PDFFontFaceCache* getInstance();
+
+    /// Returns face of the font program. If face is not in the cache,
+    /// then it is created. If face can't be created, then exception is thrown.
+    /// \param fontData Font program data
+    PDFFontFacePointer getFontFace(const QByteArray& fontData);
+
+    /// Updates cost of the face in the cache, after its estimated
+    /// memory has changed (for example, when glyphs were loaded).
+    /// If face is not in the cache, nothing happens.
+    /// \param fontFace Font face
+    void updateFontFaceCost(const PDFFontFace* fontFace);
+
+    /// Sets cache limit in bytes (estimated memory of cached faces)
+    /// \param cacheLimit Cache limit
+    void setCacheLimit(qsizetype cacheLimit);
+
+    /// Returns estimated memory of cached faces in bytes
+    qsizetype getCacheSize() const;
+
+    /// Removes all faces from the cache
+    void clear();
+
+private:
+    explicit PDFFontFaceCache();
+
+    static constexpr qsizetype DEFAULT_CACHE_LIMIT = 128 * 1024 * 1024;
+
+    mutable QMutex m_mutex;
+    QCache<QByteArray, PDFFontFacePointer> m_fontFaces;
+};
+
 /// Performs mapping from CID to GID (even identity mapping, if byte array is empty)
 class PDFCIDtoGIDMapper
 {
@@ -553,7 +733,8 @@ public:
     /// Returns true, if vertical writing mode is on
     bool isVertical() const { return m_vertical; }
 
-    /// Creates mapping from name (name must be one of predefined names)
+    /// Creates mapping from name (name must be one of predefined names). Predefined
+    /// mappings are parsed only once and then they are shared by the whole process.
     static PDFFontCMap createFromName(const QByteArray& name);
 
     /// Creates mapping from data (data must be a byte array containing the CMap)
@@ -611,13 +792,37 @@ private:
 
     using Entries = std::vector<Entry>;
 
+    /// Flat table for code lookups (used, when codes are interpreted)
+    struct CodeLookupTable;
+
+    /// Dense table mapping CIDs to unicode characters (used by ToUnicode maps)
+    struct UnicodeLookupTable;
+
+    /// Lookup tables compiled on demand, shared between copies of the CMap
+    struct LookupTables;
+
     explicit PDFFontCMap(Entries&& entries, bool vertical);
 
     /// Optimizes the entries - merges entries, which can be merged. This function
     /// requires, that entries are sorted.
     static Entries optimize(const Entries& entries);
 
+    /// Returns code lookup table, table is compiled on first use
+    const CodeLookupTable* getCodeLookupTable() const;
+
+    /// Returns unicode lookup table, table is compiled on first use
+    const UnicodeLookupTable* getUnicodeLookupTable() const;
+
+    /// Compiles entries into the code lookup table
+    /// \param entries Entries
+    static std::unique_ptr<const CodeLookupTable> createCodeLookupTable(const Entries& entries);
+
+    /// Compiles entries into the unicode lookup table
+    /// \param entries Entries
+    static std::unique_ptr<const UnicodeLookupTable> createUnicodeLookupTable(const Entries& entries);
+
     Entries m_entries;
+    std::shared_ptr<LookupTables> m_lookupTables;
     unsigned int m_maxKeyLength = 0;
     bool m_vertical = false;
 };
@@ -27,6 +27,7 @@
 
 #include "pdfdbgheap.h"
 
+#include <array>
 #include <stack>
 #include <iterator>
 #include <type_traits>
@@ -49,6 +50,76 @@ PDFFunctionPtr PDFFunction::createFunction(const PDFDocument* document, const PD
     return createFunctionImpl(document, object, &context);
 }
 
+PDFFunctionPtr PDFFunction::createOptimizedFunction(PDFFunctionPtr function)
+{
+    if (!function || function->getInputVariableCount() != 1 || function->getOutputVariableCount() == 0 || function->m_domain.size() != 2)
+    {
+        return function;
+    }
+
+    // Identity and exponential functions are cheap to evaluate, and lookup
+    // table would only decrease precision (especially exponential functions
+    // with small exponent near zero).
+    if (dynamic_cast<const PDFIdentityFunction*>(function.get()) ||
+        dynamic_cast<const PDFExponentialFunction*>(function.get()) ||
+        dynamic_cast<const PDFLookupTableFunction*>(function.get()))
+    {
+        return function;
+    }
+
+    const PDFReal domainMin = function->m_domain[0];
+    const PDFReal domainMax = function->m_domain[1];
+    if (!(domainMax > domainMin))
+    {
+        return function;
+    }
+
+    // Stitching function can have a hard step at each subdomain bound, which
+    // would be smeared by interpolation of the lookup table samples. We keep
+    // the bounds exact and optimize each partial function separately.
+    if (const PDFStitchingFunction* stitchingFunction = dynamic_cast<const PDFStitchingFunction*>(function.get()))
+    {
+        bool isOptimized = false;
+        std::vector<PDFStitchingFunction::PartialFunction> partialFunctions = stitchingFunction->getPartialFunctions();
+        for (PDFStitchingFunction::PartialFunction& partialFunction : partialFunctions)
+        {
+            PDFFunctionPtr optimizedFunction = createOptimizedFunction(partialFunction.function);
+            isOptimized = isOptimized || optimizedFunction != partialFunction.function;
+            partialFunction.function = std::move(optimizedFunction);
+        }
+
+        if (!isOptimized)
+        {
+            return function;
+        }
+
+        std::vector<PDFReal> domain = function->m_domain;
+        std::vector<PDFReal> range = function->m_range;
+        return std::make_shared<PDFStitchingFunction>(function->m_m, function->m_n, std::move(domain), std::move(range), std::move(partialFunctions));
+    }
+
+    const uint32_t n = function->getOutputVariableCount();
+    const size_t sampleCount = PDFLookupTableFunction::LOOKUP_TABLE_SIZE;
+    std::vector<PDFReal> samples(sampleCount * n, 0.0);
+
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        const PDFReal x = (i + 1 < sampleCount) ? mix(static_cast<PDFReal>(i) / static_cast<PDFReal>(sampleCount - 1), domainMin, domainMax) : domainMax;
+        PDFReal* y = samples.data() + i * n;
+
+        if (!function->apply(&x, &x + 1, y, y + n))
+        {
+            // Function can't be evaluated in whole domain, we must
+            // use the original function, to report errors properly.
+            return function;
+        }
+    }
+
+    std::vector<PDFReal> domain = function->m_domain;
+    std::vector<PDFReal> range = function->m_range;
+    return std::make_shared<PDFLookupTableFunction>(n, std::move(domain), std::move(range), std::move(samples));
+}
+
 PDFFunctionPtr PDFFunction::createFunctionImpl(const PDFDocument* document, const PDFObject& object, PDFParsingContext* context)
 {
     PDFParsingContext::PDFParsingContextObjectGuard guard(context, &object);
@@ -1580,212 +1651,1433 @@ void PDFPostScriptFunctionStack::checkUnderflow(size_t n) const
     }
 }
 
-PDFPostScriptFunction::Code PDFPostScriptFunction::getCode(const QByteArray& byteArray)
+/// Compiled form of the postscript program. Operand stack is resolved statically,
+/// each value pushed onto the stack gets its own register, and stack operators
+/// (pop, exch, dup, copy, index, roll) are resolved during compilation, so they
+/// have no runtime cost. Blocks are inlined, if/ifelse statements are translated
+/// to conditional jumps. Registers are typed statically, so no type checks are
+/// performed at runtime. Execution doesn't allocate any memory.
+class PDFPostScriptFunctionCompiledProgram
 {
-    static constexpr const std::pair<Code, const  char*> codes[] =
+public:
+    static constexpr const size_t MAX_REGISTERS = 256;
+    static constexpr const size_t MAX_INSTRUCTIONS = 4096;
+
+    using RegisterIndex = uint16_t;
+
+    enum class Code : uint8_t
     {
-        // B.1 Arithmetic operators
-        std::pair<Code, const  char*>{ Code::Add, "add" },
-        std::pair<Code, const  char*>{ Code::Sub, "sub" },
-        std::pair<Code, const  char*>{ Code::Mul, "mul" },
-        std::pair<Code, const  char*>{ Code::Div, "div" },
-        std::pair<Code, const  char*>{ Code::Idiv, "idiv" },
-        std::pair<Code, const  char*>{ Code::Mod, "mod" },
-        std::pair<Code, const  char*>{ Code::Neg, "neg" },
-        std::pair<Code, const  char*>{ Code::Abs, "abs" },
-        std::pair<Code, const  char*>{ Code::Ceiling, "ceiling" },
-        std::pair<Code, const  char*>{ Code::Floor, "floor" },
-        std::pair<Code, const  char*>{ Code::Round, "round" },
-        std::pair<Code, const  char*>{ Code::Truncate, "truncate" },
-        std::pair<Code, const  char*>{ Code::Sqrt, "sqrt" },
-        std::pair<Code, const  char*>{ Code::Sin, "sin" },
-        std::pair<Code, const  char*>{ Code::Cos, "cos" },
-        std::pair<Code, const  char*>{ Code::Atan, "atan" },
-        std::pair<Code, const  char*>{ Code::Exp, "exp" },
-        std::pair<Code, const  char*>{ Code::Ln, "ln" },
-        std::pair<Code, const  char*>{ Code::Log, "log" },
-        std::pair<Code, const  char*>{ Code::Cvi, "cvi" },
-        std::pair<Code, const  char*>{ Code::Cvr, "cvr" },
+        LoadReal,
+        LoadInteger,
+        Move,
+        IntegerToReal,
+        RealToInteger,
+        AddReal,
+        AddInteger,
+        SubReal,
+        SubInteger,
+        MulReal,
+        MulInteger,
+        Div,
+        Idiv,
+        Mod,
+        NegReal,
+        NegInteger,
+        AbsReal,
+        AbsInteger,
+        Ceiling,
+        Floor,
+        Round,
+        Truncate,
+        Sqrt,
+        Sin,
+        Cos,
+        Atan,
+        Exp,
+        Ln,
+        Log,
+        EqReal,
+        EqInteger,
+        NeReal,
+        NeInteger,
+        GtReal,
+        GtInteger,
+        GeReal,
+        GeInteger,
+        LtReal,
+        LtInteger,
+        LeReal,
+        LeInteger,
+        And,
+        Or,
+        Xor,
+        NotBoolean,
+        NotInteger,
+        Bitshift,
+        Jump,
+        JumpIfFalse
+    };
 
-        // B.2 Relational, Boolean and Bitwise operators
-        std::pair<Code, const  char*>{ Code::Eq, "eq" },
-        std::pair<Code, const  char*>{ Code::Ne, "ne" },
-        std::pair<Code, const  char*>{ Code::Gt, "gt" },
-        std::pair<Code, const  char*>{ Code::Ge, "ge" },
-        std::pair<Code, const  char*>{ Code::Lt, "lt" },
-        std::pair<Code, const  char*>{ Code::Le, "le" },
-        std::pair<Code, const  char*>{ Code::And, "and" },
-        std::pair<Code, const  char*>{ Code::Or, "or" },
-        std::pair<Code, const  char*>{ Code::Xor, "xor" },
-        std::pair<Code, const  char*>{ Code::Not, "not" },
-        std::pair<Code, const  char*>{ Code::Bitshift, "bitshift" },
-        std::pair<Code, const  char*>{ Code::True, "true" },
-        std::pair<Code, const  char*>{ Code::False, "false" },
+    struct Instruction
+    {
+        Code code = Code::Jump;
+        RegisterIndex result = 0;
+        RegisterIndex a = 0;
+        RegisterIndex b = 0;
+        uint32_t target = 0;
+        PDFReal realNumber = 0.0;
+        PDFInteger integerNumber = 0;
+    };
 
-        // B.3 Conditional operators
-        std::pair<Code, const  char*>{ Code::If, "if" },
-        std::pair<Code, const  char*>{ Code::IfElse, "ifelse" },
+    /// Register value, type of the register is known from the instruction
+    /// (booleans are stored as integers 0 and 1).
+    union Register
+    {
+        PDFReal realNumber;
+        PDFInteger integerNumber;
+    };
 
-        // B.4 Stack operators
-        std::pair<Code, const  char*>{ Code::Pop, "pop" },
-        std::pair<Code, const  char*>{ Code::Exch, "exch" },
-        std::pair<Code, const  char*>{ Code::Dup, "dup" },
-        std::pair<Code, const  char*>{ Code::Copy, "copy" },
-        std::pair<Code, const  char*>{ Code::Index, "index" },
-        std::pair<Code, const  char*>{ Code::Roll, "roll" }
+    struct Output
+    {
+        RegisterIndex index = 0;
+        bool isInteger = false;
     };
 
-    for (const std::pair<Code, const  char*>& codeItem : codes)
+    /// Executes the program. Input values must be stored in first m registers.
+    /// Returns false, if runtime error occurs (for example, division by zero). Then
+    /// values of the registers are undefined.
+    /// \param registers Registers (array of MAX_REGISTERS values)
+    bool execute(Register* registers) const;
+
+    /// Returns output value
+    /// \param registers Registers (after the program has been executed)
+    /// \param index Index of the output value
+    inline PDFReal getOutput(const Register* registers, size_t index) const
     {
-        if (byteArray == codeItem.second)
-        {
-            return codeItem.first;
-        }
+        const Output& output = m_outputs[index];
+        return output.isInteger ? static_cast<PDFReal>(registers[output.index].integerNumber) : registers[output.index].realNumber;
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid operator (PostScript function) '%1'.").arg(QString::fromLatin1(byteArray)));
-}
+    std::vector<Instruction> m_instructions;
+    std::vector<Output> m_outputs;
+};
 
-PDFPostScriptFunction::PDFPostScriptFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain, std::vector<PDFReal>&& range, PDFPostScriptFunction::Program&& program) :
-    PDFFunction(m, n, std::move(domain), std::move(range)),
-    m_program(std::move(program))
+bool PDFPostScriptFunctionCompiledProgram::execute(Register* registers) const
 {
-    Q_ASSERT(!m_program.empty());
-}
+    using PDFIntegerUnsigned = std::make_unsigned<PDFInteger>::type;
 
-PDFPostScriptFunction::~PDFPostScriptFunction()
-{
+    const size_t instructionCount = m_instructions.size();
+    size_t ip = 0;
+    while (ip < instructionCount)
+    {
+        const Instruction& instruction = m_instructions[ip++];
 
-}
+        Register& result = registers[instruction.result];
+        const Register& a = registers[instruction.a];
+        const Register& b = registers[instruction.b];
 
-PDFPostScriptFunction::Program PDFPostScriptFunction::parseProgram(const QByteArray& byteArray)
-{
-    // Lexical analyzer can't handle when '{' or '}' is near next token (for example '{0' etc.)
-    QByteArray adjustedArray = byteArray;
-    adjustedArray.replace('{', " { ").replace('}', " } ");
+        switch (instruction.code)
+        {
+            case Code::LoadReal:
+                result.realNumber = instruction.realNumber;
+                break;
 
-    Program result;
-    PDFLexicalAnalyzer parser(adjustedArray.constBegin(), adjustedArray.constEnd());
-    parser.setTokenizingPostScriptFunction();
+            case Code::LoadInteger:
+                result.integerNumber = instruction.integerNumber;
+                break;
 
-    std::stack<InstructionPointer> blockCallStack;
-    while (true)
-    {
-        PDFLexicalAnalyzer::Token token = parser.fetch();
-        if (token.type == PDFLexicalAnalyzer::TokenType::EndOfFile)
-        {
-            // We are at end, stop the parsing
-            break;
-        }
+            case Code::Move:
+                result = a;
+                break;
 
-        switch (token.type)
-        {
-            case PDFLexicalAnalyzer::TokenType::Boolean:
-            {
-                result.emplace_back(OperandObject::createBoolean(token.data.toBool()), result.size() + 1);
+            case Code::IntegerToReal:
+                result.realNumber = a.integerNumber;
                 break;
-            }
 
-            case PDFLexicalAnalyzer::TokenType::Integer:
-            {
-                result.emplace_back(OperandObject::createInteger(token.data.toLongLong()), result.size() + 1);
+            case Code::RealToInteger:
+                result.integerNumber = static_cast<PDFInteger>(a.realNumber);
                 break;
-            }
 
-            case PDFLexicalAnalyzer::TokenType::Real:
+            case Code::AddReal:
+                result.realNumber = a.realNumber + b.realNumber;
+                break;
+
+            case Code::AddInteger:
+                result.integerNumber = a.integerNumber + b.integerNumber;
+                break;
+
+            case Code::SubReal:
+                result.realNumber = a.realNumber - b.realNumber;
+                break;
+
+            case Code::SubInteger:
+                result.integerNumber = a.integerNumber - b.integerNumber;
+                break;
+
+            case Code::MulReal:
+                result.realNumber = a.realNumber * b.realNumber;
+                break;
+
+            case Code::MulInteger:
+                result.integerNumber = a.integerNumber * b.integerNumber;
+                break;
+
+            case Code::Div:
             {
-                result.emplace_back(OperandObject::createReal(token.data.toDouble()), result.size() + 1);
+                if (qFuzzyIsNull(b.realNumber))
+                {
+                    return false;
+                }
+
+                result.realNumber = a.realNumber / b.realNumber;
                 break;
             }
 
-            case PDFLexicalAnalyzer::TokenType::Command:
+            case Code::Idiv:
             {
-                QByteArray command = token.data.toByteArray();
-                if (command == "{")
+                if (b.integerNumber == 0)
                 {
-                    // Opening bracket - means start of block
-                    blockCallStack.push(result.size());
-                    result.emplace_back(Code::Call, INVALID_INSTRUCTION_POINTER);
-                    result.back().operand = OperandObject::createInstructionPointer(result.size());
+                    return false;
                 }
-                else if (command == "}")
-                {
-                    // Closing bracket - means end of block
-                    if (blockCallStack.empty())
-                    {
-                        throw PDFException(PDFTranslationContext::tr("Invalid program - bad enclosing brackets (PostScript function)."));
-                    }
 
-                    result[blockCallStack.top()].next = result.size() + 1;
-                    blockCallStack.pop();
-                    result.emplace_back(Code::Return, INVALID_INSTRUCTION_POINTER);
-                }
-                else
+                result.integerNumber = a.integerNumber / b.integerNumber;
+                break;
+            }
+
+            case Code::Mod:
+            {
+                if (b.integerNumber == 0)
                 {
-                    result.emplace_back(getCode(command), result.size() + 1);
+                    return false;
                 }
 
+                result.integerNumber = a.integerNumber % b.integerNumber;
                 break;
             }
 
-            default:
+            case Code::NegReal:
+                result.realNumber = -a.realNumber;
+                break;
+
+            case Code::NegInteger:
+                result.integerNumber = -a.integerNumber;
+                break;
+
+            case Code::AbsReal:
+                result.realNumber = qAbs(a.realNumber);
+                break;
+
+            case Code::AbsInteger:
+                result.integerNumber = qAbs(a.integerNumber);
+                break;
+
+            case Code::Ceiling:
+                result.realNumber = std::ceil(a.realNumber);
+                break;
+
+            case Code::Floor:
+                result.realNumber = std::floor(a.realNumber);
+                break;
+
+            case Code::Round:
+                result.realNumber = qRound(a.realNumber);
+                break;
+
+            case Code::Truncate:
+                result.realNumber = std::trunc(a.realNumber);
+                break;
+
+            case Code::Sqrt:
             {
-                // All other tokens treat as invalid.
-                throw PDFException(PDFTranslationContext::tr("Invalid program (PostScript function)."));
+                if (a.realNumber < 0.0)
+                {
+                    return false;
+                }
+
+                result.realNumber = std::sqrt(a.realNumber);
+                break;
             }
-        }
-    }
 
-    if (result.empty())
-    {
-        throw PDFException(PDFTranslationContext::tr("Empty program (PostScript function)."));
-    }
+            case Code::Sin:
+                result.realNumber = qSin(qDegreesToRadians(a.realNumber));
+                break;
 
-    // We must insert execute instructions, where blocks without if/ifelse occurs.
-    // We can have following program "{ 2 3 add }" which must return 5. How to find blocks,
-    // after which instructions must be executed? Next instruction must be if, or next instruction
-    // must be a call and next-next instruction must be ifelse
+            case Code::Cos:
+                result.realNumber = qCos(qDegreesToRadians(a.realNumber));
+                break;
 
-    auto isBlockUsed = [&result](InstructionPointer ip)
-    {
-        // We should call this function only on Call opcode
-        Q_ASSERT(result[ip].code == Code::Call);
+            case Code::Atan:
+            {
+                const PDFReal angles = qRadiansToDegrees(qAtan2(a.realNumber, b.realNumber));
+                result.realNumber = angles < 0.0 ? (angles + 360.0) : angles;
+                break;
+            }
 
-        const InstructionPointer next = result[ip].next;
-        if (next < result.size())
-        {
-            switch (result[next].code)
+            case Code::Exp:
+                result.realNumber = qPow(a.realNumber, b.realNumber);
+                break;
+
+            case Code::Ln:
             {
-                case Code::If:
-                case Code::IfElse:
+                if (a.realNumber < 0.0 || qFuzzyIsNull(a.realNumber))
                 {
-                    // Block is used in 'If' statement
-                    return true;
+                    return false;
                 }
 
-                case Code::Call:
-                {
-                    // We must detect, if we use 'If-Else' statement
-                    const InstructionPointer nextnext = result[next].next;
+                result.realNumber = qLn(a.realNumber);
+                break;
+            }
 
-                    if (nextnext < result.size())
-                    {
-                        return result[nextnext].code == Code::IfElse;
-                    }
+            case Code::Log:
+            {
+                if (a.realNumber < 0.0 || qFuzzyIsNull(a.realNumber))
+                {
                     return false;
                 }
 
-                default:
-                    return false;
+                result.realNumber = std::log10(a.realNumber);
+                break;
             }
-        }
 
-        return false;
-    };
+            case Code::EqReal:
+                result.integerNumber = a.realNumber == b.realNumber;
+                break;
 
-    // Insert execute instructions, where there are call blocks, which are not used in if/ifelse statements
-    for (size_t i = 0; i < result.size(); ++i)
-    {
+            case Code::EqInteger:
+                result.integerNumber = a.integerNumber == b.integerNumber;
+                break;
+
+            case Code::NeReal:
+                result.integerNumber = a.realNumber != b.realNumber;
+                break;
+
+            case Code::NeInteger:
+                result.integerNumber = a.integerNumber != b.integerNumber;
+                break;
+
+            case Code::GtReal:
+                result.integerNumber = a.realNumber > b.realNumber;
+                break;
+
+            case Code::GtInteger:
+                result.integerNumber = a.integerNumber > b.integerNumber;
+                break;
+
+            case Code::GeReal:
+                result.integerNumber = a.realNumber >= b.realNumber;
+                break;
+
+            case Code::GeInteger:
+                result.integerNumber = a.integerNumber >= b.integerNumber;
+                break;
+
+            case Code::LtReal:
+                result.integerNumber = a.realNumber < b.realNumber;
+                break;
+
+            case Code::LtInteger:
+                result.integerNumber = a.integerNumber < b.integerNumber;
+                break;
+
+            case Code::LeReal:
+                result.integerNumber = a.realNumber <= b.realNumber;
+                break;
+
+            case Code::LeInteger:
+                result.integerNumber = a.integerNumber <= b.integerNumber;
+                break;
+
+            case Code::And:
+                result.integerNumber = static_cast<PDFIntegerUnsigned>(a.integerNumber) & static_cast<PDFIntegerUnsigned>(b.integerNumber);
+                break;
+
+            case Code::Or:
+                result.integerNumber = static_cast<PDFIntegerUnsigned>(a.integerNumber) | static_cast<PDFIntegerUnsigned>(b.integerNumber);
+                break;
+
+            case Code::Xor:
+                result.integerNumber = static_cast<PDFIntegerUnsigned>(a.integerNumber) ^ static_cast<PDFIntegerUnsigned>(b.integerNumber);
+                break;
+
+            case Code::NotBoolean:
+                result.integerNumber = a.integerNumber == 0;
+                break;
+
+            case Code::NotInteger:
+                result.integerNumber = ~static_cast<PDFIntegerUnsigned>(a.integerNumber);
+                break;
+
+            case Code::Bitshift:
+            {
+                const PDFInteger shift = b.integerNumber;
+                const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(a.integerNumber);
+                PDFIntegerUnsigned shiftedValue = value;
+
+                if (shift > 0)
+                {
+                    shiftedValue = value << shift;
+                }
+                else if (shift < 0)
+                {
+                    shiftedValue = value >> -shift;
+                }
+
+                result.integerNumber = shiftedValue;
+                break;
+            }
+
+            case Code::Jump:
+                ip = instruction.target;
+                break;
+
+            case Code::JumpIfFalse:
+            {
+                if (!a.integerNumber)
+                {
+                    ip = instruction.target;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Compiles postscript program into register-based form. Program is compiled
+/// only, if stack depth and types of all operands can be determined statically,
+/// i.e. both branches of conditional statements must leave stack of the same depth
+/// and compatible types, and operands of copy, index and roll operators must be
+/// integer constants. Otherwise, program isn't compiled and interpreter is used.
+class PDFPostScriptFunctionCompiler
+{
+public:
+    using Program = PDFPostScriptFunction::Program;
+    using Code = PDFPostScriptFunction::Code;
+    using CodeObject = PDFPostScriptFunction::CodeObject;
+    using InstructionPointer = PDFPostScriptFunction::InstructionPointer;
+    using CompiledProgram = PDFPostScriptFunctionCompiledProgram;
+    using CompiledCode = PDFPostScriptFunctionCompiledProgram::Code;
+    using RegisterIndex = PDFPostScriptFunctionCompiledProgram::RegisterIndex;
+
+    explicit inline PDFPostScriptFunctionCompiler(const Program& program, uint32_t m, uint32_t n) :
+        m_program(program),
+        m_m(m),
+        m_n(n),
+        m_registerCount(0),
+        m_blockDepth(0)
+    {
+
+    }
+
+    /// Compiles the program. If program can't be compiled, nullptr is returned.
+    std::unique_ptr<CompiledProgram> compile();
+
+private:
+    static constexpr const size_t MAX_STACK_SIZE = 100;
+    static constexpr const size_t MAX_BLOCK_DEPTH = 64;
+
+    enum class ValueType
+    {
+        Real,       ///< Real number
+        Integer,    ///< Integer number
+        Number,     ///< Integer or real number (known only at runtime), stored as real number
+        Boolean,    ///< Boolean value
+        Block       ///< Block (procedure), resolved statically
+    };
+
+    struct Value
+    {
+        ValueType type = ValueType::Real;
+        RegisterIndex index = 0;
+        InstructionPointer block = PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER;
+        bool isConstant = false;
+        PDFInteger constant = 0;
+    };
+
+    using Stack = std::vector<Value>;
+
+    /// Compilation failed, program can't be compiled
+    [[noreturn]] static void fail() { throw PDFPostScriptFunction::PDFPostScriptFunctionException(QString()); }
+
+    static bool isNumber(ValueType type) { return type == ValueType::Real || type == ValueType::Integer || type == ValueType::Number; }
+    static bool isReal(ValueType type) { return type == ValueType::Real || type == ValueType::Number; }
+
+    /// Compiles sequence of instructions, starting at \p ip. If \p isBlock is true,
+    /// then sequence is terminated with return instruction, otherwise it is terminated
+    /// at the end of the program.
+    void compileSequence(InstructionPointer ip, Stack& stack, bool isBlock);
+
+    /// Compiles if/ifelse statement
+    /// \param stack Stack (condition and blocks were already popped)
+    /// \param condition Condition value
+    /// \param trueBlock Block executed, if condition is true
+    /// \param falseBlock Block executed, if condition is false (can be invalid)
+    void compileConditional(Stack& stack, const Value& condition, InstructionPointer trueBlock, InstructionPointer falseBlock);
+
+    /// Compiles single operator (arithmetic, relational, boolean or bitwise)
+    void compileOperator(Code code, Stack& stack);
+
+    Value pop(Stack& stack) const;
+    void push(Stack& stack, const Value& value) const;
+    void checkUnderflow(const Stack& stack, size_t n) const;
+
+    /// Creates new value in new register
+    Value createValue(ValueType type);
+
+    /// Converts value to real number (emits conversion, if value is integer)
+    Value toReal(const Value& value);
+
+    /// Emits move of the value to the target register (of the target type)
+    void emitMove(RegisterIndex target, ValueType targetType, const Value& value);
+
+    size_t emit(CompiledCode code, RegisterIndex result, RegisterIndex a = 0, RegisterIndex b = 0);
+    Value emitUnary(CompiledCode code, ValueType resultType, const Value& a);
+    Value emitBinary(CompiledCode code, ValueType resultType, const Value& a, const Value& b);
+
+    const Program& m_program;
+    uint32_t m_m;
+    uint32_t m_n;
+    size_t m_registerCount;
+    size_t m_blockDepth;
+    std::vector<CompiledProgram::Instruction> m_instructions;
+};
+
+std::unique_ptr<PDFPostScriptFunctionCompiledProgram> PDFPostScriptFunctionCompiler::compile()
+{
+    if (m_m > CompiledProgram::MAX_REGISTERS || m_program.empty())
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        Stack stack;
+        for (uint32_t i = 0; i < m_m; ++i)
+        {
+            push(stack, createValue(ValueType::Real));
+        }
+
+        compileSequence(0, stack, false);
+
+        if (stack.size() != m_n)
+        {
+            fail();
+        }
+
+        std::unique_ptr<CompiledProgram> compiledProgram = std::make_unique<CompiledProgram>();
+        compiledProgram->m_instructions = qMove(m_instructions);
+        compiledProgram->m_instructions.shrink_to_fit();
+        compiledProgram->m_outputs.reserve(stack.size());
+
+        for (const Value& value : stack)
+        {
+            if (!isNumber(value.type))
+            {
+                fail();
+            }
+
+            CompiledProgram::Output output;
+            output.index = value.index;
+            output.isInteger = value.type == ValueType::Integer;
+            compiledProgram->m_outputs.push_back(output);
+        }
+
+        return compiledProgram;
+    }
+    catch (const PDFPostScriptFunction::PDFPostScriptFunctionException&)
+    {
+        // Program can't be compiled
+    }
+
+    return nullptr;
+}
+
+void PDFPostScriptFunctionCompiler::compileSequence(InstructionPointer ip, Stack& stack, bool isBlock)
+{
+    if (++m_blockDepth > MAX_BLOCK_DEPTH)
+    {
+        fail();
+    }
+
+    while (true)
+    {
+        if (ip == PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+        {
+            if (isBlock)
+            {
+                // Block is not terminated by return instruction
+                fail();
+            }
+            break;
+        }
+
+        if (ip >= m_program.size())
+        {
+            fail();
+        }
+
+        const CodeObject& instruction = m_program[ip];
+        if (instruction.code == Code::Return)
+        {
+            if (!isBlock)
+            {
+                // Call stack underflow
+                fail();
+            }
+            break;
+        }
+
+        switch (instruction.code)
+        {
+            case Code::Push:
+            {
+                Value value;
+                switch (instruction.operand.type)
+                {
+                    case PDFPostScriptFunction::OperandType::Real:
+                        value = createValue(ValueType::Real);
+                        m_instructions[emit(CompiledCode::LoadReal, value.index)].realNumber = instruction.operand.realNumber;
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::Integer:
+                        value = createValue(ValueType::Integer);
+                        value.isConstant = true;
+                        value.constant = instruction.operand.integerNumber;
+                        m_instructions[emit(CompiledCode::LoadInteger, value.index)].integerNumber = instruction.operand.integerNumber;
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::Boolean:
+                        value = createValue(ValueType::Boolean);
+                        m_instructions[emit(CompiledCode::LoadInteger, value.index)].integerNumber = instruction.operand.boolean ? 1 : 0;
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::InstructionPointer:
+                        fail();
+                }
+
+                push(stack, value);
+                break;
+            }
+
+            case Code::True:
+            case Code::False:
+            {
+                Value value = createValue(ValueType::Boolean);
+                m_instructions[emit(CompiledCode::LoadInteger, value.index)].integerNumber = (instruction.code == Code::True) ? 1 : 0;
+                push(stack, value);
+                break;
+            }
+
+            case Code::Call:
+            {
+                Value value;
+                value.type = ValueType::Block;
+                value.block = instruction.operand.instructionPointer;
+                push(stack, value);
+                break;
+            }
+
+            case Code::Execute:
+            {
+                const Value block = pop(stack);
+                if (block.type != ValueType::Block)
+                {
+                    fail();
+                }
+
+                compileSequence(block.block, stack, true);
+                break;
+            }
+
+            case Code::If:
+            {
+                const Value block = pop(stack);
+                const Value condition = pop(stack);
+                if (block.type != ValueType::Block || condition.type != ValueType::Boolean)
+                {
+                    fail();
+                }
+
+                compileConditional(stack, condition, block.block, PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER);
+                break;
+            }
+
+            case Code::IfElse:
+            {
+                const Value falseBlock = pop(stack);
+                const Value trueBlock = pop(stack);
+                const Value condition = pop(stack);
+                if (falseBlock.type != ValueType::Block || trueBlock.type != ValueType::Block || condition.type != ValueType::Boolean)
+                {
+                    fail();
+                }
+
+                compileConditional(stack, condition, trueBlock.block, falseBlock.block);
+                break;
+            }
+
+            case Code::Pop:
+            {
+                pop(stack);
+                break;
+            }
+
+            case Code::Exch:
+            {
+                checkUnderflow(stack, 2);
+                std::swap(stack[stack.size() - 2], stack[stack.size() - 1]);
+                break;
+            }
+
+            case Code::Dup:
+            {
+                checkUnderflow(stack, 1);
+                push(stack, stack.back());
+                break;
+            }
+
+            case Code::Copy:
+            {
+                const Value n = pop(stack);
+                if (n.type != ValueType::Integer || !n.isConstant || n.constant < 0)
+                {
+                    fail();
+                }
+
+                const size_t count = static_cast<size_t>(n.constant);
+                checkUnderflow(stack, count);
+
+                const size_t startIndex = stack.size() - count;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    push(stack, stack[startIndex + i]);
+                }
+                break;
+            }
+
+            case Code::Index:
+            {
+                const Value n = pop(stack);
+                if (n.type != ValueType::Integer || !n.isConstant || n.constant < 0)
+                {
+                    fail();
+                }
+
+                const size_t index = static_cast<size_t>(n.constant);
+                checkUnderflow(stack, index + 1);
+                push(stack, stack[stack.size() - 1 - index]);
+                break;
+            }
+
+            case Code::Roll:
+            {
+                const Value j = pop(stack);
+                const Value n = pop(stack);
+                if (j.type != ValueType::Integer || !j.isConstant ||
+                    n.type != ValueType::Integer || !n.isConstant || n.constant < 0)
+                {
+                    fail();
+                }
+
+                const PDFInteger count = n.constant;
+                if (count == 0)
+                {
+                    break;
+                }
+
+                const PDFInteger shift = j.constant % count;
+                if (shift == 0)
+                {
+                    break;
+                }
+
+                checkUnderflow(stack, static_cast<size_t>(count));
+
+                auto itBegin = std::next(stack.begin(), stack.size() - static_cast<size_t>(count));
+                if (shift > 0)
+                {
+                    std::rotate(itBegin, stack.end() - shift, stack.end());
+                }
+                else
+                {
+                    std::rotate(itBegin, itBegin - shift, stack.end());
+                }
+                break;
+            }
+
+            default:
+            {
+                compileOperator(instruction.code, stack);
+                break;
+            }
+        }
+
+        ip = instruction.next;
+    }
+
+    --m_blockDepth;
+}
+
+void PDFPostScriptFunctionCompiler::compileConditional(Stack& stack, const Value& condition, InstructionPointer trueBlock, InstructionPointer falseBlock)
+{
+    // Layout of the generated code:
+    //      JumpIfFalse condition -> false part
+    //      true block
+    //      Jump -> true moves
+    //  false part:
+    //      false block (if present)
+    //      false moves
+    //      Jump -> end
+    //  true moves:
+    //      true moves
+    //  end:
+    //
+    // Moves unify registers of both branches, so the stack after the
+    // conditional statement is the same regardless of the branch taken.
+
+    const size_t jumpToFalsePart = emit(CompiledCode::JumpIfFalse, 0, condition.index);
+
+    Stack trueStack = stack;
+    compileSequence(trueBlock, trueStack, true);
+    const size_t jumpToTrueMoves = emit(CompiledCode::Jump, 0);
+
+    m_instructions[jumpToFalsePart].target = static_cast<uint32_t>(m_instructions.size());
+    Stack falseStack = stack;
+    if (falseBlock != PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+    {
+        compileSequence(falseBlock, falseStack, true);
+    }
+
+    if (trueStack.size() != falseStack.size())
+    {
+        fail();
+    }
+
+    Stack joinedStack = trueStack;
+    std::vector<size_t> movedIndices;
+    for (size_t i = 0; i < trueStack.size(); ++i)
+    {
+        const Value& trueValue = trueStack[i];
+        const Value& falseValue = falseStack[i];
+
+        if (trueValue.type == ValueType::Block || falseValue.type == ValueType::Block)
+        {
+            if (trueValue.type != falseValue.type || trueValue.block != falseValue.block)
+            {
+                fail();
+            }
+            continue;
+        }
+
+        if (trueValue.index == falseValue.index)
+        {
+            // Same value in both branches
+            continue;
+        }
+
+        ValueType type = trueValue.type;
+        if (trueValue.type != falseValue.type)
+        {
+            if (!isNumber(trueValue.type) || !isNumber(falseValue.type))
+            {
+                fail();
+            }
+
+            type = ValueType::Number;
+        }
+
+        joinedStack[i] = createValue(type);
+        movedIndices.push_back(i);
+    }
+
+    for (size_t i : movedIndices)
+    {
+        emitMove(joinedStack[i].index, joinedStack[i].type, falseStack[i]);
+    }
+    const size_t jumpToEnd = emit(CompiledCode::Jump, 0);
+
+    m_instructions[jumpToTrueMoves].target = static_cast<uint32_t>(m_instructions.size());
+    for (size_t i : movedIndices)
+    {
+        emitMove(joinedStack[i].index, joinedStack[i].type, trueStack[i]);
+    }
+
+    m_instructions[jumpToEnd].target = static_cast<uint32_t>(m_instructions.size());
+    stack = qMove(joinedStack);
+}
+
+void PDFPostScriptFunctionCompiler::compileOperator(Code code, Stack& stack)
+{
+    switch (code)
+    {
+        case Code::Add:
+        case Code::Sub:
+        case Code::Mul:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+
+            if (a.type == ValueType::Integer && b.type == ValueType::Integer)
+            {
+                const CompiledCode compiledCode = (code == Code::Add) ? CompiledCode::AddInteger : ((code == Code::Sub) ? CompiledCode::SubInteger : CompiledCode::MulInteger);
+                push(stack, emitBinary(compiledCode, ValueType::Integer, a, b));
+            }
+            else
+            {
+                const CompiledCode compiledCode = (code == Code::Add) ? CompiledCode::AddReal : ((code == Code::Sub) ? CompiledCode::SubReal : CompiledCode::MulReal);
+                push(stack, emitBinary(compiledCode, ValueType::Real, toReal(a), toReal(b)));
+            }
+            break;
+        }
+
+        case Code::Div:
+        case Code::Atan:
+        case Code::Exp:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+            const CompiledCode compiledCode = (code == Code::Div) ? CompiledCode::Div : ((code == Code::Atan) ? CompiledCode::Atan : CompiledCode::Exp);
+            push(stack, emitBinary(compiledCode, ValueType::Real, toReal(a), toReal(b)));
+            break;
+        }
+
+        case Code::Idiv:
+        case Code::Mod:
+        case Code::Bitshift:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+
+            if (a.type != ValueType::Integer || b.type != ValueType::Integer)
+            {
+                fail();
+            }
+
+            const CompiledCode compiledCode = (code == Code::Idiv) ? CompiledCode::Idiv : ((code == Code::Mod) ? CompiledCode::Mod : CompiledCode::Bitshift);
+            push(stack, emitBinary(compiledCode, ValueType::Integer, a, b));
+            break;
+        }
+
+        case Code::Neg:
+        case Code::Abs:
+        {
+            const Value a = pop(stack);
+
+            if (a.type == ValueType::Integer)
+            {
+                push(stack, emitUnary((code == Code::Neg) ? CompiledCode::NegInteger : CompiledCode::AbsInteger, ValueType::Integer, a));
+            }
+            else if (isReal(a.type))
+            {
+                push(stack, emitUnary((code == Code::Neg) ? CompiledCode::NegReal : CompiledCode::AbsReal, a.type, a));
+            }
+            else
+            {
+                fail();
+            }
+            break;
+        }
+
+        case Code::Ceiling:
+        case Code::Floor:
+        case Code::Round:
+        case Code::Truncate:
+        {
+            const Value a = pop(stack);
+
+            if (a.type == ValueType::Integer)
+            {
+                // Integer value remains unchanged
+                push(stack, a);
+            }
+            else if (isReal(a.type))
+            {
+                CompiledCode compiledCode = CompiledCode::Truncate;
+                switch (code)
+                {
+                    case Code::Ceiling:
+                        compiledCode = CompiledCode::Ceiling;
+                        break;
+                    case Code::Floor:
+                        compiledCode = CompiledCode::Floor;
+                        break;
+                    case Code::Round:
+                        compiledCode = CompiledCode::Round;
+                        break;
+                    default:
+                        break;
+                }
+
+                push(stack, emitUnary(compiledCode, a.type, a));
+            }
+            else
+            {
+                fail();
+            }
+            break;
+        }
+
+        case Code::Sqrt:
+        case Code::Sin:
+        case Code::Cos:
+        case Code::Ln:
+        case Code::Log:
+        {
+            CompiledCode compiledCode = CompiledCode::Sqrt;
+            switch (code)
+            {
+                case Code::Sin:
+                    compiledCode = CompiledCode::Sin;
+                    break;
+                case Code::Cos:
+                    compiledCode = CompiledCode::Cos;
+                    break;
+                case Code::Ln:
+                    compiledCode = CompiledCode::Ln;
+                    break;
+                case Code::Log:
+                    compiledCode = CompiledCode::Log;
+                    break;
+                default:
+                    break;
+            }
+
+            push(stack, emitUnary(compiledCode, ValueType::Real, toReal(pop(stack))));
+            break;
+        }
+
+        case Code::Cvi:
+        {
+            const Value a = pop(stack);
+
+            if (a.type == ValueType::Integer)
+            {
+                push(stack, a);
+            }
+            else if (isReal(a.type))
+            {
+                push(stack, emitUnary(CompiledCode::RealToInteger, ValueType::Integer, a));
+            }
+            else
+            {
+                fail();
+            }
+            break;
+        }
+
+        case Code::Cvr:
+        {
+            Value a = toReal(pop(stack));
+            a.type = ValueType::Real;
+            push(stack, a);
+            break;
+        }
+
+        case Code::Eq:
+        case Code::Ne:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+
+            if ((a.type == ValueType::Integer && b.type == ValueType::Integer) ||
+                (a.type == ValueType::Boolean && b.type == ValueType::Boolean))
+            {
+                push(stack, emitBinary((code == Code::Eq) ? CompiledCode::EqInteger : CompiledCode::NeInteger, ValueType::Boolean, a, b));
+            }
+            else
+            {
+                push(stack, emitBinary((code == Code::Eq) ? CompiledCode::EqReal : CompiledCode::NeReal, ValueType::Boolean, toReal(a), toReal(b)));
+            }
+            break;
+        }
+
+        case Code::Gt:
+        case Code::Ge:
+        case Code::Lt:
+        case Code::Le:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+
+            const bool isInteger = a.type == ValueType::Integer && b.type == ValueType::Integer;
+            CompiledCode compiledCode = CompiledCode::LeReal;
+            switch (code)
+            {
+                case Code::Gt:
+                    compiledCode = isInteger ? CompiledCode::GtInteger : CompiledCode::GtReal;
+                    break;
+                case Code::Ge:
+                    compiledCode = isInteger ? CompiledCode::GeInteger : CompiledCode::GeReal;
+                    break;
+                case Code::Lt:
+                    compiledCode = isInteger ? CompiledCode::LtInteger : CompiledCode::LtReal;
+                    break;
+                default:
+                    compiledCode = isInteger ? CompiledCode::LeInteger : CompiledCode::LeReal;
+                    break;
+            }
+
+            if (isInteger)
+            {
+                push(stack, emitBinary(compiledCode, ValueType::Boolean, a, b));
+            }
+            else
+            {
+                push(stack, emitBinary(compiledCode, ValueType::Boolean, toReal(a), toReal(b)));
+            }
+            break;
+        }
+
+        case Code::And:
+        case Code::Or:
+        case Code::Xor:
+        {
+            const Value b = pop(stack);
+            const Value a = pop(stack);
+
+            if (a.type != b.type || (a.type != ValueType::Integer && a.type != ValueType::Boolean))
+            {
+                fail();
+            }
+
+            // Booleans are stored as 0 and 1, so bitwise operations can be used
+            const CompiledCode compiledCode = (code == Code::And) ? CompiledCode::And : ((code == Code::Or) ? CompiledCode::Or : CompiledCode::Xor);
+            push(stack, emitBinary(compiledCode, a.type, a, b));
+            break;
+        }
+
+        case Code::Not:
+        {
+            const Value a = pop(stack);
+
+            if (a.type == ValueType::Integer)
+            {
+                push(stack, emitUnary(CompiledCode::NotInteger, ValueType::Integer, a));
+            }
+            else if (a.type == ValueType::Boolean)
+            {
+                push(stack, emitUnary(CompiledCode::NotBoolean, ValueType::Boolean, a));
+            }
+            else
+            {
+                fail();
+            }
+            break;
+        }
+
+        default:
+        {
+            fail();
+        }
+    }
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::pop(Stack& stack) const
+{
+    checkUnderflow(stack, 1);
+    Value value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+void PDFPostScriptFunctionCompiler::push(Stack& stack, const Value& value) const
+{
+    stack.push_back(value);
+
+    if (stack.size() > MAX_STACK_SIZE)
+    {
+        fail();
+    }
+}
+
+void PDFPostScriptFunctionCompiler::checkUnderflow(const Stack& stack, size_t n) const
+{
+    if (stack.size() < n)
+    {
+        fail();
+    }
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::createValue(ValueType type)
+{
+    if (m_registerCount >= CompiledProgram::MAX_REGISTERS)
+    {
+        fail();
+    }
+
+    Value value;
+    value.type = type;
+    value.index = static_cast<RegisterIndex>(m_registerCount++);
+    return value;
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::toReal(const Value& value)
+{
+    if (isReal(value.type))
+    {
+        return value;
+    }
+
+    if (value.type != ValueType::Integer)
+    {
+        fail();
+    }
+
+    return emitUnary(CompiledCode::IntegerToReal, ValueType::Real, value);
+}
+
+void PDFPostScriptFunctionCompiler::emitMove(RegisterIndex target, ValueType targetType, const Value& value)
+{
+    if (isReal(targetType) && value.type == ValueType::Integer)
+    {
+        emit(CompiledCode::IntegerToReal, target, value.index);
+    }
+    else
+    {
+        emit(CompiledCode::Move, target, value.index);
+    }
+}
+
+size_t PDFPostScriptFunctionCompiler::emit(CompiledCode code, RegisterIndex result, RegisterIndex a, RegisterIndex b)
+{
+    if (m_instructions.size() >= CompiledProgram::MAX_INSTRUCTIONS)
+    {
+        fail();
+    }
+
+    CompiledProgram::Instruction instruction;
+    instruction.code = code;
+    instruction.result = result;
+    instruction.a = a;
+    instruction.b = b;
+    m_instructions.push_back(instruction);
+    return m_instructions.size() - 1;
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::emitUnary(CompiledCode code, ValueType resultType, const Value& a)
+{
+    Value result = createValue(resultType);
+    emit(code, result.index, a.index);
+    return result;
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::emitBinary(CompiledCode code, ValueType resultType, const Value& a, const Value& b)
+{
+    Value result = createValue(resultType);
+    emit(code, result.index, a.index, b.index);
+    return result;
+}
+
+PDFPostScriptFunction::Code PDFPostScriptFunction::getCode(const QByteArray& byteArray)
+{
+    static constexpr const std::pair<Code, const  char*> codes[] =
+    {
+        // B.1 Arithmetic operators
+        std::pair<Code, const  char*>{ Code::Add, "add" },
+        std::pair<Code, const  char*>{ Code::Sub, "sub" },
+        std::pair<Code, const  char*>{ Code::Mul, "mul" },
+        std::pair<Code, const  char*>{ Code::Div, "div" },
+        std::pair<Code, const  char*>{ Code::Idiv, "idiv" },
+        std::pair<Code, const  char*>{ Code::Mod, "mod" },
+        std::pair<Code, const  char*>{ Code::Neg, "neg" },
+        std::pair<Code, const  char*>{ Code::Abs, "abs" },
+        std::pair<Code, const  char*>{ Code::Ceiling, "ceiling" },
+        std::pair<Code, const  char*>{ Code::Floor, "floor" },
+        std::pair<Code, const  char*>{ Code::Round, "round" },
+        std::pair<Code, const  char*>{ Code::Truncate, "truncate" },
+        std::pair<Code, const  char*>{ Code::Sqrt, "sqrt" },
+        std::pair<Code, const  char*>{ Code::Sin, "sin" },
+        std::pair<Code, const  char*>{ Code::Cos, "cos" },
+        std::pair<Code, const  char*>{ Code::Atan, "atan" },
+        std::pair<Code, const  char*>{ Code::Exp, "exp" },
+        std::pair<Code, const  char*>{ Code::Ln, "ln" },
+        std::pair<Code, const  char*>{ Code::Log, "log" },
+        std::pair<Code, const  char*>{ Code::Cvi, "cvi" },
+        std::pair<Code, const  char*>{ Code::Cvr, "cvr" },
+
+        // B.2 Relational, Boolean and Bitwise operators
+        std::pair<Code, const  char*>{ Code::Eq, "eq" },
+        std::pair<Code, const  char*>{ Code::Ne, "ne" },
+        std::pair<Code, const  char*>{ Code::Gt, "gt" },
+        std::pair<Code, const  char*>{ Code::Ge, "ge" },
+        std::pair<Code, const  char*>{ Code::Lt, "lt" },
+        std::pair<Code, const  char*>{ Code::Le, "le" },
+        std::pair<Code, const  char*>{ Code::And, "and" },
+        std::pair<Code, const  char*>{ Code::Or, "or" },
+        std::pair<Code, const  char*>{ Code::Xor, "xor" },
+        std::pair<Code, const  char*>{ Code::Not, "not" },
+        std::pair<Code, const  char*>{ Code::Bitshift, "bitshift" },
+        std::pair<Code, const  char*>{ Code::True, "true" },
+        std::pair<Code, const  char*>{ Code::False, "false" },
+
+        // B.3 Conditional operators
+        std::pair<Code, const  char*>{ Code::If, "if" },
+        std::pair<Code, const  char*>{ Code::IfElse, "ifelse" },
+
+        // B.4 Stack operators
+        std::pair<Code, const  char*>{ Code::Pop, "pop" },
+        std::pair<Code, const  char*>{ Code::Exch, "exch" },
+        std::pair<Code, const  char*>{ Code::Dup, "dup" },
+        std::pair<Code, const  char*>{ Code::Copy, "copy" },
+        std::pair<Code, const  char*>{ Code::Index, "index" },
+        std::pair<Code, const  char*>{ Code::Roll, "roll" }
+    };
+
+    for (const std::pair<Code, const  char*>& codeItem : codes)
+    {
+        if (byteArray == codeItem.second)
+        {
+            return codeItem.first;
+        }
+    }
+
+    throw PDFException(PDFTranslationContext::tr("Invalid operator (PostScript function) '%1'.").arg(QString::fromLatin1(byteArray)));
+}
+
+PDFPostScriptFunction::PDFPostScriptFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain, std::vector<PDFReal>&& range, PDFPostScriptFunction::Program&& program) :
+    PDFFunction(m, n, std::move(domain), std::move(range)),
+    m_program(std::move(program))
+{
+    Q_ASSERT(!m_program.empty());
+
+    PDFPostScriptFunctionCompiler compiler(m_program, m_m, m_n);
+    m_compiledProgram = compiler.compile();
+}
+
+PDFPostScriptFunction::~PDFPostScriptFunction()
+{
+
+}
+
+PDFPostScriptFunction::Program PDFPostScriptFunction::parseProgram(const QByteArray& byteArray)
+{
+    // Lexical analyzer can't handle when '{' or '}' is near next token (for example '{0' etc.)
+    QByteArray adjustedArray = byteArray;
+    adjustedArray.replace('{', " { ").replace('}', " } ");
+
+    Program result;
+    PDFLexicalAnalyzer parser(adjustedArray.constBegin(), adjustedArray.constEnd());
+    parser.setTokenizingPostScriptFunction();
+
+    std::stack<InstructionPointer> blockCallStack;
+    while (true)
+    {
+        PDFLexicalAnalyzer::Token token = parser.fetch();
+        if (token.type == PDFLexicalAnalyzer::TokenType::EndOfFile)
+        {
+            // We are at end, stop the parsing
+            break;
+        }
+
+        switch (token.type)
+        {
+            case PDFLexicalAnalyzer::TokenType::Boolean:
+            {
+                result.emplace_back(OperandObject::createBoolean(token.data.toBool()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Integer:
+            {
+                result.emplace_back(OperandObject::createInteger(token.data.toLongLong()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Real:
+            {
+                result.emplace_back(OperandObject::createReal(token.data.toDouble()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Command:
+            {
+                QByteArray command = token.data.toByteArray();
+                if (command == "{")
+                {
+                    // Opening bracket - means start of block
+                    blockCallStack.push(result.size());
+                    result.emplace_back(Code::Call, INVALID_INSTRUCTION_POINTER);
+                    result.back().operand = OperandObject::createInstructionPointer(result.size());
+                }
+                else if (command == "}")
+                {
+                    // Closing bracket - means end of block
+                    if (blockCallStack.empty())
+                    {
+                        throw PDFException(PDFTranslationContext::tr("Invalid program - bad enclosing brackets (PostScript function)."));
+                    }
+
+                    result[blockCallStack.top()].next = result.size() + 1;
+                    blockCallStack.pop();
+                    result.emplace_back(Code::Return, INVALID_INSTRUCTION_POINTER);
+                }
+                else
+                {
+                    result.emplace_back(getCode(command), result.size() + 1);
+                }
+
+                break;
+            }
+
+            default:
+            {
+                // All other tokens treat as invalid.
+                throw PDFException(PDFTranslationContext::tr("Invalid program (PostScript function)."));
+            }
+        }
+    }
+
+    if (result.empty())
+    {
+        throw PDFException(PDFTranslationContext::tr("Empty program (PostScript function)."));
+    }
+
+    // We must insert execute instructions, where blocks without if/ifelse occurs.
+    // We can have following program "{ 2 3 add }" which must return 5. How to find blocks,
+    // after which instructions must be executed? Next instruction must be if, or next instruction
+    // must be a call and next-next instruction must be ifelse
+
+    auto isBlockUsed = [&result](InstructionPointer ip)
+    {
+        // We should call this function only on Call opcode
+        Q_ASSERT(result[ip].code == Code::Call);
+
+        const InstructionPointer next = result[ip].next;
+        if (next < result.size())
+        {
+            switch (result[next].code)
+            {
+                case Code::If:
+                case Code::IfElse:
+                {
+                    // Block is used in 'If' statement
+                    return true;
+                }
+
+                case Code::Call:
+                {
+                    // We must detect, if we use 'If-Else' statement
+                    const InstructionPointer nextnext = result[next].next;
+
+                    if (nextnext < result.size())
+                    {
+                        return result[nextnext].code == Code::IfElse;
+                    }
+                    return false;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+        return false;
+    };
+
+    // Insert execute instructions, where there are call blocks, which are not used in if/ifelse statements
+    for (size_t i = 0; i < result.size(); ++i)
+    {
         if (result[i].code == Code::Call && !isBlockUsed(i))
         {
             InstructionPointer insertPosition = result[i].next;
@@ -1829,6 +3121,36 @@ PDFFunction::FunctionResult PDFPostScriptFunction::apply(const_iterator x_1, con
     const size_t m = std::distance(x_1, x_m);
     const size_t n = std::distance(y_1, y_n);
 
+    if (m_compiledProgram && m == m_m && n == m_n)
+    {
+        std::array<PDFPostScriptFunctionCompiledProgram::Register, PDFPostScriptFunctionCompiledProgram::MAX_REGISTERS> registers;
+
+        for (uint32_t i = 0; i < m_m; ++i)
+        {
+            registers[i].realNumber = clampInput(i, *std::next(x_1, i));
+        }
+
+        if (m_compiledProgram->execute(registers.data()))
+        {
+            for (uint32_t i = 0; i < m_n; ++i)
+            {
+                *std::next(y_1, i) = clampOutput(i, m_compiledProgram->getOutput(registers.data(), i));
+            }
+
+            return true;
+        }
+
+        // Runtime error has occured, let the interpreter report it
+    }
+
+    return interpret(x_1, x_m, y_1, y_n);
+}
+
+PDFFunction::FunctionResult PDFPostScriptFunction::interpret(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const
+{
+    const size_t m = std::distance(x_1, x_m);
+    const size_t n = std::distance(y_1, y_n);
+
     if (m != m_m)
     {
         return PDFTranslationContext::tr("Invalid number of operands for function. Expected %1, provided %2.").arg(m_m).arg(m);
@@ -1876,4 +3198,49 @@ PDFFunction::FunctionResult PDFPostScriptFunction::apply(const_iterator x_1, con
     return true;
 }
 
+PDFLookupTableFunction::PDFLookupTableFunction(uint32_t n,
+                                               std::vector<PDFReal>&& domain,
+                                               std::vector<PDFReal>&& range,
+                                               std::vector<PDFReal>&& samples) :
+    PDFFunction(1, n, std::move(domain), std::move(range)),
+    m_domainToIndexScale(0.0),
+    m_samples(std::move(samples))
+{
+    Q_ASSERT(m_domain.size() == 2);
+    Q_ASSERT(m_domain[1] > m_domain[0]);
+    Q_ASSERT(m_samples.size() == LOOKUP_TABLE_SIZE * n);
+
+    m_domainToIndexScale = static_cast<PDFReal>(LOOKUP_TABLE_SIZE - 1) / (m_domain[1] - m_domain[0]);
+}
+
+PDFFunction::FunctionResult PDFLookupTableFunction::apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const
+{
+    const size_t m = std::distance(x_1, x_m);
+    const size_t n = std::distance(y_1, y_n);
+
+    if (m != m_m)
+    {
+        return PDFTranslationContext::tr("Invalid number of operands for function. Expected %1, provided %2.").arg(m_m).arg(m);
+    }
+    if (n != m_n)
+    {
+        return PDFTranslationContext::tr("Invalid number of output variables for function. Expected %1, provided %2.").arg(m_n).arg(n);
+    }
+
+    const PDFReal x = clampInput(0, *x_1);
+    const PDFReal position = (x - m_domain[0]) * m_domainToIndexScale;
+    const size_t index = qMin(static_cast<size_t>(position), LOOKUP_TABLE_SIZE - 2);
+    const PDFReal t = position - static_cast<PDFReal>(index);
+
+    const PDFReal* samples0 = m_samples.data() + index * m_n;
+    const PDFReal* samples1 = samples0 + m_n;
+
+    for (uint32_t i = 0; i < m_n; ++i)
+    {
+        *std::next(y_1, i) = mix(t, samples0[i], samples1[i]);
+    }
+
+    return true;
+}
+
 }   // namespace pdf
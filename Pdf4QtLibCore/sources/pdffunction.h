@@ -29,6 +29,7 @@ class PDFObject;
 class PDFFunction;
 class PDFDocument;
 class PDFParsingContext;
+class PDFPostScriptFunctionCompiledProgram;
 
 enum class FunctionType
 {
@@ -91,6 +92,16 @@ public:
     /// \param object Object defining the function
     static PDFFunctionPtr createFunction(const PDFDocument* document, const PDFObject& object);
 
+    /// Creates function suitable for repeated evaluation in tight loops (for example,
+    /// per mesh vertex or per pixel in shadings and in tint transforms). Functions with
+    /// single input variable are pre-sampled into dense lookup table, which is then
+    /// linearly interpolated. Stitching functions can have discontinuities at subdomain
+    /// bounds, so they are not sampled as a whole, but each partial function is optimized
+    /// separately. Cheap functions, functions with more input variables and functions,
+    /// which fail to evaluate somewhere in the domain, are returned unchanged.
+    /// \param function Function to be optimized
+    static PDFFunctionPtr createOptimizedFunction(PDFFunctionPtr function);
+
 protected:
     static constexpr const size_t DEFAULT_OPERAND_COUNT = 32;
 
@@ -299,6 +310,9 @@ public:
                                   std::vector<PartialFunction>&& partialFunctions);
     virtual ~PDFStitchingFunction() override;
 
+    /// Returns partial functions with their subdomains
+    const std::vector<PartialFunction>& getPartialFunctions() const { return m_partialFunctions; }
+
     /// Transforms input values to the output values.
     /// \param x_1 Iterator to the first input value
     /// \param x_n Iterator to the end of the input values (one item after last value)
@@ -466,13 +480,62 @@ public:
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
 
+    /// Transforms input values to the output values using stack interpreter, compiled
+    /// program is never used. Reference implementation, which is also used, when program
+    /// can't be compiled, or when compiled program encounters runtime error.
+    /// \param x_1 Iterator to the first input value
+    /// \param x_n Iterator to the end of the input values (one item after last value)
+    /// \param y_1 Iterator to the first output value
+    /// \param y_n Iterator to the end of the output values (one item after last value)
+    FunctionResult interpret(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const;
+
+    /// Returns true, if program was compiled into register-based form
+    bool isCompiled() const { return m_compiledProgram != nullptr; }
+
 private:
     Program m_program;
 
+    /// Compiled program (can be nullptr, if program can't be statically compiled)
+    std::unique_ptr<PDFPostScriptFunctionCompiledProgram> m_compiledProgram;
+
     friend class PDFPostScriptFunctionStack;
     friend class PDFPostScriptFunctionExecutor;
 };
 
+/// Function with single input variable, which is approximated by dense lookup table
+/// of sampled values. Values between samples are linearly interpolated. Used as optimized
+/// form of functions, which are expensive to evaluate (postscript and stitching functions).
+class PDF4QTLIBCORESHARED_EXPORT PDFLookupTableFunction : public PDFFunction
+{
+public:
+    static constexpr const size_t LOOKUP_TABLE_SIZE = 1024;
+
+    /// Construct new lookup table function.
+    /// \param n Number of output variables
+    /// \param domain Array of 2 variables of input range - [x1 min, x1 max ]
+    /// \param range Array of 2 x n variables of output range - [y1 min, y1 max, y2 min, y2 max, ... ]
+    /// \param samples Array of LOOKUP_TABLE_SIZE x n samples, uniformly distributed over the domain
+    explicit PDFLookupTableFunction(uint32_t n,
+                                    std::vector<PDFReal>&& domain,
+                                    std::vector<PDFReal>&& range,
+                                    std::vector<PDFReal>&& samples);
+    virtual ~PDFLookupTableFunction() = default;
+
+    /// Transforms input values to the output values.
+    /// \param x_1 Iterator to the first input value
+    /// \param x_n Iterator to the end of the input values (one item after last value)
+    /// \param y_1 Iterator to the first output value
+    /// \param y_n Iterator to the end of the output values (one item after last value)
+    virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+
+private:
+    /// Scale, which maps input value (relative to the domain start) to the sample index
+    PDFReal m_domainToIndexScale;
+
+    /// Samples, LOOKUP_TABLE_SIZE x n values
+    std::vector<PDFReal> m_samples;
+};
+
 }   // namespace pdf
 
 #endif // PDFFUNCTION_H
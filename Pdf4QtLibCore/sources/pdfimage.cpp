@@ -22,6 +22,7 @@
 #include "pdfutils.h"
 #include "pdfjbig2decoder.h"
 #include "pdfccittfaxdecoder.h"
+#include "pdfcms.h"
 
 #include <openjpeg.h>
 #include <jpeglib.h>
@@ -54,7 +55,8 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                                PDFColorSpacePointer colorSpace,
                                bool isSoftMask,
                                RenderingIntent renderingIntent,
-                               PDFRenderErrorReporter* errorReporter)
+                               PDFRenderErrorReporter* errorReporter,
+                               int resolutionReduction)
 {
     PDFImage image;
     image.m_colorSpace = colorSpace;
@@ -161,7 +163,7 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
 
         if (softMaskObject.isStream())
         {
-            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter);
+            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter, resolutionReduction);
             maskingType = PDFImageData::MaskingType::SoftMask;
             image.m_softMask = qMove(softMaskImage.m_imageData);
         }
@@ -339,6 +341,13 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                 }
             }
 
+            // Use DCT scaling, if we are decoding the image at reduced resolution
+            if (resolutionReduction > 0)
+            {
+                codec.scale_num = 1;
+                codec.scale_denom = 1 << qMin(resolutionReduction, MAX_RESOLUTION_REDUCTION);
+            }
+
             jpeg_start_decompress(&codec);
 
             const JDIMENSION rowStride = codec.output_width * codec.output_components;
@@ -430,6 +439,31 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
 
                 if (opj_read_header(opjStream, codec, &jpegImage))
                 {
+                    // Skip highest resolution levels, if we are decoding the image at reduced
+                    // resolution. We must not skip all resolution levels of the image.
+                    if (resolutionReduction > 0)
+                    {
+                        if (opj_codestream_info_v2_t* codestreamInfo = opj_get_cstr_info(codec))
+                        {
+                            OPJ_UINT32 resolutionCount = std::numeric_limits<OPJ_UINT32>::max();
+                            if (codestreamInfo->m_default_tile_info.tccp_info)
+                            {
+                                for (OPJ_UINT32 i = 0; i < codestreamInfo->nbcomps; ++i)
+                                {
+                                    resolutionCount = qMin(resolutionCount, codestreamInfo->m_default_tile_info.tccp_info[i].numresolutions);
+                                }
+                            }
+
+                            const OPJ_UINT32 factor = qMin(OPJ_UINT32(qMin(resolutionReduction, MAX_RESOLUTION_REDUCTION)), resolutionCount > 0 ? resolutionCount - 1 : 0);
+                            if (factor > 0 && resolutionCount != std::numeric_limits<OPJ_UINT32>::max())
+                            {
+                                opj_set_decoded_resolution_factor(codec, factor);
+                            }
+
+                            opj_destroy_cstr_info(&codestreamInfo);
+                        }
+                    }
+
                     if (opj_set_decode_area(codec, jpegImage, decompressParameters.DA_x0, decompressParameters.DA_y0, decompressParameters.DA_x1, decompressParameters.DA_y1))
                     {
                         if (opj_decode(codec, opjStream, jpegImage))
@@ -716,6 +750,11 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
 
         QByteArray imageDataBuffer = document->getDecodedStream(stream);
         image.m_imageData = PDFImageData(components, bitsPerComponent, width, height, stride, maskingType, qMove(imageDataBuffer), qMove(mask), qMove(decode), qMove(matte));
+
+        if (resolutionReduction > 0)
+        {
+            image.m_imageData = reduceImageData(qMove(image.m_imageData), colorSpace.data(), resolutionReduction);
+        }
     }
     else if (imageMask)
     {
@@ -790,6 +829,94 @@ QImage PDFImage::getImage(const PDFCMS* cms,
     return QImage();
 }
 
+int PDFImage::getResolutionReduction(QSize imageSize, QSizeF targetSize)
+{
+    int resolutionReduction = 0;
+
+    while (resolutionReduction < MAX_RESOLUTION_REDUCTION &&
+           (imageSize.width() >> (resolutionReduction + 1)) >= targetSize.width() &&
+           (imageSize.height() >> (resolutionReduction + 1)) >= targetSize.height())
+    {
+        ++resolutionReduction;
+    }
+
+    return resolutionReduction;
+}
+
+PDFImageData PDFImage::reduceImageData(PDFImageData imageData, const PDFAbstractColorSpace* colorSpace, int resolutionReduction)
+{
+    const unsigned int factor = 1 << qBound(0, resolutionReduction, MAX_RESOLUTION_REDUCTION);
+    const unsigned int components = imageData.getComponents();
+    const unsigned int width = imageData.getWidth();
+    const unsigned int height = imageData.getHeight();
+    const unsigned int stride = imageData.getStride();
+    const QByteArray& data = imageData.getData();
+
+    // Indices of indexed color space and color key masks can't be averaged
+    const bool isIndexed = dynamic_cast<const PDFIndexedColorSpace*>(colorSpace);
+    if (factor == 1 ||
+        isIndexed ||
+        imageData.getBitsPerComponent() != 8 ||
+        imageData.getMaskingType() == PDFImageData::MaskingType::ColorKeyMasking ||
+        imageData.getMaskingType() == PDFImageData::MaskingType::ImageMask ||
+        width < factor ||
+        height < factor ||
+        data.size() < qsizetype(stride) * qsizetype(height))
+    {
+        return imageData;
+    }
+
+    const unsigned int reducedWidth = (width + factor - 1) / factor;
+    const unsigned int reducedHeight = (height + factor - 1) / factor;
+    const unsigned int reducedStride = reducedWidth * components;
+
+    QByteArray reducedData(qsizetype(reducedStride) * qsizetype(reducedHeight), 0);
+    std::vector<unsigned int> sums(reducedStride, 0);
+    std::vector<unsigned int> counts(reducedWidth, 0);
+
+    const unsigned char* source = reinterpret_cast<const unsigned char*>(data.constData());
+    unsigned char* target = reinterpret_cast<unsigned char*>(reducedData.data());
+
+    for (unsigned int reducedRow = 0; reducedRow < reducedHeight; ++reducedRow)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+        std::fill(counts.begin(), counts.end(), 0);
+
+        const unsigned int rowStart = reducedRow * factor;
+        const unsigned int rowEnd = qMin(rowStart + factor, height);
+        for (unsigned int row = rowStart; row < rowEnd; ++row)
+        {
+            const unsigned char* sourceLine = source + size_t(row) * stride;
+            for (unsigned int column = 0; column < width; ++column)
+            {
+                const unsigned int reducedColumn = column / factor;
+                unsigned int* sum = sums.data() + reducedColumn * components;
+                for (unsigned int componentIndex = 0; componentIndex < components; ++componentIndex)
+                {
+                    sum[componentIndex] += *sourceLine++;
+                }
+                ++counts[reducedColumn];
+            }
+        }
+
+        unsigned char* targetLine = target + size_t(reducedRow) * reducedStride;
+        for (unsigned int reducedColumn = 0; reducedColumn < reducedWidth; ++reducedColumn)
+        {
+            const unsigned int count = counts[reducedColumn];
+            const unsigned int* sum = sums.data() + reducedColumn * components;
+            for (unsigned int componentIndex = 0; componentIndex < components; ++componentIndex)
+            {
+                *targetLine++ = static_cast<unsigned char>((sum[componentIndex] + count / 2) / count);
+            }
+        }
+    }
+
+    std::vector<PDFInteger> colorKeyMask = imageData.getColorKeyMask();
+    std::vector<PDFReal> decode = imageData.getDecode();
+    std::vector<PDFReal> matte = imageData.getMatte();
+    return PDFImageData(components, 8, reducedWidth, reducedHeight, reducedStride, imageData.getMaskingType(), qMove(reducedData), qMove(colorKeyMask), qMove(decode), qMove(matte));
+}
+
 bool PDFImage::canBeConvertedToMonochromatic(const QImage& image)
 {
     for (int y = 0; y < image.height(); ++y)
@@ -896,4 +1023,93 @@ PDFAlternateImage PDFAlternateImage::parse(const PDFObjectStorage* storage, PDFO
     return result;
 }
 
+inline size_t qHash(const PDFImageCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.document, key.reference.objectNumber, key.reference.generation, key.colorSpaceDictionary, int(key.renderingIntent), key.isSoftMask, key.resolutionReduction);
+}
+
+inline size_t qHash(const PDFImageCache::ConvertedKey& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.key, key.cmsId);
+}
+
+PDFImageCache::PDFImageCache() :
+    m_images(DEFAULT_IMAGE_CACHE_LIMIT),
+    m_convertedImages(DEFAULT_CONVERTED_IMAGE_CACHE_LIMIT)
+{
+
+}
+
+PDFImageCache* PDFImageCache::getInstance()
+{
+    static PDFImageCache instance;
+    return &instance;
+}
+
+bool PDFImageCache::getImage(const Key& key, PDFImage& image) const
+{
+    QMutexLocker lock(&m_mutex);
+    if (const PDFImage* cachedImage = m_images.object(key))
+    {
+        image = *cachedImage;
+        return true;
+    }
+
+    return false;
+}
+
+void PDFImageCache::setImage(const Key& key, const PDFImage& image)
+{
+    const qsizetype cost = image.getImageData().getData().size() + image.getSoftMaskData().getData().size();
+
+    QMutexLocker lock(&m_mutex);
+    m_images.insert(key, new PDFImage(image), qMax(cost, qsizetype(1)));
+}
+
+bool PDFImageCache::getConvertedImage(const Key& key, const PDFCMS* cms, QImage& image) const
+{
+    QMutexLocker lock(&m_mutex);
+    if (const QImage* cachedImage = m_convertedImages.object(ConvertedKey{ key, cms ? cms->getId() : 0 }))
+    {
+        image = *cachedImage;
+        return true;
+    }
+
+    return false;
+}
+
+void PDFImageCache::setConvertedImage(const Key& key, const PDFCMS* cms, const QImage& image)
+{
+    QMutexLocker lock(&m_mutex);
+    m_convertedImages.insert(ConvertedKey{ key, cms ? cms->getId() : 0 }, new QImage(image), qMax(image.sizeInBytes(), qsizetype(1)));
+}
+
+void PDFImageCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_images.keys())
+    {
+        if (key.document == document)
+        {
+            m_images.remove(key);
+        }
+    }
+
+    for (const ConvertedKey& key : m_convertedImages.keys())
+    {
+        if (key.key.document == document)
+        {
+            m_convertedImages.remove(key);
+        }
+    }
+}
+
+void PDFImageCache::setCacheLimits(qsizetype imageCacheLimit, qsizetype convertedImageCacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_images.setMaxCost(imageCacheLimit);
+    m_convertedImages.setMaxCost(convertedImageCacheLimit);
+}
+
 }   // namespace pdf
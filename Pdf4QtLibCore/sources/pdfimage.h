@@ -23,6 +23,9 @@
 #include "pdfoperationcontrol.h"
 
 #include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
 
 class QByteArray;
 
@@ -32,6 +35,7 @@ class PDFStream;
 class PDFDocument;
 class PDFObjectStorage;
 class PDFRenderErrorReporter;
+class PDFCMS;
 
 /// Alternate image object. Defines alternate image, which
 /// can be shown in some circumstances instead of main image.
@@ -60,19 +64,33 @@ class PDF4QTLIBCORESHARED_EXPORT PDFImage
 public:
     PDFImage() = default;
 
+    /// Maximal resolution reduction level (image is decoded with size divided by 8)
+    static constexpr int MAX_RESOLUTION_REDUCTION = 3;
+
     /// Creates image from the content and the dictionary. If image can't be created, then exception is thrown.
+    /// Image can be decoded at reduced resolution - width and height are divided by 2^resolutionReduction.
+    /// JPEG images use DCT scaling, JPEG 2000 images skip resolution levels and 8-bit raw images
+    /// are box filtered. Other images are always decoded at full resolution.
     /// \param document Document
     /// \param stream Stream with image
     /// \param colorSpace Color space of the image
     /// \param isSoftMask Is it a soft mask image?
     /// \param renderingIntent Default rendering intent of the image
     /// \param errorReporter Error reporter for reporting errors (or warnings)
+    /// \param resolutionReduction Resolution reduction level (0 to MAX_RESOLUTION_REDUCTION)
     static PDFImage createImage(const PDFDocument* document,
                                 const PDFStream* stream,
                                 PDFColorSpacePointer colorSpace,
                                 bool isSoftMask,
                                 RenderingIntent renderingIntent,
-                                PDFRenderErrorReporter* errorReporter);
+                                PDFRenderErrorReporter* errorReporter,
+                                int resolutionReduction = 0);
+
+    /// Returns resolution reduction level for the image of given size,
+    /// so the decoded image is still at least as large as the target size.
+    /// \param imageSize Size of the image (in pixels)
+    /// \param targetSize Size of the image on the target device (in pixels)
+    static int getResolutionReduction(QSize imageSize, QSizeF targetSize);
 
     /// Returns image transformed from image data and color space
     QImage getImage(const PDFCMS* cms,
@@ -115,6 +133,14 @@ public:
     static bool canBeConvertedToMonochromatic(const QImage& image);
 
 private:
+    /// Reduces resolution of 8-bit image data using box filter. Image data,
+    /// which can't be filtered (indices, color key masks, other bit depths),
+    /// are returned unchanged.
+    /// \param imageData Image data
+    /// \param colorSpace Color space of the image (can be nullptr)
+    /// \param resolutionReduction Resolution reduction level
+    static PDFImageData reduceImageData(PDFImageData imageData, const PDFAbstractColorSpace* colorSpace, int resolutionReduction);
+
     PDFImageData m_imageData;
     PDFImageData m_softMask;
     PDFColorSpacePointer m_colorSpace;
@@ -132,6 +158,93 @@ private:
     PDFObject m_pointData;
 };
 
+/// Cache of decoded images, shared by all content processors working on the same
+/// document (page compiler, rasterizer pool, text layout, ink coverage etc.).
+/// Images repeated on many pages (logos, letterheads, backgrounds) are then decoded
+/// only once. Two levels are cached - decoded image samples (independent of the
+/// color management system) and images converted by the color management system.
+/// Entries are bound to the document and are removed, when the document is destroyed.
+/// Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFImageCache
+{
+public:
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+        PDFObjectReference reference;
+
+        /// Color space dictionary is part of the key only, if image
+        /// color space depends on the resources (named color space,
+        /// or default color spaces), otherwise it is nullptr.
+        const PDFDictionary* colorSpaceDictionary = nullptr;
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+        bool isSoftMask = false;
+        int resolutionReduction = 0;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, reference, colorSpaceDictionary, renderingIntent, isSoftMask, resolutionReduction) ==
+                   std::tie(other.document, other.reference, other.colorSpaceDictionary, other.renderingIntent, other.isSoftMask, other.resolutionReduction);
+        }
+    };
+
+    struct ConvertedKey
+    {
+        Key key;
+        quint64 cmsId = 0;
+
+        bool operator==(const ConvertedKey& other) const
+        {
+            return key == other.key && cmsId == other.cmsId;
+        }
+    };
+
+    static PDFImageCache* getInstance();
+
+    /// Returns decoded image from the cache. If image is not found,
+    /// then false is returned.
+    /// \param key Key
+    /// \param image Decoded image
+    bool getImage(const Key& key, PDFImage& image) const;
+
+    /// Inserts decoded image into the cache
+    /// \param key Key
+    /// \param image Decoded image
+    void setImage(const Key& key, const PDFImage& image);
+
+    /// Returns image converted by the color management system.
+    /// If image is not found, then false is returned.
+    /// \param key Key
+    /// \param cms Color management system
+    /// \param image Converted image
+    bool getConvertedImage(const Key& key, const PDFCMS* cms, QImage& image) const;
+
+    /// Inserts image converted by the color management system into the cache
+    /// \param key Key
+    /// \param cms Color management system
+    /// \param image Converted image
+    void setConvertedImage(const Key& key, const PDFCMS* cms, const QImage& image);
+
+    /// Removes all images of the document from the cache
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+    /// Sets cache limits (in bytes)
+    /// \param imageCacheLimit Limit for decoded images
+    /// \param convertedImageCacheLimit Limit for converted images
+    void setCacheLimits(qsizetype imageCacheLimit, qsizetype convertedImageCacheLimit);
+
+private:
+    explicit PDFImageCache();
+
+    static constexpr qsizetype DEFAULT_IMAGE_CACHE_LIMIT = 128 * 1024 * 1024;
+    static constexpr qsizetype DEFAULT_CONVERTED_IMAGE_CACHE_LIMIT = 128 * 1024 * 1024;
+
+    mutable QMutex m_mutex;
+    QCache<Key, PDFImage> m_images;
+    QCache<ConvertedKey, QImage> m_convertedImages;
+};
+
 }   // namespace pdf
 
 #endif // PDFIMAGE_H
@@ -190,6 +190,9 @@ public:
     /// Returns the properties of optional content
     const PDFOptionalContentProperties* getProperties() const { return m_properties; }
 
+    /// Returns states of all optional content groups
+    const std::map<PDFObjectReference, OCState>& getStates() const { return m_states; }
+
 signals:
     void optionalContentGroupStateChanged(PDFObjectReference ocg, OCState state);
 
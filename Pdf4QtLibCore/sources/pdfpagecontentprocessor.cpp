@@ -247,10 +247,12 @@ PDFPageContentProcessor::PDFPageContentProcessor(const PDFPage* page,
     m_textBeginEndState(0),
     m_compatibilityBeginEndState(0),
     m_drawingUncoloredTilingPatternState(0),
+    m_currentTextGlyph(nullptr),
     m_patternBaseMatrix(pagePointToDevicePointMatrix),
     m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix),
     m_meshQualitySettings(meshQualitySettings),
-    m_structuralParentKey(0)
+    m_structuralParentKey(0),
+    m_imageDeviceScale(0.0)
 {
     Q_ASSERT(page);
     Q_ASSERT(document);
@@ -493,6 +495,32 @@ void PDFPageContentProcessor::performProcessTextSequence(const TextSequence& tex
     Q_UNUSED(order);
 }
 
+bool PDFPageContentProcessor::performPathPaintingUsingTilingPattern(const QPainterPath& path,
+                                                                    const PDFTilingPattern* tilingPattern,
+                                                                    const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                                    const PDFColor& uncoloredPatternColor)
+{
+    Q_UNUSED(path);
+    Q_UNUSED(tilingPattern);
+    Q_UNUSED(uncoloredPatternColorSpace);
+    Q_UNUSED(uncoloredPatternColor);
+    return false;
+}
+
+bool PDFPageContentProcessor::performFormInstancePainting(PDFObjectReference formReference, const PDFStream* stream)
+{
+    Q_UNUSED(formReference);
+    Q_UNUSED(stream);
+    return false;
+}
+
+bool PDFPageContentProcessor::performType3GlyphInstancePainting(const PDFFontPointer& font, const QByteArray* glyphContentStream)
+{
+    Q_UNUSED(font);
+    Q_UNUSED(glyphContentStream);
+    return false;
+}
+
 bool PDFPageContentProcessor::isContentKindSuppressed(ContentKind kind) const
 {
     Q_UNUSED(kind);
@@ -510,6 +538,35 @@ bool PDFPageContentProcessor::isContentSuppressed() const
     return std::any_of(m_markedContentStack.cbegin(), m_markedContentStack.cend(), [](const MarkedContentState& state) { return state.contentSuppressed; });
 }
 
+PDFMeshQualitySettings PDFPageContentProcessor::getShadingPatternMeshQualitySettings() const
+{
+    PDFMeshQualitySettings settings = m_meshQualitySettings;
+    settings.deviceSpaceMeshingArea = getPageBoundingRectDeviceSpace();
+    settings.userSpaceToDeviceSpaceMatrix = getPatternBaseMatrix();
+    settings.initResolution();
+    return settings;
+}
+
+PDFMesh PDFPageContentProcessor::createShadingPatternMesh(const PDFShadingPattern* shadingPattern, const QPainterPath& path)
+{
+    const PDFMeshQualitySettings settings = getShadingPatternMeshQualitySettings();
+    PDFMesh mesh = PDFShadingMeshCache::getInstance()->getMesh(m_document, shadingPattern, settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+
+    // Now, merge the current path to the mesh clipping path
+    QPainterPath boundingPath = mesh.getBoundingPath();
+    if (boundingPath.isEmpty())
+    {
+        boundingPath = getCurrentWorldMatrix().map(path);
+    }
+    else
+    {
+        boundingPath = boundingPath.intersected(path);
+    }
+    mesh.setBoundingPath(boundingPath);
+
+    return mesh;
+}
+
 PDFPageContentProcessor::PDFTransparencyGroup PDFPageContentProcessor::parseTransparencyGroup(const PDFObject& object)
 {
     PDFTransparencyGroup group;
@@ -687,7 +744,7 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
 
                         QByteArray buffer = content.mid(startDataPosition, dataLength);
                         PDFStream imageStream(std::move(*dictionary), std::move(buffer));
-                        paintXObjectImage(&imageStream);
+                        paintXObjectImage(&imageStream, PDFObjectReference());
                     }
                     else
                     {
@@ -868,28 +925,9 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
                         }
 
                         // We must create a mesh and then draw pattern
-                        PDFMeshQualitySettings settings = m_meshQualitySettings;
-                        settings.deviceSpaceMeshingArea = getPageBoundingRectDeviceSpace();
-                        settings.userSpaceToDeviceSpaceMatrix = getPatternBaseMatrix();
-                        settings.initResolution();
-
                         if (!performPathPaintingUsingShading(path, false, true, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
-
-                            // Now, merge the current path to the mesh clipping path
-                            QPainterPath boundingPath = mesh.getBoundingPath();
-                            if (boundingPath.isEmpty())
-                            {
-                                boundingPath = getCurrentWorldMatrix().map(path);
-                            }
-                            else
-                            {
-                                boundingPath = boundingPath.intersected(path);
-                            }
-                            mesh.setBoundingPath(boundingPath);
-
-                            performMeshPainting(mesh);
+                            performMeshPainting(createShadingPatternMesh(shadingPattern, path));
                         }
                     }
                     break;
@@ -967,12 +1005,6 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
                             }
                         }
 
-                        // We must create a mesh and then draw pattern
-                        PDFMeshQualitySettings settings = m_meshQualitySettings;
-                        settings.deviceSpaceMeshingArea = getPageBoundingRectDeviceSpace();
-                        settings.userSpaceToDeviceSpaceMatrix = getPatternBaseMatrix();
-                        settings.initResolution();
-
                         // We must stroke the path.
                         QPainterPathStroker stroker;
                         stroker.setCapStyle(m_graphicState.getLineCapStyle());
@@ -988,22 +1020,10 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
                         }
                         QPainterPath strokedPath = stroker.createStroke(path);
 
+                        // We must create a mesh and then draw pattern
                         if (!performPathPaintingUsingShading(strokedPath, true, false, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
-
-                            QPainterPath boundingPath = mesh.getBoundingPath();
-                            if (boundingPath.isEmpty())
-                            {
-                                boundingPath = getCurrentWorldMatrix().map(strokedPath);
-                            }
-                            else
-                            {
-                                boundingPath = boundingPath.intersected(strokedPath);
-                            }
-                            mesh.setBoundingPath(boundingPath);
-
-                            performMeshPainting(mesh);
+                            performMeshPainting(createShadingPatternMesh(shadingPattern, strokedPath));
                         }
                     }
                     break;
@@ -1039,6 +1059,11 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
                                                             PDFColorSpacePointer uncoloredPatternColorSpace,
                                                             PDFColor uncoloredPatternColor)
 {
+    if (performPathPaintingUsingTilingPattern(path, tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor))
+    {
+        return;
+    }
+
     PDFPageContentProcessorStateGuard guard(this);
     performClipping(path, path.fillRule());
 
@@ -1057,36 +1082,7 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     QTransform pathTransformationMatrix = m_graphicState.getCurrentTransformationMatrix() * matrix.inverted();
     m_graphicState.setCurrentTransformationMatrix(matrix);
 
-    int uncoloredTilingPatternFlag = 0;
-
-    // Initialize colors for uncolored color space pattern
-    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
-    {
-        if (!uncoloredPatternColorSpace)
-        {
-            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
-        }
-
-        uncoloredTilingPatternFlag = 1;
-
-        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
-        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
-
-        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
-        m_graphicState.setFillColor(color, uncoloredPatternColor);
-    }
-    else
-    {
-        // Jakub Melka: According the specification, we set default color space and default color
-        m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
-        m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
-
-        QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-        m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-    }
-
+    const int uncoloredTilingPatternFlag = initializeTilingPatternColors(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
     updateGraphicState();
 
     // Mark uncolored flag, if we drawing uncolored color pattern
@@ -1876,6 +1872,11 @@ void PDFPageContentProcessor::setOperationControl(const PDFOperationControl* new
     m_operationControl = newOperationControl;
 }
 
+void PDFPageContentProcessor::setImageDeviceScale(PDFReal imageDeviceScale)
+{
+    m_imageDeviceScale = imageDeviceScale;
+}
+
 bool PDFPageContentProcessor::isProcessingCancelled() const
 {
     return m_operationControl && m_operationControl->isOperationCancelled();
@@ -1895,6 +1896,40 @@ void PDFPageContentProcessor::reportRenderErrorOnce(RenderErrorType type, QStrin
     }
 }
 
+int PDFPageContentProcessor::initializeTilingPatternColors(const PDFTilingPattern* tilingPattern,
+                                                          const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                          const PDFColor& uncoloredPatternColor)
+{
+    // Initialize colors for uncolored color space pattern
+    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
+    {
+        if (!uncoloredPatternColorSpace)
+        {
+            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
+        }
+
+        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
+        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
+
+        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
+        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
+        m_graphicState.setFillColor(color, uncoloredPatternColor);
+        return 1;
+    }
+    else
+    {
+        // Jakub Melka: According the specification, we set default color space and default color
+        m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
+        m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
+
+        QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
+        m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+        m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+    }
+
+    return 0;
+}
+
 void PDFPageContentProcessor::processApplyGraphicState(const PDFDictionary* graphicStateDictionary)
 {
     PDFDocumentDataLoaderDecorator loader(m_document);
@@ -2978,7 +3013,7 @@ void PDFPageContentProcessor::operatorShadingPaintShape(PDFPageContentProcessor:
     processPathPainting(boundingRectPath, false, true, false, boundingRectPath.fillRule());
 }
 
-void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
+void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream, PDFObjectReference reference)
 {
     if (isContentKindSuppressed(ContentKind::Images))
     {
@@ -2986,12 +3021,54 @@ void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
         return;
     }
 
-    PDFColorSpacePointer colorSpace;
-
     const PDFDictionary* streamDictionary = stream->getDictionary();
-    if (streamDictionary->hasKey("ColorSpace"))
+    const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
+
+    // Images referenced by indirect reference (so not inline images) are
+    // cached for the whole document, because the same image is often used on many pages.
+    // Color space of the image can depend on the resources, in that case resources
+    // are also part of the key.
+    const bool isCacheable = reference.isValid();
+    PDFImageCache* imageCache = PDFImageCache::getInstance();
+    PDFImageCache::Key cacheKey;
+    cacheKey.document = m_document;
+    cacheKey.reference = reference;
+    cacheKey.renderingIntent = m_graphicState.getRenderingIntent();
+    cacheKey.isSoftMask = false;
+
+    // If target device resolution is known, image can be decoded at reduced resolution
+    if (m_imageDeviceScale > 0.0)
+    {
+        PDFDocumentDataLoaderDecorator loader(m_document);
+        const PDFInteger width = loader.readIntegerFromDictionary(streamDictionary, "Width", 0);
+        const PDFInteger height = loader.readIntegerFromDictionary(streamDictionary, "Height", 0);
+
+        const QTransform matrix = getCurrentWorldMatrix();
+        const QPointF origin = matrix.map(QPointF(0.0, 0.0));
+        const PDFReal targetWidth = QLineF(origin, matrix.map(QPointF(1.0, 0.0))).length() * m_imageDeviceScale;
+        const PDFReal targetHeight = QLineF(origin, matrix.map(QPointF(0.0, 1.0))).length() * m_imageDeviceScale;
+
+        cacheKey.resolutionReduction = PDFImage::getResolutionReduction(QSize(int(width), int(height)), QSizeF(targetWidth, targetHeight));
+    }
+
+    if (m_colorSpaceDictionary)
     {
-        const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
+        const bool hasDefaultColorSpace = m_colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_GRAY) ||
+                                          m_colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_RGB) ||
+                                          m_colorSpaceDictionary->hasKey(COLOR_SPACE_NAME_DEFAULT_CMYK);
+        const bool isNamedColorSpace = colorSpaceObject.isName() && m_colorSpaceDictionary->hasKey(colorSpaceObject.getString());
+
+        if (hasDefaultColorSpace || isNamedColorSpace)
+        {
+            cacheKey.colorSpaceDictionary = m_colorSpaceDictionary;
+        }
+    }
+
+    PDFImage pdfImage;
+    if (!isCacheable || !imageCache->getImage(cacheKey, pdfImage))
+    {
+        PDFColorSpacePointer colorSpace;
+
         if (colorSpaceObject.isName() || colorSpaceObject.isArray())
         {
             colorSpace = PDFAbstractColorSpace::createColorSpace(m_colorSpaceDictionary, m_document, colorSpaceObject);
@@ -3000,39 +3077,62 @@ void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
         {
             throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid color space of the image."));
         }
-    }
 
-    PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, m_graphicState.getRenderingIntent(), this);
+        pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, m_graphicState.getRenderingIntent(), this, cacheKey.resolutionReduction);
+
+        if (isCacheable)
+        {
+            imageCache->setImage(cacheKey, pdfImage);
+        }
+    }
 
     if (!performOriginalImagePainting(pdfImage, stream))
     {
-        QImage image = pdfImage.getImage(m_CMS, this, m_operationControl);
-
-        if (!isProcessingCancelled())
+        QImage image;
+        if (!isCacheable || !imageCache->getConvertedImage(cacheKey, m_CMS, image))
         {
-            if (image.format() == QImage::Format_Alpha8)
+            image = pdfImage.getImage(m_CMS, this, m_operationControl);
+
+            if (isProcessingCancelled())
             {
-                QSize size = image.size();
-                QImage unmaskedImage(size, QImage::Format_ARGB32_Premultiplied);
-                unmaskedImage.fill(m_graphicState.getFillColor());
-                unmaskedImage.setAlphaChannel(image);
-                image = qMove(unmaskedImage);
+                return;
             }
 
-            if (!image.isNull())
+            // Stencil masks are colored by the current fill color, so we can
+            // convert to monochromatic image only other images.
+            if (image.format() != QImage::Format_Alpha8 && !image.isNull() && PDFImage::canBeConvertedToMonochromatic(image))
             {
-                if (PDFImage::canBeConvertedToMonochromatic(image))
-                {
-                    image.convertTo(QImage::Format_Mono);
-                }
+                image.convertTo(QImage::Format_Mono);
+            }
 
-                performImagePainting(image);
+            if (isCacheable && !image.isNull())
+            {
+                imageCache->setConvertedImage(cacheKey, m_CMS, image);
             }
-            else
+        }
+
+        if (image.format() == QImage::Format_Alpha8)
+        {
+            QSize size = image.size();
+            QImage unmaskedImage(size, QImage::Format_ARGB32_Premultiplied);
+            unmaskedImage.fill(m_graphicState.getFillColor());
+            unmaskedImage.setAlphaChannel(image);
+            image = qMove(unmaskedImage);
+
+            if (PDFImage::canBeConvertedToMonochromatic(image))
             {
-                throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Can't decode the image."));
+                image.convertTo(QImage::Format_Mono);
             }
         }
+
+        if (!image.isNull())
+        {
+            performImagePainting(image);
+        }
+        else
+        {
+            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Can't decode the image."));
+        }
     }
 }
 
@@ -3041,7 +3141,7 @@ void PDFPageContentProcessor::reportWarningAboutColorOperatorsInUTP()
     reportRenderErrorOnce(RenderErrorType::Warning, PDFTranslationContext::tr("Color operators are not allowed in uncolored tilling pattern."));
 }
 
-void PDFPageContentProcessor::processForm(const PDFStream* stream)
+void PDFPageContentProcessor::processForm(const PDFStream* stream, PDFObjectReference formReference)
 {
     if (isContentKindSuppressed(ContentKind::Forms))
     {
@@ -3049,6 +3149,12 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
         return;
     }
 
+    if (formReference.isValid() && canProcessFormAsInstance(stream) && performFormInstancePainting(formReference, stream))
+    {
+        // Form was painted as an instance
+        return;
+    }
+
     PDFDocumentDataLoaderDecorator loader(getDocument());
     const PDFDictionary* streamDictionary = stream->getDictionary();
 
@@ -3073,6 +3179,112 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
     processForm(transformationMatrix, boundingBox, resources, transparencyGroup, content, formStructuralParentKey);
 }
 
+bool PDFPageContentProcessor::canProcessFormAsInstance(const PDFStream* stream) const
+{
+    if (isContentSuppressed() || isTextProcessing() || m_drawingUncoloredTilingPatternState > 0 || !m_transparencyGroupStack.empty())
+    {
+        return false;
+    }
+
+    if (m_graphicState.getSoftMask() || m_graphicState.getBlendMode() != BlendMode::Normal)
+    {
+        return false;
+    }
+
+    // Transparency groups are composited with the backdrop, forms without
+    // resources use resources of the page (or parent form), so they can differ in each
+    // invocation of the form. Such forms are not instanced.
+    const PDFDictionary* streamDictionary = stream->getDictionary();
+    return !m_document->getObject(streamDictionary->get("Group")).isDictionary() &&
+           m_document->getObject(streamDictionary->get("Resources")).isDictionary();
+}
+
+QList<PDFRenderError> PDFPageContentProcessor::processFormInstance(const PDFStream* stream)
+{
+    const qsizetype errorCount = m_errorList.size();
+
+    {
+        PDFPageContentProcessorStateGuard guard(this);
+        m_graphicState.setCurrentTransformationMatrix(QTransform());
+        updateGraphicState();
+
+        processForm(stream);
+    }
+
+    QList<PDFRenderError> errors = m_errorList.mid(errorCount);
+    m_errorList.resize(errorCount);
+    return errors;
+}
+
+bool PDFPageContentProcessor::canProcessType3GlyphAsInstance(const PDFType3Font* font) const
+{
+    if (isContentSuppressed() || m_drawingUncoloredTilingPatternState > 0 || !m_transparencyGroupStack.empty())
+    {
+        return false;
+    }
+
+    if (m_graphicState.getSoftMask() || m_graphicState.getBlendMode() != BlendMode::Normal)
+    {
+        return false;
+    }
+
+    // Glyphs of fonts without resources use resources of the page,
+    // so they can differ on each page. Such glyphs are not instanced.
+    return font->getResources().isDictionary();
+}
+
+QList<PDFRenderError> PDFPageContentProcessor::processType3GlyphInstance(const QByteArray* glyphContentStream)
+{
+    const qsizetype errorCount = m_errorList.size();
+
+    {
+        PDFPageContentProcessorStateGuard guard(this);
+        m_graphicState.setCurrentTransformationMatrix(QTransform());
+        updateGraphicState();
+
+        m_operands.clear();
+        processContent(*glyphContentStream);
+    }
+
+    QList<PDFRenderError> errors = m_errorList.mid(errorCount);
+    m_errorList.resize(errorCount);
+    return errors;
+}
+
+QList<PDFRenderError> PDFPageContentProcessor::processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                                        const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                                        const PDFColor& uncoloredPatternColor)
+{
+    const qsizetype errorCount = m_errorList.size();
+
+    {
+        PDFPageContentProcessorStateGuard guard(this);
+
+        // Initialize resources
+        const PDFObject& resources = tilingPattern->getResources();
+        if (!resources.isNull())
+        {
+            initDictionaries(resources);
+        }
+
+        m_graphicState.setCurrentTransformationMatrix(QTransform());
+        const int uncoloredTilingPatternFlag = initializeTilingPatternColors(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
+        updateGraphicState();
+
+        PDFTemporaryValueChange guard2(&m_drawingUncoloredTilingPatternState, m_drawingUncoloredTilingPatternState + uncoloredTilingPatternFlag);
+        PDFTemporaryValueChange patternMatrixGuard(&m_patternBaseMatrix, m_pagePointToDevicePointMatrix);
+
+        QPainterPath boundingPath;
+        boundingPath.addRect(tilingPattern->getBoundingBox());
+        performClipping(boundingPath, boundingPath.fillRule());
+        processContent(tilingPattern->getContent());
+    }
+
+    QList<PDFRenderError> errors = m_errorList.mid(errorCount);
+    m_errorList.resize(errorCount);
+    return errors;
+}
+
 void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
 {
     // We want to have empty operands, when we are invoking forms
@@ -3107,7 +3319,8 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
             QByteArray subtype = loader.readNameFromDictionary(streamDictionary, "Subtype");
             if (subtype == "Image")
             {
-                paintXObjectImage(stream);
+                const PDFObject& imageObject = m_xobjectDictionary->get(name.name);
+                paintXObjectImage(stream, imageObject.isReference() ? imageObject.getReference() : PDFObjectReference());
             }
             else if (subtype == "Form")
             {
@@ -3117,7 +3330,8 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
                     throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Form of type %1 not supported.").arg(formType));
                 }
 
-                processForm(stream);
+                const PDFObject& formObject = m_xobjectDictionary->get(name.name);
+                processForm(stream, formObject.isReference() ? formObject.getReference() : PDFObjectReference());
             }
             else
             {
@@ -3226,6 +3440,10 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
         // Detect horizontal writing system
         const bool isHorizontalWritingSystem = font->isHorizontalWritingSystem();
 
+        // Glyph outlines are shared by all sizes of the font
+        const PDFReal glyphScale = font->getGlyphScale();
+        const QTransform glyphScaleMatrix(glyphScale, 0.0, 0.0, glyphScale, 0.0, 0.0);
+
         // Calculate text rendering matrix
         const PDFReal fontFactor = (fontSize < 0.0) ? -1.0 : 1.0;
         QTransform adjustMatrix(horizontalScaling * fontFactor, 0.0, 0.0, fontFactor, 0.0, textRise);
@@ -3261,17 +3479,23 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                         const QPainterPath& glyphPath = *item.glyph;
 
                         QTransform textRenderingMatrix = adjustMatrix * textMatrix;
+                        QTransform glyphRenderingMatrix = glyphScaleMatrix * textRenderingMatrix;
                         QTransform toDeviceSpaceTransform = textRenderingMatrix * m_graphicState.getCurrentTransformationMatrix();
+                        QTransform glyphToDeviceSpaceTransform = glyphScaleMatrix * toDeviceSpaceTransform;
 
                         if (!glyphPath.isEmpty())
                         {
-                            QPainterPath transformedGlyph = textRenderingMatrix.map(glyphPath);
+                            QPainterPath transformedGlyph = glyphRenderingMatrix.map(glyphPath);
+
+                            m_currentTextGlyph = &glyphPath;
+                            m_currentTextGlyphMatrix = glyphRenderingMatrix;
                             processPathPainting(transformedGlyph, stroke, fill, true, transformedGlyph.fillRule());
+                            m_currentTextGlyph = nullptr;
 
                             if (clipped)
                             {
                                 // Clipping is enabled, we must transform to the device coordinates
-                                m_textClippingPath = m_textClippingPath.united(toDeviceSpaceTransform.map(glyphPath));
+                                m_textClippingPath = m_textClippingPath.united(glyphToDeviceSpaceTransform.map(glyphPath));
                             }
                         }
 
@@ -3284,6 +3508,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                             info.advance = item.advance;
                             info.fontSize = fontSize;
                             info.outline = glyphPath;
+                            info.outlineMatrix = glyphToDeviceSpaceTransform;
                             info.matrix = toDeviceSpaceTransform;
                             performOutputCharacter(info);
                         }
@@ -3358,7 +3583,11 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                     m_graphicState.setCurrentTransformationMatrix(worldMatrix);
                     updateGraphicState();
 
-                    processContent(*item.characterContentStream);
+                    if (!canProcessType3GlyphAsInstance(parentFont) ||
+                        !performType3GlyphInstancePainting(m_graphicState.getTextFont(), item.characterContentStream))
+                    {
+                        processContent(*item.characterContentStream);
+                    }
 
                     if (!item.character.isNull())
                     {
@@ -3369,6 +3598,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                         info.advance = item.advance;
                         info.fontSize = fontSize;
                         info.matrix = worldMatrix;
+                        info.outlineMatrix = worldMatrix;
                         performOutputCharacter(info);
                     }
                 }
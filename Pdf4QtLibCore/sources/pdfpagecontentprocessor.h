@@ -162,9 +162,11 @@ public:
     void setCurrentTransformationMatrix(const QTransform& currentTransformationMatrix);
 
     const PDFAbstractColorSpace* getStrokeColorSpace() const { return m_strokeColorSpace.data(); }
+    const PDFColorSpacePointer& getStrokeColorSpacePointer() const { return m_strokeColorSpace; }
     void setStrokeColorSpace(const QSharedPointer<PDFAbstractColorSpace>& strokeColorSpace);
 
     const PDFAbstractColorSpace* getFillColorSpace() const { return m_fillColorSpace.data(); }
+    const PDFColorSpacePointer& getFillColorSpacePointer() const { return m_fillColorSpace; }
     void setFillColorSpace(const QSharedPointer<PDFAbstractColorSpace>& fillColorSpace);
 
     const QColor& getStrokeColor() const { return m_strokeColor; }
@@ -498,6 +500,16 @@ public:
     /// \param newOperationControl Operation control object
     void setOperationControl(const PDFOperationControl* newOperationControl);
 
+    /// Sets scale from device space of this processor to the target device pixels.
+    /// If scale is set (positive value), images are decoded at reduced resolution,
+    /// which is still sufficient for the target device. Zero means, that images
+    /// are always decoded at full resolution.
+    /// \param imageDeviceScale Scale from device space to device pixels
+    void setImageDeviceScale(PDFReal imageDeviceScale);
+
+    /// Returns scale from device space of this processor to the target device pixels
+    PDFReal getImageDeviceScale() const { return m_imageDeviceScale; }
+
     /// Returns true, if page content processing is being cancelled
     bool isProcessingCancelled() const;
 
@@ -599,6 +611,18 @@ protected:
     /// \param shadingPattern Shading pattern
     virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern);
 
+    /// This function is used, when we want to implement custom fill using tiling pattern. If path
+    /// is successfully filled by the tiling pattern, then true should be returned, otherwise
+    /// pattern cells are processed one by one as usual.
+    /// \param path Path to be filled (in current user space)
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    virtual bool performPathPaintingUsingTilingPattern(const QPainterPath& path,
+                                                       const PDFTilingPattern* tilingPattern,
+                                                       const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                       const PDFColor& uncoloredPatternColor);
+
     /// This function is called after path paintig is finished
     virtual void performFinishPathPainting();
 
@@ -684,6 +708,22 @@ protected:
     /// Implement to respond to text sequence processing
     virtual void performProcessTextSequence(const TextSequence& textSequence, ProcessOrder order);
 
+    /// Implement to paint form XObject as an instance of already processed form. Function
+    /// is called only for forms, which can be instanced (see \p canProcessFormAsInstance).
+    /// If form is painted by this function, true should be returned, otherwise form
+    /// is processed as usual.
+    /// \param formReference Reference to the form XObject
+    /// \param stream Stream of the form XObject
+    virtual bool performFormInstancePainting(PDFObjectReference formReference, const PDFStream* stream);
+
+    /// Implement to paint Type 3 font glyph as an instance of already processed glyph. Function
+    /// is called only for glyphs, which can be instanced (see \p canProcessType3GlyphAsInstance),
+    /// current transformation matrix maps glyph space to the user space. If glyph
+    /// is painted by this function, true should be returned, otherwise glyph is processed as usual.
+    /// \param font Type 3 font
+    /// \param glyphContentStream Content stream of the glyph (owned by the font)
+    virtual bool performType3GlyphInstancePainting(const PDFFontPointer& font, const QByteArray* glyphContentStream);
+
     enum class ContentKind
     {
         Shapes,     ///< General shapes (they can be also shaded / tiled)
@@ -727,6 +767,24 @@ protected:
     /// Returns page bounding rectangle in device space
     const QRectF& getPageBoundingRectDeviceSpace() const { return m_pageBoundingRectDeviceSpace; }
 
+    /// Returns mesh quality settings for meshing of shading patterns
+    /// in the current graphic state.
+    PDFMeshQualitySettings getShadingPatternMeshQualitySettings() const;
+
+    /// Creates mesh of the shading pattern, which is used to fill (or stroke) the path.
+    /// Bounding path of the mesh is intersected with the path.
+    /// \param shadingPattern Shading pattern
+    /// \param path Filled area (or stroked outline) in current user space
+    PDFMesh createShadingPatternMesh(const PDFShadingPattern* shadingPattern, const QPainterPath& path);
+
+    /// Returns outline of the text glyph, which is currently being painted (outline
+    /// is in the glyph space), or nullptr, if no text glyph is currently being painted.
+    /// This function is meant to be used in \p performPathPainting implementations.
+    const QPainterPath* getCurrentTextGlyph() const { return m_currentTextGlyph; }
+
+    /// Returns matrix mapping glyph space of the current text glyph to the user space
+    const QTransform& getCurrentTextGlyphMatrix() const { return m_currentTextGlyphMatrix; }
+
     /// Returns current procedure sets. Procedure sets are deprecated in PDF 2.0 and are here
     /// only for compatibility purposes. See chapter 14.2 in PDF 2.0 specification.
     ProcedureSets getProcedureSets() const { return m_procedureSets; }
@@ -760,7 +818,48 @@ protected:
     };
 
     /// Process form using form stream
-    void processForm(const PDFStream* stream);
+    /// \param stream Stream of the form XObject
+    /// \param formReference Reference to the form XObject (if valid, form can be instanced)
+    void processForm(const PDFStream* stream, PDFObjectReference formReference = PDFObjectReference());
+
+    /// Returns true, if form can be processed as an instance, i.e. form can be processed
+    /// once in its own coordinate system and then painted several times with different
+    /// transformation matrices. It is not possible, if form is a transparency group,
+    /// if it inherits resources, or if current graphic state uses soft mask,
+    /// blend mode or transparency group, which affect the form content.
+    /// \param stream Stream of the form XObject
+    bool canProcessFormAsInstance(const PDFStream* stream) const;
+
+    /// Processes form in the form instance space, i.e. current transformation matrix
+    /// is set to identity matrix before the form is processed. Errors which occured
+    /// during form processing are not added to the error list, but they are returned.
+    /// \param stream Stream of the form XObject
+    QList<PDFRenderError> processFormInstance(const PDFStream* stream);
+
+    /// Returns true, if glyph of the Type 3 font can be processed as an instance, i.e. glyph
+    /// can be processed once in the glyph space and then painted several times with different
+    /// transformation matrices. It is not possible, if font inherits resources, or if current
+    /// graphic state uses soft mask, blend mode or transparency group, which affect the glyph.
+    /// \param font Type 3 font
+    bool canProcessType3GlyphAsInstance(const PDFType3Font* font) const;
+
+    /// Processes glyph of the Type 3 font in the glyph space, i.e. current transformation
+    /// matrix is set to identity matrix before the glyph is processed. Resources of the font
+    /// must be already initialized. Errors which occured during glyph processing are not
+    /// added to the error list, but they are returned.
+    /// \param glyphContentStream Content stream of the glyph
+    QList<PDFRenderError> processType3GlyphInstance(const QByteArray* glyphContentStream);
+
+    /// Processes single cell of the tiling pattern in the pattern space, i.e. current
+    /// transformation matrix is set to identity matrix and the cell is clipped
+    /// by the pattern bounding box. Errors which occured during cell processing
+    /// are not added to the error list, but they are returned.
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    QList<PDFRenderError> processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                   const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                   const PDFColor& uncoloredPatternColor);
 
     const PDFDictionary* getColorSpaceDictionary() const { return m_colorSpaceDictionary; }
     const PDFDictionary* getFontDictionary() const { return m_fontDictionary; }
@@ -801,6 +900,15 @@ private:
                                        PDFColorSpacePointer uncoloredPatternColorSpace,
                                        PDFColor uncoloredPatternColor);
 
+    /// Sets stroke and fill colors for tiling pattern cell content. For uncolored tiling
+    /// patterns, returns 1, otherwise 0 (so it can be added to uncolored tiling pattern state).
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    int initializeTilingPatternColors(const PDFTilingPattern* tilingPattern,
+                                      const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                      const PDFColor& uncoloredPatternColor);
+
     /// Applies graphic state dictionary
     /// \param graphicStateDictionary Dictionary to be applied to the current graphic state
     void processApplyGraphicState(const PDFDictionary* graphicStateDictionary);
@@ -1038,7 +1146,9 @@ private:
     PDFObject readObjectFromOperandStack(size_t startPosition) const;
 
     /// Implementation of painting of XObject image
-    void paintXObjectImage(const PDFStream* stream);
+    /// \param stream Image stream
+    /// \param reference Reference to the image stream (invalid for inline images)
+    void paintXObjectImage(const PDFStream* stream, PDFObjectReference reference);
 
     /// Report warning about color operators in uncolored tiling pattern
     void reportWarningAboutColorOperatorsInUTP();
@@ -1106,6 +1216,12 @@ private:
     /// is in device space coordinates.
     QPainterPath m_textClippingPath;
 
+    /// Outline of the text glyph currently being painted (in glyph space)
+    const QPainterPath* m_currentTextGlyph;
+
+    /// Matrix mapping glyph space of current text glyph to the user space
+    QTransform m_currentTextGlyphMatrix;
+
     /// Base matrix to be used when drawing patterns. Concatenate this matrix
     /// with pattern matrix to get transformation from pattern space to device space.
     QTransform m_patternBaseMatrix;
@@ -1125,6 +1241,9 @@ private:
 
     /// Active structural parent key
     PDFInteger m_structuralParentKey;
+
+    /// Scale from device space to device pixels used for image decoding
+    PDFReal m_imageDeviceScale;
 };
 
 template<>
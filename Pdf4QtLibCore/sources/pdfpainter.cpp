@@ -19,16 +19,386 @@
 #include "pdfpattern.h"
 #include "pdfcms.h"
 #include "pdfpainterutils.h"
+#include "pdfoptionalcontent.h"
 
+#include <QCache>
+#include <QMutex>
 #include <QPainter>
+#include <QPaintEngine>
+#include <QDataStream>
 #include <QCryptographicHash>
 #include <QtMath>
 
+#include <atomic>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+/// Returns true, if painter paints into raster image (using raster or Blend2D
+/// paint engine). Content, which is rasterized by the renderer itself (glyph
+/// bitmaps, pattern tiles, shadings), is painted only onto raster devices,
+/// other devices (printers, pdf writers, ...) get vector output.
+/// \param painter Painter
+static bool isRasterPainter(QPainter* painter)
+{
+    const QPaintEngine* paintEngine = painter->paintEngine();
+    return paintEngine && (paintEngine->type() == QPaintEngine::Raster || PDFBLDisplayList::isBlend2DPainter(painter));
+}
+
+/// Cache of rasterized text glyphs. Small text is drawn by blitting
+/// glyph bitmaps from this cache, instead of rasterizing glyph outlines
+/// each time the page is drawn. Glyph bitmaps are keyed by glyph outline,
+/// linear part of glyph-to-device transformation, subpixel offset and color.
+/// Cache is split into shards by key hash, each shard has its own lock,
+/// so render threads drawing text do not wait for each other.
+class PDFGlyphRasterCache
+{
+public:
+    explicit PDFGlyphRasterCache();
+
+    static PDFGlyphRasterCache* getInstance();
+
+    /// Maximal size of the glyph in device pixels, which is drawn using the cache
+    static constexpr PDFReal MAX_GLYPH_SIZE = 64.0;
+
+    /// Number of subpixel positions in each direction
+    static constexpr int SUBPIXEL_POSITIONS = 4;
+
+    /// Maximal memory used by glyph bitmaps
+    static constexpr qsizetype CACHE_LIMIT = 32 * 1024 * 1024;
+
+    /// Number of independently locked parts of the cache
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Key
+    {
+        size_t glyphHash = 0;
+        std::array<qint32, 4> matrix = { };
+        int subpixelX = 0;
+        int subpixelY = 0;
+        QRgb color = 0;
+        bool antialiasing = false;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(glyphHash, matrix, subpixelX, subpixelY, color, antialiasing) ==
+                   std::tie(other.glyphHash, other.matrix, other.subpixelX, other.subpixelY, other.color, other.antialiasing);
+        }
+    };
+
+    struct Entry
+    {
+        QImage image;           ///< Rasterized glyph
+        QPoint offset;          ///< Offset of the image relative to glyph origin pixel
+        QPainterPath glyphPath; ///< Glyph outline, from which the image was rasterized
+    };
+
+    /// Returns rasterized glyph. If glyph is not in the cache, it is
+    /// rasterized using the function \p rasterize and inserted into the cache.
+    /// Key contains only hash of the glyph outline, so cached entry is used
+    /// only, if its outline is equal to \p glyphPath. Otherwise glyph is
+    /// rasterized and returned without caching.
+    /// \param key Key
+    /// \param glyphPath Glyph outline
+    /// \param rasterize Rasterization function
+    Entry getGlyph(const Key& key, const QPainterPath& glyphPath, const std::function<Entry(void)>& rasterize);
+
+private:
+    struct Shard
+    {
+        QMutex mutex;
+        QCache<Key, Entry> cache;
+    };
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+};
+
+inline size_t qHash(const PDFGlyphRasterCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.glyphHash, key.matrix[0], key.matrix[1], key.matrix[2], key.matrix[3], key.subpixelX, key.subpixelY, key.color, key.antialiasing);
+}
+
+PDFGlyphRasterCache::PDFGlyphRasterCache()
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.cache.setMaxCost(CACHE_LIMIT / SHARD_COUNT);
+    }
+}
+
+PDFGlyphRasterCache* PDFGlyphRasterCache::getInstance()
+{
+    static PDFGlyphRasterCache instance;
+    return &instance;
+}
+
+PDFGlyphRasterCache::Entry PDFGlyphRasterCache::getGlyph(const Key& key, const QPainterPath& glyphPath, const std::function<Entry(void)>& rasterize)
+{
+    Shard& shard = m_shards[qHash(key) % SHARD_COUNT];
+    bool isHashCollision = false;
+
+    {
+        QMutexLocker lock(&shard.mutex);
+        if (const Entry* entry = shard.cache.object(key))
+        {
+            if (entry->glyphPath == glyphPath)
+            {
+                return *entry;
+            }
+
+            isHashCollision = true;
+        }
+    }
+
+    Entry entry = rasterize();
+    entry.glyphPath = glyphPath;
+
+    if (!isHashCollision)
+    {
+        QMutexLocker lock(&shard.mutex);
+        shard.cache.insert(key, new Entry(entry), qMax<qsizetype>(entry.image.sizeInBytes(), 1));
+    }
+
+    return entry;
+}
+
+/// Cache of rasterized tiling pattern cells. Tiling pattern fill is drawn using
+/// image brush with the tile from this cache, instead of drawing each pattern
+/// cell as vector graphics. Tiles are keyed by cell content identifier, tile
+/// size in device pixels and renderer features affecting the rasterization.
+class PDFTilingPatternRasterCache
+{
+public:
+    explicit PDFTilingPatternRasterCache();
+
+    static PDFTilingPatternRasterCache* getInstance();
+
+    /// Maximal width/height of the tile in device pixels
+    static constexpr int MAX_TILE_SIZE = 1024;
+
+    /// Maximal number of pattern cells overlapping the tile
+    static constexpr PDFReal MAX_TILE_CELLS = 16.0;
+
+    /// Maximal memory used by tiles
+    static constexpr qsizetype CACHE_LIMIT = 32 * 1024 * 1024;
+
+    struct Key
+    {
+        quint64 cellId = 0;
+        int width = 0;
+        int height = 0;
+        bool antialiasing = false;
+        bool textAntialiasing = false;
+        bool smoothImages = false;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(cellId, width, height, antialiasing, textAntialiasing, smoothImages) ==
+                   std::tie(other.cellId, other.width, other.height, other.antialiasing, other.textAntialiasing, other.smoothImages);
+        }
+    };
+
+    /// Returns rasterized tile. If tile is not in the cache, it is
+    /// rasterized using the function \p rasterize and inserted into the cache.
+    /// \param key Key
+    /// \param rasterize Rasterization function
+    QImage getTile(const Key& key, const std::function<QImage(void)>& rasterize);
+
+private:
+    QMutex m_mutex;
+    QCache<Key, QImage> m_cache;
+};
+
+inline size_t qHash(const PDFTilingPatternRasterCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.cellId, key.width, key.height, key.antialiasing, key.textAntialiasing, key.smoothImages);
+}
+
+PDFTilingPatternRasterCache::PDFTilingPatternRasterCache() :
+    m_cache(CACHE_LIMIT)
+{
+
+}
+
+PDFTilingPatternRasterCache* PDFTilingPatternRasterCache::getInstance()
+{
+    static PDFTilingPatternRasterCache instance;
+    return &instance;
+}
+
+QImage PDFTilingPatternRasterCache::getTile(const Key& key, const std::function<QImage(void)>& rasterize)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (const QImage* tile = m_cache.object(key))
+        {
+            return *tile;
+        }
+    }
+
+    QImage tile = rasterize();
+
+    QMutexLocker lock(&m_mutex);
+    m_cache.insert(key, new QImage(tile), qMax<qsizetype>(tile.sizeInBytes(), 1));
+    return tile;
+}
+
+PDFFormInstanceCache::PDFFormInstanceCache() :
+    m_cache(CACHE_LIMIT)
+{
+
+}
+
+PDFFormInstanceCache* PDFFormInstanceCache::getInstance()
+{
+    static PDFFormInstanceCache instance;
+    return &instance;
+}
+
+PDFFormInstanceCache::FormInstances PDFFormInstanceCache::getFormInstances(const Key& key)
+{
+    QMutexLocker lock(&m_mutex);
+    if (const FormInstances* formInstances = m_cache.object(key))
+    {
+        return *formInstances;
+    }
+
+    return FormInstances();
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFFormInstanceCache::addFormInstance(const Key& key,
+                                                                                FormInstance formInstance,
+                                                                                const IsCompatibleFunction& isCompatible)
+{
+    QMutexLocker lock(&m_mutex);
+
+    FormInstances formInstances;
+    if (const FormInstances* cachedFormInstances = m_cache.object(key))
+    {
+        formInstances = *cachedFormInstances;
+    }
+
+    // Another thread may have processed the form in compatible graphic state
+    auto it = std::find_if(formInstances.cbegin(), formInstances.cend(), isCompatible);
+    if (it != formInstances.cend())
+    {
+        return it->precompiledForm;
+    }
+
+    std::shared_ptr<const PDFPrecompiledPage> precompiledForm = formInstance.precompiledForm;
+    if (formInstances.size() >= MAX_FORM_INSTANCES)
+    {
+        return precompiledForm;
+    }
+
+    formInstances.emplace_back(qMove(formInstance));
+
+    qsizetype cost = 0;
+    for (const FormInstance& item : formInstances)
+    {
+        cost += sizeof(FormInstance);
+        if (item.precompiledForm)
+        {
+            cost += item.precompiledForm->getMemoryConsumptionEstimate();
+        }
+    }
+
+    m_cache.insert(key, new FormInstances(qMove(formInstances)), cost);
+    return precompiledForm;
+}
+
+void PDFFormInstanceCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_cache.keys())
+    {
+        if (key.document == document)
+        {
+            m_cache.remove(key);
+        }
+    }
+}
+
+PDFType3GlyphInstanceCache::PDFType3GlyphInstanceCache() :
+    m_cache(CACHE_LIMIT)
+{
+
+}
+
+PDFType3GlyphInstanceCache* PDFType3GlyphInstanceCache::getInstance()
+{
+    static PDFType3GlyphInstanceCache instance;
+    return &instance;
+}
+
+PDFType3GlyphInstanceCache::GlyphInstances PDFType3GlyphInstanceCache::getGlyphInstances(const Key& key)
+{
+    QMutexLocker lock(&m_mutex);
+    if (const GlyphInstances* glyphInstances = m_cache.object(key))
+    {
+        return *glyphInstances;
+    }
+
+    return GlyphInstances();
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFType3GlyphInstanceCache::addGlyphInstance(const Key& key,
+                                                                                       GlyphInstance glyphInstance,
+                                                                                       const IsCompatibleFunction& isCompatible)
+{
+    QMutexLocker lock(&m_mutex);
+
+    GlyphInstances glyphInstances;
+    if (const GlyphInstances* cachedGlyphInstances = m_cache.object(key))
+    {
+        glyphInstances = *cachedGlyphInstances;
+    }
+
+    // Another thread may have processed the glyph in compatible graphic state
+    auto it = std::find_if(glyphInstances.cbegin(), glyphInstances.cend(), isCompatible);
+    if (it != glyphInstances.cend())
+    {
+        return it->precompiledGlyph;
+    }
+
+    std::shared_ptr<const PDFPrecompiledPage> precompiledGlyph = glyphInstance.precompiledGlyph;
+    if (glyphInstances.size() >= MAX_GLYPH_INSTANCES)
+    {
+        return precompiledGlyph;
+    }
+
+    glyphInstances.emplace_back(qMove(glyphInstance));
+
+    qsizetype cost = 0;
+    for (const GlyphInstance& item : glyphInstances)
+    {
+        cost += sizeof(GlyphInstance);
+        if (item.precompiledGlyph)
+        {
+            cost += item.precompiledGlyph->getMemoryConsumptionEstimate();
+        }
+    }
+
+    m_cache.insert(key, new GlyphInstances(qMove(glyphInstances)), cost);
+    return precompiledGlyph;
+}
+
+void PDFType3GlyphInstanceCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_cache.keys())
+    {
+        if (key.document == document)
+        {
+            m_cache.remove(key);
+        }
+    }
+}
+
 PDFPainterBase::PDFPainterBase(PDFRenderer::Features features,
                                const PDFPage* page,
                                const PDFDocument* document,
@@ -330,6 +700,32 @@ void PDFPainter::performMeshPainting(const PDFMesh& mesh)
     m_painter->restore();
 }
 
+bool PDFPainter::performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern)
+{
+    Q_UNUSED(stroke);
+    Q_UNUSED(fill);
+
+    if (!isRasterPainter(m_painter))
+    {
+        // Shading will be painted using the mesh
+        return false;
+    }
+
+    PDFShadingRasterizer rasterizer = PDFShadingRasterizer::create(shadingPattern, getPatternBaseMatrix(), m_CMS, getGraphicState()->getRenderingIntent(), this);
+    if (!rasterizer.isValid())
+    {
+        // Shading will be painted using the mesh
+        return false;
+    }
+
+    if (!isContentSuppressed())
+    {
+        rasterizer.draw(m_painter, QTransform(), getCurrentWorldMatrix().map(path), getEffectiveFillingAlpha());
+    }
+
+    return true;
+}
+
 void PDFPainter::performSaveGraphicState(ProcessOrder order)
 {
     if (order == ProcessOrder::AfterOperation)
@@ -369,6 +765,17 @@ PDFPrecompiledPageGenerator::PDFPrecompiledPageGenerator(PDFPrecompiledPage* pre
 {
     m_precompiledPage->setPaperColor(cms->getPaperColor());
     m_precompiledPage->getSnapInfo()->addPageMediaBox(page->getRotatedMediaBox());
+
+    // Forms are shared between pages, so they must have been
+    // processed using the same state of the optional content.
+    if (optionalContentActivity)
+    {
+        QDataStream stream(&m_optionalContentState, QIODevice::WriteOnly);
+        for (const auto& [ocg, state] : optionalContentActivity->getStates())
+        {
+            stream << ocg.objectNumber << ocg.generation << int(state);
+        }
+    }
 }
 
 void PDFPrecompiledPageGenerator::performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
@@ -378,6 +785,16 @@ void PDFPrecompiledPageGenerator::performPathPainting(const QPainterPath& path,
 
     QPen pen = stroke ? getCurrentPen() : QPen(Qt::NoPen);
     QBrush brush = fill ? getCurrentBrush() : QBrush(Qt::NoBrush);
+
+    // Filled text glyphs can be drawn from glyph raster cache, so we store
+    // also glyph outline in glyph space.
+    const QPainterPath* glyph = text ? getCurrentTextGlyph() : nullptr;
+    if (glyph && !stroke && brush.style() == Qt::SolidPattern)
+    {
+        m_precompiledPage->addGlyphPath(qMove(pen), qMove(brush), path, *glyph, getCurrentTextGlyphMatrix());
+        return;
+    }
+
     m_precompiledPage->addPath(qMove(pen), qMove(brush), path, text);
 }
 
@@ -435,6 +852,39 @@ void PDFPrecompiledPageGenerator::performMeshPainting(const PDFMesh& mesh)
     m_precompiledPage->addMesh(mesh, getEffectiveFillingAlpha());
 }
 
+bool PDFPrecompiledPageGenerator::performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern)
+{
+    Q_UNUSED(fill);
+
+    // Axial and radial shadings are not meshed, they are rasterized
+    // when page is drawn, in the target resolution.
+    PDFShadingRasterizer rasterizer = PDFShadingRasterizer::create(shadingPattern, getPatternBaseMatrix(), m_CMS, getGraphicState()->getRenderingIntent(), this);
+    if (!rasterizer.isValid())
+    {
+        // Shading will be painted using the mesh
+        return false;
+    }
+
+    if (!isContentSuppressed())
+    {
+        // Page can be drawn also onto non-raster devices, for which the shading
+        // is meshed when the page is drawn. Pattern is owned by the color space.
+        const PDFPageContentProcessorState* graphicState = getGraphicState();
+
+        PDFPrecompiledPage::ShadingMeshData meshData;
+        meshData.patternColorSpace = stroke ? graphicState->getStrokeColorSpacePointer() : graphicState->getFillColorSpacePointer();
+        meshData.settings = getShadingPatternMeshQualitySettings();
+        meshData.document = getDocument();
+        meshData.cms = m_CMS;
+        meshData.renderingIntent = graphicState->getRenderingIntent();
+        Q_ASSERT(meshData.patternColorSpace && meshData.patternColorSpace->asPatternColorSpace());
+
+        m_precompiledPage->addShading(qMove(rasterizer), qMove(meshData), getCurrentWorldMatrix().map(path), getEffectiveFillingAlpha());
+    }
+
+    return true;
+}
+
 void PDFPrecompiledPageGenerator::performSaveGraphicState(PDFPageContentProcessor::ProcessOrder order)
 {
     if (order == ProcessOrder::AfterOperation)
@@ -461,68 +911,479 @@ void PDFPrecompiledPageGenerator::setCompositionMode(QPainter::CompositionMode m
     m_precompiledPage->addSetCompositionMode(mode);
 }
 
-void PDFPrecompiledPage::draw(QPainter* painter,
-                              const QRectF& cropBox,
-                              const QTransform& pagePointToDevicePointMatrix,
-                              PDFRenderer::Features features,
-                              PDFReal opacity) const
+bool PDFPrecompiledPageGenerator::performPathPaintingUsingTilingPattern(const QPainterPath& path,
+                                                                        const PDFTilingPattern* tilingPattern,
+                                                                        const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                                        const PDFColor& uncoloredPatternColor)
 {
-    Q_ASSERT(painter);
-    Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
-
-    painter->save();
-    painter->setWorldTransform(QTransform());
-    painter->setOpacity(opacity);
+    // Tiling patterns (hatches, bricks, dots, ...) often consist of thousands
+    // of cells. We process the pattern cell only once, in the pattern space, and cells
+    // are then drawn from the image tile (or replayed as vector graphics, when printing).
+    const PDFPageContentProcessorState* graphicState = getGraphicState();
+    if (graphicState->getSoftMask() || graphicState->getBlendMode() != BlendMode::Normal)
+    {
+        // Cells must be composited with the backdrop, not with each other
+        return false;
+    }
 
-    if (features.testFlag(PDFRenderer::ClipToCropBox))
+    const QTransform patternMatrix = tilingPattern->getMatrix() * getPatternBaseMatrix();
+    const QTransform pathMatrix = getCurrentWorldMatrix();
+    if (!patternMatrix.isInvertible())
     {
-        if (cropBox.isValid())
-        {
-            QPainterPath path;
-            path.addPolygon(pagePointToDevicePointMatrix.map(cropBox));
-            painter->setClipPath(path, Qt::IntersectClip);
-        }
+        return false;
     }
 
-    painter->setRenderHint(QPainter::SmoothPixmapTransform, features.testFlag(PDFRenderer::SmoothImages));
+    const PDFReal imageDeviceScale = getContentImageDeviceScale(patternMatrix);
 
-    // Process all instructions
-    for (const Instruction& instruction : m_instructions)
+    std::vector<TilingPatternCell> temporaryCells;
+    const PDFObjectReference patternReference = tilingPattern->getPatternReference();
+    std::vector<TilingPatternCell>& cells = patternReference.isValid() ? m_tilingPatternCells[patternReference] : temporaryCells;
+    auto it = std::find_if(cells.cbegin(), cells.cend(), [&](const TilingPatternCell& cell) { return isTilingPatternCellCompatible(cell, uncoloredPatternColorSpace, uncoloredPatternColor, imageDeviceScale); });
+
+    if (it == cells.cend())
     {
-        switch (instruction.type)
+        if (cells.size() >= MAX_TILING_PATTERN_CELLS)
         {
-            case InstructionType::DrawPath:
-            {
-                const PathPaintData& data = m_paths[instruction.dataIndex];
-
-                // Set antialiasing
-                const bool antialiasing = (data.isText && features.testFlag(PDFRenderer::TextAntialiasing)) || (!data.isText && features.testFlag(PDFRenderer::Antialiasing));
-                painter->setRenderHint(QPainter::Antialiasing, antialiasing);
-                painter->setPen(data.pen);
-                painter->setBrush(data.brush);
-                painter->drawPath(data.path);
-                break;
-            }
+            // Pattern is painted in too many different graphic states
+            return false;
+        }
 
-            case InstructionType::DrawImage:
-            {
-                const ImageData& data = m_images[instruction.dataIndex];
-                const QImage& image = data.image;
+        TilingPatternCell cell;
+        cell.graphicState = *graphicState;
+        cell.uncoloredPatternColorSpace = uncoloredPatternColorSpace;
+        cell.uncoloredPatternColor = uncoloredPatternColor;
+        cell.imageDeviceScale = imageDeviceScale;
+        cell.precompiledCell = std::make_shared<PDFPrecompiledPage>();
 
-                painter->save();
+        QList<PDFRenderError> errors;
+        {
+            const PDFReal pageImageDeviceScale = getImageDeviceScale();
+            PDFTemporaryValueChange precompiledPageGuard(&m_precompiledPage, cell.precompiledCell.get());
+            setImageDeviceScale(imageDeviceScale);
+            errors = processTilingPatternCell(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
+            setImageDeviceScale(pageImageDeviceScale);
+        }
 
-                QTransform imageTransform(1.0 / image.width(), 0, 0, 1.0 / image.height(), 0, 0);
-                QTransform worldTransform = imageTransform * painter->worldTransform();
+        cell.hasImages = !cell.precompiledCell->getSnapInfo()->getSnapImages().empty();
 
-                // Jakub Melka: Because Qt uses opposite axis direction than PDF, then we must transform the y-axis
-                // to the opposite (so the image is then unchanged)
-                worldTransform.translate(0, image.height());
-                worldTransform.scale(1, -1);
+        if (cell.precompiledCell->isInstanceable())
+        {
+            cell.precompiledCell->optimize();
+            cell.precompiledCell->finalize(0, QList<PDFRenderError>());
 
-                painter->setWorldTransform(worldTransform);
-                painter->drawImage(0, 0, image);
-                painter->restore();
-                break;
+            for (PDFRenderError& error : errors)
+            {
+                reportRenderError(error.type, qMove(error.message));
+            }
+        }
+        else
+        {
+            // Pattern will be processed as usual, errors are reported again
+            cell.precompiledCell.reset();
+        }
+
+        cells.emplace_back(qMove(cell));
+        it = std::prev(cells.cend());
+    }
+
+    if (!it->precompiledCell)
+    {
+        return false;
+    }
+
+    // Tiling area is the same, as if cells were processed one
+    // by one in the content processor, so both outputs are identical.
+    const QPainterPath pagePath = pathMatrix.map(path);
+    const QRectF tilingArea = patternMatrix.inverted().map(pagePath).boundingRect();
+
+    m_precompiledPage->addTilingPattern(it->precompiledCell,
+                                        patternMatrix,
+                                        tilingPattern->getBoundingBox(),
+                                        tilingArea,
+                                        qAbs(tilingPattern->getXStep()),
+                                        qAbs(tilingPattern->getYStep()),
+                                        pagePath);
+    return true;
+}
+
+bool PDFPrecompiledPageGenerator::performFormInstancePainting(PDFObjectReference formReference, const PDFStream* stream)
+{
+    // Forms (for example, title blocks, stamps or symbols in CAD drawings)
+    // are often painted many times on the page and on many pages. We process
+    // the form only once, in its own coordinate system, and then we paint it
+    // as an instance.
+    const QTransform instanceMatrix = getCurrentWorldMatrix();
+    if (!instanceMatrix.isInvertible())
+    {
+        return false;
+    }
+
+    const PDFPageContentProcessorState* graphicState = getGraphicState();
+    if (graphicState->getStrokeColorSpace()->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Pattern ||
+        graphicState->getFillColorSpace()->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Pattern)
+    {
+        // Uncolored patterns use color, which is not stored in the graphic state
+        return false;
+    }
+
+    PDFFormInstanceCache* cache = PDFFormInstanceCache::getInstance();
+    PDFFormInstanceCache::Key key;
+    key.document = getDocument();
+    key.formReference = formReference;
+    key.cmsId = getCMS()->getId();
+    key.features = getFeatures();
+    key.optionalContentState = m_optionalContentState;
+
+    const PDFReal imageDeviceScale = getContentImageDeviceScale(instanceMatrix);
+    PDFFormInstanceCache::FormInstances formInstances = cache->getFormInstances(key);
+    auto isCompatible = [&](const PDFFormInstanceCache::FormInstance& formInstance)
+    {
+        return isFormInstanceCompatible(formInstance.graphicState, formInstance.hasImages, formInstance.imageDeviceScale, imageDeviceScale);
+    };
+    auto it = std::find_if(formInstances.cbegin(), formInstances.cend(), isCompatible);
+
+    std::shared_ptr<const PDFPrecompiledPage> precompiledForm;
+    if (it != formInstances.cend())
+    {
+        precompiledForm = it->precompiledForm;
+    }
+    else
+    {
+        if (formInstances.size() >= PDFFormInstanceCache::MAX_FORM_INSTANCES)
+        {
+            // Form is painted in too many different graphic states
+            return false;
+        }
+
+        std::shared_ptr<PDFPrecompiledPage> processedForm = std::make_shared<PDFPrecompiledPage>();
+
+        QList<PDFRenderError> errors;
+        {
+            const PDFReal pageImageDeviceScale = getImageDeviceScale();
+            PDFTemporaryValueChange precompiledPageGuard(&m_precompiledPage, processedForm.get());
+            setImageDeviceScale(imageDeviceScale);
+            errors = processFormInstance(stream);
+            setImageDeviceScale(pageImageDeviceScale);
+        }
+
+        PDFFormInstanceCache::FormInstance formInstance;
+        formInstance.graphicState = *graphicState;
+        formInstance.imageDeviceScale = imageDeviceScale;
+        formInstance.hasImages = !processedForm->getSnapInfo()->getSnapImages().empty();
+
+        if (processedForm->isInstanceable())
+        {
+            processedForm->optimize();
+            processedForm->finalize(0, QList<PDFRenderError>());
+            formInstance.precompiledForm = processedForm;
+
+            for (PDFRenderError& error : errors)
+            {
+                reportRenderError(error.type, qMove(error.message));
+            }
+        }
+
+        precompiledForm = cache->addFormInstance(key, qMove(formInstance), isCompatible);
+    }
+
+    if (!precompiledForm)
+    {
+        // Form will be processed as usual, errors are reported again
+        return false;
+    }
+
+    m_precompiledPage->getSnapInfo()->merge(*precompiledForm->getSnapInfo(), instanceMatrix);
+    m_precompiledPage->addInstance(precompiledForm, instanceMatrix);
+    return true;
+}
+
+bool PDFPrecompiledPageGenerator::performType3GlyphInstancePainting(const PDFFontPointer& font, const QByteArray* glyphContentStream)
+{
+    const QTransform instanceMatrix = getCurrentWorldMatrix();
+    if (!instanceMatrix.isInvertible())
+    {
+        return false;
+    }
+
+    const PDFPageContentProcessorState* graphicState = getGraphicState();
+    if (graphicState->getStrokeColorSpace()->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Pattern ||
+        graphicState->getFillColorSpace()->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Pattern)
+    {
+        // Uncolored patterns use color, which is not stored in the graphic state
+        return false;
+    }
+
+    PDFType3GlyphInstanceCache* cache = PDFType3GlyphInstanceCache::getInstance();
+    PDFType3GlyphInstanceCache::Key key;
+    key.document = getDocument();
+    key.font = font;
+    key.glyphContentStream = glyphContentStream;
+    key.cmsId = getCMS()->getId();
+    key.features = getFeatures();
+
+    const PDFReal imageDeviceScale = getContentImageDeviceScale(instanceMatrix);
+    PDFType3GlyphInstanceCache::GlyphInstances glyphInstances = cache->getGlyphInstances(key);
+    auto isCompatible = [&](const PDFType3GlyphInstanceCache::GlyphInstance& glyphInstance)
+    {
+        return isType3GlyphInstanceCompatible(glyphInstance.graphicState, glyphInstance.hasImages, glyphInstance.imageDeviceScale, imageDeviceScale);
+    };
+    auto it = std::find_if(glyphInstances.cbegin(), glyphInstances.cend(), isCompatible);
+
+    std::shared_ptr<const PDFPrecompiledPage> precompiledGlyph;
+    if (it != glyphInstances.cend())
+    {
+        precompiledGlyph = it->precompiledGlyph;
+    }
+    else
+    {
+        if (glyphInstances.size() >= PDFType3GlyphInstanceCache::MAX_GLYPH_INSTANCES)
+        {
+            // Glyph is painted in too many different graphic states
+            return false;
+        }
+
+        std::shared_ptr<PDFPrecompiledPage> processedGlyph = std::make_shared<PDFPrecompiledPage>();
+
+        QList<PDFRenderError> errors;
+        {
+            const PDFReal pageImageDeviceScale = getImageDeviceScale();
+            PDFTemporaryValueChange precompiledPageGuard(&m_precompiledPage, processedGlyph.get());
+            setImageDeviceScale(imageDeviceScale);
+            errors = processType3GlyphInstance(glyphContentStream);
+            setImageDeviceScale(pageImageDeviceScale);
+        }
+
+        PDFType3GlyphInstanceCache::GlyphInstance glyphInstance;
+        glyphInstance.graphicState = *graphicState;
+        glyphInstance.imageDeviceScale = imageDeviceScale;
+        glyphInstance.hasImages = !processedGlyph->getSnapInfo()->getSnapImages().empty();
+
+        if (processedGlyph->isInstanceable())
+        {
+            processedGlyph->optimize();
+            processedGlyph->finalize(0, QList<PDFRenderError>());
+            glyphInstance.precompiledGlyph = processedGlyph;
+
+            for (PDFRenderError& error : errors)
+            {
+                reportRenderError(error.type, qMove(error.message));
+            }
+        }
+
+        precompiledGlyph = cache->addGlyphInstance(key, qMove(glyphInstance), isCompatible);
+    }
+
+    if (!precompiledGlyph)
+    {
+        // Glyph will be processed as usual, errors are reported again
+        return false;
+    }
+
+    m_precompiledPage->getSnapInfo()->merge(*precompiledGlyph->getSnapInfo(), instanceMatrix);
+    m_precompiledPage->addInstance(precompiledGlyph, instanceMatrix);
+    return true;
+}
+
+bool PDFPrecompiledPageGenerator::isFormInstanceCompatible(const PDFPageContentProcessorState& formState,
+                                                           bool hasImages,
+                                                           PDFReal formImageDeviceScale,
+                                                           PDFReal imageDeviceScale) const
+{
+    if (hasImages && formImageDeviceScale < imageDeviceScale)
+    {
+        // Images in the form would have insufficient resolution
+        return false;
+    }
+
+    const PDFPageContentProcessorState& state = *getGraphicState();
+
+    // Form instances are shared between pages, so color spaces are compared by value
+    return formState.getStrokeColorSpace()->equals(state.getStrokeColorSpace()) &&
+           formState.getFillColorSpace()->equals(state.getFillColorSpace()) &&
+           formState.getStrokeColor() == state.getStrokeColor() &&
+           formState.getFillColor() == state.getFillColor() &&
+           isInheritedGraphicStateEqual(formState, state);
+}
+
+bool PDFPrecompiledPageGenerator::isTilingPatternCellCompatible(const TilingPatternCell& cell,
+                                                                const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                                const PDFColor& uncoloredPatternColor,
+                                                                PDFReal imageDeviceScale) const
+{
+    if (cell.hasImages && cell.imageDeviceScale < imageDeviceScale)
+    {
+        // Images in the cell would have insufficient resolution
+        return false;
+    }
+
+    return cell.uncoloredPatternColorSpace == uncoloredPatternColorSpace &&
+           cell.uncoloredPatternColor == uncoloredPatternColor &&
+           isInheritedGraphicStateEqual(cell.graphicState, *getGraphicState());
+}
+
+bool PDFPrecompiledPageGenerator::isType3GlyphInstanceCompatible(const PDFPageContentProcessorState& glyphState,
+                                                                 bool hasImages,
+                                                                 PDFReal glyphImageDeviceScale,
+                                                                 PDFReal imageDeviceScale) const
+{
+    if (hasImages && glyphImageDeviceScale < imageDeviceScale)
+    {
+        // Images in the glyph would have insufficient resolution
+        return false;
+    }
+
+    const PDFPageContentProcessorState& state = *getGraphicState();
+
+    return glyphState.getStrokeColorSpace()->equals(state.getStrokeColorSpace()) &&
+           glyphState.getFillColorSpace()->equals(state.getFillColorSpace()) &&
+           glyphState.getStrokeColor() == state.getStrokeColor() &&
+           glyphState.getFillColor() == state.getFillColor() &&
+           isInheritedPaintingStateEqual(glyphState, state);
+}
+
+bool PDFPrecompiledPageGenerator::isInheritedGraphicStateEqual(const PDFPageContentProcessorState& state1, const PDFPageContentProcessorState& state2)
+{
+    return isInheritedPaintingStateEqual(state1, state2) &&
+           state1.getTextCharacterSpacing() == state2.getTextCharacterSpacing() &&
+           state1.getTextWordSpacing() == state2.getTextWordSpacing() &&
+           state1.getTextHorizontalScaling() == state2.getTextHorizontalScaling() &&
+           state1.getTextLeading() == state2.getTextLeading() &&
+           state1.getTextFont() == state2.getTextFont() &&
+           state1.getTextFontSize() == state2.getTextFontSize() &&
+           state1.getTextRenderingMode() == state2.getTextRenderingMode() &&
+           state1.getTextRise() == state2.getTextRise();
+}
+
+bool PDFPrecompiledPageGenerator::isInheritedPaintingStateEqual(const PDFPageContentProcessorState& state1, const PDFPageContentProcessorState& state2)
+{
+    return state1.getAlphaStroking() == state2.getAlphaStroking() &&
+           state1.getAlphaFilling() == state2.getAlphaFilling() &&
+           state1.getLineWidth() == state2.getLineWidth() &&
+           state1.getLineCapStyle() == state2.getLineCapStyle() &&
+           state1.getLineJoinStyle() == state2.getLineJoinStyle() &&
+           state1.getMitterLimit() == state2.getMitterLimit() &&
+           state1.getLineDashPattern() == state2.getLineDashPattern() &&
+           state1.getRenderingIntent() == state2.getRenderingIntent();
+}
+
+PDFReal PDFPrecompiledPageGenerator::getContentImageDeviceScale(const QTransform& matrix) const
+{
+    // If images are decoded at reduced resolution, then we must take
+    // into account the scale of the matrix (we use the largest
+    // singular value of the matrix).
+    PDFReal imageDeviceScale = getImageDeviceScale();
+    if (imageDeviceScale > 0.0)
+    {
+        const PDFReal squaredNorm = matrix.m11() * matrix.m11() + matrix.m12() * matrix.m12() +
+                                    matrix.m21() * matrix.m21() + matrix.m22() * matrix.m22();
+        const PDFReal determinant = matrix.m11() * matrix.m22() - matrix.m12() * matrix.m21();
+        const PDFReal discriminant = qMax(squaredNorm * squaredNorm - 4.0 * determinant * determinant, 0.0);
+        imageDeviceScale *= qSqrt(0.5 * (squaredNorm + qSqrt(discriminant)));
+    }
+
+    return imageDeviceScale;
+}
+
+void PDFPrecompiledPage::draw(QPainter* painter,
+                              const QRectF& cropBox,
+                              const QTransform& pagePointToDevicePointMatrix,
+                              PDFRenderer::Features features,
+                              PDFReal opacity) const
+{
+    Q_ASSERT(painter);
+    Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+    painter->setOpacity(opacity);
+
+    if (features.testFlag(PDFRenderer::ClipToCropBox))
+    {
+        if (cropBox.isValid())
+        {
+            QPainterPath path;
+            path.addPolygon(pagePointToDevicePointMatrix.map(cropBox));
+            painter->setClipPath(path, Qt::IntersectClip);
+        }
+    }
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, features.testFlag(PDFRenderer::SmoothImages));
+
+    drawInstructions(painter, pagePointToDevicePointMatrix, features);
+
+    painter->restore();
+}
+
+void PDFPrecompiledPage::drawInstructions(QPainter* painter,
+                                          const QTransform& pagePointToDevicePointMatrix,
+                                          PDFRenderer::Features features) const
+{
+    // When drawing using Blend2D paint engine, we use native display list,
+    // which contains already converted paths and images, to avoid conversion costs.
+    std::shared_ptr<const PDFBLDisplayList> blDisplayList;
+    if (PDFBLDisplayList::isBlend2DPainter(painter))
+    {
+        blDisplayList = getBLDisplayList();
+    }
+
+    // Path used for decoding of the path elements, it reuses allocated memory
+    QPainterPath path;
+
+    // Process all instructions
+    for (const Instruction& instruction : m_instructions)
+    {
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PathPaintData& data = m_paths[instruction.dataIndex];
+
+                if (blDisplayList && blDisplayList->drawPath(painter, instruction.dataIndex))
+                {
+                    break;
+                }
+
+                // Set antialiasing
+                const bool antialiasing = (data.isText && features.testFlag(PDFRenderer::TextAntialiasing)) || (!data.isText && features.testFlag(PDFRenderer::Antialiasing));
+
+                if (!blDisplayList && data.textRunCount > 0 && drawTextRunUsingRasterCache(painter, data, antialiasing))
+                {
+                    break;
+                }
+
+                painter->setRenderHint(QPainter::Antialiasing, antialiasing);
+                painter->setPen(getPen(data));
+                painter->setBrush(getBrush(data));
+                loadPath(data.elementStart, data.elementCount, data.fillRule, path);
+                painter->drawPath(path);
+                break;
+            }
+
+            case InstructionType::DrawImage:
+            {
+                const ImageData& data = m_images[instruction.dataIndex];
+                const QImage image = getImageMipmap(data, painter->worldTransform());
+                const bool isMipmap = image.size() != data.image.size();
+
+                painter->save();
+
+                QTransform imageTransform(1.0 / image.width(), 0, 0, 1.0 / image.height(), 0, 0);
+                QTransform worldTransform = imageTransform * painter->worldTransform();
+
+                // Jakub Melka: Because Qt uses opposite axis direction than PDF, then we must transform the y-axis
+                // to the opposite (so the image is then unchanged)
+                worldTransform.translate(0, image.height());
+                worldTransform.scale(1, -1);
+
+                painter->setWorldTransform(worldTransform);
+
+                if (isMipmap || !blDisplayList || !blDisplayList->drawImage(painter, instruction.dataIndex))
+                {
+                    painter->drawImage(0, 0, image);
+                }
+
+                painter->restore();
+                break;
             }
 
             case InstructionType::DrawMesh:
@@ -536,6 +1397,24 @@ void PDFPrecompiledPage::draw(QPainter* painter,
                 break;
             }
 
+            case InstructionType::DrawShading:
+            {
+                const ShadingPaintData& data = m_shadings[instruction.dataIndex];
+
+                if (isRasterPainter(painter))
+                {
+                    data.rasterizer.draw(painter, pagePointToDevicePointMatrix, data.path, data.alpha);
+                }
+                else
+                {
+                    painter->save();
+                    painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix));
+                    data.createMesh().paint(painter, data.alpha);
+                    painter->restore();
+                }
+                break;
+            }
+
             case InstructionType::Clip:
             {
                 painter->setClipPath(m_clips[instruction.dataIndex].clipPath, Qt::IntersectClip);
@@ -566,6 +1445,28 @@ void PDFPrecompiledPage::draw(QPainter* painter,
                 break;
             }
 
+            case InstructionType::DrawInstance:
+            {
+                const InstanceData& data = m_instances[instruction.dataIndex];
+                const QTransform instancePointToDevicePointMatrix = data.matrix * pagePointToDevicePointMatrix;
+
+                painter->save();
+                painter->setWorldTransform(instancePointToDevicePointMatrix);
+                data.precompiledPage->drawInstructions(painter, instancePointToDevicePointMatrix, features);
+                painter->restore();
+                break;
+            }
+
+            case InstructionType::DrawTilingPattern:
+            {
+                const TilingPatternPaintData& data = m_tilingPatterns[instruction.dataIndex];
+                if (!drawTilingPatternUsingRasterCache(painter, data, pagePointToDevicePointMatrix, features))
+                {
+                    drawTilingPatternCells(painter, data, pagePointToDevicePointMatrix, features);
+                }
+                break;
+            }
+
             default:
             {
                 Q_ASSERT(false);
@@ -573,8 +1474,6 @@ void PDFPrecompiledPage::draw(QPainter* painter,
             }
         }
     }
-
-    painter->restore();
 }
 
 void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matrix, QColor color)
@@ -602,8 +1501,12 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
             {
                 QTransform currentMatrix = worldMatrixStack.top().inverted();
                 QPainterPath mappedRedactPath = currentMatrix.map(redactPath);
-                PathPaintData& path = m_paths[instruction.dataIndex];
-                path.path = path.path.subtracted(mappedRedactPath);
+                PathPaintData& data = m_paths[instruction.dataIndex];
+                QPainterPath redactedPath = getPath(data).subtracted(mappedRedactPath);
+                data.elementStart = storePath(redactedPath);
+                data.elementCount = redactedPath.elementCount();
+                data.fillRule = redactedPath.fillRule();
+                data.textRunCount = 0;
                 break;
             }
 
@@ -624,6 +1527,7 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
                 painter.setWorldTransform(worldTransform.inverted());
                 painter.drawPath(redactPath);
                 painter.end();
+                data.mipmaps.reset();
                 break;
             }
 
@@ -631,6 +1535,10 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
                 // We do not redact mesh
                 break;
 
+            case InstructionType::DrawShading:
+                // We do not redact shading
+                break;
+
             case InstructionType::Clip:
             {
                 QTransform currentMatrix = worldMatrixStack.top().inverted();
@@ -654,6 +1562,27 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
             case InstructionType::SetCompositionMode:
                 break;
 
+            case InstructionType::DrawInstance:
+            {
+                // Instanced page can be shared, so we redact its copy
+                InstanceData& data = m_instances[instruction.dataIndex];
+                if (data.matrix.isInvertible())
+                {
+                    std::shared_ptr<PDFPrecompiledPage> redactedPage = std::make_shared<PDFPrecompiledPage>(*data.precompiledPage);
+                    redactedPage->redact(data.matrix.inverted().map(redactPath), QTransform(), QColor());
+                    data.precompiledPage = qMove(redactedPage);
+                }
+                break;
+            }
+
+            case InstructionType::DrawTilingPattern:
+            {
+                // Pattern cells are drawn only inside the filled area
+                TilingPatternPaintData& data = m_tilingPatterns[instruction.dataIndex];
+                data.path = data.path.subtracted(redactPath);
+                break;
+            }
+
             default:
             {
                 Q_ASSERT(false);
@@ -667,12 +1596,223 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
         addRestoreGraphicState();
         addPath(Qt::NoPen, QBrush(color), matrix.map(redactPath), false);
     }
+
+    invalidateBLDisplayList();
 }
 
 void PDFPrecompiledPage::addPath(QPen pen, QBrush brush, QPainterPath path, bool isText)
 {
+    if (isText)
+    {
+        addTextPath(qMove(pen), qMove(brush), qMove(path), INVALID_GLYPH_INDEX);
+        return;
+    }
+
+    PathPaintData data;
+    data.penIndex = getPenIndex(qMove(pen), false);
+    data.brushIndex = getBrushIndex(qMove(brush), false);
+    data.elementStart = storePath(path);
+    data.elementCount = path.elementCount();
+    data.fillRule = path.fillRule();
+
     m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size());
-    m_paths.emplace_back(qMove(pen), qMove(brush), qMove(path), isText);
+    m_paths.push_back(data);
+}
+
+void PDFPrecompiledPage::addGlyphPath(QPen pen, QBrush brush, QPainterPath path, QPainterPath glyphPath, QTransform glyphMatrix)
+{
+    // Calculate hash of the glyph outline, so identical glyphs
+    // share the same bitmap in the glyph raster cache.
+    size_t hash = qHash(int(glyphPath.fillRule()));
+    const int elementCount = glyphPath.elementCount();
+    for (int i = 0; i < elementCount; ++i)
+    {
+        const QPainterPath::Element& element = glyphPath.elementAt(i);
+        hash = qHashMulti(hash, element.x, element.y, int(element.type));
+    }
+
+    const size_t glyphIndex = m_glyphs.size();
+    m_glyphs.emplace_back(qMove(glyphPath), glyphMatrix, hash);
+    addTextPath(qMove(pen), qMove(brush), qMove(path), glyphIndex);
+}
+
+void PDFPrecompiledPage::addTextPath(QPen pen, QBrush brush, QPainterPath path, size_t glyphIndex)
+{
+    const quint32 penIndex = getPenIndex(qMove(pen), true);
+    const quint32 brushIndex = getBrushIndex(qMove(brush), true);
+
+    TextRunGlyph glyph;
+    glyph.boundingRect = path.controlPointRect();
+    glyph.glyphIndex = glyphIndex;
+    glyph.elementCount = path.elementCount();
+
+    // Try to append the glyph to the text run of the previous instruction. There
+    // can't be any state change between them, because it would be an instruction.
+    if (!m_instructions.empty() && m_instructions.back().type == InstructionType::DrawPath)
+    {
+        PathPaintData& run = m_paths[m_instructions.back().dataIndex];
+        if (canAppendToTextRun(run, penIndex, brushIndex, path, glyph.boundingRect))
+        {
+            storePath(path);
+            glyph.elementStart = run.elementCount;
+            run.elementCount += glyph.elementCount;
+            m_textRunGlyphs.push_back(glyph);
+            ++run.textRunCount;
+            return;
+        }
+    }
+
+    glyph.elementStart = 0;
+
+    PathPaintData data;
+    data.penIndex = penIndex;
+    data.brushIndex = brushIndex;
+    data.elementStart = storePath(path);
+    data.elementCount = glyph.elementCount;
+    data.fillRule = path.fillRule();
+    data.isText = true;
+    data.textRunStart = quint32(m_textRunGlyphs.size());
+    data.textRunCount = 1;
+
+    m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size());
+    m_paths.push_back(data);
+    m_textRunGlyphs.push_back(glyph);
+}
+
+bool PDFPrecompiledPage::canAppendToTextRun(const PathPaintData& run,
+                                            quint32 penIndex,
+                                            quint32 brushIndex,
+                                            const QPainterPath& path,
+                                            const QRectF& boundingRect) const
+{
+    if (!run.isText ||
+        run.textRunCount == 0 ||
+        run.textRunCount >= MAX_TEXT_RUN_GLYPHS ||
+        run.elementStart + run.elementCount != m_pathElementTypes.size() ||
+        run.fillRule != path.fillRule() ||
+        run.penIndex != penIndex ||
+        run.brushIndex != brushIndex)
+    {
+        return false;
+    }
+
+    // Only filled glyphs are merged into text runs. Overlap test uses
+    // fill bounding rectangles of glyphs, which do not contain the stroke.
+    if (m_pens[penIndex].pen.style() != Qt::NoPen)
+    {
+        return false;
+    }
+
+    // Overlapping glyphs can't be merged into one path, because
+    // overlapping areas would be painted differently (for example, with
+    // even-odd fill rule, overlapping area would be not filled at all).
+    auto it = std::next(m_textRunGlyphs.cbegin(), run.textRunStart);
+    auto itEnd = std::next(it, run.textRunCount);
+    return std::none_of(it, itEnd, [&boundingRect](const TextRunGlyph& glyph) { return glyph.boundingRect.intersects(boundingRect); });
+}
+
+QPainterPath PDFPrecompiledPage::getTextRunGlyphPath(const PathPaintData& data, const TextRunGlyph& glyph) const
+{
+    QPainterPath path;
+    loadPath(data.elementStart + glyph.elementStart, glyph.elementCount, data.fillRule, path);
+    return path;
+}
+
+quint32 PDFPrecompiledPage::getPenIndex(QPen pen, bool isText)
+{
+    // Pens are usually repeated in consecutive instructions, so it is
+    // sufficient to search only most recently inserted pens.
+    const size_t searchEnd = m_pens.size() > PALETTE_SEARCH_WINDOW ? m_pens.size() - PALETTE_SEARCH_WINDOW : 0;
+    for (size_t i = m_pens.size(); i > searchEnd; --i)
+    {
+        const PenPaletteItem& item = m_pens[i - 1];
+        if (item.isText == isText && item.pen == pen)
+        {
+            return quint32(i - 1);
+        }
+    }
+
+    m_pens.push_back(PenPaletteItem{ qMove(pen), isText });
+    return quint32(m_pens.size() - 1);
+}
+
+quint32 PDFPrecompiledPage::getBrushIndex(QBrush brush, bool isText)
+{
+    const size_t searchEnd = m_brushes.size() > PALETTE_SEARCH_WINDOW ? m_brushes.size() - PALETTE_SEARCH_WINDOW : 0;
+    for (size_t i = m_brushes.size(); i > searchEnd; --i)
+    {
+        const BrushPaletteItem& item = m_brushes[i - 1];
+        if (item.isText == isText && item.brush == brush)
+        {
+            return quint32(i - 1);
+        }
+    }
+
+    m_brushes.push_back(BrushPaletteItem{ qMove(brush), isText });
+    return quint32(m_brushes.size() - 1);
+}
+
+quint32 PDFPrecompiledPage::storePath(const QPainterPath& path)
+{
+    const quint32 elementStart = quint32(m_pathElementTypes.size());
+    const int elementCount = path.elementCount();
+
+    for (int i = 0; i < elementCount; ++i)
+    {
+        const QPainterPath::Element& element = path.elementAt(i);
+        m_pathCoordinates.push_back(float(element.x));
+        m_pathCoordinates.push_back(float(element.y));
+        m_pathElementTypes.push_back(quint8(element.type));
+    }
+
+    return elementStart;
+}
+
+void PDFPrecompiledPage::loadPath(quint32 elementStart, quint32 elementCount, Qt::FillRule fillRule, QPainterPath& path) const
+{
+    path.clear();
+    path.reserve(int(elementCount));
+    path.setFillRule(fillRule);
+
+    const float* coordinates = m_pathCoordinates.data();
+    const quint32 elementEnd = elementStart + elementCount;
+    for (quint32 i = elementStart; i < elementEnd; ++i)
+    {
+        const float x = coordinates[2 * i];
+        const float y = coordinates[2 * i + 1];
+
+        switch (static_cast<QPainterPath::ElementType>(m_pathElementTypes[i]))
+        {
+            case QPainterPath::MoveToElement:
+                path.moveTo(x, y);
+                break;
+
+            case QPainterPath::LineToElement:
+                path.lineTo(x, y);
+                break;
+
+            case QPainterPath::CurveToElement:
+            {
+                if (i + 2 < elementEnd)
+                {
+                    path.cubicTo(x, y, coordinates[2 * i + 2], coordinates[2 * i + 3], coordinates[2 * i + 4], coordinates[2 * i + 5]);
+                }
+                i += 2;
+                break;
+            }
+
+            case QPainterPath::CurveToDataElement:
+                Q_ASSERT(false);
+                break;
+        }
+    }
+}
+
+QPainterPath PDFPrecompiledPage::getPath(const PathPaintData& data) const
+{
+    QPainterPath path;
+    loadPath(data.elementStart, data.elementCount, data.fillRule, path);
+    return path;
 }
 
 void PDFPrecompiledPage::addClip(QPainterPath path)
@@ -693,6 +1833,31 @@ void PDFPrecompiledPage::addMesh(PDFMesh mesh, PDFReal alpha)
     m_meshes.emplace_back(qMove(mesh), alpha);
 }
 
+void PDFPrecompiledPage::addShading(PDFShadingRasterizer rasterizer, ShadingMeshData meshData, QPainterPath path, PDFReal alpha)
+{
+    m_instructions.emplace_back(InstructionType::DrawShading, m_shadings.size());
+    m_shadings.emplace_back(qMove(rasterizer), qMove(meshData), qMove(path), alpha);
+}
+
+PDFMesh PDFPrecompiledPage::ShadingPaintData::createMesh() const
+{
+    const PDFShadingPattern* shadingPattern = meshData.patternColorSpace->asPatternColorSpace()->getPattern()->getShadingPattern();
+
+    // Errors were already reported, when page was compiled
+    PDFRenderErrorReporterDummy reporter;
+    PDFMesh mesh = PDFShadingMeshCache::getInstance()->getMesh(meshData.document, shadingPattern, meshData.settings, meshData.cms, meshData.renderingIntent, &reporter, nullptr);
+
+    QPainterPath boundingPath = mesh.getBoundingPath();
+    mesh.setBoundingPath(boundingPath.isEmpty() ? path : boundingPath.intersected(path));
+
+    for (const PDFColorConvertor& colorConvertor : meshData.colorConvertors)
+    {
+        mesh.convertColors(colorConvertor);
+    }
+
+    return mesh;
+}
+
 void PDFPrecompiledPage::addSetWorldMatrix(const QTransform& matrix)
 {
     m_instructions.emplace_back(InstructionType::SetWorldMatrix, m_matrices.size());
@@ -705,15 +1870,62 @@ void PDFPrecompiledPage::addSetCompositionMode(QPainter::CompositionMode composi
     m_compositionModes.push_back(compositionMode);
 }
 
+void PDFPrecompiledPage::addInstance(std::shared_ptr<const PDFPrecompiledPage> precompiledPage, const QTransform& matrix)
+{
+    m_instructions.emplace_back(InstructionType::DrawInstance, m_instances.size());
+    m_instances.emplace_back(qMove(precompiledPage), matrix);
+}
+
+void PDFPrecompiledPage::addTilingPattern(std::shared_ptr<const PDFPrecompiledPage> cell,
+                                          const QTransform& patternMatrix,
+                                          const QRectF& boundingBox,
+                                          const QRectF& tilingArea,
+                                          PDFReal xStep,
+                                          PDFReal yStep,
+                                          QPainterPath path)
+{
+    TilingPatternPaintData data;
+
+    // Same cell shares the tile in the raster cache
+    auto it = std::find_if(m_tilingPatterns.cbegin(), m_tilingPatterns.cend(), [&cell](const TilingPatternPaintData& item) { return item.cell == cell; });
+    data.cellId = (it != m_tilingPatterns.cend()) ? it->cellId : createTilingPatternCellId();
+
+    data.cell = qMove(cell);
+    data.patternMatrix = patternMatrix;
+    data.boundingBox = boundingBox;
+    data.tilingArea = tilingArea;
+    data.xStep = xStep;
+    data.yStep = yStep;
+    data.path = qMove(path);
+
+    m_instructions.emplace_back(InstructionType::DrawTilingPattern, m_tilingPatterns.size());
+    m_tilingPatterns.emplace_back(qMove(data));
+}
+
+quint64 PDFPrecompiledPage::createTilingPatternCellId()
+{
+    static std::atomic<quint64> lastId = 0;
+    return ++lastId;
+}
+
 void PDFPrecompiledPage::optimize()
 {
     m_instructions.shrink_to_fit();
     m_paths.shrink_to_fit();
+    m_pens.shrink_to_fit();
+    m_brushes.shrink_to_fit();
+    m_pathCoordinates.shrink_to_fit();
+    m_pathElementTypes.shrink_to_fit();
+    m_glyphs.shrink_to_fit();
+    m_textRunGlyphs.shrink_to_fit();
     m_clips.shrink_to_fit();
     m_images.shrink_to_fit();
     m_meshes.shrink_to_fit();
+    m_shadings.shrink_to_fit();
     m_matrices.shrink_to_fit();
     m_compositionModes.shrink_to_fit();
+    m_instances.shrink_to_fit();
+    m_tilingPatterns.shrink_to_fit();
 }
 
 void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
@@ -722,27 +1934,33 @@ void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
     //     - painter paths
     //     - images
     //     - meshes
+    //     - shadings
 
     if (!colorConvertor.isActive())
     {
         return;
     }
 
-    for (PathPaintData& pathData : m_paths)
+    for (PenPaletteItem& item : m_pens)
     {
-        if (pathData.pen.style() != Qt::NoPen)
+        if (item.pen.style() != Qt::NoPen)
         {
-            pathData.pen.setColor(colorConvertor.convert(pathData.pen.color(), false, pathData.isText));
+            item.pen.setColor(colorConvertor.convert(item.pen.color(), false, item.isText));
         }
-        if (pathData.brush.style() == Qt::SolidPattern)
+    }
+
+    for (BrushPaletteItem& item : m_brushes)
+    {
+        if (item.brush.style() == Qt::SolidPattern)
         {
-            pathData.brush.setColor(colorConvertor.convert(pathData.brush.color(), false, pathData.isText));
+            item.brush.setColor(colorConvertor.convert(item.brush.color(), false, item.isText));
         }
     }
 
     for (ImageData& imageData : m_images)
     {
         imageData.image = colorConvertor.convert(imageData.image);
+        imageData.mipmaps.reset();
     }
 
     for (MeshPaintData& meshPaintData : m_meshes)
@@ -750,7 +1968,44 @@ void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
         meshPaintData.mesh.convertColors(colorConvertor);
     }
 
+    for (ShadingPaintData& shadingPaintData : m_shadings)
+    {
+        shadingPaintData.rasterizer.convertColors(colorConvertor);
+        shadingPaintData.meshData.colorConvertors.push_back(colorConvertor);
+    }
+
+    // Instanced pages are shared, we convert copy of each of them only once
+    std::map<const PDFPrecompiledPage*, std::shared_ptr<const PDFPrecompiledPage>> convertedPages;
+    for (InstanceData& instanceData : m_instances)
+    {
+        std::shared_ptr<const PDFPrecompiledPage>& convertedPage = convertedPages[instanceData.precompiledPage.get()];
+        if (!convertedPage)
+        {
+            std::shared_ptr<PDFPrecompiledPage> page = std::make_shared<PDFPrecompiledPage>(*instanceData.precompiledPage);
+            page->convertColors(colorConvertor);
+            convertedPage = qMove(page);
+        }
+        instanceData.precompiledPage = convertedPage;
+    }
+
+    // Tiling pattern cells are also shared, converted cell gets new identifier,
+    // so tiles of the original cell in the raster cache are not used.
+    std::map<quint64, std::pair<std::shared_ptr<const PDFPrecompiledPage>, quint64>> convertedCells;
+    for (TilingPatternPaintData& tilingPatternData : m_tilingPatterns)
+    {
+        std::pair<std::shared_ptr<const PDFPrecompiledPage>, quint64>& convertedCell = convertedCells[tilingPatternData.cellId];
+        if (!convertedCell.first)
+        {
+            std::shared_ptr<PDFPrecompiledPage> cell = std::make_shared<PDFPrecompiledPage>(*tilingPatternData.cell);
+            cell->convertColors(colorConvertor);
+            convertedCell = std::make_pair(qMove(cell), createTilingPatternCellId());
+        }
+        tilingPatternData.cell = convertedCell.first;
+        tilingPatternData.cellId = convertedCell.second;
+    }
+
     m_paperColor = colorConvertor.convert(m_paperColor, true, false);
+    invalidateBLDisplayList();
 }
 
 void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError> errors)
@@ -762,46 +2017,433 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
     m_memoryConsumptionEstimate = sizeof(*this);
     m_memoryConsumptionEstimate += sizeof(Instruction) * m_instructions.capacity();
     m_memoryConsumptionEstimate += sizeof(PathPaintData) * m_paths.capacity();
+    m_memoryConsumptionEstimate += sizeof(PenPaletteItem) * m_pens.capacity();
+    m_memoryConsumptionEstimate += sizeof(BrushPaletteItem) * m_brushes.capacity();
+    m_memoryConsumptionEstimate += sizeof(float) * m_pathCoordinates.capacity();
+    m_memoryConsumptionEstimate += sizeof(quint8) * m_pathElementTypes.capacity();
+    m_memoryConsumptionEstimate += sizeof(GlyphData) * m_glyphs.capacity();
+    m_memoryConsumptionEstimate += sizeof(TextRunGlyph) * m_textRunGlyphs.capacity();
     m_memoryConsumptionEstimate += sizeof(ClipData) * m_clips.capacity();
     m_memoryConsumptionEstimate += sizeof(ImageData) * m_images.capacity();
     m_memoryConsumptionEstimate += sizeof(MeshPaintData) * m_meshes.capacity();
+    m_memoryConsumptionEstimate += sizeof(ShadingPaintData) * m_shadings.capacity();
     m_memoryConsumptionEstimate += sizeof(QTransform) * m_matrices.capacity();
     m_memoryConsumptionEstimate += sizeof(QPainter::CompositionMode) * m_compositionModes.capacity();
+    m_memoryConsumptionEstimate += sizeof(InstanceData) * m_instances.capacity();
+    m_memoryConsumptionEstimate += sizeof(TilingPatternPaintData) * m_tilingPatterns.capacity();
     m_memoryConsumptionEstimate += sizeof(PDFRenderError) * m_errors.size();
 
     auto calculateQPathMemoryConsumption = [](const QPainterPath& path)
     {
         return sizeof(QPainterPath::Element) * path.capacity();
     };
-    for (const PathPaintData& data : m_paths)
-    {
-        m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.path);
-    }
     for (const ClipData& data : m_clips)
     {
         m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.clipPath);
     }
     for (const ImageData& data : m_images)
     {
+        // Mipmap chain is created lazily, but we count it in advance
         m_memoryConsumptionEstimate += data.image.sizeInBytes();
+        m_memoryConsumptionEstimate += getMipmapMemoryConsumptionEstimate(data.image);
     }
     for (const MeshPaintData& data : m_meshes)
     {
         m_memoryConsumptionEstimate += data.mesh.getMemoryConsumptionEstimate();
     }
+    for (const ShadingPaintData& data : m_shadings)
+    {
+        m_memoryConsumptionEstimate += data.rasterizer.getMemoryConsumptionEstimate();
+        m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.path);
+    }
+
+    // Shared instanced pages are counted only once
+    std::set<const PDFPrecompiledPage*> instancedPages;
+    for (const InstanceData& data : m_instances)
+    {
+        if (instancedPages.insert(data.precompiledPage.get()).second)
+        {
+            m_memoryConsumptionEstimate += data.precompiledPage->getMemoryConsumptionEstimate();
+        }
+    }
+    for (const TilingPatternPaintData& data : m_tilingPatterns)
+    {
+        m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.path);
+        if (instancedPages.insert(data.cell.get()).second)
+        {
+            m_memoryConsumptionEstimate += data.cell->getMemoryConsumptionEstimate();
+        }
+    }
 }
 
-PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
-                                                                                     PDFReal epsilon) const
+bool PDFPrecompiledPage::drawTextRunUsingRasterCache(QPainter* painter, const PathPaintData& data, bool antialiasing) const
 {
-    GraphicPieceInfos infos;
+    if (!isRasterPainter(painter))
+    {
+        return false;
+    }
 
-    struct State
+    const QTransform worldTransform = painter->worldTransform();
+
+    if (worldTransform.type() == QTransform::TxProject)
     {
-        QTransform matrix;
+        // Perspective transformations are not handled by the cache
+        return false;
+    }
+
+    auto itBegin = std::next(m_textRunGlyphs.cbegin(), data.textRunStart);
+    auto itEnd = std::next(itBegin, data.textRunCount);
+
+    // All glyphs must be drawn using the cache, otherwise
+    // whole text run is drawn as a single path.
+    for (auto it = itBegin; it != itEnd; ++it)
+    {
+        const TextRunGlyph& glyph = *it;
+
+        if (glyph.glyphIndex == INVALID_GLYPH_INDEX)
+        {
+            return false;
+        }
+
+        const QRectF deviceBoundingRect = worldTransform.mapRect(glyph.boundingRect);
+        if (deviceBoundingRect.width() > PDFGlyphRasterCache::MAX_GLYPH_SIZE ||
+            deviceBoundingRect.height() > PDFGlyphRasterCache::MAX_GLYPH_SIZE)
+        {
+            // Glyph is too large, draw it as a path
+            return false;
+        }
+    }
+
+    constexpr PDFReal MATRIX_QUANTIZATION = 1024.0;
+    const QRgb color = getBrush(data).color().rgba();
+    PDFGlyphRasterCache* cache = PDFGlyphRasterCache::getInstance();
+
+    painter->setWorldTransform(QTransform());
+
+    for (auto it = itBegin; it != itEnd; ++it)
+    {
+        const GlyphData& glyphData = m_glyphs[it->glyphIndex];
+        const QTransform glyphToDeviceTransform = glyphData.glyphMatrix * worldTransform;
+
+        // Quantize the glyph-to-device transformation
+        const QPointF origin = glyphToDeviceTransform.map(QPointF(0.0, 0.0));
+        const QPoint originPixel(qFloor(origin.x()), qFloor(origin.y()));
+
+        PDFGlyphRasterCache::Key key;
+        key.glyphHash = glyphData.hash;
+        key.matrix = { qRound(glyphToDeviceTransform.m11() * MATRIX_QUANTIZATION),
+                       qRound(glyphToDeviceTransform.m12() * MATRIX_QUANTIZATION),
+                       qRound(glyphToDeviceTransform.m21() * MATRIX_QUANTIZATION),
+                       qRound(glyphToDeviceTransform.m22() * MATRIX_QUANTIZATION) };
+        key.subpixelX = qBound(0, qFloor((origin.x() - originPixel.x()) * PDFGlyphRasterCache::SUBPIXEL_POSITIONS), PDFGlyphRasterCache::SUBPIXEL_POSITIONS - 1);
+        key.subpixelY = qBound(0, qFloor((origin.y() - originPixel.y()) * PDFGlyphRasterCache::SUBPIXEL_POSITIONS), PDFGlyphRasterCache::SUBPIXEL_POSITIONS - 1);
+        key.color = color;
+        key.antialiasing = antialiasing;
+
+        auto rasterize = [&key, &glyphData]()
+        {
+            PDFGlyphRasterCache::Entry entry;
+
+            const QTransform positionedTransform(key.matrix[0] / MATRIX_QUANTIZATION,
+                                                 key.matrix[1] / MATRIX_QUANTIZATION,
+                                                 key.matrix[2] / MATRIX_QUANTIZATION,
+                                                 key.matrix[3] / MATRIX_QUANTIZATION,
+                                                 PDFReal(key.subpixelX) / PDFGlyphRasterCache::SUBPIXEL_POSITIONS,
+                                                 PDFReal(key.subpixelY) / PDFGlyphRasterCache::SUBPIXEL_POSITIONS);
+
+            QRect imageRect = positionedTransform.mapRect(glyphData.glyphPath.controlPointRect()).toAlignedRect().adjusted(-1, -1, 1, 1);
+            entry.offset = imageRect.topLeft();
+            entry.image = QImage(imageRect.size(), QImage::Format_ARGB32_Premultiplied);
+            entry.image.fill(Qt::transparent);
+
+            QPainter glyphPainter(&entry.image);
+            glyphPainter.setRenderHint(QPainter::Antialiasing, key.antialiasing);
+            glyphPainter.setWorldTransform(positionedTransform * QTransform::fromTranslate(-imageRect.left(), -imageRect.top()));
+            glyphPainter.fillPath(glyphData.glyphPath, QColor::fromRgba(key.color));
+            glyphPainter.end();
+
+            return entry;
+        };
+
+        PDFGlyphRasterCache::Entry entry = cache->getGlyph(key, glyphData.glyphPath, rasterize);
+        painter->drawImage(originPixel + entry.offset, entry.image);
+    }
+
+    painter->setWorldTransform(worldTransform);
+    return true;
+}
+
+bool PDFPrecompiledPage::drawTilingPatternUsingRasterCache(QPainter* painter,
+                                                           const TilingPatternPaintData& data,
+                                                           const QTransform& pagePointToDevicePointMatrix,
+                                                           PDFRenderer::Features features) const
+{
+    if (!isRasterPainter(painter))
+    {
+        return false;
+    }
+
+    const QTransform patternPointToDevicePointMatrix = data.patternMatrix * pagePointToDevicePointMatrix;
+    if (patternPointToDevicePointMatrix.type() == QTransform::TxProject)
+    {
+        return false;
+    }
+
+    // Size of the tile in device pixels
+    const QPointF origin = patternPointToDevicePointMatrix.map(QPointF(0.0, 0.0));
+    const PDFReal tileWidth = QLineF(origin, patternPointToDevicePointMatrix.map(QPointF(data.xStep, 0.0))).length();
+    const PDFReal tileHeight = QLineF(origin, patternPointToDevicePointMatrix.map(QPointF(0.0, data.yStep))).length();
+
+    if (!(tileWidth >= 1.0 && tileHeight >= 1.0 &&
+          tileWidth <= PDFTilingPatternRasterCache::MAX_TILE_SIZE &&
+          tileHeight <= PDFTilingPatternRasterCache::MAX_TILE_SIZE))
+    {
+        return false;
+    }
+
+    // Cell bounding box can be larger than the cell step, then content
+    // of the neighbouring cells overlaps the tile.
+    const PDFReal cellCount = (data.boundingBox.width() / data.xStep + 2.0) * (data.boundingBox.height() / data.yStep + 2.0);
+    if (!(cellCount <= PDFTilingPatternRasterCache::MAX_TILE_CELLS))
+    {
+        return false;
+    }
+
+    PDFTilingPatternRasterCache::Key key;
+    key.cellId = data.cellId;
+    key.width = qCeil(tileWidth);
+    key.height = qCeil(tileHeight);
+    key.antialiasing = features.testFlag(PDFRenderer::Antialiasing);
+    key.textAntialiasing = features.testFlag(PDFRenderer::TextAntialiasing);
+    key.smoothImages = features.testFlag(PDFRenderer::SmoothImages);
+
+    auto rasterize = [&]()
+    {
+        QImage tile(key.width, key.height, QImage::Format_ARGB32_Premultiplied);
+        tile.fill(Qt::transparent);
+
+        const int firstColumn = qFloor(-data.boundingBox.right() / data.xStep);
+        const int lastColumn = qCeil(1.0 - data.boundingBox.left() / data.xStep);
+        const int firstRow = qFloor(-data.boundingBox.bottom() / data.yStep);
+        const int lastRow = qCeil(1.0 - data.boundingBox.top() / data.yStep);
+        const QTransform patternPointToTilePointMatrix = QTransform::fromScale(key.width / data.xStep, key.height / data.yStep);
+
+        QPainter tilePainter(&tile);
+        tilePainter.setRenderHint(QPainter::SmoothPixmapTransform, key.smoothImages);
+        for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+            for (int row = firstRow; row <= lastRow; ++row)
+            {
+                const QTransform cellPointToTilePointMatrix = QTransform::fromTranslate(column * data.xStep, row * data.yStep) * patternPointToTilePointMatrix;
+
+                tilePainter.save();
+                tilePainter.setWorldTransform(cellPointToTilePointMatrix);
+                data.cell->drawInstructions(&tilePainter, cellPointToTilePointMatrix, features);
+                tilePainter.restore();
+            }
+        }
+        tilePainter.end();
+
+        return tile;
     };
-    std::stack<State> stateStack;
-    stateStack.emplace();
+
+    PDFTilingPatternRasterCache* cache = PDFTilingPatternRasterCache::getInstance();
+    const QImage tile = cache->getTile(key, rasterize);
+
+    // Brush maps tile pixels to the pattern space (tiling starts at the
+    // corner of the tiling area) and then to the device space.
+    QBrush brush(tile);
+    brush.setTransform(QTransform::fromScale(data.xStep / key.width, data.yStep / key.height) *
+                       QTransform::fromTranslate(data.tilingArea.left(), data.tilingArea.top()) *
+                       patternPointToDevicePointMatrix);
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+    painter->setRenderHint(QPainter::Antialiasing, features.testFlag(PDFRenderer::Antialiasing));
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(brush);
+    painter->drawPath(pagePointToDevicePointMatrix.map(data.path));
+    painter->restore();
+    return true;
+}
+
+void PDFPrecompiledPage::drawTilingPatternCells(QPainter* painter,
+                                                const TilingPatternPaintData& data,
+                                                const QTransform& pagePointToDevicePointMatrix,
+                                                PDFRenderer::Features features) const
+{
+    const QTransform patternPointToDevicePointMatrix = data.patternMatrix * pagePointToDevicePointMatrix;
+    const PDFInteger columns = qMax<PDFInteger>(qCeil(data.tilingArea.width() / data.xStep), 1);
+    const PDFInteger rows = qMax<PDFInteger>(qCeil(data.tilingArea.height() / data.yStep), 1);
+
+    painter->save();
+    painter->setWorldTransform(pagePointToDevicePointMatrix);
+    painter->setClipPath(data.path, Qt::IntersectClip);
+
+    for (PDFInteger column = 0; column < columns; ++column)
+    {
+        for (PDFInteger row = 0; row < rows; ++row)
+        {
+            const QTransform cellPointToDevicePointMatrix = QTransform::fromTranslate(data.tilingArea.left() + column * data.xStep, data.tilingArea.top() + row * data.yStep) * patternPointToDevicePointMatrix;
+
+            painter->save();
+            painter->setWorldTransform(cellPointToDevicePointMatrix);
+            data.cell->drawInstructions(painter, cellPointToDevicePointMatrix, features);
+            painter->restore();
+        }
+    }
+
+    painter->restore();
+}
+
+bool PDFPrecompiledPage::isMipmapped(const QImage& image)
+{
+    // Images with less than 8 bits per pixel would be enlarged by mipmaps
+    return image.depth() >= 8 && image.width() >= 2 * MIPMAP_MIN_SIZE && image.height() >= 2 * MIPMAP_MIN_SIZE;
+}
+
+qint64 PDFPrecompiledPage::getMipmapMemoryConsumptionEstimate(const QImage& image)
+{
+    qint64 memoryConsumptionEstimate = 0;
+
+    if (isMipmapped(image))
+    {
+        int width = image.width() / 2;
+        int height = image.height() / 2;
+
+        while (width >= MIPMAP_MIN_SIZE && height >= MIPMAP_MIN_SIZE)
+        {
+            // Smoothly scaled images are 32-bit
+            memoryConsumptionEstimate += qint64(width) * qint64(height) * 4;
+            width /= 2;
+            height /= 2;
+        }
+    }
+
+    return memoryConsumptionEstimate;
+}
+
+QImage PDFPrecompiledPage::getImageMipmap(const ImageData& data, const QTransform& worldTransform) const
+{
+    if (!isMipmapped(data.image) || worldTransform.type() == QTransform::TxProject)
+    {
+        return data.image;
+    }
+
+    const QPointF origin = worldTransform.map(QPointF(0.0, 0.0));
+    const PDFReal targetWidth = QLineF(origin, worldTransform.map(QPointF(1.0, 0.0))).length();
+    const PDFReal targetHeight = QLineF(origin, worldTransform.map(QPointF(0.0, 1.0))).length();
+
+    if (data.image.width() < 2 * targetWidth || data.image.height() < 2 * targetHeight)
+    {
+        // Image is not scaled down enough to use the mipmap
+        return data.image;
+    }
+
+    static QMutex mutex;
+    std::shared_ptr<const std::vector<QImage>> mipmaps;
+
+    {
+        QMutexLocker lock(&mutex);
+        mipmaps = data.mipmaps;
+    }
+
+    if (!mipmaps)
+    {
+        // Mipmap chain is created outside of the lock, if two threads are
+        // creating it simultaneously, the first one wins.
+        std::shared_ptr<std::vector<QImage>> newMipmaps = std::make_shared<std::vector<QImage>>();
+
+        QImage level = data.image;
+        while (level.width() / 2 >= MIPMAP_MIN_SIZE && level.height() / 2 >= MIPMAP_MIN_SIZE)
+        {
+            level = level.scaled(level.width() / 2, level.height() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            newMipmaps->push_back(level);
+        }
+
+        QMutexLocker lock(&mutex);
+        if (!data.mipmaps)
+        {
+            data.mipmaps = std::move(newMipmaps);
+        }
+        mipmaps = data.mipmaps;
+    }
+
+    // Select the smallest level, which is still at least as large as the target
+    QImage image = data.image;
+    for (const QImage& level : *mipmaps)
+    {
+        if (level.width() < targetWidth || level.height() < targetHeight)
+        {
+            break;
+        }
+
+        image = level;
+    }
+
+    return image;
+}
+
+std::shared_ptr<const PDFBLDisplayList> PDFPrecompiledPage::getBLDisplayList() const
+{
+    static QMutex mutex;
+
+    {
+        QMutexLocker lock(&mutex);
+        if (m_blDisplayList)
+        {
+            return m_blDisplayList;
+        }
+    }
+
+    // Display list is created outside of the lock, if two threads are
+    // creating it simultaneously, the first one wins.
+    std::shared_ptr<PDFBLDisplayList> displayList = std::make_shared<PDFBLDisplayList>();
+
+    for (const PathPaintData& data : m_paths)
+    {
+        displayList->addPath(getPen(data), getBrush(data), getPath(data));
+    }
+
+    for (const ImageData& data : m_images)
+    {
+        displayList->addImage(data.image);
+    }
+
+    QMutexLocker lock(&mutex);
+    if (!m_blDisplayList)
+    {
+        m_blDisplayList = std::move(displayList);
+    }
+
+    return m_blDisplayList;
+}
+
+void PDFPrecompiledPage::createBLDisplayList()
+{
+    if (m_blDisplayList)
+    {
+        // Display list was already created and counted
+        return;
+    }
+
+    m_memoryConsumptionEstimate += getBLDisplayList()->getMemoryConsumptionEstimate();
+
+    // Shared instanced pages are counted only once, in the same way as in finalize
+    std::set<const PDFPrecompiledPage*> instancedPages;
+    for (const InstanceData& data : m_instances)
+    {
+        if (instancedPages.insert(data.precompiledPage.get()).second)
+        {
+            m_memoryConsumptionEstimate += data.precompiledPage->getBLDisplayList()->getMemoryConsumptionEstimate();
+        }
+    }
+}
+
+PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
+                                                                                     PDFReal epsilon) const
+{
+    GraphicPieceInfos infos;
 
     // Check, if epsilon is not too small
     if (qFuzzyIsNull(epsilon))
@@ -810,6 +2452,23 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
     }
     PDFReal factor = 1.0 / epsilon;
 
+    calculateGraphicPieceInfos(mediaBox, factor, QTransform(), infos);
+    return infos;
+}
+
+void PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
+                                                    PDFReal factor,
+                                                    const QTransform& instanceMatrix,
+                                                    GraphicPieceInfos& infos) const
+{
+    struct State
+    {
+        QTransform matrix;
+    };
+    std::stack<State> stateStack;
+    stateStack.emplace();
+    stateStack.top().matrix = instanceMatrix;
+
     QImage shadingTestImage;
 
     // Process all instructions
@@ -821,46 +2480,62 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
             {
                 const PathPaintData& data = m_paths[instruction.dataIndex];
 
-                GraphicPieceInfo info;
-                QByteArray serializedPath;
-
-                // Serialize data
-                if (true)
+                auto addPathInfo = [&](const QPainterPath& path)
                 {
-                    QDataStream stream(&serializedPath, QIODevice::WriteOnly);
+                    GraphicPieceInfo info;
+                    QByteArray serializedPath;
 
-                    stream << data.isText;
-                    stream << data.pen;
-                    stream << data.brush;
+                    // Serialize data
+                    if (true)
+                    {
+                        QDataStream stream(&serializedPath, QIODevice::WriteOnly);
 
-                    // Translate map to page coordinates
-                    QPainterPath pagePath = stateStack.top().matrix.map(data.path);
+                        stream << data.isText;
+                        stream << getPen(data);
+                        stream << getBrush(data);
 
-                    info.type = data.isText ? GraphicPieceInfo::Type::Text : GraphicPieceInfo::Type::VectorGraphics;
-                    info.boundingRect = pagePath.controlPointRect();
-                    info.pagePath = pagePath;
+                        // Translate map to page coordinates
+                        QPainterPath pagePath = stateStack.top().matrix.map(path);
 
-                    const int elementCount = pagePath.elementCount();
-                    for (int i = 0; i < elementCount; ++i)
-                    {
-                        QPainterPath::Element element = pagePath.elementAt(i);
+                        info.type = data.isText ? GraphicPieceInfo::Type::Text : GraphicPieceInfo::Type::VectorGraphics;
+                        info.boundingRect = pagePath.controlPointRect();
+                        info.pagePath = pagePath;
 
-                        PDFReal roundedX = qFloor(element.x * factor);
-                        PDFReal roundedY = qFloor(element.y * factor);
+                        const int elementCount = pagePath.elementCount();
+                        for (int i = 0; i < elementCount; ++i)
+                        {
+                            QPainterPath::Element element = pagePath.elementAt(i);
 
-                        stream << roundedX;
-                        stream << roundedY;
-                        stream << element.type;
+                            PDFReal roundedX = qFloor(element.x * factor);
+                            PDFReal roundedY = qFloor(element.y * factor);
+
+                            stream << roundedX;
+                            stream << roundedY;
+                            stream << element.type;
+                        }
                     }
-                }
 
-                QByteArray hash = QCryptographicHash::hash(serializedPath, QCryptographicHash::Sha512);
-                Q_ASSERT(QCryptographicHash::hashLength(QCryptographicHash::Sha512) == 64);
+                    QByteArray hash = QCryptographicHash::hash(serializedPath, QCryptographicHash::Sha512);
+                    Q_ASSERT(QCryptographicHash::hashLength(QCryptographicHash::Sha512) == 64);
 
-                size_t size = qMin<size_t>(hash.length(), info.hash.size());
-                std::copy(hash.data(), hash.data() + size, info.hash.data());
+                    size_t size = qMin<size_t>(hash.length(), info.hash.size());
+                    std::copy(hash.data(), hash.data() + size, info.hash.data());
 
-                infos.emplace_back(std::move(info));
+                    infos.emplace_back(std::move(info));
+                };
+
+                if (data.textRunCount > 0)
+                {
+                    // Text runs are split into individual glyphs
+                    for (size_t i = data.textRunStart; i < data.textRunStart + data.textRunCount; ++i)
+                    {
+                        addPathInfo(getTextRunGlyphPath(data, m_textRunGlyphs[i]));
+                    }
+                }
+                else
+                {
+                    addPathInfo(getPath(data));
+                }
                 break;
             }
 
@@ -924,9 +2599,8 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
             }
 
             case InstructionType::DrawMesh:
+            case InstructionType::DrawShading:
             {
-                const MeshPaintData& data = m_meshes[instruction.dataIndex];
-
                 if (shadingTestImage.isNull())
                 {
                     QSizeF mediaBoxSize = mediaBox.size();
@@ -939,11 +2613,22 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
 
                 QTransform pagePointToDevicePointMatrix;
                 pagePointToDevicePointMatrix.scale(shadingTestImage.width() / mediaBox.width(), -shadingTestImage.height() / mediaBox.height());
+                pagePointToDevicePointMatrix = instanceMatrix * pagePointToDevicePointMatrix;
 
                 {
                     QPainter painter(&shadingTestImage);
                     painter.setWorldTransform(pagePointToDevicePointMatrix);
-                    data.mesh.paint(&painter, data.alpha);
+
+                    if (instruction.type == InstructionType::DrawMesh)
+                    {
+                        const MeshPaintData& data = m_meshes[instruction.dataIndex];
+                        data.mesh.paint(&painter, data.alpha);
+                    }
+                    else
+                    {
+                        const ShadingPaintData& data = m_shadings[instruction.dataIndex];
+                        data.rasterizer.draw(&painter, pagePointToDevicePointMatrix, data.path, data.alpha);
+                    }
                 }
 
                 GraphicPieceInfo info;
@@ -990,7 +2675,7 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
 
             case InstructionType::SetWorldMatrix:
             {
-                stateStack.top().matrix = m_matrices[instruction.dataIndex];
+                stateStack.top().matrix = m_matrices[instruction.dataIndex] * instanceMatrix;
                 break;
             }
 
@@ -1000,6 +2685,32 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
                 break;
             }
 
+            case InstructionType::DrawInstance:
+            {
+                const InstanceData& data = m_instances[instruction.dataIndex];
+                data.precompiledPage->calculateGraphicPieceInfos(mediaBox, factor, data.matrix * instanceMatrix, infos);
+                break;
+            }
+
+            case InstructionType::DrawTilingPattern:
+            {
+                // Collect information about each pattern cell, as if cells were drawn one by one
+                const TilingPatternPaintData& data = m_tilingPatterns[instruction.dataIndex];
+                const QTransform patternMatrix = data.patternMatrix * instanceMatrix;
+                const PDFInteger columns = qMax<PDFInteger>(qCeil(data.tilingArea.width() / data.xStep), 1);
+                const PDFInteger rows = qMax<PDFInteger>(qCeil(data.tilingArea.height() / data.yStep), 1);
+
+                for (PDFInteger column = 0; column < columns; ++column)
+                {
+                    for (PDFInteger row = 0; row < rows; ++row)
+                    {
+                        const QTransform cellMatrix = QTransform::fromTranslate(data.tilingArea.left() + column * data.xStep, data.tilingArea.top() + row * data.yStep) * patternMatrix;
+                        data.cell->calculateGraphicPieceInfos(mediaBox, factor, cellMatrix, infos);
+                    }
+                }
+                break;
+            }
+
             default:
             {
                 Q_ASSERT(false);
@@ -1007,8 +2718,6 @@ PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceI
             }
         }
     }
-
-    return infos;
 }
 
 }   // namespace pdf
@@ -25,10 +25,16 @@
 #include "pdftextlayout.h"
 #include "pdfcolorconvertor.h"
 #include "pdfsnapper.h"
+#include "pdfblpainter.h"
 
 #include <QPen>
 #include <QBrush>
 #include <QElapsedTimer>
+#include <QCache>
+#include <QMutex>
+
+#include <map>
+#include <functional>
 
 namespace pdf
 {
@@ -76,6 +82,9 @@ protected:
     /// Returns, if feature is turned on
     bool hasFeature(PDFRenderer::Feature feature) const { return m_features.testFlag(feature); }
 
+    /// Returns renderer features
+    PDFRenderer::Features getFeatures() const { return m_features; }
+
     /// Is transparency group active?
     bool isTransparencyGroupActive() const { return !m_transparencyGroupDataStack.empty(); }
 
@@ -135,6 +144,11 @@ protected:
     virtual void performClipping(const QPainterPath& path, Qt::FillRule fillRule) override;
     virtual void performImagePainting(const QImage& image) override;
     virtual void performMeshPainting(const PDFMesh& mesh) override;
+    virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern) override;
+    virtual bool performPathPaintingUsingTilingPattern(const QPainterPath& path,
+                                                       const PDFTilingPattern* tilingPattern,
+                                                       const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                       const PDFColor& uncoloredPatternColor) override;
     virtual void performSaveGraphicState(ProcessOrder order) override;
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
@@ -163,11 +177,14 @@ public:
         DrawPath,
         DrawImage,
         DrawMesh,
+        DrawShading,
         Clip,
         SaveGraphicState,
         RestoreGraphicState,
         SetWorldMatrix,
-        SetCompositionMode
+        SetCompositionMode,
+        DrawInstance,
+        DrawTilingPattern
     };
 
     struct Instruction
@@ -184,6 +201,19 @@ public:
         size_t dataIndex = 0;
     };
 
+    /// Data needed to mesh the shading, when page is drawn onto non-raster
+    /// device (printer, pdf writer, ...). Document and color management system
+    /// must outlive the page.
+    struct ShadingMeshData
+    {
+        PDFColorSpacePointer patternColorSpace; ///< Pattern color space holding the shading pattern
+        PDFMeshQualitySettings settings;
+        const PDFDocument* document = nullptr;
+        const PDFCMS* cms = nullptr;
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+        std::vector<PDFColorConvertor> colorConvertors; ///< Color conversions applied to the page
+    };
+
     /// Paints page onto the painter using matrix
     /// \param painter Painter, onto which is page drawn
     /// \param cropBox Page's crop box
@@ -203,14 +233,43 @@ public:
     void redact(QPainterPath redactPath, const QTransform& matrix, QColor color);
 
     void addPath(QPen pen, QBrush brush, QPainterPath path, bool isText);
+    void addGlyphPath(QPen pen, QBrush brush, QPainterPath path, QPainterPath glyphPath, QTransform glyphMatrix);
     void addClip(QPainterPath path);
     void addImage(QImage image);
     void addMesh(PDFMesh mesh, PDFReal alpha);
+    void addShading(PDFShadingRasterizer rasterizer, ShadingMeshData meshData, QPainterPath path, PDFReal alpha);
     void addSaveGraphicState() { m_instructions.emplace_back(InstructionType::SaveGraphicState, 0); }
     void addRestoreGraphicState() { m_instructions.emplace_back(InstructionType::RestoreGraphicState, 0); }
     void addSetWorldMatrix(const QTransform& matrix);
     void addSetCompositionMode(QPainter::CompositionMode compositionMode);
 
+    /// Adds instance of another precompiled page (for example, form XObject, which
+    /// is painted several times). Instanced page is shared, it is not copied.
+    /// \param precompiledPage Instanced page
+    /// \param matrix Matrix mapping instanced page coordinates to this page coordinates
+    void addInstance(std::shared_ptr<const PDFPrecompiledPage> precompiledPage, const QTransform& matrix);
+
+    /// Adds fill of the path using tiling pattern. Pattern cell is shared, it is not copied.
+    /// \param cell Precompiled pattern cell (in pattern space, clipped by the bounding box)
+    /// \param patternMatrix Matrix mapping pattern space to this page coordinates
+    /// \param boundingBox Bounding box of the pattern cell in pattern space
+    /// \param tilingArea Area in pattern space, which is covered by the cells
+    /// \param xStep Horizontal spacing of the cells
+    /// \param yStep Vertical spacing of the cells
+    /// \param path Filled path in this page coordinates
+    void addTilingPattern(std::shared_ptr<const PDFPrecompiledPage> cell,
+                          const QTransform& patternMatrix,
+                          const QRectF& boundingBox,
+                          const QRectF& tilingArea,
+                          PDFReal xStep,
+                          PDFReal yStep,
+                          QPainterPath path);
+
+    /// Returns true, if page content can be painted as an instance with arbitrary
+    /// transformation matrix. Meshes and shadings are created for given page
+    /// area, so content containing them can't be instanced.
+    bool isInstanceable() const { return m_meshes.empty() && m_shadings.empty(); }
+
     /// Optimizes page memory allocation to contain less space
     void optimize();
 
@@ -290,25 +349,167 @@ public:
     GraphicPieceInfos calculateGraphicPieceInfos(QRectF mediaBox,
                                                  PDFReal epsilon) const;
 
+    /// Returns Blend2D native display list of this page. Display list
+    /// is created on demand, when page is first drawn using the Blend2D
+    /// paint engine (or in advance, see \p createBLDisplayList), and then
+    /// it is reused for subsequent draws.
+    std::shared_ptr<const PDFBLDisplayList> getBLDisplayList() const;
+
+    /// Invalidates Blend2D native display list (page content was changed)
+    void invalidateBLDisplayList() { m_blDisplayList.reset(); }
+
+    /// Creates Blend2D native display list of this page and of instanced pages
+    /// in advance and adds it to the memory consumption estimate. Call it after
+    /// the page is finalized, if page will be drawn using the Blend2D paint engine.
+    void createBLDisplayList();
+
 private:
+    /// Paints page instructions onto the painter, painter must be initialized
+    /// \param painter Painter, onto which is page drawn
+    /// \param pagePointToDevicePointMatrix Page point to device point transformation matrix
+    /// \param features Renderer features
+    void drawInstructions(QPainter* painter,
+                          const QTransform& pagePointToDevicePointMatrix,
+                          PDFRenderer::Features features) const;
+
+    /// Creates information about piece of graphic in this page, page
+    /// can be instanced in another page using given matrix.
+    /// \param mediaBox Page's media box
+    /// \param factor Inverse of epsilon
+    /// \param instanceMatrix Matrix mapping this page to the target page
+    /// \param infos Graphic piece infos
+    void calculateGraphicPieceInfos(QRectF mediaBox,
+                                    PDFReal factor,
+                                    const QTransform& instanceMatrix,
+                                    GraphicPieceInfos& infos) const;
+
+    static constexpr size_t INVALID_GLYPH_INDEX = std::numeric_limits<size_t>::max();
+
+    /// Maximal number of glyphs merged into one text run
+    static constexpr quint32 MAX_TEXT_RUN_GLYPHS = 64;
+
+    /// Number of most recently inserted palette items searched for a match
+    static constexpr size_t PALETTE_SEARCH_WINDOW = 16;
+
+    /// Path paint data are stored in compact form. Pens and brushes are stored
+    /// in the per-page palette and referenced by index, path elements are stored
+    /// in the flat buffers shared by all paths of the page.
     struct PathPaintData
     {
-        inline PathPaintData() = default;
-        inline PathPaintData(QPen pen, QBrush brush, QPainterPath path, bool isText) :
-            pen(qMove(pen)),
-            brush(qMove(brush)),
-            path(qMove(path)),
-            isText(isText)
-        {
-
-        }
+        quint32 penIndex = 0;           ///< Index of the pen in the pen palette
+        quint32 brushIndex = 0;         ///< Index of the brush in the brush palette
+        quint32 elementStart = 0;       ///< Index of the first path element in flat path buffers
+        quint32 elementCount = 0;       ///< Number of path elements
+        quint32 textRunStart = 0;       ///< Index of the first glyph of the text run
+        quint32 textRunCount = 0;       ///< Number of glyphs in the text run (zero, if path is not a text run)
+        Qt::FillRule fillRule = Qt::OddEvenFill;
+        bool isText = false;
+    };
 
+    struct PenPaletteItem
+    {
         QPen pen;
+        bool isText = false;
+    };
+
+    struct BrushPaletteItem
+    {
         QBrush brush;
-        QPainterPath path;
         bool isText = false;
     };
 
+    /// Single glyph of the text run. Consecutive filled (not stroked) text glyphs
+    /// with the same brush are merged into one path (text run), but information
+    /// about individual glyphs is kept.
+    struct TextRunGlyph
+    {
+        QRectF boundingRect;                        ///< Bounding rectangle of the glyph in user space
+        int elementStart = 0;                       ///< Index of the first element of the glyph in text run path
+        int elementCount = 0;                       ///< Number of elements of the glyph in text run path
+        size_t glyphIndex = INVALID_GLYPH_INDEX;    ///< Index of glyph data (for glyph raster cache)
+    };
+
+    struct GlyphData
+    {
+        inline GlyphData() = default;
+        inline GlyphData(QPainterPath glyphPath, QTransform glyphMatrix, size_t hash) :
+            glyphPath(qMove(glyphPath)),
+            glyphMatrix(glyphMatrix),
+            hash(hash)
+        {
+
+        }
+
+        QPainterPath glyphPath; ///< Glyph outline in the glyph space
+        QTransform glyphMatrix; ///< Matrix mapping glyph space to the user space
+        size_t hash = 0;        ///< Hash of the glyph outline
+    };
+
+    /// Adds text glyph path, glyph is merged to the previous text run, if possible
+    void addTextPath(QPen pen, QBrush brush, QPainterPath path, size_t glyphIndex);
+
+    /// Returns true, if glyph can be appended to the text run
+    bool canAppendToTextRun(const PathPaintData& run, quint32 penIndex, quint32 brushIndex, const QPainterPath& path, const QRectF& boundingRect) const;
+
+    /// Returns path of a single glyph of the text run
+    QPainterPath getTextRunGlyphPath(const PathPaintData& data, const TextRunGlyph& glyph) const;
+
+    /// Returns index of the pen in the pen palette (pen is inserted, if it is not found)
+    quint32 getPenIndex(QPen pen, bool isText);
+
+    /// Returns index of the brush in the brush palette (brush is inserted, if it is not found)
+    quint32 getBrushIndex(QBrush brush, bool isText);
+
+    /// Stores path elements into the flat path buffers, returns index of the first element
+    quint32 storePath(const QPainterPath& path);
+
+    /// Loads path elements from flat path buffers into the path
+    /// \param elementStart Index of the first element
+    /// \param elementCount Element count
+    /// \param fillRule Fill rule
+    /// \param path Target path (it is cleared first)
+    void loadPath(quint32 elementStart, quint32 elementCount, Qt::FillRule fillRule, QPainterPath& path) const;
+
+    /// Returns path of the path paint data
+    QPainterPath getPath(const PathPaintData& data) const;
+
+    const QPen& getPen(const PathPaintData& data) const { return m_pens[data.penIndex].pen; }
+    const QBrush& getBrush(const PathPaintData& data) const { return m_brushes[data.brushIndex].brush; }
+
+    /// Tries to draw text run using glyph raster cache. Returns true,
+    /// if text run was drawn, false otherwise (text run must be drawn as a path).
+    /// \param painter Painter
+    /// \param data Path data of the text run
+    /// \param antialiasing Use antialiasing
+    bool drawTextRunUsingRasterCache(QPainter* painter, const PathPaintData& data, bool antialiasing) const;
+
+    struct TilingPatternPaintData;
+
+    /// Tries to fill the path by tiling pattern using image tile from the tiling
+    /// pattern raster cache. Returns true, if path was filled, false otherwise
+    /// (pattern cells must be drawn one by one).
+    /// \param painter Painter
+    /// \param data Tiling pattern data
+    /// \param pagePointToDevicePointMatrix Page point to device point transformation matrix
+    /// \param features Renderer features
+    bool drawTilingPatternUsingRasterCache(QPainter* painter,
+                                           const TilingPatternPaintData& data,
+                                           const QTransform& pagePointToDevicePointMatrix,
+                                           PDFRenderer::Features features) const;
+
+    /// Fills the path by tiling pattern, each pattern cell is drawn as vector graphics
+    /// \param painter Painter
+    /// \param data Tiling pattern data
+    /// \param pagePointToDevicePointMatrix Page point to device point transformation matrix
+    /// \param features Renderer features
+    void drawTilingPatternCells(QPainter* painter,
+                                const TilingPatternPaintData& data,
+                                const QTransform& pagePointToDevicePointMatrix,
+                                PDFRenderer::Features features) const;
+
+    /// Returns new unique identifier of the pattern cell content
+    static quint64 createTilingPatternCellId();
+
     struct ClipData
     {
         inline ClipData() = default;
@@ -331,8 +532,28 @@ private:
         }
 
         QImage image;
+
+        /// Mipmap chain of the image (each level has half size of the previous
+        /// level, first level is half of the image). It is created on first use.
+        mutable std::shared_ptr<const std::vector<QImage>> mipmaps;
     };
 
+    /// Minimal size of the mipmap level of the image
+    static constexpr int MIPMAP_MIN_SIZE = 128;
+
+    /// Returns true, if mipmap chain should be created for the image
+    static bool isMipmapped(const QImage& image);
+
+    /// Returns memory consumption estimate of mipmap chain of the image
+    static qint64 getMipmapMemoryConsumptionEstimate(const QImage& image);
+
+    /// Returns the smallest level of mipmap chain of the image, which is still
+    /// at least as large as the image mapped by the world transform. If no
+    /// mipmap level is suitable, original image is returned.
+    /// \param data Image data
+    /// \param worldTransform Transform mapping unit square to the device
+    QImage getImageMipmap(const ImageData& data, const QTransform& worldTransform) const;
+
     struct MeshPaintData
     {
         inline MeshPaintData() = default;
@@ -347,19 +568,76 @@ private:
         PDFReal alpha = 1.0;
     };
 
+    struct ShadingPaintData
+    {
+        inline ShadingPaintData() = default;
+        inline ShadingPaintData(PDFShadingRasterizer rasterizer, ShadingMeshData meshData, QPainterPath path, PDFReal alpha) :
+            rasterizer(qMove(rasterizer)),
+            meshData(qMove(meshData)),
+            path(qMove(path)),
+            alpha(alpha)
+        {
+
+        }
+
+        /// Creates mesh of the shading for non-raster devices
+        PDFMesh createMesh() const;
+
+        PDFShadingRasterizer rasterizer; ///< Rasterizer used for raster devices
+        ShadingMeshData meshData; ///< Data for meshing on other devices (printers, pdf writers, ...)
+        QPainterPath path; ///< Shaded area in device space
+        PDFReal alpha = 1.0;
+    };
+
+    struct InstanceData
+    {
+        inline InstanceData() = default;
+        inline InstanceData(std::shared_ptr<const PDFPrecompiledPage> precompiledPage, QTransform matrix) :
+            precompiledPage(qMove(precompiledPage)),
+            matrix(matrix)
+        {
+
+        }
+
+        std::shared_ptr<const PDFPrecompiledPage> precompiledPage;
+        QTransform matrix; ///< Maps instanced page coordinates to this page coordinates
+    };
+
+    struct TilingPatternPaintData
+    {
+        std::shared_ptr<const PDFPrecompiledPage> cell;
+        quint64 cellId = 0;         ///< Unique identifier of the cell content (key to the raster cache)
+        QTransform patternMatrix;   ///< Maps pattern space to this page coordinates
+        QRectF boundingBox;         ///< Bounding box of the cell in pattern space
+        QRectF tilingArea;          ///< Area in pattern space, which is covered by the cells
+        PDFReal xStep = 0.0;
+        PDFReal yStep = 0.0;
+        QPainterPath path;          ///< Filled area in this page coordinates
+    };
+
     qint64 m_compilingTimeNS = 0;
     qint64 m_memoryConsumptionEstimate = 0;
     QColor m_paperColor = QColor(Qt::white);
     std::vector<Instruction> m_instructions;
     std::vector<PathPaintData> m_paths;
+    std::vector<PenPaletteItem> m_pens;
+    std::vector<BrushPaletteItem> m_brushes;
+    std::vector<float> m_pathCoordinates;
+    std::vector<quint8> m_pathElementTypes;
+    std::vector<GlyphData> m_glyphs;
+    std::vector<TextRunGlyph> m_textRunGlyphs;
     std::vector<ClipData> m_clips;
     std::vector<ImageData> m_images;
     std::vector<MeshPaintData> m_meshes;
+    std::vector<ShadingPaintData> m_shadings;
     std::vector<QTransform> m_matrices;
     std::vector<QPainter::CompositionMode> m_compositionModes;
+    std::vector<InstanceData> m_instances;
+    std::vector<TilingPatternPaintData> m_tilingPatterns;
     QList<PDFRenderError> m_errors;
     PDFSnapInfo m_snapInfo;
     QElapsedTimer m_expirationTimer;
+    mutable std::shared_ptr<const PDFBLDisplayList> m_blDisplayList;
 };
 
 /// Processor, which processes PDF's page commands and writes them to the precompiled page.
@@ -383,15 +661,231 @@ protected:
     virtual void performClipping(const QPainterPath& path, Qt::FillRule fillRule) override;
     virtual void performImagePainting(const QImage& image) override;
     virtual void performMeshPainting(const PDFMesh& mesh) override;
+    virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern) override;
     virtual void performSaveGraphicState(ProcessOrder order) override;
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
     virtual void setCompositionMode(QPainter::CompositionMode mode) override;
+    virtual bool performFormInstancePainting(PDFObjectReference formReference, const PDFStream* stream) override;
+    virtual bool performType3GlyphInstancePainting(const PDFFontPointer& font, const QByteArray* glyphContentStream) override;
 
 private:
+    /// Returns true, if form instance can be painted in current graphic
+    /// state (only current transformation matrix can differ).
+    /// \param formState Graphic state, in which form was processed
+    /// \param hasImages Form contains images
+    /// \param formImageDeviceScale Image device scale, for which images in the form were decoded
+    /// \param imageDeviceScale Image device scale required by current transformation matrix
+    bool isFormInstanceCompatible(const PDFPageContentProcessorState& formState,
+                                  bool hasImages,
+                                  PDFReal formImageDeviceScale,
+                                  PDFReal imageDeviceScale) const;
+
+    /// Tiling pattern cell processed in the pattern space
+    struct TilingPatternCell
+    {
+        PDFPageContentProcessorState graphicState;              ///< Graphic state, in which cell was processed
+        PDFColorSpacePointer uncoloredPatternColorSpace;        ///< Color space of uncolored pattern
+        PDFColor uncoloredPatternColor;                         ///< Color of uncolored pattern
+        PDFReal imageDeviceScale = 0.0;                         ///< Image device scale, for which images were decoded
+        bool hasImages = false;                                 ///< Cell contains images
+        std::shared_ptr<PDFPrecompiledPage> precompiledCell;    ///< Processed cell (nullptr, if cell can't be reused)
+    };
+
+    /// Returns true, if tiling pattern cell can be painted in current graphic state
+    /// \param cell Tiling pattern cell
+    /// \param uncoloredPatternColorSpace Color space of uncolored pattern
+    /// \param uncoloredPatternColor Color of uncolored pattern
+    /// \param imageDeviceScale Image device scale required by current pattern matrix
+    bool isTilingPatternCellCompatible(const TilingPatternCell& cell,
+                                       const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                       const PDFColor& uncoloredPatternColor,
+                                       PDFReal imageDeviceScale) const;
+
+    /// Returns true, if Type 3 glyph instance processed in graphic state \p glyphState
+    /// can be painted in current graphic state (only current transformation matrix
+    /// and text parameters can differ). Color spaces are compared by value, because
+    /// glyph instances are shared between pages.
+    /// \param glyphState Graphic state, in which glyph was processed
+    /// \param hasImages Glyph contains images
+    /// \param glyphImageDeviceScale Image device scale, for which images were decoded
+    /// \param imageDeviceScale Image device scale required by current transformation matrix
+    bool isType3GlyphInstanceCompatible(const PDFPageContentProcessorState& glyphState,
+                                        bool hasImages,
+                                        PDFReal glyphImageDeviceScale,
+                                        PDFReal imageDeviceScale) const;
+
+    /// Returns true, if graphic state parameters inherited by the form or the pattern
+    /// cell are the same (colors are not compared).
+    /// \param state1 First graphic state
+    /// \param state2 Second graphic state
+    static bool isInheritedGraphicStateEqual(const PDFPageContentProcessorState& state1, const PDFPageContentProcessorState& state2);
+
+    /// Returns true, if graphic state parameters affecting the painting of paths
+    /// and images are the same (colors and text parameters are not compared).
+    /// \param state1 First graphic state
+    /// \param state2 Second graphic state
+    static bool isInheritedPaintingStateEqual(const PDFPageContentProcessorState& state1, const PDFPageContentProcessorState& state2);
+
+    /// Returns image device scale for content, which is processed in its own
+    /// coordinate system and then painted using given matrix.
+    /// \param matrix Matrix mapping content to the page
+    PDFReal getContentImageDeviceScale(const QTransform& matrix) const;
+
+    /// Maximal number of cells of one tiling pattern processed in different graphic states
+    static constexpr size_t MAX_TILING_PATTERN_CELLS = 4;
+
     PDFPrecompiledPage* m_precompiledPage;
+    QByteArray m_optionalContentState;
+    std::map<PDFObjectReference, std::vector<TilingPatternCell>> m_tilingPatternCells;
+};
+
+/// Cache of form XObjects processed in their own coordinate system. Forms (for example,
+/// title blocks, stamps or watermarks) are often painted on every page of the document,
+/// so they are processed only once and shared between pages and compilations. Form is
+/// keyed by document, form reference, color management system, renderer features and
+/// state of the optional content, for each key, several instances processed in different
+/// graphic states can exist.
+class PDF4QTLIBCORESHARED_EXPORT PDFFormInstanceCache
+{
+public:
+    static PDFFormInstanceCache* getInstance();
+
+    /// Maximal number of instances of one form processed in different graphic states
+    static constexpr size_t MAX_FORM_INSTANCES = 4;
+
+    /// Maximal memory used by form instances
+    static constexpr qsizetype CACHE_LIMIT = 64 * 1024 * 1024;
+
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+        PDFObjectReference formReference;
+        quint64 cmsId = 0;
+        int features = 0;
+        QByteArray optionalContentState;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, formReference, cmsId, features, optionalContentState) == std::tie(other.document, other.formReference, other.cmsId, other.features, other.optionalContentState);
+        }
+    };
+
+    struct FormInstance
+    {
+        PDFPageContentProcessorState graphicState;  ///< Graphic state, in which form was processed
+        PDFReal imageDeviceScale = 0.0;             ///< Image device scale, for which images were decoded
+        bool hasImages = false;                     ///< Form contains images
+        std::shared_ptr<const PDFPrecompiledPage> precompiledForm; ///< Processed form (nullptr, if form can't be instanced)
+    };
+
+    using FormInstances = std::vector<FormInstance>;
+    using IsCompatibleFunction = std::function<bool(const FormInstance&)>;
+
+    /// Returns instances of the form processed in different graphic states
+    /// \param key Key
+    FormInstances getFormInstances(const Key& key);
+
+    /// Adds instance of the form. If compatible instance was added in the meantime
+    /// by another thread, then new instance is not added and the compatible one is
+    /// returned instead. If form has already too many instances, then nothing is
+    /// added and new instance is returned.
+    /// \param key Key
+    /// \param formInstance Form instance
+    /// \param isCompatible Returns true, if instance can be used instead of the new one
+    std::shared_ptr<const PDFPrecompiledPage> addFormInstance(const Key& key,
+                                                              FormInstance formInstance,
+                                                              const IsCompatibleFunction& isCompatible);
+
+    /// Removes all form instances of given document
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+private:
+    explicit PDFFormInstanceCache();
+
+    QMutex m_mutex;
+    QCache<Key, FormInstances> m_cache;
 };
 
+inline size_t qHash(const PDFFormInstanceCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.document, key.formReference.objectNumber, key.formReference.generation, key.cmsId, key.features, key.optionalContentState);
+}
+
+/// Cache of Type 3 font glyphs processed in the glyph space. Documents using
+/// bitmap fonts (for example, TeX or OCR output) paint all text using Type 3 fonts,
+/// so the same glyph is painted many times on many pages. Glyphs are processed only
+/// once and shared between pages and compilations. Glyph is keyed by document, font,
+/// glyph content stream, color management system and renderer features, for each key,
+/// several instances processed in different graphic states can exist.
+class PDF4QTLIBCORESHARED_EXPORT PDFType3GlyphInstanceCache
+{
+public:
+    static PDFType3GlyphInstanceCache* getInstance();
+
+    /// Maximal number of instances of one glyph processed in different graphic states
+    static constexpr size_t MAX_GLYPH_INSTANCES = 4;
+
+    /// Maximal memory used by glyph instances
+    static constexpr qsizetype CACHE_LIMIT = 32 * 1024 * 1024;
+
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+        PDFFontPointer font;
+        const QByteArray* glyphContentStream = nullptr;
+        quint64 cmsId = 0;
+        int features = 0;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, font, glyphContentStream, cmsId, features) == std::tie(other.document, other.font, other.glyphContentStream, other.cmsId, other.features);
+        }
+    };
+
+    struct GlyphInstance
+    {
+        PDFPageContentProcessorState graphicState;  ///< Graphic state, in which glyph was processed
+        PDFReal imageDeviceScale = 0.0;             ///< Image device scale, for which images were decoded
+        bool hasImages = false;                     ///< Glyph contains images
+        std::shared_ptr<const PDFPrecompiledPage> precompiledGlyph; ///< Processed glyph (nullptr, if glyph can't be instanced)
+    };
+
+    using GlyphInstances = std::vector<GlyphInstance>;
+    using IsCompatibleFunction = std::function<bool(const GlyphInstance&)>;
+
+    /// Returns instances of the glyph processed in different graphic states
+    /// \param key Key
+    GlyphInstances getGlyphInstances(const Key& key);
+
+    /// Adds instance of the glyph. If compatible instance was added in the meantime
+    /// by another thread, then new instance is not added and the compatible one is
+    /// returned instead. If glyph has already too many instances, then nothing is
+    /// added and new instance is returned.
+    /// \param key Key
+    /// \param glyphInstance Glyph instance
+    /// \param isCompatible Returns true, if instance can be used instead of the new one
+    std::shared_ptr<const PDFPrecompiledPage> addGlyphInstance(const Key& key,
+                                                               GlyphInstance glyphInstance,
+                                                               const IsCompatibleFunction& isCompatible);
+
+    /// Removes all glyph instances of given document
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+private:
+    explicit PDFType3GlyphInstanceCache();
+
+    QMutex m_mutex;
+    QCache<Key, GlyphInstances> m_cache;
+};
+
+inline size_t qHash(const PDFType3GlyphInstanceCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.document, key.font.get(), key.glyphContentStream, key.cmsId, key.features);
+}
+
 }   // namespace pdf
 
 #endif // PDFPAINTER_H
@@ -23,6 +23,7 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfconstants.h"
 #include "pdfpainterutils.h"
+#include "pdfcms.h"
 
 #include <QMutex>
 #include <QPainter>
@@ -124,6 +125,7 @@ PDFPatternPtr PDFPattern::createPattern(const PDFDictionary* colorSpaceDictionar
                 }
 
                 PDFTilingPattern* pattern = new PDFTilingPattern();
+                pattern->m_patternReference = object.isReference() ? object.getReference() : PDFObjectReference();
                 pattern->m_boundingBox = boundingBox;
                 pattern->m_matrix = matrix;
                 pattern->m_paintType = paintType;
@@ -229,14 +231,15 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
         functions.reserve(functionsArray->getCount());
         for (size_t i = 0, functionCount = functionsArray->getCount(); i < functionCount; ++i)
         {
-            functions.push_back(PDFFunction::createFunction(document, functionsArray->getItem(i)));
+            functions.push_back(PDFFunction::createOptimizedFunction(PDFFunction::createFunction(document, functionsArray->getItem(i))));
         }
     }
     else if (!functionsObject.isNull())
     {
-        functions.push_back(PDFFunction::createFunction(document, functionsObject));
+        functions.push_back(PDFFunction::createOptimizedFunction(PDFFunction::createFunction(document, functionsObject)));
     }
 
+    const PDFObjectReference shadingReference = shadingObject.isReference() ? shadingObject.getReference() : PDFObjectReference();
     const ShadingType shadingType = static_cast<ShadingType>(loader.readIntegerFromDictionary(shadingDictionary, "ShadingType", static_cast<PDFInteger>(ShadingType::Invalid)));
     switch (shadingType)
     {
@@ -274,6 +277,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             functionShading->m_functions = qMove(functions);
             functionShading->m_matrix = matrix;
             functionShading->m_patternGraphicState = patternGraphicState;
+            functionShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -320,6 +324,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             axialShading->m_functions = qMove(functions);
             axialShading->m_matrix = matrix;
             axialShading->m_patternGraphicState = patternGraphicState;
+            axialShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -373,6 +378,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             radialShading->m_functions = qMove(functions);
             radialShading->m_matrix = matrix;
             radialShading->m_patternGraphicState = patternGraphicState;
+            radialShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -455,6 +461,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             type4567Shading->m_colorSpace = colorSpace;
             type4567Shading->m_matrix = matrix;
             type4567Shading->m_patternGraphicState = patternGraphicState;
+            type4567Shading->m_shadingReference = shadingReference;
             type4567Shading->m_bitsPerCoordinate = static_cast<uint8_t>(bitsPerCoordinate);
             type4567Shading->m_bitsPerComponent = static_cast<uint8_t>(bitsPerComponent);
             type4567Shading->m_xmin = decode[0];
@@ -1421,6 +1428,421 @@ void PDFMesh::convertColors(const PDFColorConvertor& colorConvertor)
     m_backgroundColor = colorConvertor.convert(m_backgroundColor, true, false);
 }
 
+inline size_t qHash(const PDFShadingMeshCache::Key& key, size_t seed = 0)
+{
+    seed = qHashMulti(seed, key.document, key.reference.objectNumber, key.reference.generation, key.colorSpace, key.patchTestPoints, key.backgroundColor, key.cmsId, int(key.renderingIntent));
+    seed = qHashRange(key.matrix.cbegin(), key.matrix.cend(), seed);
+    seed = qHashRange(key.meshingAreaSize.cbegin(), key.meshingAreaSize.cend(), seed);
+    return qHashRange(key.settings.cbegin(), key.settings.cend(), seed);
+}
+
+PDFShadingMeshCache::PDFShadingMeshCache() :
+    m_meshes(DEFAULT_CACHE_LIMIT)
+{
+
+}
+
+PDFShadingMeshCache* PDFShadingMeshCache::getInstance()
+{
+    static PDFShadingMeshCache instance;
+    return &instance;
+}
+
+PDFMesh PDFShadingMeshCache::getMesh(const PDFDocument* document,
+                                     const PDFShadingPattern* shadingPattern,
+                                     const PDFMeshQualitySettings& settings,
+                                     const PDFCMS* cms,
+                                     RenderingIntent intent,
+                                     PDFRenderErrorReporter* reporter,
+                                     const PDFOperationControl* operationControl)
+{
+    const QRectF& meshingArea = settings.deviceSpaceMeshingArea;
+    const PDFReal meshingAreaSize = qMax(meshingArea.width(), meshingArea.height());
+
+    if (!document || !shadingPattern->getShadingReference().isValid() || !(meshingAreaSize > 0.0))
+    {
+        return shadingPattern->createMesh(settings, cms, intent, reporter, operationControl);
+    }
+
+    // Transform device space to the normalized device space. Meshing area is moved
+    // to the origin and scaled, so its size is a power of two (scale bucket).
+    const PDFReal bucketSize = std::exp2(std::round(std::log2(meshingAreaSize)));
+    const PDFReal scale = bucketSize / meshingAreaSize;
+    const QTransform deviceToNormalizedMatrix = QTransform::fromTranslate(-meshingArea.left(), -meshingArea.top()) * QTransform::fromScale(scale, scale);
+
+    PDFMeshQualitySettings normalizedSettings = settings;
+    normalizedSettings.userSpaceToDeviceSpaceMatrix = settings.userSpaceToDeviceSpaceMatrix * deviceToNormalizedMatrix;
+    normalizedSettings.deviceSpaceMeshingArea = deviceToNormalizedMatrix.mapRect(meshingArea);
+    normalizedSettings.minimalMeshResolution = settings.minimalMeshResolution * scale;
+    normalizedSettings.preferredMeshResolution = settings.preferredMeshResolution * scale;
+
+    auto quantize = [](PDFReal value) { return qRound64(value * MATRIX_QUANTIZATION); };
+    const QTransform patternMatrix = shadingPattern->getPatternSpaceToDeviceSpaceMatrix(normalizedSettings);
+
+    Key key;
+    key.document = document;
+    key.reference = shadingPattern->getShadingReference();
+    key.colorSpace = shadingPattern->getColorSpace();
+    key.matrix = { quantize(patternMatrix.m11()), quantize(patternMatrix.m12()), quantize(patternMatrix.m21()),
+                   quantize(patternMatrix.m22()), quantize(patternMatrix.dx()), quantize(patternMatrix.dy()) };
+    key.meshingAreaSize = { quantize(normalizedSettings.deviceSpaceMeshingArea.width()), quantize(normalizedSettings.deviceSpaceMeshingArea.height()) };
+    key.settings = { normalizedSettings.minimalMeshResolution, normalizedSettings.preferredMeshResolution, normalizedSettings.tolerance,
+                     normalizedSettings.patchResolutionMappingRatioLow, normalizedSettings.patchResolutionMappingRatioHigh };
+    key.patchTestPoints = normalizedSettings.patchTestPoints;
+    key.backgroundColor = shadingPattern->getBackgroundColor().isValid() ? shadingPattern->getBackgroundColor().rgba() : 0;
+    key.cmsId = cms ? cms->getId() : 0;
+    key.renderingIntent = intent;
+
+    const QTransform normalizedToDeviceMatrix = deviceToNormalizedMatrix.inverted();
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (const Entry* entry = m_meshes.object(key))
+        {
+            PDFMesh mesh = entry->mesh;
+            lock.unlock();
+
+            mesh.transform(normalizedToDeviceMatrix);
+            return mesh;
+        }
+    }
+
+    PDFMesh mesh = shadingPattern->createMesh(normalizedSettings, cms, intent, reporter, operationControl);
+
+    // Mesh of the cancelled operation can be incomplete, so we do not cache it
+    if (!PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        Entry* entry = new Entry{ shadingPattern->getColorSpacePtr(), mesh };
+        const qsizetype cost = qMax<qsizetype>(mesh.getMemoryConsumptionEstimate(), 1);
+
+        QMutexLocker lock(&m_mutex);
+        m_meshes.insert(key, entry, cost);
+    }
+
+    mesh.transform(normalizedToDeviceMatrix);
+    return mesh;
+}
+
+void PDFShadingMeshCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_meshes.keys())
+    {
+        if (key.document == document)
+        {
+            m_meshes.remove(key);
+        }
+    }
+}
+
+void PDFShadingMeshCache::setCacheLimit(qsizetype cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_meshes.setMaxCost(cacheLimit);
+}
+
+PDFShadingRasterizer PDFShadingRasterizer::create(const PDFShadingPattern* shadingPattern,
+                                                  const QTransform& userSpaceToDeviceSpaceMatrix,
+                                                  const PDFCMS* cms,
+                                                  RenderingIntent intent,
+                                                  PDFRenderErrorReporter* reporter)
+{
+    PDFShadingRasterizer rasterizer;
+
+    const ShadingType shadingType = shadingPattern->getShadingType();
+    if (shadingType != ShadingType::Axial && shadingType != ShadingType::Radial)
+    {
+        return rasterizer;
+    }
+
+    // Background color is painted in the whole meshing area,
+    // not just in the shading area, so we let mesh handle it.
+    const PDFAbstractColorSpace* colorSpace = shadingPattern->getColorSpace();
+    if (!colorSpace || shadingPattern->getBackgroundColor().isValid())
+    {
+        return rasterizer;
+    }
+
+    const QTransform patternSpaceToDeviceSpaceMatrix = shadingPattern->getPatternSpaceToDeviceSpaceMatrix(userSpaceToDeviceSpaceMatrix);
+    if (!patternSpaceToDeviceSpaceMatrix.isAffine() || !patternSpaceToDeviceSpaceMatrix.isInvertible())
+    {
+        return rasterizer;
+    }
+
+    const PDFSingleDimensionShading* shading = static_cast<const PDFSingleDimensionShading*>(shadingPattern);
+    const QPointF axis = shading->getEndPoint() - shading->getStartPoint();
+    const PDFReal axisLengthSquared = QPointF::dotProduct(axis, axis);
+
+    if (shadingType == ShadingType::Axial)
+    {
+        if (qFuzzyIsNull(axisLengthSquared))
+        {
+            return rasterizer;
+        }
+
+        rasterizer.m_axisLengthSquaredInverted = 1.0 / axisLengthSquared;
+    }
+    else
+    {
+        const PDFRadialShading* radialShading = static_cast<const PDFRadialShading*>(shadingPattern);
+        rasterizer.m_r0 = radialShading->getR0();
+        rasterizer.m_r1 = radialShading->getR1();
+    }
+
+    // Precompute the color lookup table
+    const std::vector<PDFFunctionPtr>& functions = shading->getFunctions();
+    const size_t colorComponentCount = colorSpace->getColorComponentCount();
+    const bool isSingleFunction = functions.size() == 1;
+
+    if (functions.empty() || (!isSingleFunction && functions.size() != colorComponentCount))
+    {
+        return rasterizer;
+    }
+
+    std::vector<PDFReal> colorBuffer(colorComponentCount, 0.0);
+    std::vector<QRgb> colorLookupTable(LOOKUP_TABLE_SIZE, 0);
+    for (size_t i = 0; i < LOOKUP_TABLE_SIZE; ++i)
+    {
+        const PDFReal s = PDFReal(i) / PDFReal(LOOKUP_TABLE_SIZE - 1);
+        PDFReal t = interpolate(s, 0.0, 1.0, shading->getDomainStart(), shading->getDomainEnd());
+
+        if (isSingleFunction)
+        {
+            if (!functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + colorBuffer.size()))
+            {
+                return rasterizer;
+            }
+        }
+        else
+        {
+            for (size_t j = 0; j < colorComponentCount; ++j)
+            {
+                if (!functions[j]->apply(&t, &t + 1, colorBuffer.data() + j, colorBuffer.data() + j + 1))
+                {
+                    return rasterizer;
+                }
+            }
+        }
+
+        QColor color = colorSpace->getColor(PDFAbstractColorSpace::convertToColor(colorBuffer), cms, intent, reporter, true);
+        if (!color.isValid())
+        {
+            return rasterizer;
+        }
+
+        colorLookupTable[i] = color.rgb();
+    }
+
+    if (shadingPattern->getBoundingBox().isValid())
+    {
+        rasterizer.m_boundingPath.addPolygon(patternSpaceToDeviceSpaceMatrix.map(shadingPattern->getBoundingBox()));
+    }
+
+    rasterizer.m_type = (shadingType == ShadingType::Axial) ? Type::Axial : Type::Radial;
+    rasterizer.m_deviceSpaceToShadingSpaceMatrix = patternSpaceToDeviceSpaceMatrix.inverted();
+    rasterizer.m_startPoint = shading->getStartPoint();
+    rasterizer.m_axis = axis;
+    rasterizer.m_extendStart = shading->isExtendStart();
+    rasterizer.m_extendEnd = shading->isExtendEnd();
+    rasterizer.m_colorLookupTable = qMove(colorLookupTable);
+    return rasterizer;
+}
+
+bool PDFShadingRasterizer::getParameter(const QPointF& point, PDFReal& s) const
+{
+    const QPointF pointVector = point - m_startPoint;
+
+    if (m_type == Type::Axial)
+    {
+        s = QPointF::dotProduct(pointVector, m_axis) * m_axisLengthSquaredInverted;
+    }
+    else
+    {
+        // We are searching for the largest s, for which point lies on the circle
+        // with center c(s) = c0 + s * (c1 - c0) and radius r(s) = r0 + s * (r1 - r0),
+        // and r(s) >= 0. This leads to quadratic equation a * s^2 - 2 * b * s + c = 0.
+        const PDFReal dr = m_r1 - m_r0;
+        const PDFReal a = QPointF::dotProduct(m_axis, m_axis) - dr * dr;
+        const PDFReal b = QPointF::dotProduct(pointVector, m_axis) + m_r0 * dr;
+        const PDFReal c = QPointF::dotProduct(pointVector, pointVector) - m_r0 * m_r0;
+
+        PDFReal s1 = 0.0;
+        PDFReal s2 = 0.0;
+
+        if (qFuzzyIsNull(a))
+        {
+            if (qFuzzyIsNull(b))
+            {
+                return false;
+            }
+
+            s1 = 0.5 * c / b;
+            s2 = s1;
+        }
+        else
+        {
+            const PDFReal discriminant = b * b - a * c;
+            if (discriminant < 0.0)
+            {
+                return false;
+            }
+
+            const PDFReal D = std::sqrt(discriminant);
+            s1 = (b + D) / a;
+            s2 = (b - D) / a;
+
+            if (s1 < s2)
+            {
+                std::swap(s1, s2);
+            }
+        }
+
+        // Try the larger solution first
+        for (PDFReal solution : { s1, s2 })
+        {
+            if (m_r0 + solution * dr < 0.0)
+            {
+                continue;
+            }
+
+            if ((solution >= 0.0 || m_extendStart) && (solution <= 1.0 || m_extendEnd))
+            {
+                s = qBound(0.0, solution, 1.0);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    if (s < 0.0)
+    {
+        if (!m_extendStart)
+        {
+            return false;
+        }
+
+        s = 0.0;
+    }
+    else if (s > 1.0)
+    {
+        if (!m_extendEnd)
+        {
+            return false;
+        }
+
+        s = 1.0;
+    }
+
+    return true;
+}
+
+QRgb PDFShadingRasterizer::getColor(PDFReal s) const
+{
+    const PDFReal position = s * (LOOKUP_TABLE_SIZE - 1);
+    const size_t index = qMin(static_cast<size_t>(position), LOOKUP_TABLE_SIZE - 2);
+    const uint32_t weight = qBound(0, static_cast<int>((position - index) * 256.0), 256);
+
+    // We interpolate two 8-bit channels in one 32-bit integer (alpha/green
+    // and red/blue channels), each channel has enough bits for the multiplication.
+    const uint32_t c1 = m_colorLookupTable[index];
+    const uint32_t c2 = m_colorLookupTable[index + 1];
+    const uint32_t redBlue = (((c1 & 0x00FF00FF) * (256 - weight) + (c2 & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+    const uint32_t alphaGreen = (((c1 >> 8) & 0x00FF00FF) * (256 - weight) + ((c2 >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00;
+    return redBlue | alphaGreen;
+}
+
+void PDFShadingRasterizer::rasterize(QImage& image, const QTransform& imageToDeviceSpaceMatrix) const
+{
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+
+    if (!isValid() || image.isNull())
+    {
+        return;
+    }
+
+    // Pixels are sampled at their centers. Matrix is affine, so we can advance
+    // the shading space point incrementally along the scanline.
+    const QTransform imageToShadingSpaceMatrix = imageToDeviceSpaceMatrix * m_deviceSpaceToShadingSpaceMatrix;
+    const QPointF origin = imageToShadingSpaceMatrix.map(QPointF(0.5, 0.5));
+    const QPointF stepX = imageToShadingSpaceMatrix.map(QPointF(1.5, 0.5)) - origin;
+    const QPointF stepY = imageToShadingSpaceMatrix.map(QPointF(0.5, 1.5)) - origin;
+
+    const int width = image.width();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    uchar* bits = image.bits();
+
+    auto processRow = [&, this](int y)
+    {
+        QRgb* scanline = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+        QPointF point = origin + stepY * y;
+
+        for (int x = 0; x < width; ++x, point += stepX)
+        {
+            PDFReal s = 0.0;
+            scanline[x] = getParameter(point, s) ? getColor(s) : 0;
+        }
+    };
+
+    PDFIntegerRange<int> range(0, image.height());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), processRow);
+}
+
+void PDFShadingRasterizer::draw(QPainter* painter, const QTransform& deviceSpaceToPainterMatrix, QPainterPath path, PDFReal alpha) const
+{
+    if (!isValid() || !painter->device() || !deviceSpaceToPainterMatrix.isInvertible())
+    {
+        return;
+    }
+
+    if (!m_boundingPath.isEmpty())
+    {
+        path = path.intersected(m_boundingPath);
+    }
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+
+    // Rasterize only visible part of the shading
+    const QPainterPath mappedPath = deviceSpaceToPainterMatrix.map(path);
+    QRect targetRect = mappedPath.controlPointRect().toAlignedRect();
+    targetRect = targetRect.intersected(QRect(0, 0, painter->device()->width(), painter->device()->height()));
+
+    if (painter->hasClipping())
+    {
+        targetRect = targetRect.intersected(painter->clipBoundingRect().toAlignedRect());
+    }
+
+    if (!targetRect.isEmpty())
+    {
+        QImage image(targetRect.size(), QImage::Format_ARGB32_Premultiplied);
+        rasterize(image, QTransform::fromTranslate(targetRect.left(), targetRect.top()) * deviceSpaceToPainterMatrix.inverted());
+
+        painter->setClipPath(mappedPath, Qt::IntersectClip);
+        painter->setOpacity(painter->opacity() * alpha);
+        painter->drawImage(targetRect.topLeft(), image);
+    }
+
+    painter->restore();
+}
+
+void PDFShadingRasterizer::convertColors(const PDFColorConvertor& colorConvertor)
+{
+    for (QRgb& color : m_colorLookupTable)
+    {
+        color = colorConvertor.convert(QColor::fromRgb(color), false, false).rgb();
+    }
+}
+
+qint64 PDFShadingRasterizer::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this);
+    memoryConsumption += sizeof(QRgb) * m_colorLookupTable.capacity();
+    memoryConsumption += sizeof(QPainterPath::Element) * m_boundingPath.capacity();
+    return memoryConsumption;
+}
+
 void PDFMeshQualitySettings::initResolution()
 {
     Q_ASSERT(deviceSpaceMeshingArea.isValid());
@@ -27,6 +27,7 @@
 #include <QTransform>
 #include <QPainterPath>
 
+#include <array>
 #include <memory>
 
 namespace pdf
@@ -255,9 +256,14 @@ public:
     const PDFObject& getResources() const { return m_resources; }
     const QByteArray& getContent() const { return m_content; }
 
+    /// Returns reference to the pattern object. If pattern is not
+    /// referenced indirectly, then invalid reference is returned.
+    PDFObjectReference getPatternReference() const { return m_patternReference; }
+
 private:
     friend class PDFPattern;
 
+    PDFObjectReference m_patternReference;
     PaintType m_paintType = PaintType::Colored;
     TilingType m_tilingType = TilingType::ConstantSpacing;
     PDFReal m_xStep = 0.0;
@@ -322,6 +328,10 @@ public:
     /// the shading pattern is painted to the target device.
     const PDFObject& getPatternGraphicState() const { return m_patternGraphicState; }
 
+    /// Returns reference to the shading object. If shading is a direct
+    /// object, then invalid reference is returned.
+    PDFObjectReference getShadingReference() const { return m_shadingReference; }
+
     /// Returns color space of the pattern.
     const PDFAbstractColorSpace* getColorSpace() const;
 
@@ -354,12 +364,167 @@ protected:
     friend class PDFPattern;
 
     PDFObject m_patternGraphicState;
+    PDFObjectReference m_shadingReference;
     PDFColorSpacePointer m_colorSpace;
     QColor m_backgroundColor;
     PDFColor m_originalBackgroundColor;
     bool m_antiAlias = false;
 };
 
+/// Cache of shading meshes. Meshing of shadings (especially patch meshes) is expensive,
+/// so meshes of shadings defined by indirect objects are cached for the whole document.
+/// Mesh resolution is relative to the meshing area, so mesh is created in normalized
+/// device space (meshing area is scaled to the nearest power of two size, which
+/// is the scale bucket) and then transformed to the actual device space. So, the same
+/// mesh is reused, when page is painted in different zoom levels. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFShadingMeshCache
+{
+public:
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+        PDFObjectReference reference;
+        const PDFAbstractColorSpace* colorSpace = nullptr;
+        std::array<qint64, 6> matrix = { };
+        std::array<qint64, 2> meshingAreaSize = { };
+        std::array<PDFReal, 5> settings = { };
+        PDFInteger patchTestPoints = 0;
+        QRgb backgroundColor = 0;
+        quint64 cmsId = 0;
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, reference, colorSpace, matrix, meshingAreaSize, settings, patchTestPoints, backgroundColor, cmsId, renderingIntent) ==
+                   std::tie(other.document, other.reference, other.colorSpace, other.matrix, other.meshingAreaSize, other.settings, other.patchTestPoints, other.backgroundColor, other.cmsId, other.renderingIntent);
+        }
+    };
+
+    static PDFShadingMeshCache* getInstance();
+
+    /// Returns mesh of the shading pattern in device space. If shading is defined
+    /// by indirect object, then mesh is taken from the cache (if it is present),
+    /// otherwise mesh is created and inserted into the cache.
+    /// \param document Document
+    /// \param shadingPattern Shading pattern
+    /// \param settings Meshing settings
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    /// \param operationControl Operation control
+    PDFMesh getMesh(const PDFDocument* document,
+                    const PDFShadingPattern* shadingPattern,
+                    const PDFMeshQualitySettings& settings,
+                    const PDFCMS* cms,
+                    RenderingIntent intent,
+                    PDFRenderErrorReporter* reporter,
+                    const PDFOperationControl* operationControl);
+
+    /// Removes all meshes of the document from the cache
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+    /// Sets cache limit (in bytes)
+    /// \param cacheLimit Cache limit
+    void setCacheLimit(qsizetype cacheLimit);
+
+private:
+    explicit PDFShadingMeshCache();
+
+    struct Entry
+    {
+        /// Color space is held to keep its address (which is part of the key) valid
+        PDFColorSpacePointer colorSpace;
+        PDFMesh mesh;
+    };
+
+    static constexpr qsizetype DEFAULT_CACHE_LIMIT = 64 * 1024 * 1024;
+    static constexpr PDFReal MATRIX_QUANTIZATION = 65536.0;
+
+    mutable QMutex m_mutex;
+    QCache<Key, Entry> m_meshes;
+};
+
+/// Rasterizer of axial and radial shadings. Instead of meshing the shading into
+/// triangles, color of each pixel is computed directly from the shading geometry
+/// using one-dimensional color lookup table, which is precomputed from the shading
+/// functions. Rasterizer is created in device space, and it can be drawn in arbitrary
+/// resolution later (so it can be stored in precompiled page).
+class PDF4QTLIBCORESHARED_EXPORT PDFShadingRasterizer
+{
+public:
+    explicit inline PDFShadingRasterizer() = default;
+
+    /// Creates rasterizer for the shading pattern. If shading can't be rasterized
+    /// directly (it is not axial/radial shading, it has background color, or color
+    /// lookup table can't be computed), then invalid rasterizer is returned.
+    /// \param shadingPattern Shading pattern
+    /// \param userSpaceToDeviceSpaceMatrix Matrix, which transforms user space points to the device space
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    static PDFShadingRasterizer create(const PDFShadingPattern* shadingPattern,
+                                       const QTransform& userSpaceToDeviceSpaceMatrix,
+                                       const PDFCMS* cms,
+                                       RenderingIntent intent,
+                                       PDFRenderErrorReporter* reporter);
+
+    /// Returns true, if rasterizer is valid
+    bool isValid() const { return m_type != Type::Invalid; }
+
+    /// Rasterizes shading into the image. Pixels outside of the shading
+    /// are set to transparent color.
+    /// \param image Target image (must be in Format_ARGB32_Premultiplied format)
+    /// \param imageToDeviceSpaceMatrix Matrix, which transforms image pixel coordinates to the device space
+    void rasterize(QImage& image, const QTransform& imageToDeviceSpaceMatrix) const;
+
+    /// Draws shading onto the painter, shading is clipped by the path. Shading is
+    /// rasterized in the painter's device resolution.
+    /// \param painter Painter
+    /// \param deviceSpaceToPainterMatrix Matrix, which transforms device space to the painter's device space
+    /// \param path Clipping path in device space
+    /// \param alpha Opacity
+    void draw(QPainter* painter, const QTransform& deviceSpaceToPainterMatrix, QPainterPath path, PDFReal alpha) const;
+
+    /// Apply color conversion
+    void convertColors(const PDFColorConvertor& colorConvertor);
+
+    /// Returns estimate of number of bytes, which this rasterizer occupies in memory
+    qint64 getMemoryConsumptionEstimate() const;
+
+private:
+    enum class Type
+    {
+        Invalid,
+        Axial,
+        Radial
+    };
+
+    /// Computes shading parameter s (position on the shading axis, in range [0, 1]) for point
+    /// in the shading space. If point is not covered by the shading, false is returned.
+    /// \param point Point in the shading space
+    /// \param s Shading parameter
+    bool getParameter(const QPointF& point, PDFReal& s) const;
+
+    /// Returns color of the shading parameter (interpolated from lookup table)
+    /// \param s Shading parameter
+    QRgb getColor(PDFReal s) const;
+
+    static constexpr size_t LOOKUP_TABLE_SIZE = 1024;
+
+    Type m_type = Type::Invalid;
+    QTransform m_deviceSpaceToShadingSpaceMatrix;
+    QPainterPath m_boundingPath;
+    QPointF m_startPoint;
+    QPointF m_axis;
+    PDFReal m_axisLengthSquaredInverted = 0.0;
+    PDFReal m_r0 = 0.0;
+    PDFReal m_r1 = 0.0;
+    bool m_extendStart = false;
+    bool m_extendEnd = false;
+    std::vector<QRgb> m_colorLookupTable;
+};
+
 class PDFSingleDimensionShading : public PDFShadingPattern
 {
 public:
@@ -44,7 +44,8 @@ PDFRenderer::PDFRenderer(const PDFDocument* document,
     m_optionalContentActivity(optionalContentActivity),
     m_operationControl(nullptr),
     m_features(features),
-    m_meshQualitySettings(meshQualitySettings)
+    m_meshQualitySettings(meshQualitySettings),
+    m_imageDeviceScale(0.0)
 {
     Q_ASSERT(document);
 }
@@ -207,6 +208,7 @@ void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex)
 
     PDFPrecompiledPageGenerator generator(precompiledPage, m_features, page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_meshQualitySettings);
     generator.setOperationControl(m_operationControl);
+    generator.setImageDeviceScale(m_imageDeviceScale);
     QList<PDFRenderError> errors = generator.processContents();
 
     PDFColorConvertor colorConvertor = m_cms->getColorConvertor();
@@ -363,6 +365,15 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         PDFPrecompiledPage precompiledPage;
         PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
         PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+
+        // Page is rendered at known size, so images need not to be decoded at higher resolution
+        const QSize imageSize = imageSizeGetter(page);
+        const QSizeF pageSize = page->getRotatedMediaBox().size();
+        if (!imageSize.isEmpty() && !pageSize.isEmpty())
+        {
+            renderer.setImageDeviceScale(qMax(imageSize.width() / pageSize.width(), imageSize.height() / pageSize.height()));
+        }
+
         renderer.compile(&precompiledPage, pageIndex);
 
         qint64 pageCompileTime = pageTimer.restart();
@@ -384,7 +395,7 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         pageTimer.restart();
         PDFRasterizer* rasterizer = acquire();
         qint64 pageWaitTime = pageTimer.restart();
-        QImage image = rasterizer->render(pageIndex, page, &precompiledPage, imageSizeGetter(page), m_features, &annotationManager, cms.data(), PageRotation::None);
+        QImage image = rasterizer->render(pageIndex, page, &precompiledPage, imageSize, m_features, &annotationManager, cms.data(), PageRotation::None);
         qint64 pageRenderTime = pageTimer.elapsed();
         release(rasterizer);
 
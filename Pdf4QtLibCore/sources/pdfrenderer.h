@@ -127,6 +127,13 @@ public:
     const PDFOperationControl* getOperationControl() const;
     void setOperationControl(const PDFOperationControl* newOperationControl);
 
+    /// Sets scale from page points to target device pixels used when page is compiled.
+    /// If it is set, images are decoded at reduced resolution sufficient for the target
+    /// device. Compiled page then shouldn't be drawn at higher scale. Zero means, that
+    /// images are decoded at full resolution.
+    /// \param imageDeviceScale Scale from page points to device pixels
+    void setImageDeviceScale(PDFReal imageDeviceScale) { m_imageDeviceScale = imageDeviceScale; }
+
 private:
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
@@ -135,6 +142,7 @@ private:
     const PDFOperationControl* m_operationControl;
     Features m_features;
     PDFMeshQualitySettings m_meshQualitySettings;
+    PDFReal m_imageDeviceScale;
 };
 
 /// Renders PDF pages to bitmap images (QImage).
@@ -81,6 +81,27 @@ void PDFSnapInfo::addLine(const QPointF& start, const QPointF& end)
     m_snapLines.emplace_back(line);
 }
 
+void PDFSnapInfo::merge(const PDFSnapInfo& snapInfo, const QTransform& matrix)
+{
+    for (const SnapPoint& snapPoint : snapInfo.m_snapPoints)
+    {
+        m_snapPoints.emplace_back(snapPoint.type, matrix.map(snapPoint.point));
+    }
+
+    for (const QLineF& line : snapInfo.m_snapLines)
+    {
+        m_snapLines.emplace_back(matrix.map(line));
+    }
+
+    for (const SnapImage& snapImage : snapInfo.m_snapImages)
+    {
+        SnapImage mappedSnapImage;
+        mappedSnapImage.imagePath = matrix.map(snapImage.imagePath);
+        mappedSnapImage.image = snapImage.image;
+        m_snapImages.emplace_back(qMove(mappedSnapImage));
+    }
+}
+
 PDFSnapper::PDFSnapper()
 {
 
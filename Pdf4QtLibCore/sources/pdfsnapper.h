@@ -89,6 +89,13 @@ public:
     /// \param end End point of line, in page coordinates
     void addLine(const QPointF& start, const QPointF& end);
 
+    /// Adds all snap points, lines and images of other snap info,
+    /// transformed by given matrix (for example, snap info of instanced
+    /// form, which is painted on the page).
+    /// \param snapInfo Snap info to be merged
+    /// \param matrix Matrix mapping other snap info coordinates to page coordinates
+    void merge(const PDFSnapInfo& snapInfo, const QTransform& matrix);
+
     /// Returns snap points
     const std::vector<SnapPoint>& getSnapPoints() const { return m_snapPoints; }
 
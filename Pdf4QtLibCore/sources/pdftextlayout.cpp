@@ -281,7 +281,7 @@ void PDFTextLayout::addCharacter(const PDFTextCharacterInfo& info)
     character.fontSize = fontMappedLine.length();
 
     QRectF boundingBox = info.outline.boundingRect();
-    character.boundingBox.addPolygon(info.matrix.map(boundingBox));
+    character.boundingBox.addPolygon(info.outlineMatrix.map(boundingBox));
 
     m_characters.emplace_back(qMove(character));
     m_angles.insert(character.angle);
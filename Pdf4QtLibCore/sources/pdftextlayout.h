@@ -42,7 +42,8 @@ struct PDFTextCharacterInfo
     /// Character
     QChar character;
 
-    /// Character path
+    /// Character path (in glyph space, it must be translated
+    /// into device space using outline matrix)
     QPainterPath outline;
 
     /// Do we use a vertical writing system?
@@ -58,6 +59,9 @@ struct PDFTextCharacterInfo
 
     /// Transformation matrix from character space to device space
     QTransform matrix;
+
+    /// Transformation matrix from glyph space (outline) to device space
+    QTransform outlineMatrix;
 };
 
 struct PDFTextLayoutSettings
@@ -25,6 +25,8 @@
 
 #include <QtMath>
 #include <iterator>
+#include <algorithm>
+#include <numeric>
 
 namespace pdf
 {
@@ -37,15 +39,25 @@ PDFFloatBitmap::PDFFloatBitmap() :
 
 }
 
-PDFFloatBitmap::PDFFloatBitmap(size_t width, size_t height, PDFPixelFormat format) :
+PDFFloatBitmap::PDFFloatBitmap(size_t width, size_t height, PDFPixelFormat format, StorageMode storageMode) :
     m_format(format),
     m_width(width),
     m_height(height),
-    m_pixelSize(format.getChannelCount())
+    m_pixelSize(format.getChannelCount()),
+    m_storageMode(storageMode)
 {
     Q_ASSERT(format.isValid());
 
-    m_data.resize(format.calculateBitmapDataLength(width, height), static_cast<PDFColorComponent>(0.0f));
+    switch (m_storageMode)
+    {
+        case StorageMode::Float:
+            m_data.resize(format.calculateBitmapDataLength(width, height), static_cast<PDFColorComponent>(0.0f));
+            break;
+
+        case StorageMode::Fixed16:
+            m_fixed16Data.resize(format.calculateBitmapDataLength(width, height), 0);
+            break;
+    }
 
     if (m_format.hasActiveColorMask())
     {
@@ -55,6 +67,7 @@ PDFFloatBitmap::PDFFloatBitmap(size_t width, size_t height, PDFPixelFormat forma
 
 PDFColorBuffer PDFFloatBitmap::getPixel(size_t x, size_t y)
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     Q_ASSERT(x < m_width);
     Q_ASSERT(y < m_height);
 
@@ -64,6 +77,7 @@ PDFColorBuffer PDFFloatBitmap::getPixel(size_t x, size_t y)
 
 PDFConstColorBuffer PDFFloatBitmap::getPixel(size_t x, size_t y) const
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     Q_ASSERT(x < m_width);
     Q_ASSERT(y < m_height);
 
@@ -73,20 +87,65 @@ PDFConstColorBuffer PDFFloatBitmap::getPixel(size_t x, size_t y) const
 
 PDFColorBuffer PDFFloatBitmap::getPixels()
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     return PDFColorBuffer(m_data.data(), m_data.size());
 }
 
+void PDFFloatBitmap::readPixel(size_t x, size_t y, PDFColorBuffer buffer) const
+{
+    Q_ASSERT(x < m_width);
+    Q_ASSERT(y < m_height);
+    Q_ASSERT(buffer.size() == m_pixelSize);
+
+    const size_t index = getPixelIndex(x, y);
+    for (size_t i = 0; i < m_pixelSize; ++i)
+    {
+        buffer[i] = getComponent(index + i);
+    }
+}
+
+void PDFFloatBitmap::setStorageMode(StorageMode storageMode)
+{
+    if (m_storageMode == storageMode)
+    {
+        return;
+    }
+
+    switch (storageMode)
+    {
+        case StorageMode::Float:
+        {
+            m_data.resize(m_fixed16Data.size());
+            std::transform(m_fixed16Data.cbegin(), m_fixed16Data.cend(), m_data.begin(), &PDFFloatBitmap::decodeFixed16);
+            m_fixed16Data = std::vector<uint16_t>();
+            break;
+        }
+
+        case StorageMode::Fixed16:
+        {
+            m_fixed16Data.resize(m_data.size());
+            std::transform(m_data.cbegin(), m_data.cend(), m_fixed16Data.begin(), &PDFFloatBitmap::encodeFixed16);
+            m_data = std::vector<PDFColorComponent>();
+            break;
+        }
+    }
+
+    m_storageMode = storageMode;
+}
+
 PDFColorComponent PDFFloatBitmap::getPixelInkCoverage(size_t x, size_t y) const
 {
-    PDFConstColorBuffer buffer = getPixel(x, y);
+    Q_ASSERT(x < m_width);
+    Q_ASSERT(y < m_height);
 
+    const size_t index = getPixelIndex(x, y);
     const uint8_t colorChannelIndexStart = m_format.getColorChannelIndexStart();
     const uint8_t colorChannelIndexEnd = m_format.getColorChannelIndexEnd();
 
     PDFColorComponent inkCoverage = 0.0;
     for (uint8_t i = colorChannelIndexStart; i < colorChannelIndexEnd; ++i)
     {
-        inkCoverage += buffer[i];
+        inkCoverage += getComponent(index + i);
     }
 
     return inkCoverage;
@@ -111,21 +170,25 @@ PDFFloatBitmap PDFFloatBitmap::getInkCoverageBitmap() const
 
 const PDFColorComponent* PDFFloatBitmap::begin() const
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     return m_data.data();
 }
 
 const PDFColorComponent* PDFFloatBitmap::end() const
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     return m_data.data() + m_data.size();
 }
 
 PDFColorComponent* PDFFloatBitmap::begin()
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     return m_data.data();
 }
 
 PDFColorComponent* PDFFloatBitmap::end()
 {
+    Q_ASSERT(m_storageMode == StorageMode::Float);
     return m_data.data() + m_data.size();
 }
 
@@ -217,8 +280,7 @@ QImage PDFFloatBitmap::getChannelImage(uint8_t channelIndex) const
         uchar* line = image.scanLine(y);
         for (int x = 0; x < image.width(); ++x)
         {
-            PDFConstColorBuffer buffer = getPixel(x, y);
-            line[x] = qRound(buffer[channelIndex] * 255);
+            line[x] = qRound(getComponent(getPixelIndex(x, y) + channelIndex) * 255);
         }
     }
 
@@ -399,6 +461,76 @@ void PDFFloatBitmap::copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t cha
     }
 }
 
+void PDFFloatBitmap::copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y)
+{
+    Q_ASSERT(getPixelFormat() == sourceBitmap.getPixelFormat());
+    Q_ASSERT(x + sourceBitmap.getWidth() <= getWidth());
+    Q_ASSERT(y + sourceBitmap.getHeight() <= getHeight());
+
+    const size_t width = sourceBitmap.getWidth();
+    const size_t rowLength = width * m_pixelSize;
+    const bool copyActiveColorMask = hasActiveColorMask() && sourceBitmap.hasActiveColorMask();
+
+    for (size_t row = 0; row < sourceBitmap.getHeight(); ++row)
+    {
+        copyComponents(sourceBitmap, row * rowLength, *this, getPixelIndex(x, y + row), rowLength);
+
+        if (copyActiveColorMask)
+        {
+            auto sourceMaskRow = std::next(sourceBitmap.m_activeColorMask.cbegin(), row * width);
+            std::copy(sourceMaskRow, std::next(sourceMaskRow, width), std::next(m_activeColorMask.begin(), (y + row) * m_width + x));
+        }
+    }
+}
+
+void PDFFloatBitmap::copyRegion(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y)
+{
+    Q_ASSERT(getPixelFormat() == sourceBitmap.getPixelFormat());
+    Q_ASSERT(x + getWidth() <= sourceBitmap.getWidth());
+    Q_ASSERT(y + getHeight() <= sourceBitmap.getHeight());
+
+    const size_t rowLength = m_width * m_pixelSize;
+    const bool copyActiveColorMask = hasActiveColorMask() && sourceBitmap.hasActiveColorMask();
+
+    for (size_t row = 0; row < m_height; ++row)
+    {
+        copyComponents(sourceBitmap, sourceBitmap.getPixelIndex(x, y + row), *this, row * rowLength, rowLength);
+
+        if (copyActiveColorMask)
+        {
+            auto sourceMaskRow = std::next(sourceBitmap.m_activeColorMask.cbegin(), (y + row) * sourceBitmap.m_width + x);
+            std::copy(sourceMaskRow, std::next(sourceMaskRow, m_width), std::next(m_activeColorMask.begin(), row * m_width));
+        }
+    }
+}
+
+void PDFFloatBitmap::copyComponents(const PDFFloatBitmap& source, size_t sourceIndex, PDFFloatBitmap& target, size_t targetIndex, size_t count)
+{
+    const bool isSourceFloat = source.m_storageMode == StorageMode::Float;
+    const bool isTargetFloat = target.m_storageMode == StorageMode::Float;
+
+    if (isSourceFloat && isTargetFloat)
+    {
+        auto it = std::next(source.m_data.cbegin(), sourceIndex);
+        std::copy(it, std::next(it, count), std::next(target.m_data.begin(), targetIndex));
+    }
+    else if (isSourceFloat)
+    {
+        auto it = std::next(source.m_data.cbegin(), sourceIndex);
+        std::transform(it, std::next(it, count), std::next(target.m_fixed16Data.begin(), targetIndex), &PDFFloatBitmap::encodeFixed16);
+    }
+    else if (isTargetFloat)
+    {
+        auto it = std::next(source.m_fixed16Data.cbegin(), sourceIndex);
+        std::transform(it, std::next(it, count), std::next(target.m_data.begin(), targetIndex), &PDFFloatBitmap::decodeFixed16);
+    }
+    else
+    {
+        auto it = std::next(source.m_fixed16Data.cbegin(), sourceIndex);
+        std::copy(it, std::next(it, count), std::next(target.m_fixed16Data.begin(), targetIndex));
+    }
+}
+
 PDFFloatBitmap PDFFloatBitmap::resize(size_t width, size_t height, Qt::TransformationMode mode) const
 {
     if (width == 0 || height == 0)
@@ -506,6 +638,276 @@ PDFFloatBitmap PDFFloatBitmap::resize(size_t width, size_t height, Qt::Transform
     return bitmap;
 }
 
+/// Row of pixels blended by separable blend kernel. Pointers to color
+/// buffers point to the first pixel of the row, per-pixel values
+/// common for all color channels are stored in arrays.
+struct PDFSeparableBlendRow
+{
+    size_t count = 0;                               ///< Number of pixels in the row
+    size_t pixelSize = 0;                           ///< Number of channels of one pixel
+    const PDFColorComponent* source = nullptr;      ///< Source pixels
+    const PDFColorComponent* backdrop = nullptr;    ///< Backdrop pixels
+    PDFColorComponent* target = nullptr;            ///< Target pixels
+    const PDFColorComponent* f_s = nullptr;         ///< Source shape
+    const PDFColorComponent* alpha_s = nullptr;     ///< Source opacity
+    const PDFColorComponent* alpha_b = nullptr;     ///< Backdrop opacity
+    const PDFColorComponent* alpha_i_1 = nullptr;   ///< Old result opacity
+    const PDFColorComponent* alpha_i = nullptr;     ///< New result opacity
+    const uint8_t* isColorDefined = nullptr;        ///< Is color of the result defined (nonzero group opacity)?
+};
+
+/// Blends one color channel of the row. Blend mode is known at compile time
+/// and loop doesn't contain branches, so it can be vectorized by the compiler.
+/// Pixels with undefined color keep their old color.
+/// \param row Blended row
+/// \param channel Color channel
+template<BlendMode mode, bool subtractive>
+static void blendSeparableChannel(const PDFSeparableBlendRow& row, uint8_t channel)
+{
+    const PDFColorComponent* sourceColor = row.source + channel;
+    const PDFColorComponent* backdropColor = row.backdrop + channel;
+    PDFColorComponent* targetColor = row.target + channel;
+
+    for (size_t i = 0; i < row.count; ++i)
+    {
+        const size_t offset = i * row.pixelSize;
+        const PDFColorComponent C_s_i = sourceColor[offset];
+        const PDFColorComponent C_b = backdropColor[offset];
+        const PDFColorComponent C_i_1 = targetColor[offset];
+
+        PDFColorComponent B_i = 0.0f;
+        if constexpr (subtractive)
+        {
+            B_i = 1.0f - PDFBlendFunction::blend<mode>(1.0f - C_b, 1.0f - C_s_i);
+        }
+        else
+        {
+            B_i = PDFBlendFunction::blend<mode>(C_b, C_s_i);
+        }
+
+        const PDFColorComponent f_s_i = row.f_s[i];
+        const PDFColorComponent alpha_s_i = row.alpha_s[i];
+        const PDFColorComponent alpha_b = row.alpha_b[i];
+        const PDFColorComponent C_t = (f_s_i - alpha_s_i) * alpha_b * C_b + alpha_s_i * ((1.0f - alpha_b) * C_s_i + alpha_b * B_i);
+        const PDFColorComponent C_i = ((1.0f - f_s_i) * row.alpha_i_1[i] * C_i_1 + C_t) / row.alpha_i[i];
+
+        targetColor[offset] = row.isColorDefined[i] ? C_i : C_i_1;
+    }
+}
+
+/// Blends color channels of the row pixel by pixel. Pixel size and number of
+/// blended channels are known at compile time, so channels of one pixel are
+/// contiguous in memory, values common for all channels are loaded only
+/// once per pixel and the channel loop can be vectorized by the compiler.
+/// Results are the same as results of \p blendSeparableChannel.
+/// \param row Blended row
+/// \param channelStart First color channel
+template<BlendMode mode, bool subtractive, size_t pixelSize, size_t channelCount>
+static void blendSeparablePixels(const PDFSeparableBlendRow& row, uint8_t channelStart)
+{
+    Q_ASSERT(row.pixelSize == pixelSize);
+    Q_ASSERT(channelStart + channelCount <= pixelSize);
+
+    const PDFColorComponent* sourceColor = row.source + channelStart;
+    const PDFColorComponent* backdropColor = row.backdrop + channelStart;
+    PDFColorComponent* targetColor = row.target + channelStart;
+
+    for (size_t i = 0; i < row.count; ++i)
+    {
+        const size_t offset = i * pixelSize;
+        const PDFColorComponent f_s_i = row.f_s[i];
+        const PDFColorComponent alpha_s_i = row.alpha_s[i];
+        const PDFColorComponent alpha_b = row.alpha_b[i];
+        const PDFColorComponent alpha_i = row.alpha_i[i];
+        const PDFColorComponent targetFactor = (1.0f - f_s_i) * row.alpha_i_1[i];
+        const bool isColorDefined = row.isColorDefined[i];
+
+        for (size_t channel = 0; channel < channelCount; ++channel)
+        {
+            const PDFColorComponent C_s_i = sourceColor[offset + channel];
+            const PDFColorComponent C_b = backdropColor[offset + channel];
+            const PDFColorComponent C_i_1 = targetColor[offset + channel];
+
+            PDFColorComponent B_i = 0.0f;
+            if constexpr (subtractive)
+            {
+                B_i = 1.0f - PDFBlendFunction::blend<mode>(1.0f - C_b, 1.0f - C_s_i);
+            }
+            else
+            {
+                B_i = PDFBlendFunction::blend<mode>(C_b, C_s_i);
+            }
+
+            const PDFColorComponent C_t = (f_s_i - alpha_s_i) * alpha_b * C_b + alpha_s_i * ((1.0f - alpha_b) * C_s_i + alpha_b * B_i);
+            const PDFColorComponent C_i = (targetFactor * C_i_1 + C_t) / alpha_i;
+
+            targetColor[offset + channel] = isColorDefined ? C_i : C_i_1;
+        }
+    }
+}
+
+/// Blends color channels of the row using separable blend mode. Process colors
+/// of RGB and CMYK bitmaps without spot colors are blended by kernels specialized
+/// for their pixel layout, other layouts are blended channel by channel.
+/// \param row Blended row
+/// \param channelStart First color channel
+/// \param channelEnd Color channel after the last one
+/// \param subtractive Are color channels subtractive?
+template<BlendMode mode>
+static void blendSeparableChannels(const PDFSeparableBlendRow& row, uint8_t channelStart, uint8_t channelEnd, bool subtractive)
+{
+    // Shape and opacity channels follow color channels
+    const size_t channelCount = channelEnd - channelStart;
+    if (row.pixelSize == channelCount + 2)
+    {
+        switch (channelCount)
+        {
+            case 3:
+                subtractive ? blendSeparablePixels<mode, true, 5, 3>(row, channelStart) : blendSeparablePixels<mode, false, 5, 3>(row, channelStart);
+                return;
+
+            case 4:
+                subtractive ? blendSeparablePixels<mode, true, 6, 4>(row, channelStart) : blendSeparablePixels<mode, false, 6, 4>(row, channelStart);
+                return;
+
+            default:
+                break;
+        }
+    }
+
+    for (uint8_t channel = channelStart; channel < channelEnd; ++channel)
+    {
+        if (subtractive)
+        {
+            blendSeparableChannel<mode, true>(row, channel);
+        }
+        else
+        {
+            blendSeparableChannel<mode, false>(row, channel);
+        }
+    }
+}
+
+/// Blending kernel for separable blend modes without overprinting. Results
+/// are the same as results of PDFFloatBitmap::blendGeneric. Bitmaps are processed
+/// row by row, at first, shape and opacity are calculated for all pixels
+/// in the row, then color channels are blended one by one.
+template<BlendMode mode>
+static void blendSeparable(const PDFFloatBitmap& source,
+                           PDFFloatBitmap& target,
+                           const PDFFloatBitmap& backdrop,
+                           const PDFFloatBitmap& initialBackdrop,
+                           const PDFFloatBitmap& blendSoftMask,
+                           bool alphaIsShape,
+                           PDFColorComponent constantAlpha,
+                           bool knockoutGroup,
+                           QRect blendRegion)
+{
+    const PDFPixelFormat pixelFormat = source.getPixelFormat();
+    const uint8_t shapeChannel = pixelFormat.getShapeChannelIndex();
+    const uint8_t opacityChannel = pixelFormat.getOpacityChannelIndex();
+
+    const size_t count = blendRegion.width();
+    const size_t left = blendRegion.left();
+    std::vector<PDFColorComponent> f_s(count, 0.0f);
+    std::vector<PDFColorComponent> alpha_s(count, 0.0f);
+    std::vector<PDFColorComponent> alpha_b(count, 0.0f);
+    std::vector<PDFColorComponent> alpha_i_1(count, 0.0f);
+    std::vector<PDFColorComponent> alpha_i(count, 0.0f);
+    std::vector<PDFColorComponent> f_g(count, 0.0f);
+    std::vector<PDFColorComponent> alpha_g(count, 0.0f);
+    std::vector<uint8_t> isColorDefined(count, 0);
+
+    PDFSeparableBlendRow row;
+    row.count = count;
+    row.pixelSize = source.getPixelSize();
+    row.f_s = f_s.data();
+    row.alpha_s = alpha_s.data();
+    row.alpha_b = alpha_b.data();
+    row.alpha_i_1 = alpha_i_1.data();
+    row.alpha_i = alpha_i.data();
+    row.isColorDefined = isColorDefined.data();
+
+    const size_t initialBackdropPixelSize = initialBackdrop.getPixelSize();
+    const PDFColorComponent f_k_i = alphaIsShape ? constantAlpha : 1.0f;
+    const PDFColorComponent q_k_i = !alphaIsShape ? constantAlpha : 1.0f;
+
+    for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+    {
+        row.source = source.begin() + source.getPixelIndex(left, y);
+        row.backdrop = backdrop.begin() + backdrop.getPixelIndex(left, y);
+        row.target = target.begin() + target.getPixelIndex(left, y);
+        const PDFColorComponent* initialBackdropColor = initialBackdrop.begin() + initialBackdrop.getPixelIndex(left, y);
+        const PDFColorComponent* softMaskColor = blendSoftMask.begin() + blendSoftMask.getPixelIndex(left, y);
+
+        // Shape and opacity, common for all color channels
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t offset = i * row.pixelSize;
+            const PDFColorComponent softMaskValue = softMaskColor[i];
+            const PDFColorComponent f_m_i = alphaIsShape ? softMaskValue : 1.0f;
+            const PDFColorComponent q_m_i = !alphaIsShape ? softMaskValue : 1.0f;
+            const PDFColorComponent f_s_i = row.source[offset + shapeChannel] * f_m_i * f_k_i;
+            const PDFColorComponent alpha_s_i = row.source[offset + opacityChannel] * (f_m_i * q_m_i) * (f_k_i * q_k_i);
+            const PDFColorComponent alpha_g_i_1 = row.target[offset + opacityChannel];
+            const PDFColorComponent alpha_g_b = knockoutGroup ? 0.0f : alpha_g_i_1;
+            const PDFColorComponent alpha_0 = initialBackdropColor[i * initialBackdropPixelSize + opacityChannel];
+            const PDFColorComponent f_g_i_1 = row.target[offset + shapeChannel];
+            const PDFColorComponent alpha_g_i = (1.0f - f_s_i) * alpha_g_i_1 + (f_s_i - alpha_s_i) * alpha_g_b + alpha_s_i;
+            const PDFColorComponent alpha_i_1_value = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i_1);
+
+            f_s[i] = f_s_i;
+            alpha_s[i] = alpha_s_i;
+            alpha_i_1[i] = alpha_i_1_value;
+            alpha_i[i] = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i);
+            alpha_b[i] = knockoutGroup ? alpha_0 : alpha_i_1_value;
+            f_g[i] = PDFBlendFunction::blend_Union(f_g_i_1, f_s_i);
+            alpha_g[i] = alpha_g_i;
+            isColorDefined[i] = !qFuzzyIsNull(alpha_g_i);
+        }
+
+        if (pixelFormat.hasProcessColors())
+        {
+            blendSeparableChannels<mode>(row, pixelFormat.getProcessColorChannelIndexStart(), pixelFormat.getProcessColorChannelIndexEnd(), pixelFormat.hasProcessColorsSubtractive());
+        }
+
+        if (pixelFormat.hasSpotColors())
+        {
+            // For blending spot colors, only white preserving blend modes are possible.
+            // If this is not the case, revert spot color blend mode to normal blending.
+            // See 11.7.4.2 of PDF 2.0 specification.
+            if (PDFBlendModeInfo::isWhitePreserving(mode))
+            {
+                blendSeparableChannels<mode>(row, pixelFormat.getSpotColorChannelIndexStart(), pixelFormat.getSpotColorChannelIndexEnd(), pixelFormat.hasSpotColorsSubtractive());
+            }
+            else
+            {
+                blendSeparableChannels<BlendMode::Normal>(row, pixelFormat.getSpotColorChannelIndexStart(), pixelFormat.getSpotColorChannelIndexEnd(), pixelFormat.hasSpotColorsSubtractive());
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t offset = i * row.pixelSize;
+            row.target[offset + shapeChannel] = f_g[i];
+            row.target[offset + opacityChannel] = alpha_g[i];
+        }
+
+        if (target.hasActiveColorMask())
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (isColorDefined[i])
+                {
+                    const size_t x = left + i;
+                    const uint32_t activeColorChannels = source.hasActiveColorMask() ? source.getPixelActiveColorMask(x, y) : PDFPixelFormat::getAllColorsMask();
+                    target.markPixelActiveColorMask(x, y, activeColorChannels);
+                }
+            }
+        }
+    }
+}
+
 void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
                            PDFFloatBitmap& target,
                            const PDFFloatBitmap& backdrop,
@@ -525,6 +927,95 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
     Q_ASSERT(source.getHeight() == blendSoftMask.getHeight());
     Q_ASSERT(blendSoftMask.getPixelFormat() == PDFPixelFormat::createOpacityMask());
 
+    if (blendRegion.isEmpty())
+    {
+        return;
+    }
+
+    // Separable blend modes without overprinting are blended
+    // using specialized kernels, everything else goes to generic code.
+    if (overprintMode != OverprintMode::NoOveprint)
+    {
+        blendGeneric(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, mode, knockoutGroup, overprintMode, blendRegion);
+        return;
+    }
+
+    switch (mode)
+    {
+        case BlendMode::Normal:
+        case BlendMode::Compatible:
+            blendSeparable<BlendMode::Normal>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Multiply:
+            blendSeparable<BlendMode::Multiply>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Screen:
+            blendSeparable<BlendMode::Screen>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Overlay:
+            blendSeparable<BlendMode::Overlay>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Darken:
+            blendSeparable<BlendMode::Darken>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Lighten:
+            blendSeparable<BlendMode::Lighten>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::ColorDodge:
+            blendSeparable<BlendMode::ColorDodge>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::ColorBurn:
+            blendSeparable<BlendMode::ColorBurn>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::HardLight:
+            blendSeparable<BlendMode::HardLight>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::SoftLight:
+            blendSeparable<BlendMode::SoftLight>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Difference:
+            blendSeparable<BlendMode::Difference>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        case BlendMode::Exclusion:
+            blendSeparable<BlendMode::Exclusion>(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, knockoutGroup, blendRegion);
+            break;
+
+        default:
+            blendGeneric(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, mode, knockoutGroup, overprintMode, blendRegion);
+            break;
+    }
+}
+
+void PDFFloatBitmap::blendGeneric(const PDFFloatBitmap& source,
+                                  PDFFloatBitmap& target,
+                                  const PDFFloatBitmap& backdrop,
+                                  const PDFFloatBitmap& initialBackdrop,
+                                  const PDFFloatBitmap& blendSoftMask,
+                                  bool alphaIsShape,
+                                  PDFColorComponent constantAlpha,
+                                  BlendMode mode,
+                                  bool knockoutGroup,
+                                  OverprintMode overprintMode,
+                                  QRect blendRegion)
+{
+    Q_ASSERT(source.getWidth() == target.getWidth());
+    Q_ASSERT(source.getHeight() == target.getHeight());
+    Q_ASSERT(source.getPixelFormat() == target.getPixelFormat());
+    Q_ASSERT(source.getWidth() == blendSoftMask.getWidth());
+    Q_ASSERT(source.getHeight() == blendSoftMask.getHeight());
+    Q_ASSERT(blendSoftMask.getPixelFormat() == PDFPixelFormat::createOpacityMask());
+
     Q_ASSERT(blendRegion.left() >= 0);
     Q_ASSERT(blendRegion.top() >= 0);
     Q_ASSERT(static_cast<std::size_t>( blendRegion.right() ) < source.getWidth());
@@ -629,9 +1120,9 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
         return channelBlendModes[channel];
     };
 
-    for (int x = blendRegion.left(); x <= blendRegion.right(); ++x)
+    for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
     {
-        for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+        for (int x = blendRegion.left(); x <= blendRegion.right(); ++x)
         {
             PDFConstColorBuffer sourceColor = source.getPixel(x, y);
             PDFColorBuffer targetColor = target.getPixel(x, y);
@@ -910,8 +1401,8 @@ PDFFloatBitmapWithColorSpace::PDFFloatBitmapWithColorSpace(size_t width, size_t
 
 }
 
-PDFFloatBitmapWithColorSpace::PDFFloatBitmapWithColorSpace(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer blendColorSpace) :
-    PDFFloatBitmap(width, height, format),
+PDFFloatBitmapWithColorSpace::PDFFloatBitmapWithColorSpace(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer blendColorSpace, StorageMode storageMode) :
+    PDFFloatBitmap(width, height, format, storageMode),
     m_colorSpace(blendColorSpace)
 {
 
@@ -1083,7 +1574,7 @@ const PDFFloatBitmap& PDFTransparencyRenderer::endPaint()
     return *getImmediateBackdrop();
 }
 
-QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit) const
+QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit)
 {
     QImage image;
 
@@ -1152,13 +1643,56 @@ QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace&
 }
 
 QImage PDFTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const
+{
+    if (m_transparencyGroupDataStack.size() == 1) // We have finished the painting
+    {
+        return toImage(*getImmediateBackdrop(), use16Bit, usePaper, paperColor);
+    }
+
+    return QImage();
+}
+
+QImage PDFTransparencyRenderer::toImage(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit, bool usePaper, const PDFRGB& paperColor)
 {
     QImage image;
 
-    if (m_transparencyGroupDataStack.size() == 1 && // We have finished the painting
-        getImmediateBackdrop()->getPixelFormat().getProcessColorChannelCount() == 3) // We have exactly three process colors (RGB)
+    if (floatImage.getStorageMode() != PDFFloatBitmap::StorageMode::Float)
+    {
+        // Image is converted by strips, so bitmap
+        // stored in reduced precision is never expanded as a whole.
+        constexpr size_t STRIP_HEIGHT = 256;
+
+        const size_t width = floatImage.getWidth();
+        const size_t height = floatImage.getHeight();
+
+        for (size_t y = 0; y < height; y += STRIP_HEIGHT)
+        {
+            PDFFloatBitmapWithColorSpace strip(width, qMin(STRIP_HEIGHT, height - y), floatImage.getPixelFormat(), floatImage.getColorSpace());
+            strip.copyRegion(floatImage, 0, y);
+
+            QImage stripImage = toImage(strip, use16Bit, usePaper, paperColor);
+            if (stripImage.isNull())
+            {
+                return QImage();
+            }
+
+            if (image.isNull())
+            {
+                image = QImage(int(width), int(height), stripImage.format());
+            }
+
+            const size_t bytesPerLine = qMin<size_t>(image.bytesPerLine(), stripImage.bytesPerLine());
+            for (int row = 0; row < stripImage.height(); ++row)
+            {
+                std::copy_n(stripImage.constScanLine(row), bytesPerLine, image.scanLine(int(y) + row));
+            }
+        }
+
+        return image;
+    }
+
+    if (floatImage.getPixelFormat().getProcessColorChannelCount() == 3) // We have exactly three process colors (RGB)
     {
-        const PDFFloatBitmapWithColorSpace& floatImage = *getImmediateBackdrop();
         Q_ASSERT(floatImage.getPixelFormat().hasOpacityChannel());
 
         if (!usePaper)
@@ -2108,6 +2642,19 @@ void PDFTransparencyRenderer::performPathPainting(const QPainterPath& path, bool
 
     QTransform worldMatrix = getCurrentWorldMatrix();
 
+    // Paths outside of the paint area (for example, paths in other tiles
+    // of the tiled renderer) are skipped before the stroke is computed. Stroke
+    // can't exceed the path by more than the miter length (or the square cap).
+    PDFReal margin = 0.0;
+    if (stroke)
+    {
+        margin = qMax(getGraphicState()->getLineWidth(), 1.0) * qMax(getGraphicState()->getMitterLimit(), 2.0);
+    }
+    if (!getActualFillRect(worldMatrix.mapRect(path.controlPointRect().adjusted(-margin, -margin, margin, margin))).isValid())
+    {
+        return;
+    }
+
     const PDFReal shapeStroking = getShapeStroking();
     const PDFReal opacityStroking = getOpacityStroking();
     const PDFReal shapeFilling = getShapeFilling();
@@ -2525,6 +3072,15 @@ void PDFTransparencyRenderer::performBeginTransparencyGroup(ProcessOrder order,
         // Create draw buffer
         m_drawBuffer = PDFDrawBuffer(data.immediateBackdrop.getWidth(), data.immediateBackdrop.getHeight(), data.immediateBackdrop.getPixelFormat());
 
+        // Backdrops of the parent group are not used until this
+        // group is finished, so we can store them in reduced precision.
+        if (m_settings.flags.testFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage))
+        {
+            PDFTransparencyGroupPainterData& parentData = m_transparencyGroupDataStack.back();
+            parentData.initialBackdrop.setStorageMode(PDFFloatBitmap::StorageMode::Fixed16);
+            parentData.immediateBackdrop.setStorageMode(PDFFloatBitmap::StorageMode::Fixed16);
+        }
+
         m_transparencyGroupDataStack.emplace_back(qMove(data));
         invalidateCachedItems();
     }
@@ -2566,7 +3122,16 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
 
         if (sourceData.saveOriginalImage)
         {
-            m_originalProcessBitmap = sourceData.immediateBackdrop;
+            if (m_settings.flags.testFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage))
+            {
+                const PDFFloatBitmapWithColorSpace& image = sourceData.immediateBackdrop;
+                m_originalProcessBitmap = PDFFloatBitmapWithColorSpace(image.getWidth(), image.getHeight(), image.getPixelFormat(), image.getColorSpace(), PDFFloatBitmap::StorageMode::Fixed16);
+                m_originalProcessBitmap.copyBitmap(image, 0, 0);
+            }
+            else
+            {
+                m_originalProcessBitmap = sourceData.immediateBackdrop;
+            }
         }
 
         // Collapse spot colors
@@ -2576,6 +3141,8 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
         }
 
         PDFTransparencyGroupPainterData& targetData = m_transparencyGroupDataStack.back();
+        targetData.initialBackdrop.setStorageMode(PDFFloatBitmap::StorageMode::Float);
+        targetData.immediateBackdrop.setStorageMode(PDFFloatBitmap::StorageMode::Float);
         sourceData.immediateBackdrop.convertToColorSpace(getCMS(), targetData.renderingIntent, targetData.blendColorSpace, this);
 
         PDFOverprintMode overprintMode = getGraphicState()->getOverprintMode();
@@ -2622,6 +3189,13 @@ bool PDFTransparencyRenderer::performOriginalImagePainting(const PDFImage& image
 {
     Q_UNUSED(stream);
 
+    // Image is painted into the unit square, images outside of the paint
+    // area are not converted at all.
+    if (!getActualFillRect(getCurrentWorldMatrix().mapRect(QRectF(0.0, 0.0, 1.0, 1.0))).isValid())
+    {
+        return true;
+    }
+
     PDFFloatBitmap texture = getImage(image);
 
     if (m_settings.flags.testFlag(PDFTransparencyRendererSettings::SmoothImageTransformation) && image.isInterpolated())
@@ -3213,111 +3787,198 @@ void PDFInkMapper::createSpotColors(bool activate)
     m_spotColors.clear();
     m_activeSpotColors = 0;
 
-    PDFRenderErrorReporterDummy renderErrorReporter;
-    PDFCMSPointer cms = m_cmsManager ? m_cmsManager->getCurrentCMS() : nullptr;
+    std::vector<PDFInteger> pageIndices(m_document->getCatalog()->getPageCount(), 0);
+    std::iota(pageIndices.begin(), pageIndices.end(), 0);
 
-    const PDFCatalog* catalog = m_document->getCatalog();
-    const size_t pageCount = catalog->getPageCount();
-    for (size_t i = 0; i < pageCount; ++i)
-    {
-        const PDFPage* page = catalog->getPage(i);
-        PDFObject resources = m_document->getObject(page->getResources());
+    addSpotColors(pageIndices, activate);
+}
 
-        if (resources.isDictionary() && resources.getDictionary()->hasKey("ColorSpace"))
-        {
-            const PDFDictionary* colorSpaceDictionary = m_document->getDictionaryFromObject(resources.getDictionary()->get("ColorSpace"));
-            if (colorSpaceDictionary)
-            {
-                std::size_t colorSpaces = colorSpaceDictionary->getCount();
-                for (size_t csIndex = 0; csIndex < colorSpaces; ++ csIndex)
-                {
-                    PDFColorSpacePointer colorSpacePointer;
-                    try
-                    {
-                        colorSpacePointer = PDFAbstractColorSpace::createColorSpace(colorSpaceDictionary, m_document, m_document->getObject(colorSpaceDictionary->getValue(csIndex)));
-                    }
-                    catch (const PDFException&)
-                    {
-                        // Ignore invalid color spaces
-                        continue;
-                    }
+void PDFInkMapper::addSpotColors(const std::vector<PDFInteger>& pageIndices, bool activate)
+{
+    mergeSpotColors(findSpotColors(pageIndices), activate);
+}
 
-                    if (!colorSpacePointer)
-                    {
-                        continue;
-                    }
+std::vector<PDFInkMapper::ColorInfo> PDFInkMapper::findSpotColors(const std::vector<PDFInteger>& pageIndices, bool parallel) const
+{
+    std::vector<std::vector<ColorInfo>> pageSpotColors(pageIndices.size());
 
-                    switch (colorSpacePointer->getColorSpace())
+    auto scanPage = [this, &pageIndices, &pageSpotColors](const PDFInteger& pageIndex)
+    {
+        const size_t index = std::distance(pageIndices.data(), &pageIndex);
+
+        PDFSpotColorCache* cache = PDFSpotColorCache::getInstance();
+        PDFSpotColorCache::Key key{ m_document, pageIndex };
+
+        if (!cache->getSpotColors(key, pageSpotColors[index]))
+        {
+            pageSpotColors[index] = scanPageSpotColors(pageIndex);
+            cache->setSpotColors(key, pageSpotColors[index]);
+        }
+    };
+
+    if (parallel)
+    {
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.cbegin(), pageIndices.cend(), scanPage);
+    }
+    else
+    {
+        std::for_each(pageIndices.cbegin(), pageIndices.cend(), scanPage);
+    }
+
+    // Merge spot colors in page order, so the order of spot
+    // colors doesn't depend on the order, in which pages were scanned.
+    std::vector<ColorInfo> result;
+    for (std::vector<ColorInfo>& spotColors : pageSpotColors)
+    {
+        for (ColorInfo& info : spotColors)
+        {
+            auto it = std::find_if(result.cbegin(), result.cend(), [&info](const auto& resultInfo) { return resultInfo.name == info.name; });
+            if (it == result.cend())
+            {
+                result.emplace_back(qMove(info));
+            }
+        }
+    }
+
+    PDFRenderErrorReporterDummy renderErrorReporter;
+    PDFCMSPointer cms = m_cmsManager ? m_cmsManager->getCurrentCMS() : nullptr;
+
+    if (cms)
+    {
+        for (ColorInfo& info : result)
+        {
+            PDFColor color;
+            color.resize(info.colorSpace->getColorComponentCount());
+            color[info.colorSpaceIndex] = 1.0f;
+            info.color = info.colorSpace->getColor(color, cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true);
+        }
+    }
+
+    return result;
+}
+
+void PDFInkMapper::mergeSpotColors(const std::vector<ColorInfo>& spotColors, bool activate)
+{
+    for (const ColorInfo& spotColor : spotColors)
+    {
+        if (containsSpotColor(spotColor.name) || containsProcessColor(spotColor.name))
+        {
+            continue;
+        }
+
+        ColorInfo info = spotColor;
+        info.spotColorIndex = uint32_t(m_spotColors.size());
+        info.canBeActive = info.spotColorIndex < MAX_SPOT_COLOR_COMPONENTS;
+        info.active = activate && info.canBeActive;
+
+        if (info.active)
+        {
+            ++m_activeSpotColors;
+        }
+
+        m_spotColors.emplace_back(qMove(info));
+    }
+}
+
+std::vector<PDFInkMapper::ColorInfo> PDFInkMapper::scanPageSpotColors(PDFInteger pageIndex) const
+{
+    std::vector<ColorInfo> spotColors;
+
+    const PDFCatalog* catalog = m_document->getCatalog();
+    if (pageIndex < 0 || size_t(pageIndex) >= catalog->getPageCount())
+    {
+        return spotColors;
+    }
+
+    const PDFPage* page = catalog->getPage(pageIndex);
+
+    auto containsColor = [&spotColors](const QByteArray& colorName)
+    {
+        return std::find_if(spotColors.cbegin(), spotColors.cend(), [&colorName](const auto& info) { return info.name == colorName; }) != spotColors.cend();
+    };
+
+    PDFObject resources = m_document->getObject(page->getResources());
+
+    if (resources.isDictionary() && resources.getDictionary()->hasKey("ColorSpace"))
+    {
+        const PDFDictionary* colorSpaceDictionary = m_document->getDictionaryFromObject(resources.getDictionary()->get("ColorSpace"));
+        if (colorSpaceDictionary)
+        {
+            std::size_t colorSpaces = colorSpaceDictionary->getCount();
+            for (size_t csIndex = 0; csIndex < colorSpaces; ++ csIndex)
+            {
+                PDFColorSpacePointer colorSpacePointer;
+                try
+                {
+                    colorSpacePointer = PDFAbstractColorSpace::createColorSpace(colorSpaceDictionary, m_document, m_document->getObject(colorSpaceDictionary->getValue(csIndex)));
+                }
+                catch (const PDFException&)
+                {
+                    // Ignore invalid color spaces
+                    continue;
+                }
+
+                if (!colorSpacePointer)
+                {
+                    continue;
+                }
+
+                switch (colorSpacePointer->getColorSpace())
+                {
+                    case PDFAbstractColorSpace::ColorSpace::Separation:
                     {
-                        case PDFAbstractColorSpace::ColorSpace::Separation:
-                        {
-                            const PDFSeparationColorSpace* separationColorSpace = dynamic_cast<const PDFSeparationColorSpace*>(colorSpacePointer.data());
+                        const PDFSeparationColorSpace* separationColorSpace = dynamic_cast<const PDFSeparationColorSpace*>(colorSpacePointer.data());
 
-                            if (!separationColorSpace->isNone() && !separationColorSpace->isAll() && !separationColorSpace->getColorName().isEmpty())
+                        if (!separationColorSpace->isNone() && !separationColorSpace->isAll() && !separationColorSpace->getColorName().isEmpty())
+                        {
+                            // Try to add spot color
+                            const QByteArray& colorName = separationColorSpace->getColorName();
+                            if (!containsColor(colorName) && !containsProcessColor(colorName))
                             {
-                                // Try to add spot color
-                                const QByteArray& colorName = separationColorSpace->getColorName();
-                                if (!containsSpotColor(colorName) && !containsProcessColor(colorName))
-                                {
-                                    ColorInfo info;
-                                    info.name = colorName;
-                                    info.textName = PDFEncoding::convertTextString(info.name);
-                                    info.colorSpace = colorSpacePointer;
-                                    info.spotColorIndex = uint32_t(m_spotColors.size());
-                                    info.color = cms ? separationColorSpace->getColor(pdf::PDFColor(1.0f), cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true) : nullptr;
-                                    m_spotColors.emplace_back(qMove(info));
-                                }
+                                ColorInfo info;
+                                info.name = colorName;
+                                info.textName = PDFEncoding::convertTextString(info.name);
+                                info.colorSpace = colorSpacePointer;
+                                spotColors.emplace_back(qMove(info));
                             }
-
-                            break;
                         }
 
-                        case PDFAbstractColorSpace::ColorSpace::DeviceN:
-                        {
-                            const PDFDeviceNColorSpace* deviceNColorSpace = dynamic_cast<const PDFDeviceNColorSpace*>(colorSpacePointer.data());
+                        break;
+                    }
 
-                            if (!deviceNColorSpace->isNone())
+                    case PDFAbstractColorSpace::ColorSpace::DeviceN:
+                    {
+                        const PDFDeviceNColorSpace* deviceNColorSpace = dynamic_cast<const PDFDeviceNColorSpace*>(colorSpacePointer.data());
+
+                        if (!deviceNColorSpace->isNone())
+                        {
+                            const PDFDeviceNColorSpace::Colorants& colorants = deviceNColorSpace->getColorants();
+                            for (size_t ii = 0; ii < colorants.size(); ++ii)
                             {
-                                const PDFDeviceNColorSpace::Colorants& colorants = deviceNColorSpace->getColorants();
-                                for (size_t ii = 0; ii < colorants.size(); ++ii)
+                                const PDFDeviceNColorSpace::ColorantInfo& colorantInfo = colorants[ii];
+                                if (!containsColor(colorantInfo.name) && !containsProcessColor(colorantInfo.name))
                                 {
-                                    const PDFDeviceNColorSpace::ColorantInfo& colorantInfo = colorants[ii];
-                                    if (!containsSpotColor(colorantInfo.name) && !containsProcessColor(colorantInfo.name))
-                                    {
-                                        PDFColor color;
-                                        color.resize(deviceNColorSpace->getColorComponentCount());
-                                        color[ii] = 1.0f;
-
-                                        ColorInfo info;
-                                        info.name = colorantInfo.name;
-                                        info.textName = PDFEncoding::convertTextString(info.name);
-                                        info.colorSpaceIndex = uint32_t(ii);
-                                        info.colorSpace = colorSpacePointer;
-                                        info.spotColorIndex = uint32_t(m_spotColors.size());
-                                        info.color = cms ? deviceNColorSpace->getColor(color, cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true) : nullptr;
-                                        m_spotColors.emplace_back(qMove(info));
-                                    }
+                                    ColorInfo info;
+                                    info.name = colorantInfo.name;
+                                    info.textName = PDFEncoding::convertTextString(info.name);
+                                    info.colorSpaceIndex = uint32_t(ii);
+                                    info.colorSpace = colorSpacePointer;
+                                    spotColors.emplace_back(qMove(info));
                                 }
                             }
-
-                            break;
                         }
 
-                        default:
-                            break;
+                        break;
                     }
+
+                    default:
+                        break;
                 }
             }
         }
     }
 
-    size_t minIndex = qMin<uint32_t>(uint32_t(m_spotColors.size()), MAX_SPOT_COLOR_COMPONENTS);
-    for (size_t i = 0; i < minIndex; ++i)
-    {
-        m_spotColors[i].canBeActive = true;
-    }
-
-    setSpotColorsActive(activate);
+    return spotColors;
 }
 
 bool PDFInkMapper::containsSpotColor(const QByteArray& colorName) const
@@ -3514,6 +4175,60 @@ PDFInkMapping PDFInkMapper::createMapping(const PDFAbstractColorSpace* sourceCol
     return mapping;
 }
 
+inline size_t qHash(const PDFSpotColorCache::Key& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.document, key.pageIndex);
+}
+
+PDFSpotColorCache::PDFSpotColorCache() :
+    m_spotColors(DEFAULT_CACHE_LIMIT)
+{
+
+}
+
+PDFSpotColorCache* PDFSpotColorCache::getInstance()
+{
+    static PDFSpotColorCache instance;
+    return &instance;
+}
+
+bool PDFSpotColorCache::getSpotColors(const Key& key, std::vector<PDFInkMapper::ColorInfo>& spotColors) const
+{
+    QMutexLocker lock(&m_mutex);
+    if (const std::vector<PDFInkMapper::ColorInfo>* cachedSpotColors = m_spotColors.object(key))
+    {
+        spotColors = *cachedSpotColors;
+        return true;
+    }
+
+    return false;
+}
+
+void PDFSpotColorCache::setSpotColors(const Key& key, std::vector<PDFInkMapper::ColorInfo> spotColors)
+{
+    QMutexLocker lock(&m_mutex);
+    m_spotColors.insert(key, new std::vector<PDFInkMapper::ColorInfo>(qMove(spotColors)));
+}
+
+void PDFSpotColorCache::clear(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const Key& key : m_spotColors.keys())
+    {
+        if (key.document == document)
+        {
+            m_spotColors.remove(key);
+        }
+    }
+}
+
+void PDFSpotColorCache::setCacheLimit(qsizetype cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_spotColors.setMaxCost(cacheLimit);
+}
+
 PDFPainterPathSampler::PDFPainterPathSampler(QPainterPath path, int samplesCount, PDFColorComponent defaultShape, QRect fillRect, bool precise) :
     m_defaultShape(defaultShape),
     m_samplesCount(qMax(samplesCount, 1)),
@@ -3855,6 +4570,121 @@ void PDFTransparencyRenderer::PDFTransparencySoftMask::makeOpaque()
     }
 }
 
+PDFTiledTransparencyRenderer::PDFTiledTransparencyRenderer(const PDFPage* page,
+                                                           const PDFDocument* document,
+                                                           const PDFFontCache* fontCache,
+                                                           const PDFCMS* cms,
+                                                           const PDFOptionalContentActivity* optionalContentActivity,
+                                                           const PDFInkMapper* inkMapper,
+                                                           PDFTransparencyRendererSettings settings,
+                                                           QTransform pagePointToDevicePointMatrix) :
+    m_page(page),
+    m_document(document),
+    m_fontCache(fontCache),
+    m_cms(cms),
+    m_optionalContentActivity(optionalContentActivity),
+    m_inkMapper(inkMapper),
+    m_settings(settings),
+    m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix)
+{
+
+}
+
+QList<PDFRenderError> PDFTiledTransparencyRenderer::render(QSize pixelSize)
+{
+    Q_ASSERT(pixelSize.isValid());
+
+    m_deviceBitmap = PDFFloatBitmapWithColorSpace();
+    m_originalProcessBitmap = PDFFloatBitmapWithColorSpace();
+
+    const int tileSize = qMax(m_settings.tileSize, 1);
+    std::vector<QRect> tiles;
+    for (int y = 0; y < pixelSize.height(); y += tileSize)
+    {
+        for (int x = 0; x < pixelSize.width(); x += tileSize)
+        {
+            tiles.emplace_back(x, y, qMin(tileSize, pixelSize.width() - x), qMin(tileSize, pixelSize.height() - y));
+        }
+    }
+
+    QMutex mutex;
+    QList<PDFRenderError> errors;
+
+    auto renderTile = [&](const QRect& tile)
+    {
+        // Each tile is rendered by its own renderer, which uses page
+        // to device matrix shifted by tile position, so graphics is painted exactly
+        // at the same pixels, as if whole page was rendered at once.
+        const QTransform tilePagePointToDevicePointMatrix = m_pagePointToDevicePointMatrix * QTransform::fromTranslate(-tile.left(), -tile.top());
+
+        PDFTransparencyRenderer renderer(m_page, m_document, m_fontCache, m_cms, m_optionalContentActivity,
+                                         m_inkMapper, m_settings, tilePagePointToDevicePointMatrix);
+        if (m_deviceColorSpace)
+        {
+            renderer.setDeviceColorSpace(m_deviceColorSpace);
+        }
+        if (m_processColorSpace)
+        {
+            renderer.setProcessColorSpace(m_processColorSpace);
+        }
+
+        renderer.beginPaint(tile.size());
+        QList<PDFRenderError> tileErrors = renderer.processContents();
+        renderer.endPaint();
+
+        const PDFFloatBitmapWithColorSpace& tileDeviceBitmap = renderer.getDeviceBitmap();
+        const PDFFloatBitmapWithColorSpace tileOriginalProcessBitmap = renderer.getOriginalProcessBitmap();
+        const bool hasOriginalProcessBitmap = tileOriginalProcessBitmap.getPixelFormat().isValid();
+
+        {
+            QMutexLocker lock(&mutex);
+
+            // Result bitmaps are created, when first tile is finished
+            if (m_deviceBitmap.getWidth() == 0)
+            {
+                const PDFFloatBitmap::StorageMode storageMode = m_settings.flags.testFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage) ? PDFFloatBitmap::StorageMode::Fixed16
+                                                                                                                                                   : PDFFloatBitmap::StorageMode::Float;
+                m_deviceBitmap = PDFFloatBitmapWithColorSpace(pixelSize.width(), pixelSize.height(), tileDeviceBitmap.getPixelFormat(), tileDeviceBitmap.getColorSpace(), storageMode);
+
+                if (hasOriginalProcessBitmap)
+                {
+                    m_originalProcessBitmap = PDFFloatBitmapWithColorSpace(pixelSize.width(), pixelSize.height(), tileOriginalProcessBitmap.getPixelFormat(), tileOriginalProcessBitmap.getColorSpace(), storageMode);
+                }
+            }
+
+            for (PDFRenderError& error : tileErrors)
+            {
+                auto isSameError = [&error](const PDFRenderError& item) { return item.type == error.type && item.message == error.message; };
+                if (std::none_of(errors.cbegin(), errors.cend(), isSameError))
+                {
+                    errors.push_back(qMove(error));
+                }
+            }
+        }
+
+        // Tiles do not overlap, so they can be copied without locking
+        m_deviceBitmap.copyBitmap(tileDeviceBitmap, tile.left(), tile.top());
+
+        if (hasOriginalProcessBitmap)
+        {
+            m_originalProcessBitmap.copyBitmap(tileOriginalProcessBitmap, tile.left(), tile.top());
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, tiles.cbegin(), tiles.cend(), renderTile);
+    return errors;
+}
+
+QImage PDFTiledTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const
+{
+    if (m_deviceBitmap.getWidth() == 0)
+    {
+        return QImage();
+    }
+
+    return PDFTransparencyRenderer::toImage(m_deviceBitmap, use16Bit, usePaper, paperColor);
+}
+
 PDFInkCoverageCalculator::PDFInkCoverageCalculator(const PDFDocument* document,
                                                    const PDFFontCache* fontCache,
                                                    const PDFCMSManager* cmsManager,
@@ -3892,115 +4722,191 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
 
     auto calculatePageCoverage = [this, size](PDFInteger pageIndex)
     {
-        if (pageIndex >= PDFInteger(m_document->getCatalog()->getPageCount()))
-        {
-            return;
-        }
+        std::vector<InkCoverageChannelInfo> results = calculatePageInkCoverage(size, pageIndex);
 
-        const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
-        if (!page)
+        if (m_progress)
         {
-            return;
+            m_progress->step();
         }
 
-        QRectF pageRect = page->getRotatedMediaBox();
-        QSizeF pageSize = pageRect.size();
-        pageSize.scale(size.width(), size.height(), Qt::KeepAspectRatio);
-        QSize imageSize = pageSize.toSize();
-
-        if (!imageSize.isValid())
+        if (results.empty())
         {
             return;
         }
 
-        pdf::PDFTransparencyRendererSettings settings;
-        settings.flags.setFlag(PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+        QMutexLocker lock(&m_mutex);
+        m_inkCoverageResults[pageIndex] = qMove(results);
+    };
 
-        // Jakub Melka: debug is very slow, use multithreading
-#ifdef QT_DEBUG
-        settings.flags.setFlag(PDFTransparencyRendererSettings::MultithreadedPathSampler, true);
-#endif
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pages.begin(), pages.end(), calculatePageCoverage);
 
-        settings.flags.setFlag(PDFTransparencyRendererSettings::ActiveColorMask, false);
-        settings.flags.setFlag(PDFTransparencyRendererSettings::SeparationSimulation, true);
-        settings.activeColorMask = PDFPixelFormat::getAllColorsMask();
+    if (m_progress)
+    {
+        m_progress->finish();
+    }
+}
 
-        QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
-        pdf::PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
-        pdf::PDFTransparencyRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
-                                              m_inkMapper, settings, pagePointToDevicePoint);
+void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>& pages, int concurrency, const PageInkCoverageCallback& callback)
+{
+    if (pages.empty())
+    {
+        // Nothing to do
+        return;
+    }
 
-        renderer.beginPaint(imageSize);
-        renderer.processContents();
-        renderer.endPaint();
+    if (m_progress)
+    {
+        m_progress->start(pages.size(), ProgressStartupInfo());
+    }
 
-        PDFFloatBitmapWithColorSpace originalProcessImage = renderer.getOriginalProcessBitmap();
-        QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
+    if (concurrency <= 0)
+    {
+        concurrency = PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Page);
+    }
 
-        pdf::PDFPixelFormat pixelFormat = originalProcessImage.getPixelFormat();
-        pdf::PDFColorComponent totalArea = pageSizeMM.width() * pageSizeMM.height();
-        pdf::PDFColorComponent pixelArea = totalArea / pdf::PDFColorComponent(originalProcessImage.getWidth() * originalProcessImage.getHeight());
+    const size_t batchSize = size_t(qMax(concurrency, 1));
+    std::vector<std::vector<InkCoverageChannelInfo>> batchResults(qMin(batchSize, pages.size()));
 
-        std::vector<PDFColorComponent> pageCoverage;
-        const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
-        pageCoverage.resize(colorChannelCount, 0.0f);
+    for (auto batchBegin = pages.cbegin(); batchBegin != pages.cend();)
+    {
+        const size_t currentBatchSize = qMin<size_t>(batchSize, std::distance(batchBegin, pages.cend()));
+        const auto batchEnd = std::next(batchBegin, currentBatchSize);
 
-        for (size_t y = 0; y < originalProcessImage.getHeight(); ++y)
+        auto calculatePageCoverage = [this, size, batchBegin, &batchResults](const PDFInteger& pageIndex)
         {
-            for (size_t x = 0; x < originalProcessImage.getWidth(); ++x)
-            {
-                const pdf::PDFColorBuffer buffer = originalProcessImage.getPixel(x, y);
-                const pdf::PDFColorComponent alpha = pixelFormat.hasOpacityChannel() ? buffer[pixelFormat.getOpacityChannelIndex()] : 1.0f;
+            const size_t index = std::distance(&*batchBegin, &pageIndex);
+            batchResults[index] = calculatePageInkCoverage(size, pageIndex);
 
-                for (uint8_t i = 0; i < colorChannelCount; ++i)
-                {
-                    pageCoverage[i] += buffer[i] * alpha;
-                }
+            if (m_progress)
+            {
+                m_progress->step();
             }
-        }
+        };
+
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, batchBegin, batchEnd, calculatePageCoverage);
 
-        std::vector<PDFColorComponent> pageRatioCoverage = pageCoverage;
-        for (uint8_t i = 0; i < colorChannelCount; ++i)
+        // Results of the batch are passed in the page order
+        // and released, so memory doesn't grow with page count.
+        for (size_t i = 0; i < currentBatchSize; ++i)
         {
-            pageCoverage[i] *= pixelArea;
-            pageRatioCoverage[i] *= pixelArea / totalArea;
+            if (!batchResults[i].empty())
+            {
+                callback(*std::next(batchBegin, i), batchResults[i]);
+            }
+
+            batchResults[i] = std::vector<InkCoverageChannelInfo>();
         }
 
-        std::vector<PDFInkMapper::ColorInfo> separations = m_inkMapper->getSeparations(pixelFormat.getProcessColorChannelCount());
-        Q_ASSERT(pixelFormat.getColorChannelCount() == separations.size());
+        batchBegin = batchEnd;
+    }
 
-        std::vector<InkCoverageChannelInfo> results;
-        results.reserve(separations.size());
+    if (m_progress)
+    {
+        m_progress->finish();
+    }
+}
 
-        for (size_t i = 0; i < separations.size(); ++i)
-        {
-            const PDFInkMapper::ColorInfo& colorInfo = separations[i];
+std::vector<PDFInkCoverageCalculator::InkCoverageChannelInfo> PDFInkCoverageCalculator::calculatePageInkCoverage(QSize size, PDFInteger pageIndex) const
+{
+    if (pageIndex >= PDFInteger(m_document->getCatalog()->getPageCount()))
+    {
+        return { };
+    }
 
-            InkCoverageChannelInfo info;
-            info.color = colorInfo.color;
-            info.name = colorInfo.name;
-            info.textName = colorInfo.textName;
-            info.isSpot = colorInfo.isSpot;
-            info.coveredArea = pageCoverage[i];
-            info.ratio = pageRatioCoverage[i];
-            results.emplace_back(qMove(info));
-        }
+    const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        return { };
+    }
 
-        if (m_progress)
+    QRectF pageRect = page->getRotatedMediaBox();
+    QSizeF pageSize = pageRect.size();
+    pageSize.scale(size.width(), size.height(), Qt::KeepAspectRatio);
+    QSize imageSize = pageSize.toSize();
+
+    if (!imageSize.isValid())
+    {
+        return { };
+    }
+
+    pdf::PDFTransparencyRendererSettings settings;
+    settings.flags.setFlag(PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+
+    // Jakub Melka: debug is very slow, use multithreading
+#ifdef QT_DEBUG
+    settings.flags.setFlag(PDFTransparencyRendererSettings::MultithreadedPathSampler, true);
+#endif
+
+    settings.flags.setFlag(PDFTransparencyRendererSettings::ActiveColorMask, false);
+    settings.flags.setFlag(PDFTransparencyRendererSettings::SeparationSimulation, true);
+    settings.flags.setFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage, m_settings.flags.testFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage));
+    settings.activeColorMask = PDFPixelFormat::getAllColorsMask();
+
+    QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
+    pdf::PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+    pdf::PDFTransparencyRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
+                                          m_inkMapper, settings, pagePointToDevicePoint);
+
+    renderer.beginPaint(imageSize);
+    renderer.processContents();
+    renderer.endPaint();
+
+    PDFFloatBitmapWithColorSpace originalProcessImage = renderer.getOriginalProcessBitmap();
+    QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
+
+    pdf::PDFPixelFormat pixelFormat = originalProcessImage.getPixelFormat();
+    pdf::PDFColorComponent totalArea = pageSizeMM.width() * pageSizeMM.height();
+    pdf::PDFColorComponent pixelArea = totalArea / pdf::PDFColorComponent(originalProcessImage.getWidth() * originalProcessImage.getHeight());
+
+    std::vector<PDFColorComponent> pageCoverage;
+    const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
+    pageCoverage.resize(colorChannelCount, 0.0f);
+
+    std::vector<PDFColorComponent> pixel(originalProcessImage.getPixelSize(), 0.0f);
+    const pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
+
+    for (size_t y = 0; y < originalProcessImage.getHeight(); ++y)
+    {
+        for (size_t x = 0; x < originalProcessImage.getWidth(); ++x)
         {
-            m_progress->step();
+            originalProcessImage.readPixel(x, y, buffer);
+            const pdf::PDFColorComponent alpha = pixelFormat.hasOpacityChannel() ? buffer[pixelFormat.getOpacityChannelIndex()] : 1.0f;
+
+            for (uint8_t i = 0; i < colorChannelCount; ++i)
+            {
+                pageCoverage[i] += buffer[i] * alpha;
+            }
         }
+    }
 
-        QMutexLocker lock(&m_mutex);
-        m_inkCoverageResults[pageIndex] = qMove(results);
-    };
+    std::vector<PDFColorComponent> pageRatioCoverage = pageCoverage;
+    for (uint8_t i = 0; i < colorChannelCount; ++i)
+    {
+        pageCoverage[i] *= pixelArea;
+        pageRatioCoverage[i] *= pixelArea / totalArea;
+    }
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pages.begin(), pages.end(), calculatePageCoverage);
+    std::vector<PDFInkMapper::ColorInfo> separations = m_inkMapper->getSeparations(pixelFormat.getProcessColorChannelCount());
+    Q_ASSERT(pixelFormat.getColorChannelCount() == separations.size());
 
-    if (m_progress)
+    std::vector<InkCoverageChannelInfo> results;
+    results.reserve(separations.size());
+
+    for (size_t i = 0; i < separations.size(); ++i)
     {
-        m_progress->finish();
+        const PDFInkMapper::ColorInfo& colorInfo = separations[i];
+
+        InkCoverageChannelInfo info;
+        info.color = colorInfo.color;
+        info.name = colorInfo.name;
+        info.textName = colorInfo.textName;
+        info.isSpot = colorInfo.isSpot;
+        info.coveredArea = pageCoverage[i];
+        info.ratio = pageRatioCoverage[i];
+        results.emplace_back(qMove(info));
     }
+
+    return results;
 }
 
 void PDFInkCoverageCalculator::clear()
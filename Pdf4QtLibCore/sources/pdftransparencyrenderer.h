@@ -26,6 +26,10 @@
 #include "pdfprogress.h"
 
 #include <QImage>
+#include <QMutex>
+#include <QCache>
+
+#include <functional>
 
 namespace pdf
 {
@@ -140,8 +144,24 @@ private:
 class PDF4QTLIBCORESHARED_EXPORT PDFFloatBitmap
 {
 public:
+    /// Storage mode of the bitmap data. Reduced precision storage mode stores each
+    /// channel as 16-bit fixed point number, so bitmap needs half of the memory.
+    /// Values are clamped to the range [0, 1] and rounded to the nearest multiple
+    /// of 1 / 65535, so absolute error of the stored value is half of the step
+    /// plus float rounding error, less than 7.7e-6 in total, which is well below
+    /// one level of 8-bit output (1 / 255). Bitmaps in reduced precision storage
+    /// mode can't be accessed using pointers to the data (functions getPixel,
+    /// getPixels, begin, end, and functions modifying the bitmap), pixels are read
+    /// using function readPixel, and written using functions copyBitmap and
+    /// setStorageMode.
+    enum class StorageMode
+    {
+        Float,      ///< Channels are stored as 32-bit floats
+        Fixed16,    ///< Channels are stored as 16-bit fixed point numbers (reduced precision)
+    };
+
     explicit PDFFloatBitmap();
-    explicit PDFFloatBitmap(size_t width, size_t height, PDFPixelFormat format);
+    explicit PDFFloatBitmap(size_t width, size_t height, PDFPixelFormat format, StorageMode storageMode = StorageMode::Float);
 
     PDFFloatBitmap(const PDFFloatBitmap&) = default;
     PDFFloatBitmap(PDFFloatBitmap&&) = default;
@@ -158,6 +178,21 @@ public:
     /// Returns buffer with all pixels
     PDFColorBuffer getPixels();
 
+    /// Reads pixel channels into the buffer. Buffer must have pixel size
+    /// channels. This function can be used in all storage modes.
+    /// \param x Horizontal coordinate of the pixel
+    /// \param y Vertical coordinate of the pixel
+    /// \param buffer Target buffer
+    void readPixel(size_t x, size_t y, PDFColorBuffer buffer) const;
+
+    /// Returns storage mode of the bitmap data
+    StorageMode getStorageMode() const { return m_storageMode; }
+
+    /// Converts bitmap data to given storage mode. Converting
+    /// to reduced precision storage mode loses precision.
+    /// \param storageMode Storage mode
+    void setStorageMode(StorageMode storageMode);
+
     /// Returns ink coverage
     PDFColorComponent getPixelInkCoverage(size_t x, size_t y) const;
 
@@ -255,6 +290,22 @@ public:
     /// \param channelTo Target channel
     void copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t channelFrom, uint8_t channelTo);
 
+    /// Copies all pixels of the source bitmap into this bitmap at given position.
+    /// Pixel format must be the same and source bitmap must fit into this bitmap.
+    /// Storage modes of the bitmaps can differ.
+    /// \param sourceBitmap Source bitmap
+    /// \param x Horizontal coordinate of the top-left corner of the source bitmap
+    /// \param y Vertical coordinate of the top-left corner of the source bitmap
+    void copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y);
+
+    /// Fills this bitmap with pixels of the source bitmap region, which starts at
+    /// given position and has size of this bitmap. Pixel format must be the same
+    /// and region must fit into the source bitmap. Storage modes of the bitmaps can differ.
+    /// \param sourceBitmap Source bitmap
+    /// \param x Horizontal coordinate of the top-left corner of the region
+    /// \param y Vertical coordinate of the top-left corner of the region
+    void copyRegion(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y);
+
     /// Resize the bitmap using given transformation mode. Fast transformation mode
     /// uses nearest neighbour mapping, smooth transformation mode uses weighted
     /// averaging algorithm.
@@ -296,6 +347,22 @@ public:
                       OverprintMode overprintMode,
                       QRect blendRegion);
 
+    /// Performs bitmap blending using generic scalar code, which handles all blend
+    /// modes and overprint modes. Function \p blend uses it as a fallback, when
+    /// no specialized kernel exists for given blend mode and overprint mode.
+    /// Parameters are the same as in function \p blend.
+    static void blendGeneric(const PDFFloatBitmap& source,
+                             PDFFloatBitmap& target,
+                             const PDFFloatBitmap& backdrop,
+                             const PDFFloatBitmap& initialBackdrop,
+                             const PDFFloatBitmap& softMask,
+                             bool alphaIsShape,
+                             PDFColorComponent constantAlpha,
+                             BlendMode mode,
+                             bool knockoutGroup,
+                             OverprintMode overprintMode,
+                             QRect blendRegion);
+
     /// Blends converted spot colors, which are in \p convertedSpotColors bitmap.
     /// Process colors must match.
     /// \param convertedSpotColors Bitmap with converted spot colors
@@ -310,11 +377,28 @@ public:
     static PDFFloatBitmap createOpaqueSoftMask(size_t width, size_t height);
 
 private:
+    /// Copies components between bitmaps, converting them between storage modes
+    /// \param source Source bitmap
+    /// \param sourceIndex Index of the first source component
+    /// \param target Target bitmap
+    /// \param targetIndex Index of the first target component
+    /// \param count Component count
+    static void copyComponents(const PDFFloatBitmap& source, size_t sourceIndex, PDFFloatBitmap& target, size_t targetIndex, size_t count);
+
+    static inline uint16_t encodeFixed16(PDFColorComponent value) { return static_cast<uint16_t>(qBound(0.0f, value, 1.0f) * 65535.0f + 0.5f); }
+    static inline PDFColorComponent decodeFixed16(uint16_t value) { return value * (1.0f / 65535.0f); }
+
+    /// Returns component at given index in the data block (in any storage mode)
+    /// \param index Index of the component
+    PDFColorComponent getComponent(size_t index) const { return (m_storageMode == StorageMode::Float) ? m_data[index] : decodeFixed16(m_fixed16Data[index]); }
+
     PDFPixelFormat m_format;
     std::size_t m_width;
     std::size_t m_height;
     std::size_t m_pixelSize;
+    StorageMode m_storageMode = StorageMode::Float;
     std::vector<PDFColorComponent> m_data;
+    std::vector<uint16_t> m_fixed16Data;
     std::vector<uint32_t> m_activeColorMask;
 };
 
@@ -324,7 +408,7 @@ class PDF4QTLIBCORESHARED_EXPORT PDFFloatBitmapWithColorSpace : public PDFFloatB
 public:
     explicit PDFFloatBitmapWithColorSpace();
     explicit PDFFloatBitmapWithColorSpace(size_t width, size_t height, PDFPixelFormat format);
-    explicit PDFFloatBitmapWithColorSpace(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer blendColorSpace);
+    explicit PDFFloatBitmapWithColorSpace(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer blendColorSpace, StorageMode storageMode = StorageMode::Float);
 
     PDFColorSpacePointer getColorSpace() const;
     void setColorSpace(const PDFColorSpacePointer& colorSpace);
@@ -395,10 +479,36 @@ public:
     /// \param withSpots Add active spot colors?
     std::vector<ColorInfo> getSeparations(uint32_t processColorCount, bool withSpots = true) const;
 
-    /// Scan document for spot colors and fills color info
+    /// Scan document for spot colors and fills color info. Pages are
+    /// scanned in parallel, spot colors are ordered by the first page,
+    /// on which they are used.
     /// \param activate Set spot colors active?
     void createSpotColors(bool activate);
 
+    /// Scans given pages for spot colors and adds spot colors, which
+    /// are not yet present. Already present spot colors are kept, so
+    /// indices of separations don't change. This function can be used
+    /// for incremental discovery of spot colors (for example, current
+    /// page is scanned first and the rest of the document later).
+    /// \param pageIndices Page indices
+    /// \param activate Set new spot colors active?
+    void addSpotColors(const std::vector<PDFInteger>& pageIndices, bool activate);
+
+    /// Finds spot colors used on given pages. Spot colors of each page are cached
+    /// for the document. This function doesn't modify the ink mapper nor it accesses
+    /// its spot colors, so it can be called from a background thread. Result can be
+    /// added to the ink mapper using \p mergeSpotColors. Background scans should
+    /// not be parallel, so they don't occupy page thread pool needed by rendering.
+    /// \param pageIndices Page indices
+    /// \param parallel Scan pages in parallel (in page thread pool), or sequentially in calling thread?
+    std::vector<ColorInfo> findSpotColors(const std::vector<PDFInteger>& pageIndices, bool parallel = true) const;
+
+    /// Adds spot colors, which are not yet present. Already present
+    /// spot colors are kept.
+    /// \param spotColors Spot colors (typically from \p findSpotColors)
+    /// \param activate Set new spot colors active?
+    void mergeSpotColors(const std::vector<ColorInfo>& spotColors, bool activate);
+
     /// Returns true, if mapper contains given spot color
     /// \param colorName Color name
     bool containsSpotColor(const QByteArray& colorName) const;
@@ -445,6 +555,11 @@ public:
                                 PDFPixelFormat targetPixelFormat) const;
 
 private:
+    /// Scans page resources for spot colors. Color of the spot colors
+    /// is not computed (it depends on the color management system).
+    /// \param pageIndex Page index
+    std::vector<ColorInfo> scanPageSpotColors(PDFInteger pageIndex) const;
+
     const PDFCMSManager* m_cmsManager;
     const PDFDocument* m_document;
     std::vector<ColorInfo> m_spotColors;
@@ -452,6 +567,55 @@ private:
     size_t m_activeSpotColors = 0;
 };
 
+/// Cache of spot colors used on document pages, so the document is scanned
+/// only once, even if more ink mappers are created (for example, in output
+/// preview and in ink coverage). Spot colors are stored without converted
+/// color, because it depends on the color management system. This class
+/// is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFSpotColorCache
+{
+public:
+    struct Key
+    {
+        const PDFDocument* document = nullptr;
+        PDFInteger pageIndex = 0;
+
+        bool operator==(const Key& other) const
+        {
+            return std::tie(document, pageIndex) == std::tie(other.document, other.pageIndex);
+        }
+    };
+
+    static PDFSpotColorCache* getInstance();
+
+    /// Returns spot colors of the page. If page is not in the cache,
+    /// then false is returned.
+    /// \param key Key
+    /// \param spotColors Spot colors of the page
+    bool getSpotColors(const Key& key, std::vector<PDFInkMapper::ColorInfo>& spotColors) const;
+
+    /// Inserts spot colors of the page into the cache
+    /// \param key Key
+    /// \param spotColors Spot colors of the page
+    void setSpotColors(const Key& key, std::vector<PDFInkMapper::ColorInfo> spotColors);
+
+    /// Removes all pages of the document from the cache
+    /// \param document Document
+    void clear(const PDFDocument* document);
+
+    /// Sets cache limit (maximal number of pages)
+    /// \param cacheLimit Cache limit
+    void setCacheLimit(qsizetype cacheLimit);
+
+private:
+    explicit PDFSpotColorCache();
+
+    static constexpr qsizetype DEFAULT_CACHE_LIMIT = 65536;
+
+    mutable QMutex m_mutex;
+    QCache<Key, std::vector<PDFInkMapper::ColorInfo>> m_spotColors;
+};
+
 /// Painter path sampler. Returns shape value of pixel. This sampler
 /// uses MSAA with regular grid.
 class PDFPainterPathSampler
@@ -573,6 +737,10 @@ struct PDFTransparencyRendererSettings
     /// used when some shadings are being sampled.
     int shadingAlgorithmLimit = 64;
 
+    /// Size of the tile (in pixels) used by the tiled transparency
+    /// renderer. Each tile is rendered independently.
+    int tileSize = 512;
+
     enum Flag
     {
         None               = 0x0000,
@@ -617,6 +785,12 @@ struct PDFTransparencyRendererSettings
         /// and before separation simulation is applied. Active color mask
         /// is still applied to this image.
         SaveOriginalProcessImage    = 0x0400,
+
+        /// Store page-sized bitmaps, which are not actively painted into
+        /// (result bitmaps, original process image, backdrops of the parent
+        /// transparency groups), in reduced precision storage mode,
+        /// see PDFFloatBitmap::StorageMode.
+        ReducedPrecisionStorage     = 0x0800,
     };
 
     Q_DECLARE_FLAGS(Flags, Flag)
@@ -679,6 +853,19 @@ public:
     /// \param paperColor Paper color
     QImage toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const;
 
+    /// Converts float image to QImage, but only, if the float image is RGB. If error
+    /// occurs, empty image is returned. Also, result image can be painted onto opaque
+    /// paper with paper color \p paperColor.
+    /// \param floatImage Float image (in device color space)
+    /// \param use16bit Produce 16-bit image instead of standard 8-bit
+    /// \param usePaper Blend image with opaque paper, with color \p paperColor
+    /// \param paperColor Paper color
+    static QImage toImage(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit, bool usePaper, const PDFRGB& paperColor);
+
+    /// Returns result bitmap in the device color space. This function
+    /// should be called only after call to \p endPaint.
+    const PDFFloatBitmapWithColorSpace& getDeviceBitmap() const { return *getImmediateBackdrop(); }
+
     /// Clear color buffer with given color (this affects all process colors). If a number
     /// of process colors are different from a number of colors in color, then error is triggered,
     /// and most min(process color count, colors in color) process color channels are filled
@@ -795,7 +982,7 @@ private:
     PDFFloatBitmapWithColorSpace convertImageToBlendSpace(const PDFFloatBitmapWithColorSpace& image);
 
     /// Converts RGB bitmap to the image.
-    QImage toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit) const;
+    static QImage toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit);
 
     PDFFloatBitmapWithColorSpace* getInitialBackdrop();
     PDFFloatBitmapWithColorSpace* getImmediateBackdrop();
@@ -925,6 +1112,67 @@ private:
     PDFFloatBitmapWithColorSpace m_originalProcessBitmap;
 };
 
+/// Renders PDF page with transparency in tiles. Page is split into independent tiles,
+/// each tile is rendered by its own transparency renderer (so it has its own draw
+/// buffers and transparency group stack), and tiles are stitched into the result
+/// bitmaps. Tiles are rendered in parallel in the page thread pool, so number of tiles
+/// in flight (and memory used by them) is bounded by the number of threads in the pool.
+/// Content stream is interpreted for each tile (CPU time is traded for memory), but
+/// paths and images outside of the tile are skipped before they are rasterized.
+/// Do not use this renderer from the tasks running in the page thread pool.
+class PDF4QTLIBCORESHARED_EXPORT PDFTiledTransparencyRenderer
+{
+public:
+    PDFTiledTransparencyRenderer(const PDFPage* page,
+                                 const PDFDocument* document,
+                                 const PDFFontCache* fontCache,
+                                 const PDFCMS* cms,
+                                 const PDFOptionalContentActivity* optionalContentActivity,
+                                 const PDFInkMapper* inkMapper,
+                                 PDFTransparencyRendererSettings settings,
+                                 QTransform pagePointToDevicePointMatrix);
+
+    /// Sets device color space (see PDFTransparencyRenderer::setDeviceColorSpace)
+    /// \param colorSpace Color space
+    void setDeviceColorSpace(PDFColorSpacePointer colorSpace) { m_deviceColorSpace = qMove(colorSpace); }
+
+    /// Sets process color space (see PDFTransparencyRenderer::setProcessColorSpace)
+    /// \param colorSpace Color space
+    void setProcessColorSpace(PDFColorSpacePointer colorSpace) { m_processColorSpace = qMove(colorSpace); }
+
+    /// Renders the page in tiles and stitches the tiles into the result bitmaps.
+    /// Returns list of rendering errors (each error is reported only once,
+    /// even if it occured in several tiles).
+    /// \param pixelSize Size of the result bitmap
+    QList<PDFRenderError> render(QSize pixelSize);
+
+    /// Returns result bitmap in the device color space
+    const PDFFloatBitmapWithColorSpace& getDeviceBitmap() const { return m_deviceBitmap; }
+
+    /// Returns original process bitmap (see PDFTransparencyRenderer::getOriginalProcessBitmap)
+    const PDFFloatBitmapWithColorSpace& getOriginalProcessBitmap() const { return m_originalProcessBitmap; }
+
+    /// Converts result bitmap to the image (see PDFTransparencyRenderer::toImage)
+    /// \param use16bit Produce 16-bit image instead of standard 8-bit
+    /// \param usePaper Blend image with opaque paper, with color \p paperColor
+    /// \param paperColor Paper color
+    QImage toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const;
+
+private:
+    const PDFPage* m_page;
+    const PDFDocument* m_document;
+    const PDFFontCache* m_fontCache;
+    const PDFCMS* m_cms;
+    const PDFOptionalContentActivity* m_optionalContentActivity;
+    const PDFInkMapper* m_inkMapper;
+    PDFTransparencyRendererSettings m_settings;
+    QTransform m_pagePointToDevicePointMatrix;
+    PDFColorSpacePointer m_deviceColorSpace;
+    PDFColorSpacePointer m_processColorSpace;
+    PDFFloatBitmapWithColorSpace m_deviceBitmap;
+    PDFFloatBitmapWithColorSpace m_originalProcessBitmap;
+};
+
 /// Ink coverage calculator. Calculates ink coverage for a given
 /// page range. Calculates ink coverage of both cmyk colors and spot colors.
 class PDF4QTLIBCORESHARED_EXPORT PDFInkCoverageCalculator
@@ -955,6 +1203,22 @@ public:
     /// \param pages Page indices
     void perform(QSize size, const std::vector<PDFInteger>& pages);
 
+    using PageInkCoverageCallback = std::function<void(PDFInteger, const std::vector<InkCoverageChannelInfo>&)>;
+
+    /// Perform ink coverage calculations on given pages, without storing
+    /// results in this object. Pages are rendered in batches of at most
+    /// \p concurrency pages, and after each batch is finished, the callback
+    /// is called from the calling thread for each page of the batch in the
+    /// order of \p pages. So at most \p concurrency page images are kept
+    /// in memory at the same time. Pages, for which ink coverage can't
+    /// be calculated, are skipped.
+    /// \param size Resolution size (for ink coverage calculation)
+    /// \param pages Page indices
+    /// \param concurrency Maximal number of pages rendered at once (if zero
+    ///        or negative, ideal thread count for page scope is used)
+    /// \param callback Callback receiving ink coverage of a single page
+    void perform(QSize size, const std::vector<PDFInteger>& pages, int concurrency, const PageInkCoverageCallback& callback);
+
     /// Clear all calculated ink coverage results
     void clear();
 
@@ -978,6 +1242,12 @@ public:
     static InkCoverageChannelInfo* findCoverageInfoByName(std::vector<InkCoverageChannelInfo>& infos, const QByteArray& name);
 
 private:
+    /// Calculates ink coverage of a single page. If page can't be rendered,
+    /// empty vector is returned.
+    /// \param size Resolution size (for ink coverage calculation)
+    /// \param pageIndex Page index
+    std::vector<InkCoverageChannelInfo> calculatePageInkCoverage(QSize size, PDFInteger pageIndex) const;
+
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
     const PDFCMSManager* m_cmsManager;
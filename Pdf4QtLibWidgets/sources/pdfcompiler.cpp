@@ -74,6 +74,14 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
                         PDFRenderer renderer(proxy->getDocument(), proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(), proxy->getFeatures(), proxy->getMeshQualitySettings());
                         renderer.setOperationControl(m_compiler);
                         renderer.compile(&task.precompiledPage, task.pageIndex);
+
+                        // Blend2D display list must be counted in the page size in the cache
+                        const RendererEngine rendererEngine = proxy->getRendererEngine();
+                        if (rendererEngine == RendererEngine::Blend2D_MultiThread || rendererEngine == RendererEngine::Blend2D_SingleThread)
+                        {
+                            task.precompiledPage.createBLDisplayList();
+                        }
+
                         task.finished = true;
                         return compiledPage;
                     };
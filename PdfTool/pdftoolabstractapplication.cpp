@@ -182,6 +182,13 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addPositionalArgument("right", "Right (new) document to be compared.");
     }
 
+    if (optionFlags.testFlag(InkCoverage))
+    {
+        parser->addOption(QCommandLineOption("ink-reduced-precision", "Store rendered pages in 16-bit precision instead of 32-bit floats. Memory usage is lower, error of ink coverage ratios is below 0.001 %."));
+        parser->addOption(QCommandLineOption("ink-render-size", "Size of the rendered page image in pixels (longer side), in which ink coverage is calculated. Covered areas are always reported in mm^2, independently of this size.", "pixels", "1920"));
+        parser->addOption(QCommandLineOption("ink-concurrency", "Maximal number of pages rendered at once. Memory usage grows with this number. Zero means ideal thread count.", "count", "0"));
+    }
+
     if (optionFlags.testFlag(SignatureVerification))
     {
         parser->addOption(QCommandLineOption("ver-no-user-cert", "Disable user certificate store."));
@@ -894,6 +901,28 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.diffFiles = positionalArguments;
     }
 
+    if (optionFlags.testFlag(InkCoverage))
+    {
+        options.inkCoverageReducedPrecision = parser->isSet("ink-reduced-precision");
+
+        bool ok = false;
+        QString textValue = parser->value("ink-render-size");
+        options.inkCoverageRenderSize = textValue.toInt(&ok);
+        if (!ok || options.inkCoverageRenderSize <= 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid render size '%1'. Size 1920 pixels is used as default.").arg(textValue), options.outputCodec);
+            options.inkCoverageRenderSize = 1920;
+        }
+
+        textValue = parser->value("ink-concurrency");
+        options.inkCoverageConcurrency = textValue.toInt(&ok);
+        if (!ok || options.inkCoverageConcurrency < 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid concurrency '%1'. Ideal thread count is used as default.").arg(textValue), options.outputCodec);
+            options.inkCoverageConcurrency = 0;
+        }
+    }
+
     if (optionFlags.testFlag(Optimize))
     {
         options.optimizeFlags = pdf::PDFOptimizer::None;
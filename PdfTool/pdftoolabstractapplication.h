@@ -149,6 +149,11 @@ struct PDFToolOptions
     // For option 'Diff'
     QStringList diffFiles;
 
+    // For option 'InkCoverage'
+    bool inkCoverageReducedPrecision = false;
+    int inkCoverageRenderSize = 1920;
+    int inkCoverageConcurrency = 0;
+
     // For option 'Optimize'
     pdf::PDFOptimizer::OptimizationFlags optimizeFlags = pdf::PDFOptimizer::None;
 
@@ -252,6 +257,7 @@ public:
         CertStoreInstall                = 0x00400000,       ///< Settings for certificate store install certificate tool
         Encrypt                         = 0x00800000,       ///< Encryption settings
         Diff                            = 0x01000000,       ///< Diff settings (compare documents)
+        InkCoverage                     = 0x02000000,       ///< Ink coverage settings
     };
     Q_DECLARE_FLAGS(Options, Option)
 
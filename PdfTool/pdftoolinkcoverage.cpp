@@ -76,16 +76,16 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
     pdf::PDFInkMapper inkMapper(&cmsManager, &document);
     inkMapper.createSpotColors(true);
 
+    pdf::PDFTransparencyRendererSettings settings;
+    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::ReducedPrecisionStorage, options.inkCoverageReducedPrecision);
+
     pdf::PDFInkCoverageCalculator calculator(&document,
                                              &fontCache,
                                              &cmsManager,
                                              &optionalContentActivity,
                                              &inkMapper,
                                              nullptr,
-                                             pdf::PDFTransparencyRendererSettings());
-    calculator.perform(QSize(1920, 1920), pageIndices);
-
-    fontCache.setCacheShrinkEnabled(nullptr, true);
+                                             settings);
 
     PDFOutputFormatter formatter(options.outputStyle);
     formatter.beginDocument("ink-coverage", PDFToolTranslationContext::tr("Ink Coverage"));
@@ -94,25 +94,19 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
     formatter.beginTable("ink-coverage-by-page", PDFToolTranslationContext::tr("Ink Coverage by Page"));
 
     QLocale locale;
-    std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo> headerCoverage;
 
-    for (const pdf::PDFInteger pageIndex : pageIndices)
+    // Ink coverage is calculated in DeviceCMYK process color space,
+    // so all separations are known before any page is rendered and we can write
+    // the header first and then write rows of pages as they are calculated.
+    std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo> headerCoverage;
+    for (const pdf::PDFInkMapper::ColorInfo& colorInfo : inkMapper.getSeparations(4))
     {
-        const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>* coverage = calculator.getInkCoverage(pageIndex);
-
-        if (!coverage)
-        {
-            // Jakub Melka: Something bad happened?
-            continue;
-        }
-
-        for (const auto& info : *coverage)
-        {
-            if (!pdf::PDFInkCoverageCalculator::findCoverageInfoByName(headerCoverage, info.name))
-            {
-                headerCoverage.push_back(info);
-            }
-        }
+        pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo info;
+        info.name = colorInfo.name;
+        info.textName = colorInfo.textName;
+        info.isSpot = colorInfo.isSpot;
+        info.color = colorInfo.color;
+        headerCoverage.emplace_back(qMove(info));
     }
 
     formatter.beginTableHeaderRow("header");
@@ -124,29 +118,20 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
     }
     formatter.endTableHeaderRow();
 
-    for (const pdf::PDFInteger pageIndex : pageIndices)
+    auto writePageCoverage = [&](pdf::PDFInteger pageIndex, const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>& coverage)
     {
-        const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>* coverage = calculator.getInkCoverage(pageIndex);
-
-        if (!coverage)
-        {
-            // Jakub Melka: Something bad happened?
-            continue;
-        }
-
         formatter.beginTableRow("page-coverage", pageIndex + 1);
         formatter.writeTableColumn("page-no", locale.toString(pageIndex + 1), Qt::AlignRight);
 
-        for (const auto& info : headerCoverage)
+        for (auto& info : headerCoverage)
         {
-            const pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(*coverage, info.name);
-            pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* sumChannelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(headerCoverage, info.name);
+            const pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(coverage, info.name);
 
             if (channelInfo)
             {
                 formatter.writeTableColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->ratio * 100.0, 'f', 2), Qt::AlignRight);
                 formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->coveredArea, 'f', 2), Qt::AlignRight);
-                sumChannelInfo->coveredArea += channelInfo->coveredArea;
+                info.coveredArea += channelInfo->coveredArea;
             }
             else
             {
@@ -156,7 +141,18 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
         }
 
         formatter.endTableRow();
-    }
+
+        // No page is being rendered now, so we can release fonts
+        // over the cache limit. Otherwise the font cache would grow with the
+        // count of processed pages.
+        fontCache.setCacheShrinkEnabled(nullptr, true);
+        fontCache.setCacheShrinkEnabled(nullptr, false);
+    };
+
+    const int renderSize = options.inkCoverageRenderSize;
+    calculator.perform(QSize(renderSize, renderSize), pageIndices, options.inkCoverageConcurrency, writePageCoverage);
+
+    fontCache.setCacheShrinkEnabled(nullptr, true);
 
     // Summary
     formatter.beginTableRow("sum-coverage");
@@ -164,9 +160,8 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
 
     for (const auto& info : headerCoverage)
     {
-        const pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(headerCoverage, info.name);
         formatter.writeTableColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
-        formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->coveredArea, 'f', 2), Qt::AlignRight);
+        formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), locale.toString(info.coveredArea, 'f', 2), Qt::AlignRight);
     }
 
     formatter.endTableRow();
@@ -181,7 +176,7 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
 
 PDFToolAbstractApplication::Options PDFToolInkCoverageApplication::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | ColorManagementSystem;
+    return ConsoleFormat | OpenDocument | PageSelector | ColorManagementSystem | InkCoverage;
 }
 
 }   // namespace pdftool
@@ -27,8 +27,16 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfjbig2decoder.h"
+#include "pdfcolorspaces.h"
+#include "pdfcms.h"
+#include "pdfblendfunction.h"
+#include "pdftransparencyrenderer.h"
+#include "pdffont.h"
 
 #include <regex>
+#include <array>
+#include <random>
+#include <functional>
 
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(push)
@@ -59,13 +67,25 @@ private slots:
     void test_exponential_function();
     void test_stitching_function();
     void test_postscript_function();
+    void test_postscript_function_compiled();
+    void test_lookup_table_function();
     void test_jbig2_arithmetic_decoder();
+    void test_image_8bit_conversion();
+    void benchmark_image_8bit_conversion_data();
+    void benchmark_image_8bit_conversion();
+    void test_float_bitmap_blend();
+    void benchmark_float_bitmap_blend_data();
+    void benchmark_float_bitmap_blend();
+    void test_float_bitmap_reduced_precision();
+    void test_cmap_lookup();
+    void benchmark_cmap_interpret();
 
 private:
     void scanWholeStream(const char* stream);
     void testTokens(const char* stream, const std::vector<pdf::PDFLexicalAnalyzer::Token>& tokens);
 
     QString getStringFromTokens(const std::vector<pdf::PDFLexicalAnalyzer::Token>& tokens);
+    pdf::PDFFloatBitmap createRandomFloatBitmap(size_t width, size_t height, pdf::PDFPixelFormat format, std::mt19937& generator);
 };
 
 LexicalAnalyzerTest::LexicalAnalyzerTest()
@@ -1063,6 +1083,229 @@ void LexicalAnalyzerTest::test_postscript_function()
     test01("2.0 1 index exch div exch pop", [](double x) { return x / 2.0; });
 }
 
+void LexicalAnalyzerTest::test_postscript_function_compiled()
+{
+    const char* operators[] = { "add", "sub", "mul", "div", "idiv", "mod", "neg", "abs", "ceiling", "floor", "round", "truncate",
+                                "sqrt", "sin", "cos", "atan", "exp", "ln", "log", "cvi", "cvr", "eq", "ne", "gt", "ge", "lt", "le",
+                                "and", "or", "xor", "not", "bitshift", "true", "false", "pop", "exch", "dup", "2 copy", "1 index",
+                                "3 1 roll", "2 -1 roll" };
+
+    std::mt19937 generator(37);
+
+    // Generates random program, most of them are invalid, or can't be compiled,
+    // but compiled program must always give the same result as the interpreter.
+    std::function<QByteArray(int)> generateProgram = [&](int depth) -> QByteArray
+    {
+        QByteArray program;
+        const int length = generator() % 8 + 1;
+        for (int i = 0; i < length; ++i)
+        {
+            switch (generator() % 10)
+            {
+                case 0:
+                case 1:
+                    program += QByteArray::number(int(generator() % 7) - 2) + " ";
+                    break;
+
+                case 2:
+                case 3:
+                    program += QByteArray::number((int(generator() % 200) - 50) / 10.0, 'f', 1) + " ";
+                    break;
+
+                case 4:
+                    if (depth < 3)
+                    {
+                        program += "dup 0.5 gt { " + generateProgram(depth + 1) + "} { " + generateProgram(depth + 1) + "} ifelse ";
+                        break;
+                    }
+                    Q_FALLTHROUGH();
+
+                case 5:
+                    if (depth < 3)
+                    {
+                        program += "dup 0.5 lt { " + generateProgram(depth + 1) + "} if ";
+                        break;
+                    }
+                    Q_FALLTHROUGH();
+
+                default:
+                    program += QByteArray(operators[generator() % std::size(operators)]) + " ";
+                    break;
+            }
+        }
+        return program;
+    };
+
+    // Returns false, if compiled program gives different result than the interpreter
+    auto verify = [&](const QByteArray& program, uint32_t m, uint32_t n, bool mustBeCompiled, bool* isCompiled = nullptr) -> bool
+    {
+        pdf::PDFPostScriptFunction::Program parsedProgram;
+        try
+        {
+            parsedProgram = pdf::PDFPostScriptFunction::parseProgram(program);
+        }
+        catch (const pdf::PDFException&)
+        {
+            // Invalid program, nothing to verify
+            return !mustBeCompiled;
+        }
+
+        std::vector<pdf::PDFReal> domain;
+        std::vector<pdf::PDFReal> range;
+        domain.resize(2 * m, 0.0);
+        range.resize(2 * n, 0.0);
+        for (uint32_t i = 0; i < m; ++i)
+        {
+            domain[2 * i + 1] = 1.0;
+        }
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            range[2 * i] = -100.0;
+            range[2 * i + 1] = 100.0;
+        }
+
+        pdf::PDFPostScriptFunction function(m, n, std::move(domain), std::move(range), std::move(parsedProgram));
+        if (mustBeCompiled && !function.isCompiled())
+        {
+            qInfo() << qPrintable(QString("Program: %1 was not compiled").arg(QString::fromLatin1(program)));
+            return false;
+        }
+
+        if (isCompiled)
+        {
+            *isCompiled = function.isCompiled();
+        }
+
+        std::uniform_real_distribution<pdf::PDFReal> distribution(-0.5, 1.5);
+        for (int i = 0; i < 32; ++i)
+        {
+            std::array<pdf::PDFReal, 3> x = { distribution(generator), distribution(generator), distribution(generator) };
+            std::array<pdf::PDFReal, 3> yCompiled = { };
+            std::array<pdf::PDFReal, 3> yInterpreted = { };
+
+            pdf::PDFFunction::FunctionResult compiledResult = function.apply(x.data(), x.data() + m, yCompiled.data(), yCompiled.data() + n);
+            pdf::PDFFunction::FunctionResult interpretedResult = function.interpret(x.data(), x.data() + m, yInterpreted.data(), yInterpreted.data() + n);
+
+            if (bool(compiledResult) != bool(interpretedResult))
+            {
+                qInfo() << qPrintable(QString("Program: %1, evaluation differs").arg(QString::fromLatin1(program)));
+                return false;
+            }
+
+            for (uint32_t j = 0; compiledResult && j < n; ++j)
+            {
+                const bool isSame = (std::isnan(yCompiled[j]) && std::isnan(yInterpreted[j])) || qAbs(yCompiled[j] - yInterpreted[j]) < 1e-10;
+                if (!isSame)
+                {
+                    qInfo() << qPrintable(QString("Program: %1, expected: %2, actual: %3").arg(QString::fromLatin1(program)).arg(yInterpreted[j]).arg(yCompiled[j]));
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    };
+
+    // Typical programs must be compiled
+    QVERIFY(verify("dup mul", 1, 1, true));
+    QVERIFY(verify("100.0 mul cvi 10 idiv cvr 10.0 div", 1, 1, true));
+    QVERIFY(verify("dup 0.5 gt { 1.0 exch sub } { 2.0 mul } ifelse", 1, 1, true));
+    QVERIFY(verify("dup 0.5 lt { pop 0 } if", 1, 1, true));
+    QVERIFY(verify("dup 0.25 gt exch 0.75 lt and { 1.0 } { 0.0 } ifelse", 1, 1, true));
+    QVERIFY(verify("2.0 2 copy div 3 1 roll exp add", 1, 1, true));
+    QVERIFY(verify("2.0 1 index exch div exch pop", 1, 1, true));
+    QVERIFY(verify("dup 0.7 mul exch dup 0.2 mul exch 0.1 mul", 1, 3, true));
+    QVERIFY(verify("3 1 roll 1 index 0.0 eq { pop pop } { exch div mul } ifelse", 3, 1, true));
+    QVERIFY(verify("0.0 div", 1, 1, true));
+    QVERIFY(verify("0.5 sub ln", 1, 1, true));
+
+    int compiledCount = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const QByteArray program = generateProgram(0);
+        const uint32_t m = generator() % 3 + 1;
+        const uint32_t n = generator() % 3 + 1;
+
+        bool isCompiled = false;
+        QVERIFY(verify(program, m, n, false, &isCompiled));
+
+        if (isCompiled)
+        {
+            ++compiledCount;
+        }
+    }
+
+    QVERIFY(compiledCount > 0);
+}
+
+void LexicalAnalyzerTest::test_lookup_table_function()
+{
+    const char* stream = "dup 0.5 gt { 1.0 exch sub } { 2.0 mul } ifelse dup dup mul";
+
+    QByteArray data;
+    QDataStream dataStream(&data, QIODevice::WriteOnly);
+    QByteArray dictionaryData = QString(" << /FunctionType 4 /Domain [ 0 1 ] /Range [ 0 1 0 1 ] /Length %1 >> stream\n").arg(std::strlen(stream)).toLocal8Bit();
+    QByteArray remainder = " endstream";
+    dataStream.writeRawData(dictionaryData.constBegin(), dictionaryData.size());
+    dataStream.writeRawData(stream, int(std::strlen(stream)));
+    dataStream.writeRawData(remainder, remainder.size());
+
+    pdf::PDFDocument document;
+    pdf::PDFParser parser(data, nullptr, pdf::PDFParser::AllowStreams);
+    pdf::PDFFunctionPtr function = pdf::PDFFunction::createFunction(&document, parser.getObject());
+    pdf::PDFFunctionPtr optimizedFunction = pdf::PDFFunction::createOptimizedFunction(function);
+
+    QVERIFY(function);
+    QVERIFY(optimizedFunction);
+    QVERIFY(function != optimizedFunction);
+    QCOMPARE(optimizedFunction->getInputVariableCount(), 1u);
+    QCOMPARE(optimizedFunction->getOutputVariableCount(), 2u);
+
+    std::mt19937 generator(1024);
+    std::uniform_real_distribution<pdf::PDFReal> distribution(-0.5, 1.5);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const pdf::PDFReal x = distribution(generator);
+        std::array<pdf::PDFReal, 2> expected = { };
+        std::array<pdf::PDFReal, 2> actual = { };
+
+        QVERIFY(function->apply(&x, &x + 1, expected.data(), expected.data() + expected.size()));
+        QVERIFY(optimizedFunction->apply(&x, &x + 1, actual.data(), actual.data() + actual.size()));
+
+        // Function has derivative up to 2 and kink at 0.5, so error is
+        // bounded by the lookup table step.
+        const pdf::PDFReal tolerance = 4.0 / pdf::PDFLookupTableFunction::LOOKUP_TABLE_SIZE;
+        QVERIFY(qAbs(expected[0] - actual[0]) < tolerance);
+        QVERIFY(qAbs(expected[1] - actual[1]) < tolerance);
+    }
+
+    // Functions, which can't be evaluated in whole domain, are not optimized
+    pdf::PDFPostScriptFunction::Program program = pdf::PDFPostScriptFunction::parseProgram("0.5 sub ln");
+    pdf::PDFFunctionPtr invalidFunction = std::make_shared<pdf::PDFPostScriptFunction>(1, 1, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, std::vector<pdf::PDFReal>{ -10.0, 10.0 }, std::move(program));
+    QVERIFY(pdf::PDFFunction::createOptimizedFunction(invalidFunction) == invalidFunction);
+
+    // Stitching functions keep hard steps at subdomain bounds
+    pdf::PDFFunctionPtr lowerFunction = std::make_shared<pdf::PDFPostScriptFunction>(1, 1, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, pdf::PDFPostScriptFunction::parseProgram("0.5 mul"));
+    pdf::PDFFunctionPtr upperFunction = std::make_shared<pdf::PDFPostScriptFunction>(1, 1, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, pdf::PDFPostScriptFunction::parseProgram("pop 1.0"));
+    std::vector<pdf::PDFStitchingFunction::PartialFunction> partialFunctions;
+    partialFunctions.emplace_back(lowerFunction, 0.0, 0.5, 0.0, 1.0);
+    partialFunctions.emplace_back(upperFunction, 0.5, 1.0, 0.0, 1.0);
+    pdf::PDFFunctionPtr stitchingFunction = std::make_shared<pdf::PDFStitchingFunction>(1, 1, std::vector<pdf::PDFReal>{ 0.0, 1.0 }, std::vector<pdf::PDFReal>{ }, std::move(partialFunctions));
+    pdf::PDFFunctionPtr optimizedStitchingFunction = pdf::PDFFunction::createOptimizedFunction(stitchingFunction);
+    QVERIFY(optimizedStitchingFunction != stitchingFunction);
+    QVERIFY(dynamic_cast<const pdf::PDFStitchingFunction*>(optimizedStitchingFunction.get()));
+
+    for (const pdf::PDFReal x : { 0.25, 0.4999, 0.5, 0.5001, 0.75 })
+    {
+        pdf::PDFReal expected = 0.0;
+        pdf::PDFReal actual = 0.0;
+
+        QVERIFY(stitchingFunction->apply(&x, &x + 1, &expected, &expected + 1));
+        QVERIFY(optimizedStitchingFunction->apply(&x, &x + 1, &actual, &actual + 1));
+        QVERIFY(qAbs(expected - actual) < 1e-6);
+    }
+}
+
 void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()
 {
     std::vector<uint8_t> compressed = { 0x84, 0xC7, 0x3B, 0xFC, 0xE1, 0xA1, 0x43, 0x04, 0x02, 0x20, 0x00, 0x00, 0x41, 0x0D, 0xBB, 0x86, 0xF4, 0x31, 0x7F, 0xFF, 0x88, 0xFF, 0x37, 0x47, 0x1A, 0xDB, 0x6A, 0xDF, 0xFF, 0xAC };
@@ -1102,6 +1345,364 @@ void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()
     QVERIFY(decompressed == decompressedByAD);
 }
 
+void LexicalAnalyzerTest::test_image_8bit_conversion()
+{
+    pdf::PDFCMSGeneric cms;
+    pdf::PDFRenderErrorReporterDummy reporter;
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+
+    for (const char* colorSpaceName : { "DeviceGray", "DeviceRGB", "DeviceCMYK" })
+    {
+        pdf::PDFColorSpacePointer colorSpace = pdf::PDFAbstractColorSpace::createColorSpace(nullptr, nullptr, pdf::PDFObject::createName(colorSpaceName));
+        const unsigned int components = static_cast<unsigned int>(colorSpace->getColorComponentCount());
+        const unsigned int width = 97;
+        const unsigned int height = 31;
+        const unsigned int stride = width * components + 3;
+
+        QByteArray data(stride * height, 0);
+        for (char& value : data)
+        {
+            value = static_cast<char>(distribution(generator));
+        }
+
+        // Identity decode array forces generic (float) conversion path
+        std::vector<pdf::PDFReal> identityDecode;
+        for (unsigned int i = 0; i < components; ++i)
+        {
+            identityDecode.insert(identityDecode.end(), { 0.0, 1.0 });
+        }
+
+        pdf::PDFImageData imageData8Bit(components, 8, width, height, stride, pdf::PDFImageData::MaskingType::None, data, { }, { }, { });
+        pdf::PDFImageData imageDataGeneric(components, 8, width, height, stride, pdf::PDFImageData::MaskingType::None, data, { }, std::move(identityDecode), { });
+
+        QImage image8Bit = colorSpace->getImage(imageData8Bit, pdf::PDFImageData(), &cms, pdf::RenderingIntent::Perceptual, &reporter, nullptr);
+        QImage imageGeneric = colorSpace->getImage(imageDataGeneric, pdf::PDFImageData(), &cms, pdf::RenderingIntent::Perceptual, &reporter, nullptr);
+
+        QCOMPARE(image8Bit.size(), imageGeneric.size());
+        for (int y = 0; y < image8Bit.height(); ++y)
+        {
+            for (int x = 0; x < image8Bit.width(); ++x)
+            {
+                QRgb pixel8Bit = image8Bit.pixel(x, y);
+                QRgb pixelGeneric = imageGeneric.pixel(x, y);
+
+                QVERIFY2(qAbs(qRed(pixel8Bit) - qRed(pixelGeneric)) <= 1 &&
+                         qAbs(qGreen(pixel8Bit) - qGreen(pixelGeneric)) <= 1 &&
+                         qAbs(qBlue(pixel8Bit) - qBlue(pixelGeneric)) <= 1,
+                         qPrintable(QString("%1: pixel (%2, %3) differs").arg(colorSpaceName).arg(x).arg(y)));
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::benchmark_image_8bit_conversion_data()
+{
+    QTest::addColumn<QByteArray>("colorSpaceName");
+    QTest::addColumn<bool>("useDecode");
+
+    QTest::newRow("DeviceGray 8-bit") << QByteArray("DeviceGray") << false;
+    QTest::newRow("DeviceGray generic") << QByteArray("DeviceGray") << true;
+    QTest::newRow("DeviceRGB 8-bit") << QByteArray("DeviceRGB") << false;
+    QTest::newRow("DeviceRGB generic") << QByteArray("DeviceRGB") << true;
+    QTest::newRow("DeviceCMYK 8-bit") << QByteArray("DeviceCMYK") << false;
+    QTest::newRow("DeviceCMYK generic") << QByteArray("DeviceCMYK") << true;
+}
+
+void LexicalAnalyzerTest::benchmark_image_8bit_conversion()
+{
+    QFETCH(QByteArray, colorSpaceName);
+    QFETCH(bool, useDecode);
+
+    pdf::PDFCMSGeneric cms;
+    pdf::PDFRenderErrorReporterDummy reporter;
+    pdf::PDFColorSpacePointer colorSpace = pdf::PDFAbstractColorSpace::createColorSpace(nullptr, nullptr, pdf::PDFObject::createName(colorSpaceName));
+
+    // Simulates large scanned page
+    const unsigned int components = static_cast<unsigned int>(colorSpace->getColorComponentCount());
+    const unsigned int width = 1700;
+    const unsigned int height = 2200;
+    const unsigned int stride = width * components;
+
+    QByteArray data(stride * height, 0);
+    for (int i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(i * 31);
+    }
+
+    std::vector<pdf::PDFReal> decode;
+    if (useDecode)
+    {
+        for (unsigned int i = 0; i < components; ++i)
+        {
+            decode.insert(decode.end(), { 0.0, 1.0 });
+        }
+    }
+
+    pdf::PDFImageData imageData(components, 8, width, height, stride, pdf::PDFImageData::MaskingType::None, data, { }, std::move(decode), { });
+
+    QBENCHMARK
+    {
+        QImage image = colorSpace->getImage(imageData, pdf::PDFImageData(), &cms, pdf::RenderingIntent::Perceptual, &reporter, nullptr);
+        QVERIFY(!image.isNull());
+    }
+}
+
+void LexicalAnalyzerTest::test_float_bitmap_blend()
+{
+    std::mt19937 generator(42);
+
+    const size_t width = 37;
+    const size_t height = 23;
+    const QRect blendRegion(3, 2, 31, 19);
+
+    const std::vector<std::pair<const char*, pdf::PDFPixelFormat>> formats = {
+        { "Gray", pdf::PDFPixelFormat::createFormatDefaultGray(0) },
+        { "RGB", pdf::PDFPixelFormat::createFormatDefaultRGB(0) },
+        { "CMYK", pdf::PDFPixelFormat::createFormatDefaultCMYK(0) },
+        { "RGB + 2 spots", pdf::PDFPixelFormat::createFormatDefaultRGB(2) },
+        { "CMYK + 4 spots", pdf::PDFPixelFormat::createFormatDefaultCMYK(4) },
+        { "CMYK + 4 spots, active color mask", pdf::PDFPixelFormat::createFormat(4, 4, true, true, true) }
+    };
+
+    for (const auto& formatItem : formats)
+    {
+        const pdf::PDFPixelFormat format = formatItem.second;
+        const pdf::PDFFloatBitmap source = createRandomFloatBitmap(width, height, format, generator);
+        const pdf::PDFFloatBitmap initialBackdrop = createRandomFloatBitmap(width, height, format, generator);
+        const pdf::PDFFloatBitmap target = createRandomFloatBitmap(width, height, format, generator);
+        const pdf::PDFFloatBitmap softMask = createRandomFloatBitmap(width, height, pdf::PDFPixelFormat::createOpacityMask(), generator);
+
+        for (const pdf::BlendMode mode : pdf::PDFBlendModeInfo::getBlendModes())
+        {
+            if (!pdf::PDFBlendModeInfo::isSeparable(mode))
+            {
+                continue;
+            }
+
+            for (const bool alphaIsShape : { false, true })
+            {
+                for (const bool knockoutGroup : { false, true })
+                {
+                    pdf::PDFFloatBitmap targetKernel = target;
+                    pdf::PDFFloatBitmap targetGeneric = target;
+
+                    // Backdrop is the target itself, as in non-knockout transparency groups
+                    pdf::PDFFloatBitmap::blend(source, targetKernel, knockoutGroup ? initialBackdrop : targetKernel, initialBackdrop, softMask, alphaIsShape, 0.75f, mode, knockoutGroup, pdf::PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
+                    pdf::PDFFloatBitmap::blendGeneric(source, targetGeneric, knockoutGroup ? initialBackdrop : targetGeneric, initialBackdrop, softMask, alphaIsShape, 0.75f, mode, knockoutGroup, pdf::PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
+
+                    const QString name = QString("%1, %2, alphaIsShape = %3, knockout = %4").arg(formatItem.first, pdf::PDFBlendModeInfo::getBlendModeName(mode)).arg(alphaIsShape).arg(knockoutGroup);
+
+                    for (size_t y = 0; y < height; ++y)
+                    {
+                        for (size_t x = 0; x < width; ++x)
+                        {
+                            pdf::PDFConstColorBuffer pixelKernel = std::as_const(targetKernel).getPixel(x, y);
+                            pdf::PDFConstColorBuffer pixelGeneric = std::as_const(targetGeneric).getPixel(x, y);
+
+                            for (size_t i = 0; i < pixelKernel.size(); ++i)
+                            {
+                                const pdf::PDFColorComponent difference = qAbs(pixelKernel[i] - pixelGeneric[i]);
+                                QVERIFY2(difference <= 1e-4f * qMax(1.0f, qAbs(pixelGeneric[i])), qPrintable(QString("%1: pixel (%2, %3), channel %4 differs").arg(name).arg(x).arg(y).arg(i)));
+                            }
+
+                            if (format.hasActiveColorMask())
+                            {
+                                QCOMPARE(targetKernel.getPixelActiveColorMask(x, y), targetGeneric.getPixelActiveColorMask(x, y));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::benchmark_float_bitmap_blend_data()
+{
+    QTest::addColumn<int>("processColors");
+    QTest::addColumn<int>("spotColors");
+    QTest::addColumn<bool>("useGeneric");
+
+    QTest::newRow("Gray kernel") << 1 << 0 << false;
+    QTest::newRow("Gray generic") << 1 << 0 << true;
+    QTest::newRow("RGB kernel") << 3 << 0 << false;
+    QTest::newRow("RGB generic") << 3 << 0 << true;
+    QTest::newRow("CMYK kernel") << 4 << 0 << false;
+    QTest::newRow("CMYK generic") << 4 << 0 << true;
+    QTest::newRow("CMYK + 4 spots kernel") << 4 << 4 << false;
+    QTest::newRow("CMYK + 4 spots generic") << 4 << 4 << true;
+    QTest::newRow("CMYK + 8 spots kernel") << 4 << 8 << false;
+    QTest::newRow("CMYK + 8 spots generic") << 4 << 8 << true;
+}
+
+void LexicalAnalyzerTest::benchmark_float_bitmap_blend()
+{
+    QFETCH(int, processColors);
+    QFETCH(int, spotColors);
+    QFETCH(bool, useGeneric);
+
+    std::mt19937 generator(42);
+
+    const pdf::PDFPixelFormat format = pdf::PDFPixelFormat::createFormat(static_cast<uint8_t>(processColors), static_cast<uint8_t>(spotColors), true, processColors == 4, false);
+    const size_t width = 1024;
+    const size_t height = 1024;
+    const QRect blendRegion(0, 0, int(width), int(height));
+
+    const pdf::PDFFloatBitmap source = createRandomFloatBitmap(width, height, format, generator);
+    const pdf::PDFFloatBitmap initialBackdrop = createRandomFloatBitmap(width, height, format, generator);
+    const pdf::PDFFloatBitmap softMask = createRandomFloatBitmap(width, height, pdf::PDFPixelFormat::createOpacityMask(), generator);
+    pdf::PDFFloatBitmap target = createRandomFloatBitmap(width, height, format, generator);
+
+    auto blendFunction = useGeneric ? &pdf::PDFFloatBitmap::blendGeneric : &pdf::PDFFloatBitmap::blend;
+
+    QBENCHMARK
+    {
+        blendFunction(source, target, target, initialBackdrop, softMask, false, 0.75f, pdf::BlendMode::Multiply, false, pdf::PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
+    }
+}
+
+void LexicalAnalyzerTest::test_float_bitmap_reduced_precision()
+{
+    std::mt19937 generator(42);
+
+    const size_t width = 37;
+    const size_t height = 23;
+    const pdf::PDFPixelFormat format = pdf::PDFPixelFormat::createFormat(4, 4, true, true, true);
+    const pdf::PDFFloatBitmap bitmap = createRandomFloatBitmap(width, height, format, generator);
+
+    // Documented accuracy bound of reduced precision storage mode
+    const pdf::PDFColorComponent maximalError = 7.7e-6f;
+
+    pdf::PDFFloatBitmap reducedBitmap(width, height, format, pdf::PDFFloatBitmap::StorageMode::Fixed16);
+    reducedBitmap.copyBitmap(bitmap, 0, 0);
+
+    pdf::PDFFloatBitmap convertedBitmap = bitmap;
+    convertedBitmap.setStorageMode(pdf::PDFFloatBitmap::StorageMode::Fixed16);
+    convertedBitmap.setStorageMode(pdf::PDFFloatBitmap::StorageMode::Float);
+
+    pdf::PDFFloatBitmap regionBitmap(width - 3, height - 2, format);
+    regionBitmap.copyRegion(reducedBitmap, 3, 2);
+
+    std::vector<pdf::PDFColorComponent> pixel(bitmap.getPixelSize(), 0.0f);
+    pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            pdf::PDFConstColorBuffer original = bitmap.getPixel(x, y);
+            pdf::PDFConstColorBuffer converted = std::as_const(convertedBitmap).getPixel(x, y);
+            reducedBitmap.readPixel(x, y, buffer);
+
+            for (size_t i = 0; i < buffer.size(); ++i)
+            {
+                QVERIFY(qAbs(buffer[i] - original[i]) <= maximalError);
+                QVERIFY(qAbs(converted[i] - original[i]) <= maximalError);
+
+                if (x >= 3 && y >= 2)
+                {
+                    QCOMPARE(std::as_const(regionBitmap).getPixel(x - 3, y - 2)[i], buffer[i]);
+                }
+            }
+
+            QCOMPARE(reducedBitmap.getPixelInkCoverage(x, y), convertedBitmap.getPixelInkCoverage(x, y));
+            QCOMPARE(reducedBitmap.getPixelActiveColorMask(x, y), bitmap.getPixelActiveColorMask(x, y));
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_cmap_lookup()
+{
+    const char* cmapData = "/WMode 0 def\n"
+                           "2 begincodespacerange <00> <80> <8140> <FFFF> endcodespacerange\n"
+                           "3 begincidrange\n"
+                           "<20> <7e> 1\n"
+                           "<8140> <817e> 633\n"
+                           "<8180> <81ac> 696\n"
+                           "endcidrange\n"
+                           "1 begincidchar\n"
+                           "<41> 500\n"
+                           "endcidchar\n";
+
+    pdf::PDFFontCMap cmap = pdf::PDFFontCMap::createFromData(QByteArray(cmapData));
+    QVERIFY(cmap.isValid());
+    QVERIFY(!cmap.isVertical());
+
+    // First suitable entry is used, so range <20> <7e> takes precedence over character <41>
+    const std::vector<pdf::CID> expectedCIDs = { 34, 633, 696, 0 };
+    const QByteArray codes("\x41\x81\x40\x81\x80\x90\x90", 7);
+    QCOMPARE(cmap.interpret(codes), expectedCIDs);
+    QCOMPARE(pdf::PDFFontCMap::deserialize(cmap.serialize()).interpret(codes), expectedCIDs);
+    QVERIFY(pdf::PDFFontCMap().interpret(codes).empty());
+
+    const char* toUnicodeData = "2 beginbfchar\n"
+                                "<0003> <0020>\n"
+                                "<0011> <002E>\n"
+                                "endbfchar\n"
+                                "1 beginbfrange\n"
+                                "<0024> <0026> <0041>\n"
+                                "endbfrange\n";
+
+    pdf::PDFFontCMap toUnicode = pdf::PDFFontCMap::createFromData(QByteArray(toUnicodeData));
+    QCOMPARE(toUnicode.getToUnicode(0x03), QChar(' '));
+    QCOMPARE(toUnicode.getToUnicode(0x11), QChar('.'));
+    QCOMPARE(toUnicode.getToUnicode(0x24), QChar('A'));
+    QCOMPARE(toUnicode.getToUnicode(0x26), QChar('C'));
+    QVERIFY(toUnicode.getToUnicode(0x27).isNull());
+    QVERIFY(toUnicode.getToUnicode(0x10000).isNull());
+    QCOMPARE(toUnicode.interpret(QByteArray("\x00\x25", 2)), std::vector<pdf::CID>({ 0x42 }));
+
+    // Heavily overlapping ranges exceed the table fill limit, entries are searched
+    QByteArray overlappingData = "200 begincidrange\n";
+    for (int i = 0; i < 200; ++i)
+    {
+        overlappingData += QString("<0000> <ffff> %1\n").arg(i + 5).toLatin1();
+    }
+    overlappingData += "endcidrange\n";
+
+    pdf::PDFFontCMap overlapping = pdf::PDFFontCMap::createFromData(overlappingData);
+    QVERIFY(overlapping.isValid());
+    const std::vector<pdf::CID> overlappingCIDs = overlapping.interpret(QByteArray("\x00\x41\x81\x40", 4));
+    QCOMPARE(overlappingCIDs.size(), size_t(2));
+    const pdf::CID offset = overlappingCIDs[0] - 0x41;
+    QVERIFY(offset >= 5 && offset < 205);
+    QCOMPARE(overlappingCIDs[1], 0x8140 + offset);
+    QCOMPARE(overlapping.getToUnicode(0x0001), QChar(char16_t(0x0001 + offset)));
+}
+
+void LexicalAnalyzerTest::benchmark_cmap_interpret()
+{
+    // Simulates large CJK CMap, text is encoded using two byte codes
+    QByteArray cmapData = "1000 begincidrange\n";
+    for (int i = 0; i < 1000; ++i)
+    {
+        const int from = 0x8140 + i * 32;
+        cmapData += QString("<%1> <%2> %3\n").arg(from, 4, 16, QChar('0')).arg(from + 30, 4, 16, QChar('0')).arg(i * 31 + 1).toLatin1();
+    }
+    cmapData += "endcidrange\n";
+
+    pdf::PDFFontCMap cmap = pdf::PDFFontCMap::createFromData(cmapData);
+    QVERIFY(cmap.isValid());
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 1000 * 32 - 1);
+
+    QByteArray text;
+    for (int i = 0; i < 100000; ++i)
+    {
+        const int code = 0x8140 + distribution(generator);
+        text.append(static_cast<char>(code >> 8));
+        text.append(static_cast<char>(code & 0xFF));
+    }
+
+    QBENCHMARK
+    {
+        std::vector<pdf::CID> cids = cmap.interpret(text);
+        QCOMPARE(cids.size(), size_t(100000));
+    }
+}
+
 void LexicalAnalyzerTest::scanWholeStream(const char* stream)
 {
     pdf::PDFLexicalAnalyzer analyzer(stream, stream + strlen(stream));
@@ -1158,6 +1759,38 @@ QString LexicalAnalyzerTest::getStringFromTokens(const std::vector<pdf::PDFLexic
     return QString("{ %1 }").arg(stringTokens.join(", "));
 }
 
+pdf::PDFFloatBitmap LexicalAnalyzerTest::createRandomFloatBitmap(size_t width, size_t height, pdf::PDFPixelFormat format, std::mt19937& generator)
+{
+    std::uniform_real_distribution<pdf::PDFColorComponent> distribution(0.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> maskDistribution(0, pdf::PDFPixelFormat::getAllColorsMask());
+
+    pdf::PDFFloatBitmap bitmap(width, height, format);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            pdf::PDFColorBuffer pixel = bitmap.getPixel(x, y);
+            for (pdf::PDFColorComponent& value : pixel)
+            {
+                value = distribution(generator);
+            }
+
+            // Some pixels are fully transparent, so color is undefined
+            if (format.hasOpacityChannel() && (x + y) % 7 == 0)
+            {
+                pixel[format.getOpacityChannelIndex()] = 0.0f;
+            }
+
+            if (format.hasActiveColorMask())
+            {
+                bitmap.markPixelActiveColorMask(x, y, maskDistribution(generator));
+            }
+        }
+    }
+
+    return bitmap;
+}
+
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(pop)
 #endif